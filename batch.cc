@@ -0,0 +1,296 @@
+/*============================================================================
+ *    Contains:
+ *        S_validate_batch, S_solpos_batch, S_solpos_columns,
+ *        S_batch_slice, S_columns_slice, S_batch_row
+ *
+ *        The range checks mirror S_validate in solpos.cc one for one;
+ *        keep the two in step.
+ *----------------------------------------------------------------------------*/
+#include "batch.h"
+
+#include <cmath>
+#include <limits>
+
+#include "solpos_internal.h"
+
+namespace solpos {
+
+namespace internal {
+
+/* every member of poscolumns, so a column added there without a table
+   entry fails to compile */
+static_assert(sizeof(poscolumns) == kPosColumns * sizeof(double *),
+              "kPosColumn must list every poscolumns member");
+
+double *poscolumns::*const kPosColumn[kPosColumns] = {
+    &poscolumns::amass,   &poscolumns::ampress, &poscolumns::azim,
+    &poscolumns::cosinc,  &poscolumns::coszen,  &poscolumns::declin,
+    &poscolumns::elevref, &poscolumns::erv,     &poscolumns::etr,
+    &poscolumns::etrn,    &poscolumns::etrtilt, &poscolumns::hrang,
+    &poscolumns::prime,   &poscolumns::sbcf,    &poscolumns::sretr,
+    &poscolumns::ssetr,   &poscolumns::unprime, &poscolumns::zenref};
+
+double posdata::*const kPosMember[kPosColumns] = {
+    &posdata::amass,   &posdata::ampress, &posdata::azim,
+    &posdata::cosinc,  &posdata::coszen,  &posdata::declin,
+    &posdata::elevref, &posdata::erv,     &posdata::etr,
+    &posdata::etrn,    &posdata::etrtilt, &posdata::hrang,
+    &posdata::prime,   &posdata::sbcf,    &posdata::sretr,
+    &posdata::ssetr,   &posdata::unprime, &posdata::zenref};
+
+}  // namespace internal
+
+/*============================================================================
+*    Local function prototypes
+============================================================================*/
+template <typename T>
+static void or_outside(const T *x, int count, T lo, T hi, int bit,
+                       int *errors);
+static void or_time(const posbatch *batch, int *errors);
+static void or_epoch(const posbatch *batch, int *errors);
+
+/*============================================================================
+ *    Local void function or_outside
+ *
+ *    Sets bit in errors[i] for every x[i] outside [lo, hi].  Written
+ *    without branches so that it vectorizes.
+ *----------------------------------------------------------------------------*/
+template <typename T>
+static void or_outside(const T *x, int count, T lo, T hi, int bit,
+                       int *errors) {
+  for (int i = 0; i < count; ++i)
+    errors[i] |= static_cast<int>((x[i] < lo) | (x[i] > hi)) << bit;
+}
+
+/*============================================================================
+ *    Local void function or_time
+ *
+ *    The hour, minute and second checks, which interact at hour 24
+ *----------------------------------------------------------------------------*/
+static void or_time(const posbatch *batch, int *errors) {
+  const posdata *base = batch->base;
+
+  for (int i = 0; i < batch->count; ++i) {
+    int h = batch->hour ? batch->hour[i] : base->hour;
+    int m = batch->minute ? batch->minute[i] : base->minute;
+    int s = batch->second ? batch->second[i] : base->second;
+    int h24m = (h == 24) & (m > 0); /* no more than 24 hrs */
+    int h24s = (h == 24) & (s > 0);
+
+    errors[i] |= (((h < 0) | (h > 24) | h24m | h24s) << S_HOUR_ERROR) |
+                 (((m < 0) | (m > 59) | h24m) << S_MINUTE_ERROR) |
+                 (((s < 0) | (s > 59) | h24s) << S_SECOND_ERROR);
+  }
+}
+
+/*============================================================================
+ *    Local void function or_epoch
+ *
+ *    The S_EPOCH checks: local standard year 1950 - 2050, and epochfrac
+ *----------------------------------------------------------------------------*/
+static void or_epoch(const posbatch *batch, int *errors) {
+  const posdata *base = batch->base;
+  const long long lo = S_epoch(1950, 1, 1, 0, 0, 0, 0.0);
+  const long long hi = S_epoch(2051, 1, 1, 0, 0, 0, 0.0) - 1;
+
+  if (batch->timezone) {
+    for (int i = 0; i < batch->count; ++i) {
+      long long t = batch->epoch ? batch->epoch[i] : base->epoch;
+      long long local = t + std::llround(batch->timezone[i] * 3600.0);
+      errors[i] |= static_cast<int>((local < lo) | (local > hi))
+                   << S_YEAR_ERROR;
+    }
+  } else if (batch->epoch) {
+    /* (one time zone: shift the bounds instead of every row) */
+    const long long shift = std::llround(base->timezone * 3600.0);
+    or_outside(batch->epoch, batch->count, lo - shift, hi - shift,
+               S_YEAR_ERROR, errors);
+  }
+
+  if (batch->epochfrac) {
+    for (int i = 0; i < batch->count; ++i) {
+      double f = batch->epochfrac[i];
+      errors[i] |= static_cast<int>(!((f >= 0.0) & (f < 1.0)))
+                   << S_SECOND_ERROR;
+    }
+  }
+}
+
+/*============================================================================
+ *    Int function S_validate_batch
+ *----------------------------------------------------------------------------*/
+int S_validate_batch(const posbatch *batch, int *errors) {
+  const posdata *base = batch->base;
+  const int function = base->function;
+  const int n = batch->count;
+  int columns = 0; /* error bits decided per row rather than by base */
+  int summary = 0;
+
+  if (function & S_EPOCH) {
+    if (batch->epoch || batch->timezone) columns |= 1L << S_YEAR_ERROR;
+    if (batch->epochfrac) columns |= 1L << S_SECOND_ERROR;
+  } else {
+    if (batch->year) columns |= 1L << S_YEAR_ERROR;
+    if (batch->month) columns |= 1L << S_MONTH_ERROR;
+    if (batch->day) columns |= 1L << S_DAY_ERROR;
+    if (batch->daynum) columns |= 1L << S_DOY_ERROR;
+    if (batch->hour || batch->minute || batch->second)
+      columns |= (1L << S_HOUR_ERROR) | (1L << S_MINUTE_ERROR) |
+                 (1L << S_SECOND_ERROR);
+  }
+  if (batch->interval) columns |= 1L << S_INTRVL_ERROR;
+  if (batch->timezone) columns |= 1L << S_TZONE_ERROR;
+  if (batch->latitude) columns |= 1L << S_LAT_ERROR;
+  if (batch->longitude) columns |= 1L << S_LON_ERROR;
+  if (batch->temp) columns |= 1L << S_TEMP_ERROR;
+  if (batch->press) columns |= 1L << S_PRESS_ERROR;
+  if (batch->tilt) columns |= 1L << S_TILT_ERROR;
+  if (batch->aspect) columns |= 1L << S_ASPECT_ERROR;
+
+  /* Inputs shared by all rows are checked once */
+  const int common = S_validate(base) & ~columns;
+  for (int i = 0; i < n; ++i) errors[i] = common;
+
+  if ((function & L_GEOM) && (function & S_EPOCH)) {
+    or_epoch(batch, errors);
+  } else if (function & L_GEOM) {
+    if (batch->year)
+      or_outside(batch->year, n, 1950, 2050, S_YEAR_ERROR, errors);
+    if (!(function & S_DOY)) {
+      if (batch->month)
+        or_outside(batch->month, n, 1, 12, S_MONTH_ERROR, errors);
+      if (batch->day) or_outside(batch->day, n, 1, 31, S_DAY_ERROR, errors);
+    } else if (batch->daynum) {
+      or_outside(batch->daynum, n, 1, 366, S_DOY_ERROR, errors);
+    }
+    if (columns & (1L << S_HOUR_ERROR)) or_time(batch, errors);
+  }
+
+  if (function & L_GEOM) {
+    if (batch->timezone)
+      or_outside(batch->timezone, n, -12.0, 12.0, S_TZONE_ERROR, errors);
+    if (batch->interval)
+      or_outside(batch->interval, n, 0, 28800, S_INTRVL_ERROR, errors);
+    if (batch->longitude)
+      or_outside(batch->longitude, n, -180.0, 180.0, S_LON_ERROR, errors);
+    if (batch->latitude)
+      or_outside(batch->latitude, n, -90.0, 90.0, S_LAT_ERROR, errors);
+  }
+
+  if ((function & L_REFRAC) && batch->temp)
+    or_outside(batch->temp, n, -100.0, 100.0, S_TEMP_ERROR, errors);
+
+  /* (the upper pressure limit applies whatever the function switch) */
+  if (batch->press) {
+    const double lowest = (function & L_REFRAC)
+                              ? 0.0
+                              : -std::numeric_limits<double>::infinity();
+    or_outside(batch->press, n, lowest, 2000.0, S_PRESS_ERROR, errors);
+  }
+
+  if ((function & L_TILT) && batch->tilt)
+    or_outside(batch->tilt, n, -180.0, 180.0, S_TILT_ERROR, errors);
+
+  if ((function & L_TILT) && batch->aspect)
+    or_outside(batch->aspect, n, -360.0, 360.0, S_ASPECT_ERROR, errors);
+
+  for (int i = 0; i < n; ++i) summary |= errors[i];
+  return summary;
+}
+
+/*============================================================================
+ *    Void function S_batch_row
+ *----------------------------------------------------------------------------*/
+void S_batch_row(const posbatch *batch, int i, posdata *pdat) {
+  *pdat = *batch->base;
+  if (batch->year) pdat->year = batch->year[i];
+  if (batch->month) pdat->month = batch->month[i];
+  if (batch->day) pdat->day = batch->day[i];
+  if (batch->daynum) pdat->daynum = batch->daynum[i];
+  if (batch->hour) pdat->hour = batch->hour[i];
+  if (batch->minute) pdat->minute = batch->minute[i];
+  if (batch->second) pdat->second = batch->second[i];
+  if (batch->interval) pdat->interval = batch->interval[i];
+  if (batch->latitude) pdat->latitude = batch->latitude[i];
+  if (batch->longitude) pdat->longitude = batch->longitude[i];
+  if (batch->timezone) pdat->timezone = batch->timezone[i];
+  if (batch->press) pdat->press = batch->press[i];
+  if (batch->temp) pdat->temp = batch->temp[i];
+  if (batch->tilt) pdat->tilt = batch->tilt[i];
+  if (batch->aspect) pdat->aspect = batch->aspect[i];
+  if (batch->epoch) pdat->epoch = batch->epoch[i];
+  if (batch->epochfrac) pdat->epochfrac = batch->epochfrac[i];
+}
+
+/*============================================================================
+ *    Int function S_solpos_batch
+ *----------------------------------------------------------------------------*/
+int S_solpos_batch(const posbatch *batch, int *errors, posdata *out) {
+  int summary = S_validate_batch(batch, errors);
+
+  for (int i = 0; i < batch->count; ++i) {
+    S_batch_row(batch, i, &out[i]);
+    if (errors[i] == 0) internal::compute(&out[i]);
+  }
+  return summary;
+}
+
+/*============================================================================
+ *    Int function S_solpos_columns
+ *----------------------------------------------------------------------------*/
+int S_solpos_columns(const posbatch *batch, int *errors,
+                     const poscolumns *out) {
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  int summary = S_validate_batch(batch, errors);
+  posdata pd; /* the one row being computed */
+
+  for (int i = 0; i < batch->count; ++i) {
+    S_batch_row(batch, i, &pd);
+    if (errors[i] == 0) internal::compute(&pd);
+    for (int k = 0; k < internal::kPosColumns; ++k) {
+      double *column = out->*internal::kPosColumn[k];
+      if (column) column[i] = errors[i] ? nan : pd.*internal::kPosMember[k];
+    }
+  }
+  return summary;
+}
+
+/*============================================================================
+ *    Void function S_batch_slice
+ *----------------------------------------------------------------------------*/
+void S_batch_slice(const posbatch *batch, int first, int count,
+                   posbatch *slice) {
+  *slice = *batch;
+  slice->count = count;
+  if (slice->year) slice->year += first;
+  if (slice->month) slice->month += first;
+  if (slice->day) slice->day += first;
+  if (slice->daynum) slice->daynum += first;
+  if (slice->hour) slice->hour += first;
+  if (slice->minute) slice->minute += first;
+  if (slice->second) slice->second += first;
+  if (slice->interval) slice->interval += first;
+  if (slice->latitude) slice->latitude += first;
+  if (slice->longitude) slice->longitude += first;
+  if (slice->timezone) slice->timezone += first;
+  if (slice->press) slice->press += first;
+  if (slice->temp) slice->temp += first;
+  if (slice->tilt) slice->tilt += first;
+  if (slice->aspect) slice->aspect += first;
+  if (slice->epoch) slice->epoch += first;
+  if (slice->epochfrac) slice->epochfrac += first;
+}
+
+/*============================================================================
+ *    Void function S_columns_slice
+ *----------------------------------------------------------------------------*/
+void S_columns_slice(const poscolumns *columns, int first,
+                     poscolumns *slice) {
+  *slice = *columns;
+  for (int k = 0; k < internal::kPosColumns; ++k) {
+    double *poscolumns::*column = internal::kPosColumn[k];
+    if (slice->*column) slice->*column += first;
+  }
+}
+
+}  // namespace solpos
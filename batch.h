@@ -0,0 +1,147 @@
+/*============================================================================
+ *
+ *    NAME:  batch.h
+ *
+ *    Contains:
+ *        S_validate_batch  (validates many rows of S_solpos inputs at once)
+ *        S_solpos_batch    (runs S_solpos over many rows, skipping the
+ *                           invalid ones instead of failing the batch)
+ *        S_solpos_columns  (the same, writing selected output columns
+ *                           instead of a posdata per row)
+ *
+ *            INPUTS:     (from posbatch) a posdata holding the function
+ *                        switch and every input shared by all rows, plus
+ *                        optional per-row columns for the inputs that vary
+ *
+ *            OUTPUTS:    per-row error codes with the same S_*_ERROR bit
+ *                        layout as S_solpos, and a posdata per valid row
+ *
+ *    Usage:
+ *         posdata base;
+ *         S_init(&base);
+ *         base.latitude = ...;            (inputs shared by all rows)
+ *
+ *         posbatch batch = {};
+ *         batch.base = &base;
+ *         batch.count = n;
+ *         batch.hour = hours;             (inputs that vary per row)
+ *         ...
+ *         int summary = S_solpos_batch(&batch, errors, out);
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_BATCH_H_
+#define SOLPOS_BATCH_H_
+
+#include "solpos.h"
+
+namespace solpos {
+
+struct posbatch {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  const posdata *base; /* I:  Function switch and the value of every input
+                                whose column below is nullptr */
+  int count;           /* I:  Number of rows */
+
+  /* Optional input columns, count entries each (nullptr = use base).
+     Meanings and ranges are those of the posdata members. */
+  const int *year;
+  const int *month;
+  const int *day;
+  const int *daynum;
+  const int *hour;
+  const int *minute;
+  const int *second;
+  const int *interval;
+  const double *latitude;
+  const double *longitude;
+  const double *timezone;
+  const double *press;
+  const double *temp;
+  const double *tilt;
+  const double *aspect;
+  const long long *epoch;   /* (with the S_EPOCH switch) */
+  const double *epochfrac;
+};
+
+/* Output columns filled by S_solpos_columns.  Each is either nullptr (not
+   wanted) or has count entries; meanings are those of the posdata
+   members, and S_solpos computes whatever base->function selects. */
+struct poscolumns {
+  double *amass;
+  double *ampress;
+  double *azim;
+  double *cosinc;
+  double *coszen;
+  double *declin;
+  double *elevref;
+  double *erv;
+  double *etr;
+  double *etrn;
+  double *etrtilt;
+  double *hrang;
+  double *prime;
+  double *sbcf;
+  double *sretr;
+  double *ssetr;
+  double *unprime;
+  double *zenref;
+};
+
+/*============================================================================
+ *    Int function S_validate_batch
+ *
+ *    Validates every row of the batch column by column.  Checks on inputs
+ *    taken from base are done once and broadcast; checks on columns are
+ *    branch-free compare-and-or loops that the compiler vectorizes.
+ *
+ *    OUTPUTS: errors[i] = the S_solpos return code row i would produce
+ *
+ *    RETURNS: The OR of all row codes, so 0 means every row is valid
+ *----------------------------------------------------------------------------*/
+int S_validate_batch(const posbatch *batch, int *errors);
+
+/*============================================================================
+ *    Int function S_solpos_batch
+ *
+ *    Validates the batch (as S_validate_batch), then computes every valid
+ *    row into out[i].  Invalid rows only get their inputs copied to out[i];
+ *    their outputs are left undefined.
+ *
+ *    OUTPUTS: errors[i] as for S_validate_batch, out[i] for each row
+ *
+ *    RETURNS: The OR of all row codes
+ *----------------------------------------------------------------------------*/
+int S_solpos_batch(const posbatch *batch, int *errors, posdata *out);
+
+/*============================================================================
+ *    Int function S_solpos_columns
+ *
+ *    As S_solpos_batch, but writes only the requested output columns
+ *    instead of a posdata per row; rows with errors get NaN.
+ *----------------------------------------------------------------------------*/
+int S_solpos_columns(const posbatch *batch, int *errors,
+                     const poscolumns *out);
+
+/*============================================================================
+ *    Void functions S_batch_slice and S_columns_slice
+ *
+ *    Describe rows [first, first + count) of a batch or of output columns,
+ *    e.g. to split the work of one batch between threads
+ *----------------------------------------------------------------------------*/
+void S_batch_slice(const posbatch *batch, int first, int count,
+                   posbatch *slice);
+void S_columns_slice(const poscolumns *columns, int first,
+                     poscolumns *slice);
+
+/*============================================================================
+ *    Void function S_batch_row
+ *
+ *    Assembles the inputs of row i into pdat (base values overridden by
+ *    the non-null columns).
+ *----------------------------------------------------------------------------*/
+void S_batch_row(const posbatch *batch, int i, posdata *pdat);
+
+}  // namespace solpos
+
+#endif  // SOLPOS_BATCH_H_
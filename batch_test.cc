@@ -0,0 +1,219 @@
+#include "batch.h"
+
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace solpos {
+namespace {
+
+/* Atlanta, GA, as in solpos_test */
+void InitAtlanta(posdata *pdat) {
+  S_init(pdat);
+  pdat->longitude = -84.43;
+  pdat->latitude = 33.65;
+  pdat->timezone = -5.0;
+  pdat->year = 1999;
+  pdat->daynum = 203;
+  pdat->hour = 9;
+  pdat->minute = 45;
+  pdat->second = 37;
+  pdat->temp = 27.0;
+  pdat->press = 1006.0;
+  pdat->tilt = pdat->latitude;
+  pdat->aspect = 135.0;
+}
+
+TEST(BatchTest, MatchesScalarSolpos) {
+  posdata base;
+  InitAtlanta(&base);
+
+  std::vector<int> hour, minute;
+  std::vector<double> press;
+  for (int h = -1; h <= 25; ++h) {
+    for (int m = 0; m < 61; m += 15) {
+      hour.push_back(h);
+      minute.push_back(m);
+      press.push_back(h == 12 ? 2500.0 : 1006.0 - m);
+    }
+  }
+
+  posbatch batch = {};
+  batch.base = &base;
+  batch.count = static_cast<int>(hour.size());
+  batch.hour = hour.data();
+  batch.minute = minute.data();
+  batch.press = press.data();
+
+  std::vector<int> errors(batch.count);
+  std::vector<posdata> out(batch.count);
+  int summary = S_solpos_batch(&batch, errors.data(), out.data());
+
+  int expected_summary = 0;
+  int valid = 0;
+  for (int i = 0; i < batch.count; ++i) {
+    posdata pd = base;
+    pd.hour = hour[i];
+    pd.minute = minute[i];
+    pd.press = press[i];
+    int code = S_solpos(&pd);
+    expected_summary |= code;
+
+    EXPECT_EQ(errors[i], code) << "row " << i;
+    if (code == 0) {
+      ++valid;
+      EXPECT_EQ(out[i].zenref, pd.zenref);
+      EXPECT_EQ(out[i].azim, pd.azim);
+      EXPECT_EQ(out[i].etrtilt, pd.etrtilt);
+      EXPECT_EQ(out[i].ssetr, pd.ssetr);
+    }
+  }
+  EXPECT_EQ(summary, expected_summary);
+  EXPECT_NE(summary & (1L << S_HOUR_ERROR), 0);
+  EXPECT_NE(summary & (1L << S_MINUTE_ERROR), 0);
+  EXPECT_NE(summary & (1L << S_PRESS_ERROR), 0);
+  EXPECT_GT(valid, 0);
+}
+
+TEST(BatchTest, ValidateColumnsAndBase) {
+  posdata base;
+  InitAtlanta(&base);
+  base.function &= ~S_DOY; /* month and day input */
+  base.month = 7;
+  base.day = 22;
+
+  const int year[] = {1949, 1950, 2050, 2051, 1999};
+  const int day[] = {0, 1, 31, 32, 22};
+  const double latitude[] = {90.0, -90.5, 0.0, 45.0, 91.0};
+  const double tilt[] = {180.0, -181.0, 0.0, 0.0, 0.0};
+
+  posbatch batch = {};
+  batch.base = &base;
+  batch.count = 5;
+  batch.year = year;
+  batch.day = day;
+  batch.latitude = latitude;
+  batch.tilt = tilt;
+
+  int errors[5];
+  S_validate_batch(&batch, errors);
+  for (int i = 0; i < batch.count; ++i) {
+    posdata pd;
+    S_batch_row(&batch, i, &pd);
+    EXPECT_EQ(errors[i], S_validate(&pd)) << "row " << i;
+  }
+
+  /* An invalid shared input flags every row */
+  base.sbsky = 2.0;
+  EXPECT_EQ(S_validate_batch(&batch, errors) & (1L << S_SBSKY_ERROR),
+            1L << S_SBSKY_ERROR);
+  for (int i = 0; i < batch.count; ++i)
+    EXPECT_NE(errors[i] & (1L << S_SBSKY_ERROR), 0);
+
+  /* All valid */
+  base.sbsky = 0.04;
+  batch.count = 1;
+  batch.year = year + 4;
+  batch.day = day + 4;
+  batch.latitude = latitude + 2;
+  batch.tilt = tilt + 2;
+  EXPECT_EQ(S_validate_batch(&batch, errors), 0);
+}
+
+TEST(BatchTest, EpochColumn) {
+  posdata base;
+  InitAtlanta(&base);
+  base.function |= S_EPOCH;
+
+  const long long start = S_epoch(2050, 12, 31, 0, 0, 0, base.timezone);
+  std::vector<long long> epoch;
+  for (long long t = start - 3600; t < start + 2 * 86400; t += 1800)
+    epoch.push_back(t);
+
+  posbatch batch = {};
+  batch.base = &base;
+  batch.count = static_cast<int>(epoch.size());
+  batch.epoch = epoch.data();
+
+  std::vector<int> errors(batch.count);
+  std::vector<posdata> out(batch.count);
+  EXPECT_EQ(S_solpos_batch(&batch, errors.data(), out.data()),
+            1L << S_YEAR_ERROR);
+
+  for (int i = 0; i < batch.count; ++i) {
+    posdata pd = base;
+    pd.epoch = epoch[i];
+    EXPECT_EQ(errors[i], S_solpos(&pd)) << "row " << i;
+    EXPECT_EQ(errors[i] != 0, epoch[i] >= start + 86400) << "row " << i;
+    if (errors[i] == 0) {
+      EXPECT_EQ(out[i].zenref, pd.zenref);
+    }
+  }
+
+  /* A time zone column moves the year boundary per row */
+  std::vector<double> timezone(batch.count, 5.0);
+  batch.timezone = timezone.data();
+  S_validate_batch(&batch, errors.data());
+  for (int i = 0; i < batch.count; ++i) {
+    posdata pd;
+    S_batch_row(&batch, i, &pd);
+    EXPECT_EQ(errors[i], S_validate(&pd)) << "row " << i;
+  }
+}
+
+TEST(BatchTest, ColumnsMatchBatchAndSlice) {
+  posdata base;
+  InitAtlanta(&base);
+
+  std::vector<int> hour;
+  for (int h = -1; h <= 25; ++h) hour.push_back(h);
+
+  posbatch batch = {};
+  batch.base = &base;
+  batch.count = static_cast<int>(hour.size());
+  batch.hour = hour.data();
+
+  std::vector<int> errors(batch.count), column_errors(batch.count);
+  std::vector<posdata> out(batch.count);
+  std::vector<double> zenref(batch.count), etrn(batch.count);
+  poscolumns columns = {};
+  columns.zenref = zenref.data();
+  columns.etrn = etrn.data();
+
+  int summary = S_solpos_batch(&batch, errors.data(), out.data());
+  EXPECT_EQ(S_solpos_columns(&batch, column_errors.data(), &columns),
+            summary);
+  for (int i = 0; i < batch.count; ++i) {
+    EXPECT_EQ(column_errors[i], errors[i]) << "row " << i;
+    if (errors[i] == 0) {
+      EXPECT_EQ(zenref[i], out[i].zenref) << "row " << i;
+      EXPECT_EQ(etrn[i], out[i].etrn) << "row " << i;
+    } else {
+      EXPECT_TRUE(std::isnan(zenref[i])) << "row " << i;
+    }
+  }
+
+  /* The second half on its own gives the same rows */
+  int first = batch.count / 2;
+  posbatch slice;
+  poscolumns half;
+  std::vector<double> again(batch.count, -1.0);
+  columns.zenref = again.data();
+  columns.etrn = nullptr;
+  S_batch_slice(&batch, first, batch.count - first, &slice);
+  S_columns_slice(&columns, first, &half);
+  EXPECT_EQ(half.etrn, nullptr);
+  S_solpos_columns(&slice, column_errors.data(), &half);
+  for (int i = 0; i < batch.count; ++i) {
+    if (i < first) {
+      EXPECT_EQ(again[i], -1.0);
+    } else if (errors[i] == 0) {
+      EXPECT_EQ(again[i], zenref[i]) << "row " << i;
+    }
+  }
+}
+
+}  // namespace
+}  // namespace solpos
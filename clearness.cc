@@ -0,0 +1,128 @@
+/*============================================================================
+ *    Contains:
+ *        S_kt, S_kt_batch, S_unprime
+ *
+ *        The air mass and unprime formulas are shared with amass() and
+ *        prime() in solpos.cc through solpos_internal.h.
+ *----------------------------------------------------------------------------*/
+#include "clearness.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "solpos_internal.h"
+
+namespace solpos {
+
+/*============================================================================
+*    Local constants and function prototypes
+============================================================================*/
+static const int kBlock = 512;
+static const double kDegreesToRadians = M_PI / 180.0;
+
+/* The output columns of ktdata */
+static const int kOutputs = 8;
+static double *ktdata::*const kOutput[kOutputs] = {
+    &ktdata::kt,  &ktdata::kn,   &ktdata::ktprime, &ktdata::amass,
+    &ktdata::etr, &ktdata::etrn, &ktdata::prime,   &ktdata::unprime};
+
+/* Column pointer advanced by first rows, or nullptr */
+static double *offset(double *column, int first) {
+  return column ? column + first : nullptr;
+}
+static const double *offset(const double *column, int first) {
+  return column ? column + first : nullptr;
+}
+
+/*============================================================================
+ *    Void function S_kt
+ *----------------------------------------------------------------------------*/
+void S_kt(const ktdata *kd) {
+  const double *ghi = kd->ghi, *dni = kd->dni;
+
+  for (int i = 0; i < kd->count; ++i) {
+    double zenref = kd->zenref[i];
+    double coszen = std::cos(kDegreesToRadians * zenref);
+
+    /* amass(), prime() and etr() of solpos.cc */
+    double am = internal::air_mass(zenref, coszen);
+    double unprime = internal::unprime_factor(am);
+    double prime = 1.0 / unprime;
+    double etrn = coszen > 0.0 ? kd->solcon * kd->erv[i] : 0.0;
+    double etr = etrn * coszen;
+
+    if (kd->amass) kd->amass[i] = am;
+    if (kd->etr) kd->etr[i] = etr;
+    if (kd->etrn) kd->etrn[i] = etrn;
+    if (kd->prime) kd->prime[i] = prime;
+    if (kd->unprime) kd->unprime[i] = unprime;
+
+    if (ghi) {
+      double kt = etr > 0.0 ? ghi[i] / etr : 0.0;
+      if (kd->kt) kd->kt[i] = kt;
+      if (kd->ktprime) kd->ktprime[i] = kt * prime;
+    }
+    if (dni && kd->kn) kd->kn[i] = etrn > 0.0 ? dni[i] / etrn : 0.0;
+  }
+}
+
+/*============================================================================
+ *    Int function S_kt_batch
+ *----------------------------------------------------------------------------*/
+int S_kt_batch(const posbatch *batch, const ktdata *kd, int *errors) {
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  double zenref[kBlock], erv[kBlock];
+  posdata base = *batch->base;
+  posbatch work = *batch;
+  int summary = 0;
+
+  /* the fused stage does amass, prime and etr itself */
+  base.function = (base.function & (L_DOY | S_EPOCH)) | (S_REFRAC & ~L_DOY);
+  work.base = &base;
+
+  for (int first = 0; first < batch->count; first += kBlock) {
+    int n = std::min(kBlock, batch->count - first);
+    posbatch slice;
+    poscolumns columns = {};
+    columns.zenref = zenref;
+    columns.erv = erv;
+    S_batch_slice(&work, first, n, &slice);
+    int codes = S_solpos_columns(&slice, errors + first, &columns);
+    summary |= codes;
+
+    ktdata block = *kd;
+    block.count = n;
+    block.ghi = offset(kd->ghi, first);
+    block.dni = offset(kd->dni, first);
+    block.zenref = zenref;
+    block.erv = erv;
+    block.solcon = base.solcon;
+    for (int k = 0; k < kOutputs; ++k)
+      block.*kOutput[k] = offset(block.*kOutput[k], first);
+    S_kt(&block);
+
+    if (codes == 0) continue;
+    for (int i = 0; i < n; ++i) {
+      if (errors[first + i] == 0) continue;
+      for (int k = 0; k < kOutputs; ++k)
+        if (block.*kOutput[k]) (block.*kOutput[k])[i] = nan;
+    }
+  }
+  return summary;
+}
+
+/*============================================================================
+ *    Void function S_unprime
+ *----------------------------------------------------------------------------*/
+void S_unprime(int count, const double *zenref, const double *ktprime,
+               double *kt) {
+  for (int i = 0; i < count; ++i) {
+    double coszen = std::cos(kDegreesToRadians * zenref[i]);
+    double unprime =
+        internal::unprime_factor(internal::air_mass(zenref[i], coszen));
+    kt[i] = zenref[i] > 93.0 ? 0.0 : ktprime[i] * unprime;
+  }
+}
+
+}  // namespace solpos
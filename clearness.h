@@ -0,0 +1,87 @@
+/*============================================================================
+ *
+ *    NAME:  clearness.h
+ *
+ *    Contains:
+ *        S_kt        (clearness indices of measured irradiance columns)
+ *        S_kt_batch  (the same, computing the positions from a posbatch)
+ *        S_unprime   (Perez-normalized Kt' back to Kt)
+ *
+ *    The indices are
+ *        Kt  = GHI / etr
+ *        Kn  = DNI / etrn
+ *        Kt' = Kt * prime        (Perez et al. 1990, see prime() in
+ *                                 solpos.cc)
+ *    and all three are 0 when the sun is below the horizon (etr = 0).
+ *
+ *    S_kt runs the S_solpos amass, prime and etr stages and the index
+ *    divisions as one pass per row, so the position columns are read once
+ *    and each output column written once.
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_CLEARNESS_H_
+#define SOLPOS_CLEARNESS_H_
+
+#include "batch.h"
+
+namespace solpos {
+
+struct ktdata {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  int count;            /* I:  Number of rows */
+  const double *ghi;    /* I:  Global horizontal irradiance (nullptr = no
+                                kt or ktprime) */
+  const double *dni;    /* I:  Direct normal irradiance (nullptr = no kn) */
+  const double *zenref; /* I:  posdata::zenref, degrees */
+  const double *erv;    /* I:  posdata::erv */
+  double solcon;        /* I:  posdata::solcon */
+
+  /* Output columns, count entries each (nullptr = not wanted) */
+  double *kt;      /* O:  Clearness index */
+  double *kn;      /* O:  Direct beam clearness index */
+  double *ktprime; /* O:  Perez-normalized clearness index */
+  double *amass;   /* O:  As posdata (S_AMASS) */
+  double *etr;     /* O:  As posdata (S_ETR) */
+  double *etrn;    /* O:  As posdata (S_ETR) */
+  double *prime;   /* O:  As posdata (S_PRIME) */
+  double *unprime; /* O:  As posdata (S_PRIME) */
+};
+
+/*============================================================================
+ *    Void function S_kt
+ *
+ *    Fills the requested output columns of kd from its input columns.
+ *    Outputs match the posdata members S_solpos would produce for the
+ *    same zenref and erv.
+ *----------------------------------------------------------------------------*/
+void S_kt(const ktdata *kd);
+
+/*============================================================================
+ *    Int function S_kt_batch
+ *
+ *    Computes zenref and erv for each row of batch (the S_REFRAC stages,
+ *    in the date mode of batch->base->function, a block at a time) and
+ *    runs S_kt on them.  kd->count, zenref, erv and solcon are taken from
+ *    the batch; the input and output columns have batch->count entries.
+ *    Rows with errors get NaN outputs.
+ *
+ *    OUTPUTS: errors[i] (S_solpos return code) and the columns of kd
+ *
+ *    RETURNS: The OR of all row codes
+ *----------------------------------------------------------------------------*/
+int S_kt_batch(const posbatch *batch, const ktdata *kd, int *errors);
+
+/*============================================================================
+ *    Void function S_unprime
+ *
+ *    The reverse transform: kt[i] = ktprime[i] * unprime at zenref[i]
+ *    (0 beyond 93 degrees, where the normalization is undefined).
+ *    kt may be ktprime.
+ *----------------------------------------------------------------------------*/
+void S_unprime(int count, const double *zenref, const double *ktprime,
+               double *kt);
+
+}  // namespace solpos
+
+#endif  // SOLPOS_CLEARNESS_H_
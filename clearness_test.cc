@@ -0,0 +1,140 @@
+#include "clearness.h"
+
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace solpos {
+namespace {
+
+/* Golden, CO, on the 1st of each month at every half hour */
+class ClearnessTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    S_init(&base_);
+    base_.function = S_ALL & ~S_DOY;
+    base_.latitude = 39.74;
+    base_.longitude = -105.18;
+    base_.timezone = -7.0;
+    base_.year = 2021;
+    base_.day = 1;
+    base_.minute = 0;
+    base_.second = 0;
+    base_.press = 820.0;
+
+    for (int m = 1; m <= 12; ++m) {
+      for (int h = 0; h < 24; ++h) {
+        for (int mm = 0; mm < 60; mm += 30) {
+          month_.push_back(m);
+          hour_.push_back(h);
+          minute_.push_back(mm);
+          ghi_.push_back(50.0 + 40.0 * h);
+          dni_.push_back(30.0 * h);
+        }
+      }
+    }
+    month_[7] = 13;
+
+    batch_ = posbatch();
+    batch_.base = &base_;
+    batch_.count = static_cast<int>(hour_.size());
+    batch_.month = month_.data();
+    batch_.hour = hour_.data();
+    batch_.minute = minute_.data();
+  }
+
+  posdata base_;
+  posbatch batch_;
+  std::vector<int> month_, hour_, minute_;
+  std::vector<double> ghi_, dni_;
+};
+
+TEST_F(ClearnessTest, MatchesScalarStages) {
+  int n = batch_.count;
+  std::vector<int> errors(n);
+  std::vector<double> kt(n), kn(n), ktprime(n), amass(n), etr(n), etrn(n),
+      prime(n), unprime(n);
+  ktdata kd = {};
+  kd.ghi = ghi_.data();
+  kd.dni = dni_.data();
+  kd.kt = kt.data();
+  kd.kn = kn.data();
+  kd.ktprime = ktprime.data();
+  kd.amass = amass.data();
+  kd.etr = etr.data();
+  kd.etrn = etrn.data();
+  kd.prime = prime.data();
+  kd.unprime = unprime.data();
+
+  EXPECT_EQ(S_kt_batch(&batch_, &kd, errors.data()), 1 << S_MONTH_ERROR);
+
+  int day = 0;
+  for (int i = 0; i < n; ++i) {
+    posdata pd;
+    S_batch_row(&batch_, i, &pd);
+    ASSERT_EQ(errors[i], S_solpos(&pd)) << "row " << i;
+    if (errors[i] != 0) {
+      EXPECT_TRUE(std::isnan(kt[i]));
+      EXPECT_TRUE(std::isnan(unprime[i]));
+      continue;
+    }
+    EXPECT_DOUBLE_EQ(amass[i], pd.amass) << "row " << i;
+    EXPECT_DOUBLE_EQ(etr[i], pd.etr) << "row " << i;
+    EXPECT_DOUBLE_EQ(etrn[i], pd.etrn) << "row " << i;
+    EXPECT_DOUBLE_EQ(prime[i], pd.prime) << "row " << i;
+    EXPECT_DOUBLE_EQ(unprime[i], pd.unprime) << "row " << i;
+    if (pd.etr > 0.0) {
+      ++day;
+      EXPECT_DOUBLE_EQ(kt[i], ghi_[i] / pd.etr) << "row " << i;
+      EXPECT_DOUBLE_EQ(kn[i], dni_[i] / pd.etrn) << "row " << i;
+      EXPECT_DOUBLE_EQ(ktprime[i], ghi_[i] / pd.etr * pd.prime);
+    } else {
+      EXPECT_EQ(kt[i], 0.0);
+      EXPECT_EQ(kn[i], 0.0);
+      EXPECT_EQ(ktprime[i], 0.0);
+    }
+  }
+  EXPECT_GT(day, 200);
+}
+
+TEST_F(ClearnessTest, UnprimeReversesPrime) {
+  int n = batch_.count;
+  std::vector<int> errors(n);
+  std::vector<double> kt(n), ktprime(n), zenref(n), back(n);
+  ktdata kd = {};
+  kd.ghi = ghi_.data();
+  kd.kt = kt.data();
+  kd.ktprime = ktprime.data();
+  S_kt_batch(&batch_, &kd, errors.data());
+
+  poscolumns columns = {};
+  columns.zenref = zenref.data();
+  S_solpos_columns(&batch_, errors.data(), &columns);
+  S_unprime(n, zenref.data(), ktprime.data(), back.data());
+  for (int i = 0; i < n; ++i) {
+    if (errors[i] == 0 && zenref[i] <= 93.0) {
+      EXPECT_NEAR(back[i], kt[i], 1e-12 * (1.0 + kt[i])) << "row " << i;
+    }
+  }
+
+  /* in place */
+  S_unprime(n, zenref.data(), ktprime.data(), ktprime.data());
+  EXPECT_EQ(ktprime[n / 2], back[n / 2]);
+}
+
+TEST(ClearnessScalarTest, OnlyRequestedColumns) {
+  double ghi = 600.0, zenref = 60.0, erv = 1.0, kt = -1.0;
+  ktdata kd = {};
+  kd.count = 1;
+  kd.ghi = &ghi;
+  kd.zenref = &zenref;
+  kd.erv = &erv;
+  kd.solcon = 1367.0;
+  kd.kt = &kt;
+  S_kt(&kd);
+  EXPECT_NEAR(kt, 600.0 / (1367.0 * 0.5), 1e-12);
+}
+
+}  // namespace
+}  // namespace solpos
@@ -0,0 +1,135 @@
+/*============================================================================
+ *    Contains:
+ *        S_clearsky_ineichen, S_clearsky_haurwitz
+ *----------------------------------------------------------------------------*/
+#include "clearsky.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace solpos {
+
+/*============================================================================
+*    Local constants and function prototypes
+============================================================================*/
+static const int kDays = 367; /* daily tables are indexed by daynum 1 - 366 */
+static const double kNaN = std::numeric_limits<double>::quiet_NaN();
+
+static void daily_linke(const clearskysite *site, double *linke);
+static void ineichen(const clearskysite *site, const clearskydata *data,
+                     int first);
+
+/*============================================================================
+ *    Local void function daily_linke
+ *
+ *    Fills linke[1 .. 366] from the site's monthly table, interpolating
+ *    linearly between mid-month days (wrapping DEC to JAN), or with the
+ *    single value without one
+ *----------------------------------------------------------------------------*/
+static void daily_linke(const clearskysite *site, double *linke) {
+  static const int month_days[12] = {31, 28, 31, 30, 31, 30,
+                                     31, 31, 30, 31, 30, 31};
+  const double *table = site->linke_monthly;
+  double middle[14]; /* DEC of the year before, JAN - DEC, JAN after */
+  double value[14];
+
+  if (!table) {
+    std::fill(linke, linke + kDays, site->linke);
+    return;
+  }
+
+  int first = 1;
+  for (int m = 0; m < 12; ++m) {
+    middle[m + 1] = first + (month_days[m] - 1) / 2.0;
+    value[m + 1] = table[m];
+    first += month_days[m];
+  }
+  middle[0] = middle[12] - 365.0;
+  value[0] = table[11];
+  middle[13] = middle[1] + 365.0;
+  value[13] = table[0];
+
+  int m = 0;
+  linke[0] = table[0];
+  for (int day = 1; day < kDays; ++day) {
+    while (day >= middle[m + 1]) ++m;
+    double f = (day - middle[m]) / (middle[m + 1] - middle[m]);
+    linke[day] = value[m] + f * (value[m + 1] - value[m]);
+  }
+}
+
+/*============================================================================
+ *    Local void function ineichen
+ *
+ *    The model for one site, over rows [first, first + data->count)
+ *----------------------------------------------------------------------------*/
+static void ineichen(const clearskysite *site, const clearskydata *data,
+                     int first) {
+  double linke[kDays];
+  const double h = site->elevation;
+  const double fh1 = std::exp(-h / 8000.0);
+  const double fh2 = std::exp(-h / 1250.0);
+  const double cg1 = 5.09e-5 * h + 0.868;
+  const double cg2 = 3.92e-5 * h + 0.0387;
+  const double b = 0.664 + 0.163 / fh1;
+  const double *cz = data->coszen + first;
+  const double *am = data->ampress + first;
+  const double *etrn = data->etrn + first;
+  const int *daynum = site->linke_monthly ? data->daynum + first : nullptr;
+  double *ghi = data->ghi ? data->ghi + first : nullptr;
+  double *dni = data->dni ? data->dni + first : nullptr;
+  double *dhi = data->dhi ? data->dhi + first : nullptr;
+
+  daily_linke(site, linke);
+
+  for (int i = 0; i < data->count; ++i) {
+    if (daynum && ((daynum[i] < 1) || (daynum[i] >= kDays))) {
+      if (ghi) ghi[i] = kNaN;
+      if (dni) dni[i] = kNaN;
+      if (dhi) dhi[i] = kNaN;
+      continue;
+    }
+    double tl = daynum ? linke[daynum[i]] : site->linke;
+    int up = (cz[i] > 0.0) & (am[i] > 0.0);
+
+    double g = cg1 * etrn[i] * cz[i] *
+               std::exp(-cg2 * am[i] * (fh1 + fh2 * (tl - 1.0)));
+    if (site->enhancement) g *= std::exp(0.01 * std::pow(am[i], 1.8));
+
+    /* beam from Linke turbidity, limited by the beam share of GHI */
+    double beam = b * etrn[i] * std::exp(-0.09 * am[i] * (tl - 1.0));
+    double share =
+        (1.0 - (0.1 - 0.2 * std::exp(-tl)) / (0.1 + 0.882 / fh1)) / cz[i];
+    double n = std::min(beam, g * std::min(std::max(share, 0.0), 1e20));
+
+    g = up ? std::max(g, 0.0) : 0.0;
+    n = up ? n : 0.0;
+    if (ghi) ghi[i] = g;
+    if (dni) dni[i] = n;
+    if (dhi) dhi[i] = g - n * (up ? cz[i] : 0.0);
+  }
+}
+
+/*============================================================================
+ *    Void function S_clearsky_ineichen
+ *----------------------------------------------------------------------------*/
+void S_clearsky_ineichen(int sites, const clearskysite *site,
+                         const clearskydata *data) {
+  for (int s = 0; s < sites; ++s) ineichen(&site[s], data, s * data->count);
+}
+
+/*============================================================================
+ *    Void function S_clearsky_haurwitz
+ *----------------------------------------------------------------------------*/
+void S_clearsky_haurwitz(const clearskydata *data) {
+  const double *cz = data->coszen;
+
+  if (!data->ghi) return; /* its only output */
+  for (int i = 0; i < data->count; ++i) {
+    double g = 1098.0 * cz[i] * std::exp(-0.059 / cz[i]);
+    data->ghi[i] = cz[i] > 0.0 ? g : 0.0;
+  }
+}
+
+}  // namespace solpos
@@ -0,0 +1,84 @@
+/*============================================================================
+ *
+ *    NAME:  clearsky.h
+ *
+ *    Contains:
+ *        S_clearsky_ineichen  (Ineichen-Perez clear-sky GHI, DNI and DHI)
+ *        S_clearsky_haurwitz  (Haurwitz clear-sky GHI)
+ *
+ *            INPUTS:     columns of coszen, ampress and etrn, as S_solpos
+ *                        (S_AMASS and S_ETR) or S_solpos_columns produce
+ *                        them; for Ineichen-Perez also per site Linke
+ *                        turbidity and elevation
+ *
+ *            OUTPUTS:    clear-sky irradiance columns, W/m^2 (0 with the
+ *                        sun at or below the horizon)
+ *
+ *    Both are straight loops over the position columns, so positions are
+ *    computed once and any number of models or turbidities can be run
+ *    over them.  Site x time batches are laid out site-major: row
+ *    s * count + t is time t at site s.
+ *
+ *    References:
+ *        Ineichen, P. and Perez, R.  2002.  A new airmass independent
+ *            formulation for the Linke turbidity coefficient.  Solar
+ *            Energy 73 (3), pp. 151-157
+ *        Haurwitz, B.  1945.  Insolation in relation to cloudiness and
+ *            cloud density.  Journal of Meteorology 2, pp. 154-166
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_CLEARSKY_H_
+#define SOLPOS_CLEARSKY_H_
+
+namespace solpos {
+
+struct clearskysite {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  double linke;          /* I:  Linke turbidity at air mass 2 */
+  const double *linke_monthly; /* I:  Optional Linke turbidity for JAN to DEC
+                                      (12 values, interpolated daily between
+                                      mid-month values); nullptr = linke */
+  double elevation;      /* I:  Site elevation, meters */
+  int enhancement;       /* I:  Nonzero to apply the Perez enhancement
+                                factor exp(0.01 * ampress^1.8) to GHI */
+};
+
+struct clearskydata {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  int count;             /* I:  Rows (times) per site */
+  const double *coszen;  /* I:  posdata::coszen */
+  const double *ampress; /* I:  posdata::ampress (pressure-corrected air
+                                mass; Ineichen-Perez only) */
+  const double *etrn;    /* I:  posdata::etrn (Ineichen-Perez only) */
+  const int *daynum;     /* I:  posdata::daynum (only with monthly Linke
+                                tables); rows outside 1 - 366 get NaN
+                                outputs */
+
+  /* Output columns (nullptr = not wanted) */
+  double *ghi;           /* O:  Global horizontal irradiance */
+  double *dni;           /* O:  Direct normal irradiance */
+  double *dhi;           /* O:  Diffuse horizontal irradiance */
+};
+
+/*============================================================================
+ *    Void function S_clearsky_ineichen
+ *
+ *    Runs the model for sites site[0 .. sites - 1] over sites * data->count
+ *    site-major rows of data.
+ *----------------------------------------------------------------------------*/
+void S_clearsky_ineichen(int sites, const clearskysite *site,
+                         const clearskydata *data);
+
+/*============================================================================
+ *    Void function S_clearsky_haurwitz
+ *
+ *    GHI only (data->dni and data->dhi are ignored), over data->count rows;
+ *    the model has no site parameters.
+ *----------------------------------------------------------------------------*/
+void S_clearsky_haurwitz(const clearskydata *data);
+
+}  // namespace solpos
+
+#endif  // SOLPOS_CLEARSKY_H_
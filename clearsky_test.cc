@@ -0,0 +1,192 @@
+#include "clearsky.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "batch.h"
+#include "gtest/gtest.h"
+
+namespace solpos {
+namespace {
+
+TEST(ClearskyTest, IneichenRow) {
+  double cz = 0.7, am = 1.5, etrn = 1361.0, ghi, dni, dhi;
+  clearskysite site = {};
+  site.linke = 3.0;
+  clearskydata data = {};
+  data.count = 1;
+  data.coszen = &cz;
+  data.ampress = &am;
+  data.etrn = &etrn;
+  data.ghi = &ghi;
+  data.dni = &dni;
+  data.dhi = &dhi;
+
+  S_clearsky_ineichen(1, &site, &data);
+  EXPECT_NEAR(ghi, 694.77392, 1e-4);
+  EXPECT_NEAR(dni, 859.21950, 1e-4);
+  EXPECT_NEAR(dhi, 93.32027, 1e-4);
+
+  site.enhancement = 1;
+  S_clearsky_ineichen(1, &site, &data);
+  EXPECT_NEAR(ghi, 709.33926, 1e-4);
+
+  /* clearer air and higher ground both let more through */
+  site.enhancement = 0;
+  site.linke = 2.0;
+  S_clearsky_ineichen(1, &site, &data);
+  EXPECT_GT(ghi, 694.8);
+  site.linke = 3.0;
+  site.elevation = 1500.0;
+  S_clearsky_ineichen(1, &site, &data);
+  EXPECT_GT(ghi, 694.8);
+
+  /* night */
+  cz = -0.1;
+  am = -1.0;
+  etrn = 0.0;
+  S_clearsky_ineichen(1, &site, &data);
+  EXPECT_EQ(ghi, 0.0);
+  EXPECT_EQ(dni, 0.0);
+  EXPECT_EQ(dhi, 0.0);
+}
+
+TEST(ClearskyTest, Haurwitz) {
+  double cz[3] = {1.0, 0.5, -0.2}, ghi[3];
+  clearskydata data = {};
+  data.count = 3;
+  data.coszen = cz;
+  data.ghi = ghi;
+  S_clearsky_haurwitz(&data);
+  EXPECT_NEAR(ghi[0], 1035.09203, 1e-4);
+  EXPECT_LT(ghi[1], ghi[0] / 2.0);
+  EXPECT_EQ(ghi[2], 0.0);
+
+  data.ghi = nullptr; /* not wanted: nothing written */
+  S_clearsky_haurwitz(&data);
+}
+
+TEST(ClearskyTest, MonthlyLinke) {
+  const double monthly[12] = {2.0, 2.2, 2.4, 2.6, 2.8, 3.0,
+                              3.2, 3.4, 3.6, 3.8, 4.0, 4.2};
+  /* the same position on four days: mid-JAN, mid-JUL, between mid-JUN
+     (day 166.5) and mid-JUL, and 1 JAN (between mid-DEC and mid-JAN) */
+  double cz[4], am[4], etrn[4], ghi[4], want[4];
+  int daynum[4] = {16, 197, 181, 1};
+  const double linke[4] = {2.0, 3.2, 3.0 + 0.2 * 14.5 / 30.5,
+                           2.0 + 2.2 * 15.0 / 31.0};
+  for (int i = 0; i < 4; ++i) {
+    cz[i] = 0.8;
+    am[i] = 1.25;
+    etrn[i] = 1361.0;
+  }
+
+  clearskysite site = {};
+  site.linke_monthly = monthly;
+  site.elevation = 300.0;
+  clearskydata data = {};
+  data.count = 4;
+  data.coszen = cz;
+  data.ampress = am;
+  data.etrn = etrn;
+  data.daynum = daynum;
+  data.ghi = ghi;
+  S_clearsky_ineichen(1, &site, &data);
+
+  for (int i = 0; i < 4; ++i) {
+    clearskysite fixed = site;
+    fixed.linke_monthly = nullptr;
+    fixed.linke = linke[i];
+    clearskydata one = data;
+    one.count = 1;
+    one.coszen = &cz[i];
+    one.ampress = &am[i];
+    one.etrn = &etrn[i];
+    one.daynum = nullptr;
+    one.ghi = &want[i];
+    S_clearsky_ineichen(1, &fixed, &one);
+    EXPECT_NEAR(ghi[i], want[i], 1e-9) << "day " << daynum[i];
+  }
+
+  /* days off the table are not read */
+  daynum[1] = 0;
+  daynum[2] = 367;
+  S_clearsky_ineichen(1, &site, &data);
+  EXPECT_NEAR(ghi[0], want[0], 1e-9);
+  EXPECT_TRUE(std::isnan(ghi[1]));
+  EXPECT_TRUE(std::isnan(ghi[2]));
+  EXPECT_NEAR(ghi[3], want[3], 1e-9);
+}
+
+TEST(ClearskyTest, SitesByTimeFromPositions) {
+  /* two sites, a day at 10-minute steps */
+  const int times = 144;
+  const double latitude[2] = {33.65, 39.74};
+  const double longitude[2] = {-84.43, -105.18};
+  clearskysite site[2] = {};
+  site[0].linke = 3.5;
+  site[0].elevation = 300.0;
+  site[1].linke = 2.5;
+  site[1].elevation = 1830.0;
+
+  std::vector<double> cz(2 * times), am(2 * times), etrn(2 * times);
+  std::vector<int> hour(times), minute(times), errors(times);
+  for (int t = 0; t < times; ++t) {
+    hour[t] = t / 6;
+    minute[t] = t % 6 * 10;
+  }
+  for (int s = 0; s < 2; ++s) {
+    posdata base;
+    S_init(&base);
+    base.function = S_ALL & ~S_DOY;
+    base.latitude = latitude[s];
+    base.longitude = longitude[s];
+    base.timezone = s == 0 ? -5.0 : -7.0;
+    base.year = 2022;
+    base.month = 3;
+    base.day = 20;
+    base.second = 0;
+    posbatch batch = {};
+    batch.base = &base;
+    batch.count = times;
+    batch.hour = hour.data();
+    batch.minute = minute.data();
+    poscolumns out = {};
+    out.coszen = &cz[s * times];
+    out.ampress = &am[s * times];
+    out.etrn = &etrn[s * times];
+    ASSERT_EQ(S_solpos_columns(&batch, errors.data(), &out), 0);
+  }
+
+  std::vector<double> ghi(2 * times), dni(2 * times), dhi(2 * times);
+  clearskydata data = {};
+  data.count = times;
+  data.coszen = cz.data();
+  data.ampress = am.data();
+  data.etrn = etrn.data();
+  data.ghi = ghi.data();
+  data.dni = dni.data();
+  data.dhi = dhi.data();
+  S_clearsky_ineichen(2, site, &data);
+
+  double peak[2] = {0.0, 0.0};
+  for (int s = 0; s < 2; ++s) {
+    for (int t = 0; t < times; ++t) {
+      int i = s * times + t;
+      double mu0 = cz[i] > 0.0 ? cz[i] : 0.0;
+      EXPECT_NEAR(ghi[i], dhi[i] + dni[i] * mu0, 1e-9);
+      EXPECT_GE(dni[i], 0.0);
+      if (cz[i] <= 0.0) {
+        EXPECT_EQ(ghi[i], 0.0);
+      }
+      peak[s] = std::max(peak[s], ghi[i]);
+    }
+  }
+  EXPECT_GT(peak[0], 700.0);
+  EXPECT_GT(peak[1], peak[0] * 0.9);
+  EXPECT_LT(peak[1], 1100.0);
+}
+
+}  // namespace
+}  // namespace solpos
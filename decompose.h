@@ -0,0 +1,104 @@
+/*============================================================================
+ *
+ *    NAME:  decompose.h
+ *
+ *    Contains:
+ *        S_decompose        (DNI and DHI estimated from GHI alone)
+ *        S_decompose_batch  (the same, fused with the position calculation
+ *                            of a posbatch)
+ *
+ *    Models:
+ *        S_DECOMP_ERBS    Erbs, Klein and Duffie (1982): diffuse fraction
+ *                         as a polynomial in Kt
+ *        S_DECOMP_DISC    Maxwell (1987): Kn from Kt and air mass
+ *        S_DECOMP_DIRINT  Perez et al. (1992): DISC scaled by a
+ *                         coefficient looked up by Kt', zenith, the
+ *                         stability index dKt' (from the rows before and
+ *                         after) and precipitable water (from dew point)
+ *
+ *    All of them use zenref, and Kt = GHI / (solcon * erv * coszen), with
+ *    coszen no smaller than 0.065 and Kt clipped to [0, 1] (as in DISC).
+ *    DISC and DIRINT take the air mass from amass() scaled by press / 1013
+ *    (and capped at 12), and DIRINT Kt' = Kt * prime from prime(), clipped
+ *    to [0, 1].  Beyond a zenith of 87 degrees, or where GHI or the estimate
+ *    is negative, DNI is 0 and DHI = GHI.  Otherwise DHI = GHI - DNI *
+ *    coszen.
+ *
+ *    DIRINT rows are read as a time series: dKt' of row i uses the
+ *    neighbouring rows i - 1 and i + 1 (only one of them at the ends, or
+ *    where a neighbour has the sun beyond 87 degrees or no valid data), so
+ *    pass rows in time order, one site per call.
+ *
+ *    The DIRINT coefficients (the 6 x 6 x 7 x 5 table of the 1992 paper's
+ *    software) are built in; decompdata::dirint may point to another
+ *    table to use in their place.
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_DECOMPOSE_H_
+#define SOLPOS_DECOMPOSE_H_
+
+#include "batch.h"
+
+namespace solpos {
+
+enum { S_DECOMP_ERBS = 1, S_DECOMP_DISC, S_DECOMP_DIRINT };
+
+/* DIRINT coefficients by bin:
+       Kt'    [0, .24) [.24, .4) [.4, .56) [.56, .7) [.7, .8) [.8, 1]
+       zenith [0, 25) [25, 40) [40, 55) [55, 70) [70, 80) [80, ...)
+       dKt'   [0, .015) [.015, .035) [.035, .07) [.07, .15) [.15, .3)
+              [.3, 1] and "not available" (a single row)
+       w (cm) [0, 1) [1, 2) [2, 3) [3, ...) and "not available" */
+struct dirintcoeffs {
+  double c[6][6][7][5];
+};
+
+struct decompdata {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  int count;             /* I:  Number of rows */
+  const double *ghi;     /* I:  Global horizontal irradiance, W/m^2 */
+  const double *zenref;  /* I:  posdata::zenref */
+  const double *erv;     /* I:  posdata::erv */
+  double solcon;         /* I:  posdata::solcon */
+  double press;          /* I:  Surface pressure, millibars */
+  const double *presses; /* I:  Optional per-row press (nullptr = press) */
+  const double *dewpoint; /* I:  Optional dew point, degrees C (DIRINT;
+                                 nullptr = precipitable water unknown) */
+  const dirintcoeffs *dirint; /* I:  DIRINT table (nullptr = Perez 1992) */
+
+  /* Output columns (nullptr = not wanted) */
+  double *dni;           /* O:  Direct normal irradiance, W/m^2 */
+  double *dhi;           /* O:  Diffuse horizontal irradiance, W/m^2 */
+  double *kt;            /* O:  Clearness index used */
+};
+
+/*============================================================================
+ *    Int function S_decompose
+ *
+ *    Runs model (one of the S_DECOMP_* values) over the rows of dd.
+ *
+ *----------------------------------------------------------------------------*/
+void S_decompose(int model, const decompdata *dd);
+
+/*============================================================================
+ *    Int function S_decompose_batch
+ *
+ *    Computes zenref and erv for each row of batch (the S_REFRAC stages, a
+ *    block at a time) and decomposes them in the same pass.  The DIRINT
+ *    stability index is carried from block to block in a three-row window
+ *    (each block computes one row of look-ahead), so no per-batch buffer
+ *    is needed.  The zenref, erv, solcon, press and presses members of dd
+ *    are taken from the batch; its other columns have batch->count
+ *    entries.  Rows with errors get NaN outputs and break the series.
+ *
+ *    OUTPUTS: errors[i] (S_solpos return code) and the columns of dd
+ *
+ *    RETURNS: The OR of all row codes
+ *----------------------------------------------------------------------------*/
+int S_decompose_batch(const posbatch *batch, int model, const decompdata *dd,
+                      int *errors);
+
+}  // namespace solpos
+
+#endif  // SOLPOS_DECOMPOSE_H_
@@ -0,0 +1,193 @@
+#include "decompose.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace solpos {
+namespace {
+
+/* Rows at given zenith angles with erv 1 */
+struct Series {
+  std::vector<double> ghi, zenref, erv, dni, dhi, kt;
+
+  Series(const std::vector<double> &g, const std::vector<double> &z)
+      : ghi(g), zenref(z), erv(g.size(), 1.0), dni(g.size()), dhi(g.size()),
+        kt(g.size()) {}
+
+  decompdata Data() {
+    decompdata dd = {};
+    dd.count = static_cast<int>(ghi.size());
+    dd.ghi = ghi.data();
+    dd.zenref = zenref.data();
+    dd.erv = erv.data();
+    dd.solcon = 1367.0;
+    dd.press = 900.0;
+    dd.dni = dni.data();
+    dd.dhi = dhi.data();
+    dd.kt = kt.data();
+    return dd;
+  }
+};
+
+TEST(DecomposeTest, Disc) {
+  Series s({800.0, 50.0, -3.0}, {30.0, 88.0, 40.0});
+  decompdata dd = s.Data();
+  S_decompose(S_DECOMP_DISC, &dd);
+  EXPECT_NEAR(s.kt[0], 0.675757, 1e-6);
+  EXPECT_NEAR(s.dni[0], 486.425831, 1e-6);
+  EXPECT_NEAR(s.dhi[0], 800.0 - 486.425831 * std::cos(M_PI / 6.0), 1e-6);
+  /* below 87 degrees and negative GHI: all diffuse */
+  EXPECT_EQ(s.dni[1], 0.0);
+  EXPECT_EQ(s.dhi[1], 50.0);
+  EXPECT_EQ(s.dni[2], 0.0);
+}
+
+TEST(DecomposeTest, Erbs) {
+  /* Kt = 0.5, 0.1 and 0.9 at zenith 60 */
+  Series s({341.75, 68.35, 615.15}, {60.0, 60.0, 60.0});
+  decompdata dd = s.Data();
+  S_decompose(S_DECOMP_ERBS, &dd);
+  const double df[3] = {
+      0.9511 - 0.1604 * 0.5 + 4.388 * 0.25 - 16.638 * 0.125 + 12.336 * 0.0625,
+      1.0 - 0.09 * 0.1, 0.165};
+  for (int i = 0; i < 3; ++i) {
+    EXPECT_NEAR(s.dhi[i], df[i] * s.ghi[i], 1e-9) << "row " << i;
+    EXPECT_NEAR(s.dni[i] * 0.5, (1.0 - df[i]) * s.ghi[i], 1e-9);
+  }
+}
+
+/* A table whose entries encode their own bins */
+dirintcoeffs *BinTable() {
+  static dirintcoeffs table;
+  for (int a = 0; a < 6; ++a)
+    for (int b = 0; b < 6; ++b)
+      for (int c = 0; c < 7; ++c)
+        for (int d = 0; d < 5; ++d)
+          table.c[a][b][c][d] = 1000 * a + 100 * b + 10 * c + d + 1;
+  return &table;
+}
+
+TEST(DecomposeTest, DirintBins) {
+  /* a steady series, then a jump */
+  Series s({500.0, 500.0, 500.0, 700.0}, {50.0, 50.0, 50.0, 50.0});
+  std::vector<double> disc(4), dewpoint(4, 10.0);
+  decompdata dd = s.Data();
+  dd.dni = disc.data();
+  S_decompose(S_DECOMP_DISC, &dd);
+
+  dd = s.Data();
+  dd.dirint = BinTable();
+  dd.dewpoint = dewpoint.data();
+  S_decompose(S_DECOMP_DIRINT, &dd);
+  /* w = exp(0.7 - 0.075) = 1.87 cm: bin 1; zenith 50: bin 2 */
+  for (int i = 0; i < 4; ++i) {
+    double code = s.dni[i] / disc[i] - 1.0;
+    int rounded = static_cast<int>(std::lround(code));
+    EXPECT_EQ(rounded % 10, 1) << "row " << i;
+    EXPECT_EQ(rounded / 100 % 10, 2) << "row " << i;
+  }
+  EXPECT_EQ(std::lround(s.dni[0] / disc[0] - 1.0) / 10 % 10, 0);
+  EXPECT_EQ(std::lround(s.dni[1] / disc[1] - 1.0) / 10 % 10, 0);
+  /* Kt' 0.60 then 0.85: dKt' 0.12 (half the step), then the full 0.24 */
+  EXPECT_EQ(std::lround(s.dni[2] / disc[2] - 1.0) / 10 % 10, 3);
+  EXPECT_EQ(std::lround(s.dni[3] / disc[3] - 1.0) / 10 % 10, 4);
+
+  /* a single row has no stability index: bin 7 */
+  dd.count = 1;
+  dd.dewpoint = nullptr;
+  S_decompose(S_DECOMP_DIRINT, &dd);
+  EXPECT_EQ(std::lround(s.dni[0] / disc[0] - 1.0) % 100, 64);
+}
+
+TEST(DecomposeTest, DirintDefaultTable) {
+  Series s({500.0, 500.0, 500.0, 700.0}, {50.0, 50.0, 50.0, 50.0});
+  std::vector<double> disc(4), dewpoint(4, 10.0);
+  decompdata dd = s.Data();
+  dd.dni = disc.data();
+  S_decompose(S_DECOMP_DISC, &dd);
+
+  /* no table: Perez 1992.  Kt' 0.60, zenith 50, steady, w 1.87 cm */
+  dd = s.Data();
+  dd.dewpoint = dewpoint.data();
+  S_decompose(S_DECOMP_DIRINT, &dd);
+  EXPECT_NEAR(s.dni[0] / disc[0], 1.02971, 1e-12);
+  EXPECT_NEAR(s.dni[1] / disc[1], 1.02971, 1e-12);
+
+  /* a single row, no dew point: the "not available" bins */
+  dd.count = 1;
+  dd.dewpoint = nullptr;
+  S_decompose(S_DECOMP_DIRINT, &dd);
+  EXPECT_NEAR(s.dni[0] / disc[0], 0.97299, 1e-12);
+}
+
+TEST(DecomposeTest, BatchMatchesColumns) {
+  posdata base;
+  S_init(&base);
+  base.function = S_ALL & ~S_DOY;
+  base.latitude = 35.05;
+  base.longitude = -106.62;
+  base.timezone = -7.0;
+  base.year = 2018;
+  base.month = 5;
+  base.day = 10;
+  base.second = 0;
+  base.press = 840.0;
+
+  /* a day at one-minute steps, so the series crosses blocks */
+  const int count = 1440;
+  std::vector<int> hour(count), minute(count), errors(count);
+  std::vector<double> ghi(count), dewpoint(count);
+  for (int i = 0; i < count; ++i) {
+    hour[i] = i / 60;
+    minute[i] = i % 60;
+    ghi[i] = 900.0 * std::sin(M_PI * (i - 360) / 840.0) *
+             (0.7 + 0.3 * std::cos(i / 7.0));
+    dewpoint[i] = -5.0 + i % 30;
+  }
+  minute[700] = 60;
+
+  posbatch batch = {};
+  batch.base = &base;
+  batch.count = count;
+  batch.hour = hour.data();
+  batch.minute = minute.data();
+
+  std::vector<double> zenref(count), erv(count);
+  poscolumns columns = {};
+  columns.zenref = zenref.data();
+  columns.erv = erv.data();
+  int summary = S_solpos_columns(&batch, errors.data(), &columns);
+
+  std::vector<double> want(count), dni(count);
+  decompdata dd = {};
+  dd.count = count;
+  dd.ghi = ghi.data();
+  dd.zenref = zenref.data();
+  dd.erv = erv.data();
+  dd.solcon = base.solcon;
+  dd.press = base.press;
+  dd.dewpoint = dewpoint.data();
+  dd.dirint = BinTable();
+  dd.dni = want.data();
+  S_decompose(S_DECOMP_DIRINT, &dd);
+
+  dd.dni = dni.data();
+  EXPECT_EQ(S_decompose_batch(&batch, S_DECOMP_DIRINT, &dd, errors.data()),
+            summary);
+  int day = 0;
+  for (int i = 0; i < count; ++i) {
+    if (errors[i]) {
+      EXPECT_TRUE(std::isnan(dni[i]));
+    } else {
+      ASSERT_EQ(dni[i], want[i]) << "row " << i;
+      day += dni[i] > 0.0;
+    }
+  }
+  EXPECT_GT(day, 600);
+}
+
+}  // namespace
+}  // namespace solpos
@@ -0,0 +1,124 @@
+/*============================================================================
+ *
+ *    NAME:  dual.h
+ *
+ *    Contains:
+ *        dual<N>  (a forward-mode dual number: a value and its partial
+ *                  derivatives with respect to N seeded inputs)
+ *
+ *    Arithmetic, comparison and the elementary functions the solpos stages
+ *    use (sin, cos, tan, asin, acos, atan2, sqrt, exp, pow, abs) carry the
+ *    derivatives by the chain rule.  Comparisons look at the value only.
+ *    Plain doubles convert to duals with zero derivatives.
+ *
+ *    Usage:
+ *         dual<2> x = dual<2>::seed(0.3, 0);   (d/dx = 1)
+ *         dual<2> y = dual<2>::seed(1.2, 1);   (d/dy = 1)
+ *         dual<2> f = sin(x) * y;
+ *         f.v                                  (sin(0.3) * 1.2)
+ *         f.d[0], f.d[1]                       (cos(0.3) * 1.2, sin(0.3))
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_DUAL_H_
+#define SOLPOS_DUAL_H_
+
+#include <cmath>
+
+namespace solpos {
+
+template <int N>
+struct dual {
+  double v;    /* value */
+  double d[N]; /* partial derivatives */
+
+  dual() : dual(0.0) {}
+  dual(double value) : v(value) {
+    for (int k = 0; k < N; ++k) d[k] = 0.0;
+  }
+
+  /* Input number k of N, at value */
+  static dual seed(double value, int k) {
+    dual x(value);
+    x.d[k] = 1.0;
+    return x;
+  }
+
+  /* value f with derivative df/dv = slope, by the chain rule */
+  dual chain(double f, double slope) const {
+    dual r(f);
+    for (int k = 0; k < N; ++k) r.d[k] = slope * d[k];
+    return r;
+  }
+
+  dual &operator+=(const dual &b) { return *this = *this + b; }
+  dual &operator-=(const dual &b) { return *this = *this - b; }
+  dual &operator*=(const dual &b) { return *this = *this * b; }
+  dual &operator/=(const dual &b) { return *this = *this / b; }
+
+  friend dual operator-(const dual &a) { return a.chain(-a.v, -1.0); }
+  friend dual operator+(const dual &a, const dual &b) {
+    dual r(a.v + b.v);
+    for (int k = 0; k < N; ++k) r.d[k] = a.d[k] + b.d[k];
+    return r;
+  }
+  friend dual operator-(const dual &a, const dual &b) {
+    dual r(a.v - b.v);
+    for (int k = 0; k < N; ++k) r.d[k] = a.d[k] - b.d[k];
+    return r;
+  }
+  friend dual operator*(const dual &a, const dual &b) {
+    dual r(a.v * b.v);
+    for (int k = 0; k < N; ++k) r.d[k] = a.d[k] * b.v + a.v * b.d[k];
+    return r;
+  }
+  friend dual operator/(const dual &a, const dual &b) {
+    dual r(a.v / b.v);
+    for (int k = 0; k < N; ++k) r.d[k] = (a.d[k] - r.v * b.d[k]) / b.v;
+    return r;
+  }
+
+  friend bool operator<(const dual &a, const dual &b) { return a.v < b.v; }
+  friend bool operator>(const dual &a, const dual &b) { return a.v > b.v; }
+  friend bool operator<=(const dual &a, const dual &b) { return a.v <= b.v; }
+  friend bool operator>=(const dual &a, const dual &b) { return a.v >= b.v; }
+
+  friend double value(const dual &a) { return a.v; }
+  friend dual sin(const dual &a) {
+    return a.chain(std::sin(a.v), std::cos(a.v));
+  }
+  friend dual cos(const dual &a) {
+    return a.chain(std::cos(a.v), -std::sin(a.v));
+  }
+  friend dual tan(const dual &a) {
+    double t = std::tan(a.v);
+    return a.chain(t, 1.0 + t * t);
+  }
+  friend dual asin(const dual &a) {
+    return a.chain(std::asin(a.v), 1.0 / std::sqrt(1.0 - a.v * a.v));
+  }
+  friend dual acos(const dual &a) {
+    return a.chain(std::acos(a.v), -1.0 / std::sqrt(1.0 - a.v * a.v));
+  }
+  friend dual atan2(const dual &y, const dual &x) {
+    double r2 = x.v * x.v + y.v * y.v;
+    dual r(std::atan2(y.v, x.v));
+    for (int k = 0; k < N; ++k) r.d[k] = (x.v * y.d[k] - y.v * x.d[k]) / r2;
+    return r;
+  }
+  friend dual sqrt(const dual &a) {
+    double s = std::sqrt(a.v);
+    return a.chain(s, 0.5 / s);
+  }
+  friend dual exp(const dual &a) {
+    double e = std::exp(a.v);
+    return a.chain(e, e);
+  }
+  friend dual pow(const dual &a, double p) {
+    return a.chain(std::pow(a.v, p), p * std::pow(a.v, p - 1.0));
+  }
+  friend dual abs(const dual &a) { return a.v < 0.0 ? -a : a; }
+};
+
+}  // namespace solpos
+
+#endif  // SOLPOS_DUAL_H_
@@ -0,0 +1,246 @@
+/*============================================================================
+ *    Contains:
+ *        S_enrich_create, S_enrich_push, S_enrich_pop, S_enrich_close,
+ *        S_enrich_destroy
+ *----------------------------------------------------------------------------*/
+#include "enrich.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <limits>
+#include <map>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "parallel.h"
+#include "realtime.h"
+#include "ring.h"
+#include "solpos_internal.h"
+
+namespace solpos {
+
+/*============================================================================
+*    Local constants, types and function prototypes
+============================================================================*/
+static const double kNaN = std::numeric_limits<double>::quiet_NaN();
+
+/* Stages run per record, after the shared S_GEOM terms */
+static const int kStages =
+    (S_ZENETR | S_SOLAZM | S_REFRAC | S_AMASS | S_ETR | S_TILT) & ~L_DOY;
+
+struct enrichpipe {
+  std::vector<rtcontext> site;
+  std::vector<int> clock; /* per site, index of its (timezone, interval) */
+  int batch;
+  int workers;
+
+  std::vector<std::unique_ptr<internal::spsc_ring<telemetry> > > input;
+  internal::mpmc_ring<telemetry> output;
+  std::vector<std::thread> worker;
+  std::atomic<int> running;
+  std::atomic<bool> closed, stop;
+
+  explicit enrichpipe(size_t capacity) : output(capacity) {}
+};
+
+static void backoff(int *idle);
+static void enrich(const enrichpipe *pipe, int n, telemetry *records,
+                   int *order);
+static void work(enrichpipe *pipe, int first);
+
+/*============================================================================
+ *    Local void function backoff
+ *
+ *    Waits a little longer each time nothing was ready
+ *----------------------------------------------------------------------------*/
+static void backoff(int *idle) {
+  if (++*idle < 64)
+    std::this_thread::yield();
+  else
+    std::this_thread::sleep_for(std::chrono::microseconds(50));
+}
+
+/*============================================================================
+ *    Local void function enrich
+ *
+ *    Fills the outputs of records[0 .. n - 1]; order has room for n
+ *----------------------------------------------------------------------------*/
+static void enrich(const enrichpipe *pipe, int n, telemetry *records,
+                   int *order) {
+  posdata shared;        /* S_GEOM terms of the current epoch and clock */
+  int shared_clock = -1; /* that clock, -1 before the first */
+
+  for (int i = 0; i < n; ++i) order[i] = i;
+  std::sort(order, order + n, [pipe, records](int a, int b) {
+    const telemetry &ra = records[a], &rb = records[b];
+    if (ra.epoch != rb.epoch) return ra.epoch < rb.epoch;
+    return pipe->clock[ra.site] < pipe->clock[rb.site];
+  });
+
+  for (int k = 0; k < n; ++k) {
+    telemetry &r = records[order[k]];
+    const rtcontext &ctx = pipe->site[r.site];
+
+    if ((r.epoch < ctx.first) || (r.epoch >= ctx.last)) {
+      r.error = (1L << S_YEAR_ERROR);
+      r.azim = r.elevref = r.cosinc = r.etr = r.etrn = r.amass = kNaN;
+      continue;
+    }
+    if ((shared_clock != pipe->clock[r.site]) || (shared.epoch != r.epoch)) {
+      shared = ctx.site;
+      shared.function = S_EPOCH | S_GEOM;
+      shared.epoch = r.epoch;
+      shared.epochfrac = 0.0;
+      internal::compute(&shared);
+      shared_clock = pipe->clock[r.site];
+    }
+
+    /* the site's own inputs over the shared terms, then its stages */
+    posdata pd = shared;
+    pd.function = S_EPOCH | kStages;
+    pd.latitude = ctx.site.latitude;
+    pd.longitude = ctx.site.longitude;
+    pd.press = ctx.site.press;
+    pd.temp = ctx.site.temp;
+    pd.tilt = ctx.site.tilt;
+    pd.aspect = ctx.site.aspect;
+    pd.solcon = ctx.site.solcon;
+    internal::compute_local(&pd);
+
+    r.error = 0;
+    r.azim = pd.azim;
+    r.elevref = pd.elevref;
+    r.cosinc = pd.cosinc;
+    r.etr = pd.etr;
+    r.etrn = pd.etrn;
+    r.amass = pd.amass;
+  }
+}
+
+/*============================================================================
+ *    Local void function work
+ *
+ *    Body of worker first: serves input queues first, first + workers, ...
+ *----------------------------------------------------------------------------*/
+static void work(enrichpipe *pipe, int first) {
+  const int inputs = static_cast<int>(pipe->input.size());
+  const int step = pipe->workers;
+  std::vector<telemetry> records(pipe->batch);
+  std::vector<int> order(pipe->batch);
+  int idle = 0;
+
+  while (!pipe->stop.load(std::memory_order_relaxed)) {
+    /* closed before an empty sweep means nothing more can come */
+    bool closed = pipe->closed.load(std::memory_order_acquire);
+    int n = 0;
+    for (int q = first; q < inputs && n < pipe->batch; q += step)
+      while (n < pipe->batch && pipe->input[q]->pop(&records[n])) ++n;
+
+    if (n == 0) {
+      if (closed) break;
+      backoff(&idle);
+      continue;
+    }
+    idle = 0;
+
+    enrich(pipe, n, records.data(), order.data());
+    for (int i = 0; i < n; ++i) {
+      int full = 0;
+      while (!pipe->output.push(records[i])) {
+        if (pipe->stop.load(std::memory_order_relaxed)) break;
+        backoff(&full);
+      }
+    }
+  }
+  pipe->running.fetch_sub(1, std::memory_order_release);
+}
+
+/*============================================================================
+ *    Int function S_enrich_create
+ *----------------------------------------------------------------------------*/
+int S_enrich_create(const enrichspec *spec, int *errors, enrichpipe **pipe) {
+  int inputs = std::max(spec->inputs, 1);
+  size_t capacity = static_cast<size_t>(std::max(spec->capacity, 2));
+  std::unique_ptr<enrichpipe> made(new enrichpipe(capacity));
+  std::map<std::pair<double, int>, int> clocks;
+  int retval = 0;
+
+  *pipe = nullptr;
+  made->site.resize(spec->sites);
+  made->clock.resize(spec->sites);
+  for (int s = 0; s < spec->sites; ++s) {
+    posdata site = spec->site[s];
+    site.function = kStages;
+    int code = S_rt_init(&made->site[s], &site);
+    if (errors) errors[s] = code;
+    retval |= code;
+
+    std::pair<double, int> key(site.timezone, site.interval);
+    std::map<std::pair<double, int>, int>::iterator it = clocks.find(key);
+    if (it == clocks.end())
+      it = clocks.insert(std::make_pair(key, static_cast<int>(clocks.size())))
+               .first;
+    made->clock[s] = it->second;
+  }
+  if (retval != 0) return retval;
+
+  made->batch = std::max(spec->batch, 1);
+  for (int q = 0; q < inputs; ++q)
+    made->input.push_back(std::unique_ptr<internal::spsc_ring<telemetry> >(
+        new internal::spsc_ring<telemetry>(capacity)));
+
+  int workers = std::min(internal::thread_count(spec->workers, inputs, 1),
+                         inputs);
+  made->workers = workers;
+  made->running.store(workers);
+  made->closed.store(false);
+  made->stop.store(false);
+  for (int w = 0; w < workers; ++w)
+    made->worker.push_back(std::thread(work, made.get(), w));
+
+  *pipe = made.release();
+  return 0;
+}
+
+/*============================================================================
+ *    Int function S_enrich_push
+ *----------------------------------------------------------------------------*/
+int S_enrich_push(enrichpipe *pipe, int input, const telemetry *record) {
+  if ((record->site < 0) ||
+      (record->site >= static_cast<int>(pipe->site.size())))
+    return -1;
+  return pipe->input[input]->push(*record) ? 1 : 0;
+}
+
+/*============================================================================
+ *    Int function S_enrich_pop
+ *----------------------------------------------------------------------------*/
+int S_enrich_pop(enrichpipe *pipe, telemetry *record) {
+  if (pipe->output.pop(record)) return 1;
+  if (pipe->running.load(std::memory_order_acquire) > 0) return 0;
+  /* the workers may have pushed their last records before stopping */
+  return pipe->output.pop(record) ? 1 : -1;
+}
+
+/*============================================================================
+ *    Void function S_enrich_close
+ *----------------------------------------------------------------------------*/
+void S_enrich_close(enrichpipe *pipe) {
+  pipe->closed.store(true, std::memory_order_release);
+}
+
+/*============================================================================
+ *    Void function S_enrich_destroy
+ *----------------------------------------------------------------------------*/
+void S_enrich_destroy(enrichpipe *pipe) {
+  if (!pipe) return;
+  pipe->closed.store(true, std::memory_order_release);
+  pipe->stop.store(true, std::memory_order_relaxed);
+  for (size_t w = 0; w < pipe->worker.size(); ++w) pipe->worker[w].join();
+  delete pipe;
+}
+
+}  // namespace solpos
@@ -0,0 +1,127 @@
+/*============================================================================
+ *
+ *    NAME:  enrich.h
+ *
+ *    Contains:
+ *        S_enrich_create   (starts a pipeline adding solar position to a
+ *                           stream of telemetry records)
+ *        S_enrich_push     (queues a record, without blocking)
+ *        S_enrich_pop      (takes an enriched record, without blocking)
+ *        S_enrich_close    (no more records: workers drain and stop)
+ *        S_enrich_destroy  (stops the workers and frees the pipeline)
+ *
+ *            INPUTS:     per pipeline the sites (posdata, as for S_rt_init);
+ *                        per record a site index, epoch and measurements
+ *
+ *            OUTPUTS:    the records with azim, elevref, cosinc, etr, etrn
+ *                        and amass of their site and epoch
+ *
+ *    Producers push into lock-free single-producer queues, one per
+ *    producer thread; each queue is served by one of the worker threads,
+ *    which take records in micro-batches of up to spec.batch.  A batch is
+ *    sorted by epoch, and the records of one epoch at sites of one
+ *    timezone and interval share the date, time and ecliptic terms (the
+ *    S_GEOM stage up to the hour angle), which are most of the cost; the
+ *    rest runs per record.  Results are bitwise those of S_solpos with
+ *    S_EPOCH and the stages of S_ZENETR, S_SOLAZM, S_REFRAC, S_AMASS,
+ *    S_ETR and S_TILT.
+ *
+ *    Enriched records go to one lock-free multi-consumer queue, in input
+ *    order for each input queue.  There is backpressure all the way: a
+ *    worker waits while the output queue is full, so its input queues fill
+ *    and S_enrich_push starts returning 0.
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_ENRICH_H_
+#define SOLPOS_ENRICH_H_
+
+#include "solpos.h"
+
+namespace solpos {
+
+/* Measurements carried through with each record */
+#define S_TELEMETRY_VALUES 4
+
+struct telemetry {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  int site;              /* I:  Index into the pipeline's sites */
+  long long epoch;       /* I:  Unix time of the measurements */
+  double value[S_TELEMETRY_VALUES]; /* I:  Measurements, passed through */
+
+  int error;             /* O:  S_solpos return code (outputs NaN if set) */
+  double azim;           /* O:  posdata::azim */
+  double elevref;        /* O:  posdata::elevref */
+  double cosinc;         /* O:  posdata::cosinc, of the site's tilt/aspect */
+  double etr;            /* O:  posdata::etr */
+  double etrn;           /* O:  posdata::etrn */
+  double amass;          /* O:  posdata::amass */
+};
+
+struct enrichspec {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  int sites;             /* I:  Number of sites */
+  const posdata *site;   /* I:  The sites (their function is not used) */
+  int inputs;            /* I:  Input queues, one per producer thread */
+  int workers;           /* I:  Worker threads (0 = one per hardware thread;
+                                at most inputs) */
+  int capacity;          /* I:  Records per queue (rounded up to a power of
+                                two) */
+  int batch;             /* I:  Largest micro-batch */
+};
+
+struct enrichpipe; /* opaque */
+
+/*============================================================================
+ *    Int function S_enrich_create
+ *
+ *    Validates the sites and starts the workers.
+ *
+ *    OUTPUTS: errors[s] (S_rt_init code of site s; errors may be nullptr)
+ *
+ *    RETURNS: 0 with *pipe set, or the OR of the site codes (*pipe is
+ *             nullptr then)
+ *----------------------------------------------------------------------------*/
+int S_enrich_create(const enrichspec *spec, int *errors, enrichpipe **pipe);
+
+/*============================================================================
+ *    Int function S_enrich_push
+ *
+ *    Queues a copy of *record on input queue input.  Only one thread at a
+ *    time may push to a given input queue.
+ *
+ *    RETURNS: 1 when queued, 0 when the queue is full (try again later),
+ *             -1 when record->site is not a site of the pipeline
+ *----------------------------------------------------------------------------*/
+int S_enrich_push(enrichpipe *pipe, int input, const telemetry *record);
+
+/*============================================================================
+ *    Int function S_enrich_pop
+ *
+ *    Takes the next enriched record.  Any number of threads may pop.
+ *
+ *    RETURNS: 1 with *record filled, 0 when none is ready yet, -1 when
+ *             none ever will be (closed and drained)
+ *----------------------------------------------------------------------------*/
+int S_enrich_pop(enrichpipe *pipe, telemetry *record);
+
+/*============================================================================
+ *    Void function S_enrich_close
+ *
+ *    Call once every push has returned: the workers finish the queued
+ *    records and stop, after which S_enrich_pop drains the output.
+ *----------------------------------------------------------------------------*/
+void S_enrich_close(enrichpipe *pipe);
+
+/*============================================================================
+ *    Void function S_enrich_destroy
+ *
+ *    Stops the workers, dropping records not yet popped, and frees the
+ *    pipeline.  No thread may push or pop meanwhile.
+ *----------------------------------------------------------------------------*/
+void S_enrich_destroy(enrichpipe *pipe);
+
+}  // namespace solpos
+
+#endif  // SOLPOS_ENRICH_H_
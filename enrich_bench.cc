@@ -0,0 +1,135 @@
+/*============================================================================
+ *    Throughput and latency benchmark of the enrichment pipeline
+ *
+ *        enrich_bench [records] [producers] [workers] [batch]
+ *
+ *    Synthetic producers each report their share of 1000 inverters, spread
+ *    over four timezones, once a second of simulated time, as fast as the
+ *    pipeline takes them; one consumer drains the output.  Prints records
+ *    per second through the pipeline, next to a single thread calling
+ *    S_solpos per record, and the push-to-pop latency (p50, p99, p99.9,
+ *    max) of every 16th record.
+ *----------------------------------------------------------------------------*/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+#include "enrich.h"
+
+namespace {
+
+using solpos::posdata;
+using solpos::telemetry;
+
+typedef std::chrono::steady_clock Clock;
+
+const int kSites = 1000;
+const int kSampleEvery = 16;
+
+long long nanos() {
+  return std::chrono::duration_cast<std::chrono::nanoseconds>(
+             Clock::now().time_since_epoch())
+      .count();
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  long long records = argc > 1 ? std::atoll(argv[1]) : 4000000;
+  int producers = argc > 2 ? std::atoi(argv[2]) : 4;
+  int workers = argc > 3 ? std::atoi(argv[3]) : 4;
+  int batch = argc > 4 ? std::atoi(argv[4]) : 256;
+  if (producers < 1) producers = 1;
+  long long per = records / producers;
+  records = per * producers;
+
+  std::vector<posdata> sites(kSites);
+  const double tz[4] = {-8.0, -7.0, -6.0, -5.0};
+  for (int s = 0; s < kSites; ++s) {
+    solpos::S_init(&sites[s]);
+    sites[s].timezone = tz[s % 4];
+    sites[s].latitude = 30.0 + 0.01 * s;
+    sites[s].longitude = 15.0 * tz[s % 4] + 0.003 * s;
+    sites[s].tilt = 20.0 + s % 10;
+  }
+  const long long start = solpos::S_epoch(2022, 6, 1, 5, 0, 0, 0.0);
+
+  /* the baseline: one S_solpos call per record on one thread */
+  long long base_n = std::min(records, 200000LL);
+  double sink = 0.0;
+  long long t0 = nanos();
+  for (long long i = 0; i < base_n; ++i) {
+    posdata pd = sites[i % kSites];
+    pd.function = S_EPOCH | ((S_ZENETR | S_SOLAZM | S_REFRAC | S_AMASS |
+                              S_ETR | S_TILT) & ~L_DOY);
+    pd.epoch = start + i / kSites;
+    pd.epochfrac = 0.0;
+    solpos::S_solpos(&pd);
+    sink += pd.azim;
+  }
+  double base_rate = base_n * 1e9 / (nanos() - t0);
+
+  solpos::enrichspec spec = {kSites, sites.data(), producers, workers, 65536,
+                             batch};
+  solpos::enrichpipe *pipe;
+  if (solpos::S_enrich_create(&spec, nullptr, &pipe) != 0) {
+    std::fprintf(stderr, "bad sites\n");
+    return 1;
+  }
+
+  std::vector<long long> latency;
+  latency.reserve(records / kSampleEvery + 1);
+  long long popped = 0;
+  t0 = nanos();
+
+  std::thread consumer([&] {
+    telemetry r;
+    int got;
+    while ((got = solpos::S_enrich_pop(pipe, &r)) >= 0) {
+      if (got == 0) {
+        std::this_thread::yield();
+        continue;
+      }
+      if ((popped++ % kSampleEvery) == 0)
+        latency.push_back(nanos() - static_cast<long long>(r.value[3]));
+      sink += r.azim;
+    }
+  });
+
+  std::vector<std::thread> threads;
+  for (int q = 0; q < producers; ++q) {
+    threads.push_back(std::thread([=] {
+      telemetry r = {};
+      for (long long i = 0; i < per; ++i) {
+        long long k = i * producers + q; /* interleaved over the sites */
+        r.site = static_cast<int>(k % kSites);
+        r.epoch = start + k / kSites;
+        r.value[0] = 0.5 * r.site;
+        r.value[3] = static_cast<double>(nanos());
+        while (solpos::S_enrich_push(pipe, q, &r) == 0)
+          std::this_thread::yield();
+      }
+    }));
+  }
+  for (size_t q = 0; q < threads.size(); ++q) threads[q].join();
+  solpos::S_enrich_close(pipe);
+  consumer.join();
+  double seconds = (nanos() - t0) * 1e-9;
+  solpos::S_enrich_destroy(pipe);
+
+  std::sort(latency.begin(), latency.end());
+  size_t n = latency.size();
+  std::printf("%lld records, %d producers, %d workers, batch %d "
+              "(checksum %.3f)\n",
+              popped, producers, workers, batch, sink);
+  std::printf("pipeline  %12.0f records/s\n", popped / seconds);
+  std::printf("S_solpos  %12.0f records/s on one thread\n", base_rate);
+  if (n > 0)
+    std::printf("latency   p50 %lld  p99 %lld  p99.9 %lld  max %lld ns\n",
+                latency[n / 2], latency[n * 99 / 100],
+                latency[n * 999 / 1000], latency[n - 1]);
+  return 0;
+}
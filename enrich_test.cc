@@ -0,0 +1,154 @@
+#include "enrich.h"
+
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace solpos {
+namespace {
+
+std::vector<posdata> Sites() {
+  std::vector<posdata> sites(4);
+  const double lat[4] = {35.05, 39.74, 21.3, -33.9};
+  const double lon[4] = {-106.62, -105.18, -157.8, 18.4};
+  const double tz[4] = {-7.0, -7.0, -10.0, 2.0};
+  for (int s = 0; s < 4; ++s) {
+    S_init(&sites[s]);
+    sites[s].latitude = lat[s];
+    sites[s].longitude = lon[s];
+    sites[s].timezone = tz[s];
+    sites[s].tilt = 10.0 * s;
+    sites[s].aspect = s == 3 ? 0.0 : 180.0;
+  }
+  sites[1].press = 830.0;
+  sites[1].interval = 60; /* its own clock, despite the shared timezone */
+  return sites;
+}
+
+void Push(enrichpipe *pipe, int input, const telemetry &r) {
+  while (S_enrich_push(pipe, input, &r) == 0) std::this_thread::yield();
+}
+
+TEST(EnrichTest, MatchesSolposInInputOrder) {
+  std::vector<posdata> sites = Sites();
+  enrichspec spec = {4, sites.data(), 3, 2, 64, 32};
+  enrichpipe *pipe;
+  ASSERT_EQ(S_enrich_create(&spec, nullptr, &pipe), 0);
+
+  /* three producers, each sending every site once a minute for a day */
+  const long long start = S_epoch(2021, 9, 22, 0, 0, 0, 0.0);
+  const int per = 4 * 1440;
+  std::vector<std::thread> producers;
+  for (int q = 0; q < 3; ++q) {
+    producers.push_back(std::thread([=] {
+      for (int i = 0; i < per; ++i) {
+        telemetry r = {};
+        r.site = (i + q) % 4;
+        r.epoch = start + 60 * (i / 4) + 20 * q;
+        r.value[0] = i;
+        r.value[1] = q;
+        Push(pipe, q, r);
+      }
+    }));
+  }
+
+  std::vector<int> seen(3, 0);
+  int bad = 0, popped = 0;
+  std::thread consumer([&] {
+    telemetry r;
+    int got;
+    while ((got = S_enrich_pop(pipe, &r)) >= 0) {
+      if (got == 0) {
+        std::this_thread::yield();
+        continue;
+      }
+      ++popped;
+      int q = static_cast<int>(r.value[1]);
+      bad += r.value[0] != seen[q]++;
+
+      posdata pd = sites[r.site];
+      pd.function = S_EPOCH | ((S_ZENETR | S_SOLAZM | S_REFRAC | S_AMASS |
+                                S_ETR | S_TILT) & ~L_DOY);
+      pd.epoch = r.epoch;
+      pd.epochfrac = 0.0;
+      bad += S_solpos(&pd) != 0;
+      bad += (r.error != 0) | (r.azim != pd.azim) |
+             (r.elevref != pd.elevref) | (r.cosinc != pd.cosinc) |
+             (r.etr != pd.etr) | (r.etrn != pd.etrn) | (r.amass != pd.amass);
+    }
+  });
+  for (std::thread &p : producers) p.join();
+  S_enrich_close(pipe);
+  consumer.join();
+  S_enrich_destroy(pipe);
+
+  EXPECT_EQ(popped, 3 * per);
+  EXPECT_EQ(bad, 0);
+}
+
+TEST(EnrichTest, Errors) {
+  std::vector<posdata> sites = Sites();
+  sites[2].temp = -300.0;
+  int errors[4];
+  enrichspec spec = {4, sites.data(), 1, 1, 16, 8};
+  enrichpipe *pipe = nullptr;
+  EXPECT_EQ(S_enrich_create(&spec, errors, &pipe), 1L << S_TEMP_ERROR);
+  EXPECT_EQ(pipe, nullptr);
+  EXPECT_EQ(errors[0], 0);
+  EXPECT_EQ(errors[2], 1L << S_TEMP_ERROR);
+
+  sites[2].temp = 15.0;
+  ASSERT_EQ(S_enrich_create(&spec, errors, &pipe), 0);
+  telemetry r = {};
+  r.site = 4;
+  EXPECT_EQ(S_enrich_push(pipe, 0, &r), -1);
+  r.site = 0;
+  r.epoch = S_epoch(2051, 1, 1, 0, 0, 0, -7.0);
+  Push(pipe, 0, r);
+  r.epoch -= 1;
+  Push(pipe, 0, r);
+  S_enrich_close(pipe);
+
+  std::vector<telemetry> out;
+  telemetry got;
+  int code;
+  while ((code = S_enrich_pop(pipe, &got)) >= 0)
+    if (code == 1) out.push_back(got);
+  S_enrich_destroy(pipe);
+  ASSERT_EQ(out.size(), 2u);
+  EXPECT_EQ(out[0].error, 1L << S_YEAR_ERROR);
+  EXPECT_TRUE(std::isnan(out[0].azim));
+  EXPECT_EQ(out[1].error, 0);
+}
+
+TEST(EnrichTest, Backpressure) {
+  std::vector<posdata> sites = Sites();
+  enrichspec spec = {4, sites.data(), 1, 1, 8, 4};
+  enrichpipe *pipe;
+  ASSERT_EQ(S_enrich_create(&spec, nullptr, &pipe), 0);
+
+  /* nobody pops: the output fills, then the worker's batch, then input */
+  telemetry r = {};
+  r.epoch = S_epoch(2022, 1, 1, 12, 0, 0, -7.0);
+  int queued = 0;
+  for (int tries = 0; tries < 100000 && queued < 1000; ++tries) {
+    int code = S_enrich_push(pipe, 0, &r);
+    if (code == 1)
+      ++queued;
+    else
+      std::this_thread::yield();
+  }
+  EXPECT_LE(queued, 8 + 4 + 8);
+  EXPECT_GE(queued, 8 + 8);
+
+  /* the output holds the first records; destroying drops the rest */
+  telemetry got;
+  EXPECT_EQ(S_enrich_pop(pipe, &got), 1);
+  EXPECT_EQ(got.error, 0);
+  S_enrich_destroy(pipe);
+}
+
+}  // namespace
+}  // namespace solpos
@@ -0,0 +1,141 @@
+/*============================================================================
+ *    Contains:
+ *        S_heliostat_aim, S_heliostat_stream
+ *----------------------------------------------------------------------------*/
+#include "heliostat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+namespace solpos {
+
+/*============================================================================
+*    Local constants and function prototypes
+============================================================================*/
+static const int kBlock = 512;
+static const double kDegreesToRadians = M_PI / 180.0;
+static const double kRadiansToDegrees = 180.0 / M_PI;
+
+static void targets(const heliofield *field, int first, int n, double *tx,
+                    double *ty, double *tz);
+static void aim(int n, const double *tx, const double *ty, const double *tz,
+                double azim, double elevref, double *mirror_azim,
+                double *mirror_elev, double *cosine);
+
+/*============================================================================
+ *    Local void function targets
+ *
+ *    Unit vectors from mirrors [first, first + n) to the receiver
+ *----------------------------------------------------------------------------*/
+static void targets(const heliofield *field, int first, int n, double *tx,
+                    double *ty, double *tz) {
+  for (int i = 0; i < n; ++i) {
+    double dx = field->receiver[0] - field->east[first + i];
+    double dy = field->receiver[1] - field->north[first + i];
+    double dz = field->receiver[2] - field->up[first + i];
+    double inv = 1.0 / std::sqrt(dx * dx + dy * dy + dz * dz);
+    tx[i] = dx * inv;
+    ty[i] = dy * inv;
+    tz[i] = dz * inv;
+  }
+}
+
+/*============================================================================
+ *    Local void function aim
+ *
+ *    Outputs of n mirrors with receiver directions (tx, ty, tz) for the sun
+ *    at azim and elevref; cosine is required, the angle columns optional
+ *----------------------------------------------------------------------------*/
+static void aim(int n, const double *tx, const double *ty, const double *tz,
+                double azim, double elevref, double *mirror_azim,
+                double *mirror_elev, double *cosine) {
+  const double ce = std::cos(kDegreesToRadians * elevref);
+  const double sx = ce * std::sin(kDegreesToRadians * azim);
+  const double sy = ce * std::cos(kDegreesToRadians * azim);
+  const double sz = std::sin(kDegreesToRadians * elevref);
+  const double day = elevref > 0.0;
+
+  /* |s + t| = sqrt(2 + 2 s . t), and n . s = |s + t| / 2 */
+  for (int i = 0; i < n; ++i) {
+    double st = sx * tx[i] + sy * ty[i] + sz * tz[i];
+    cosine[i] = day * 0.5 * std::sqrt(2.0 + 2.0 * st);
+  }
+  if (!mirror_azim && !mirror_elev) return;
+
+  for (int i = 0; i < n; ++i) {
+    double nx = sx + tx[i], ny = sy + ty[i], nz = sz + tz[i];
+    double norm = std::sqrt(nx * nx + ny * ny + nz * nz);
+    double a = kRadiansToDegrees * std::atan2(nx, ny);
+    if (mirror_azim) mirror_azim[i] = a < 0.0 ? a + 360.0 : a;
+    if (mirror_elev) mirror_elev[i] = kRadiansToDegrees * std::asin(nz / norm);
+  }
+}
+
+/*============================================================================
+ *    Void function S_heliostat_aim
+ *----------------------------------------------------------------------------*/
+void S_heliostat_aim(const heliofield *field, double azim, double elevref,
+                     const heliocolumns *out) {
+  double tx[kBlock], ty[kBlock], tz[kBlock], cosine[kBlock];
+
+  for (int first = 0; first < field->count; first += kBlock) {
+    int n = std::min(kBlock, field->count - first);
+    targets(field, first, n, tx, ty, tz);
+    aim(n, tx, ty, tz, azim, elevref, out->azim ? out->azim + first : nullptr,
+        out->elev ? out->elev + first : nullptr,
+        out->cosine ? out->cosine + first : cosine);
+  }
+}
+
+/*============================================================================
+ *    Int function S_heliostat_stream
+ *----------------------------------------------------------------------------*/
+int S_heliostat_stream(const posbatch *batch, const heliofield *field,
+                       int angles, heliosink sink, void *context) {
+  const int count = field->count;
+  std::vector<double> tx(count), ty(count), tz(count), cosine(count);
+  std::vector<double> mirror_azim(angles ? count : 0),
+      mirror_elev(angles ? count : 0);
+  double azim[kBlock], elevref[kBlock];
+  int codes[kBlock];
+  posdata base = *batch->base;
+  posbatch work = *batch;
+  int summary = 0;
+
+  targets(field, 0, count, tx.data(), ty.data(), tz.data());
+
+  /* the sun vector needs only azim (S_SOLAZM) and elevref (S_REFRAC) */
+  base.function = (base.function & (L_DOY | S_EPOCH)) |
+                  ((S_SOLAZM | S_REFRAC) & ~L_DOY);
+  work.base = &base;
+
+  for (int first = 0; first < batch->count; first += kBlock) {
+    int n = std::min(kBlock, batch->count - first);
+    posbatch slice;
+    poscolumns columns = {};
+    columns.azim = azim;
+    columns.elevref = elevref;
+    S_batch_slice(&work, first, n, &slice);
+    summary |= S_solpos_columns(&slice, codes, &columns);
+
+    for (int i = 0; i < n; ++i) {
+      helioframe frame = {};
+      frame.error = codes[i];
+      frame.azim = azim[i];
+      frame.elevref = elevref[i];
+      if (codes[i] == 0) {
+        aim(count, tx.data(), ty.data(), tz.data(), azim[i], elevref[i],
+            angles ? mirror_azim.data() : nullptr,
+            angles ? mirror_elev.data() : nullptr, cosine.data());
+        frame.cosine = cosine.data();
+        frame.mirror_azim = angles ? mirror_azim.data() : nullptr;
+        frame.mirror_elev = angles ? mirror_elev.data() : nullptr;
+      }
+      sink(context, first + i, &frame);
+    }
+  }
+  return summary;
+}
+
+}  // namespace solpos
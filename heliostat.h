@@ -0,0 +1,97 @@
+/*============================================================================
+ *
+ *    NAME:  heliostat.h
+ *
+ *    Contains:
+ *        S_heliostat_aim     (aim normals, drive angles and cosine
+ *                             efficiency of every mirror of a field for one
+ *                             sun position)
+ *        S_heliostat_stream  (the same for every timestamp of a posbatch,
+ *                             handing each timestamp's results to a sink)
+ *
+ *            INPUTS:     mirror pivot positions and the receiver aim point
+ *                        (meters east, north and up of any common origin),
+ *                        and the sun's azim and elevref
+ *
+ *            OUTPUTS:    per mirror the azimuth and elevation of its normal
+ *                        (its drive angles, degrees, azimuth east of north
+ *                        as posdata::azim) and its cosine efficiency
+ *
+ *    A mirror reflects the sun onto the receiver when its normal bisects
+ *    the unit vectors s (to the sun) and t (to the receiver):
+ *    n = (s + t) / |s + t|.  Its cosine efficiency is then
+ *    n . s = sqrt((1 + s . t) / 2).  It is 0 with the sun at or below the
+ *    horizon (elevref <= 0); the drive angles are computed regardless.
+ *
+ *    The per-mirror loops are branch-free passes over columns; the cosine
+ *    pass is plain arithmetic and vectorizes, the drive angles (atan2 and
+ *    asin) are a separate pass that is skipped when not wanted.
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_HELIOSTAT_H_
+#define SOLPOS_HELIOSTAT_H_
+
+#include "batch.h"
+
+namespace solpos {
+
+struct heliofield {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  int count;             /* I:  Number of mirrors */
+  const double *east;    /* I:  Mirror pivot positions, m */
+  const double *north;
+  const double *up;
+  double receiver[3];    /* I:  Receiver aim point (east, north, up), m */
+};
+
+/* Per-mirror output columns, count entries each (nullptr = not wanted) */
+struct heliocolumns {
+  double *azim;          /* Azimuth of the mirror normal, degrees */
+  double *elev;          /* Elevation of the mirror normal, degrees */
+  double *cosine;        /* Cosine efficiency */
+};
+
+/* One timestamp of S_heliostat_stream */
+struct helioframe {
+  int error;             /* S_solpos return code of the timestamp */
+  double azim;           /* Sun azimuth (posdata::azim), degrees */
+  double elevref;        /* Sun elevation (posdata::elevref), degrees */
+
+  /* Mirror columns of the timestamp, as heliocolumns; nullptr for rows
+     with errors, and for the angles when they were not asked for */
+  const double *mirror_azim;
+  const double *mirror_elev;
+  const double *cosine;
+};
+
+/* Receives each timestamp of S_heliostat_stream, in row order.  The
+   columns of frame are only valid until it returns. */
+typedef void (*heliosink)(void *context, int row, const helioframe *frame);
+
+/*============================================================================
+ *    Void function S_heliostat_aim
+ *
+ *    Fills the non-null columns of out for the sun at azim and elevref
+ *    (degrees, as posdata).
+ *----------------------------------------------------------------------------*/
+void S_heliostat_aim(const heliofield *field, double azim, double elevref,
+                     const heliocolumns *out);
+
+/*============================================================================
+ *    Int function S_heliostat_stream
+ *
+ *    Computes the sun position once per row of batch (the S_SOLAZM and
+ *    S_REFRAC stages, a block of rows at a time), aims the whole field at
+ *    it and calls sink(context, row, frame).  The mirror-to-receiver
+ *    vectors are computed once per call.  Cosine efficiency is always
+ *    given; drive angles only when angles is nonzero.
+ *
+ *    RETURNS: The OR of all row codes
+ *----------------------------------------------------------------------------*/
+int S_heliostat_stream(const posbatch *batch, const heliofield *field,
+                       int angles, heliosink sink, void *context);
+
+}  // namespace solpos
+
+#endif  // SOLPOS_HELIOSTAT_H_
@@ -0,0 +1,145 @@
+#include "heliostat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace solpos {
+namespace {
+
+/* A ring of mirrors at several radii around a tower */
+struct Field {
+  std::vector<double> east, north, up;
+  heliofield field;
+
+  Field() {
+    for (int r = 50; r <= 500; r += 50)
+      for (int k = 0; k < 36; ++k) {
+        east.push_back(r * std::sin(k * M_PI / 18.0));
+        north.push_back(r * std::cos(k * M_PI / 18.0));
+        up.push_back(2.0 + 0.01 * k);
+      }
+    field.count = static_cast<int>(east.size());
+    field.east = east.data();
+    field.north = north.data();
+    field.up = up.data();
+    field.receiver[0] = 0.0;
+    field.receiver[1] = 0.0;
+    field.receiver[2] = 150.0;
+  }
+};
+
+TEST(HeliostatTest, SingleMirror) {
+  double east = 0.0, north = 0.0, up = 0.0;
+  heliofield field = {1, &east, &north, &up, {0.0, 0.0, 100.0}};
+  double azim, elev, cosine;
+  heliocolumns out = {&azim, &elev, &cosine};
+
+  /* receiver overhead, sun due south at 30 degrees: normal half way */
+  S_heliostat_aim(&field, 180.0, 30.0, &out);
+  EXPECT_NEAR(azim, 180.0, 1e-12);
+  EXPECT_NEAR(elev, 60.0, 1e-12);
+  EXPECT_NEAR(cosine, std::sqrt(0.75), 1e-15);
+
+  S_heliostat_aim(&field, 0.0, 90.0, &out);
+  EXPECT_NEAR(elev, 90.0, 1e-6);
+  EXPECT_NEAR(cosine, 1.0, 1e-15);
+
+  S_heliostat_aim(&field, 90.0, -3.0, &out);
+  EXPECT_EQ(cosine, 0.0);
+  EXPECT_NEAR(azim, 90.0, 1e-12);
+}
+
+TEST(HeliostatTest, NormalsReflectTheSunOntoTheReceiver) {
+  Field f;
+  const int n = f.field.count;
+  std::vector<double> azim(n), elev(n), cosine(n);
+  heliocolumns out = {azim.data(), elev.data(), cosine.data()};
+  const double sun_azim = 123.0, sun_elev = 41.0;
+  S_heliostat_aim(&f.field, sun_azim, sun_elev, &out);
+
+  const double d = M_PI / 180.0;
+  double s[3] = {std::cos(sun_elev * d) * std::sin(sun_azim * d),
+                 std::cos(sun_elev * d) * std::cos(sun_azim * d),
+                 std::sin(sun_elev * d)};
+  for (int i = 0; i < n; ++i) {
+    double m[3] = {std::cos(elev[i] * d) * std::sin(azim[i] * d),
+                   std::cos(elev[i] * d) * std::cos(azim[i] * d),
+                   std::sin(elev[i] * d)};
+    double t[3] = {-f.east[i], -f.north[i], 150.0 - f.up[i]};
+    double len = std::sqrt(t[0] * t[0] + t[1] * t[1] + t[2] * t[2]);
+    double ms = m[0] * s[0] + m[1] * s[1] + m[2] * s[2];
+    EXPECT_NEAR(cosine[i], ms, 1e-12) << "mirror " << i;
+    /* the reflection 2 (m . s) m - s points at the receiver */
+    for (int k = 0; k < 3; ++k)
+      EXPECT_NEAR(2.0 * ms * m[k] - s[k], t[k] / len, 1e-12) << "mirror " << i;
+  }
+  /* mirrors on the sun's side of the tower do worse */
+  EXPECT_LT(cosine[18], cosine[0]);
+}
+
+struct Collect {
+  const heliofield *field;
+  int rows, errors, day;
+  double worst;
+};
+
+void Check(void *context, int row, const helioframe *frame) {
+  Collect *c = static_cast<Collect *>(context);
+  EXPECT_EQ(row, c->rows);
+  ++c->rows;
+  if (frame->error) {
+    ++c->errors;
+    EXPECT_EQ(frame->cosine, nullptr);
+    return;
+  }
+  EXPECT_EQ(frame->mirror_elev, nullptr);
+  std::vector<double> cosine(c->field->count);
+  heliocolumns out = {nullptr, nullptr, cosine.data()};
+  S_heliostat_aim(c->field, frame->azim, frame->elevref, &out);
+  for (int i = 0; i < c->field->count; ++i) {
+    c->worst = std::max(c->worst, std::fabs(cosine[i] - frame->cosine[i]));
+  }
+  c->day += frame->elevref > 0.0;
+}
+
+TEST(HeliostatTest, StreamMatchesAim) {
+  Field f;
+  posdata base;
+  S_init(&base);
+  base.function = S_ALL & ~S_DOY;
+  base.latitude = 37.56;
+  base.longitude = -116.12;
+  base.timezone = -8.0;
+  base.year = 2019;
+  base.month = 3;
+  base.day = 20;
+  base.second = 0;
+
+  const int count = 1440;
+  std::vector<int> hour(count), minute(count);
+  for (int i = 0; i < count; ++i) {
+    hour[i] = i / 60;
+    minute[i] = i % 60;
+  }
+  minute[600] = 99;
+  posbatch batch = {};
+  batch.base = &base;
+  batch.count = count;
+  batch.hour = hour.data();
+  batch.minute = minute.data();
+
+  Collect c = {&f.field, 0, 0, 0, 0.0};
+  EXPECT_EQ(S_heliostat_stream(&batch, &f.field, 0, Check, &c),
+            1L << S_MINUTE_ERROR);
+  EXPECT_EQ(c.rows, count);
+  EXPECT_EQ(c.errors, 1);
+  EXPECT_GT(c.day, 700);
+  EXPECT_LT(c.day, 760);
+  EXPECT_EQ(c.worst, 0.0);
+}
+
+}  // namespace
+}  // namespace solpos
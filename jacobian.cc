@@ -0,0 +1,102 @@
+/*============================================================================
+ *    Contains:
+ *        S_solpos_jacobian
+ *----------------------------------------------------------------------------*/
+#include "jacobian.h"
+
+#include <limits>
+
+#include "dual.h"
+#include "solpos_internal.h"
+#include "solpos_stages.h"
+
+namespace solpos {
+
+/*============================================================================
+*    Local constants and types
+============================================================================*/
+static const double kNaN = std::numeric_limits<double>::quiet_NaN();
+
+/* Seeded inputs */
+enum { kTime, kTilt, kAspect, kInputs };
+
+typedef dual<kInputs> scalar;
+
+/* The posdata members the templated stages use, as dual numbers */
+struct dualpos {
+  int function;
+  scalar ectime, utime;
+  scalar latitude, longitude, press, temp, tilt, aspect;
+  scalar mnlong, mnanom, eclong, ecobli, declin, rascen, gmst, lmst, hrang;
+  scalar zenetr, elevetr, azim, elevref, zenref, coszen;
+  scalar etrn, cosinc, etrtilt;
+};
+
+/*============================================================================
+ *    Int function S_solpos_jacobian
+ *----------------------------------------------------------------------------*/
+int S_solpos_jacobian(const posbatch *batch, int *errors,
+                      const posjacobian *out) {
+  posdata base = *batch->base;
+  posbatch work = *batch;
+  const int dates = base.function & (L_DOY | S_EPOCH);
+
+  base.function = dates | ((S_TILT | S_ETR) & ~L_DOY);
+  work.base = &base;
+  int summary = S_validate_batch(&work, errors);
+
+  for (int i = 0; i < batch->count; ++i) {
+    posdata pd;
+    dualpos dp;
+
+    if (errors[i] == 0) {
+      /* date and time terms in double; they are exact in whole days */
+      S_batch_row(&work, i, &pd);
+      pd.function = dates | L_GEOM;
+      internal::compute(&pd);
+
+      dp.function = dates | ((S_TILT | S_ETR) & ~L_DOY);
+      dp.ectime = scalar(pd.ectime);
+      dp.ectime.d[kTime] = 1.0 / 86400.0;
+      dp.utime = scalar(pd.utime);
+      dp.utime.d[kTime] = 1.0 / 3600.0;
+      dp.latitude = pd.latitude;
+      dp.longitude = pd.longitude;
+      dp.press = pd.press;
+      dp.temp = pd.temp;
+      dp.tilt = scalar::seed(pd.tilt, kTilt);
+      dp.aspect = scalar::seed(pd.aspect, kAspect);
+
+      internal::trigdata<scalar> trig;
+      internal::init_trig(&trig);
+      internal::ecliptic(&dp);
+      internal::zen_no_ref(&dp, &trig);
+      internal::sazm(&dp, &trig);
+      internal::refrac(&dp);
+      dp.etrn = dp.coszen > 0.0 ? pd.solcon * pd.erv : 0.0;
+      internal::tilt(&dp);
+    } else {
+      dp.azim = dp.elevref = dp.cosinc = dp.etrtilt = kNaN;
+      for (int k = 0; k < kInputs; ++k)
+        dp.azim.d[k] = dp.elevref.d[k] = dp.cosinc.d[k] = dp.etrtilt.d[k] =
+            kNaN;
+    }
+
+    if (out->azim) out->azim[i] = dp.azim.v;
+    if (out->elevref) out->elevref[i] = dp.elevref.v;
+    if (out->cosinc) out->cosinc[i] = dp.cosinc.v;
+    if (out->etrtilt) out->etrtilt[i] = dp.etrtilt.v;
+    if (out->azim_dt) out->azim_dt[i] = dp.azim.d[kTime];
+    if (out->elevref_dt) out->elevref_dt[i] = dp.elevref.d[kTime];
+    if (out->cosinc_dt) out->cosinc_dt[i] = dp.cosinc.d[kTime];
+    if (out->etrtilt_dt) out->etrtilt_dt[i] = dp.etrtilt.d[kTime];
+    if (out->cosinc_dtilt) out->cosinc_dtilt[i] = dp.cosinc.d[kTilt];
+    if (out->etrtilt_dtilt) out->etrtilt_dtilt[i] = dp.etrtilt.d[kTilt];
+    if (out->cosinc_daspect) out->cosinc_daspect[i] = dp.cosinc.d[kAspect];
+    if (out->etrtilt_daspect)
+      out->etrtilt_daspect[i] = dp.etrtilt.d[kAspect];
+  }
+  return summary;
+}
+
+}  // namespace solpos
@@ -0,0 +1,76 @@
+/*============================================================================
+ *
+ *    NAME:  jacobian.h
+ *
+ *    Contains:
+ *        S_solpos_jacobian  (solar position and tilted-surface outputs with
+ *                            their exact derivatives with respect to time,
+ *                            panel tilt and panel aspect)
+ *
+ *            INPUTS:     a posbatch, as S_solpos_columns
+ *
+ *            OUTPUTS:    value columns, rates per second of time (the sun's
+ *                        angular rates among them), and the sensitivities
+ *                        of cosinc and etrtilt to tilt and aspect
+ *
+ *    The derivatives come in one pass, by running the S_solpos stages from
+ *    the ecliptic coordinates to the tilted surface (solpos_stages.h) on
+ *    dual<3> numbers (dual.h) seeded with time, tilt and aspect, instead of
+ *    two or more S_solpos calls per finite difference.  They are those of
+ *    the model as written: zero where an output is clamped (zenetr past 99
+ *    degrees, elevref below -9, etrtilt when cosinc < 0), and not defined
+ *    at the steps of the model (the near-zenith refraction cutoff, and
+ *    azim with the sun at the zenith or pole).  Erv is taken per day, so
+ *    its time rate is zero.
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_JACOBIAN_H_
+#define SOLPOS_JACOBIAN_H_
+
+#include "batch.h"
+
+namespace solpos {
+
+/* Output columns filled by S_solpos_jacobian.  Each is either nullptr (not
+   wanted) or has batch->count entries.  Angles are in degrees, time in
+   seconds. */
+struct posjacobian {
+  /* Values, as the posdata members */
+  double *azim;
+  double *elevref;
+  double *cosinc;
+  double *etrtilt;
+
+  /* Per second of time */
+  double *azim_dt;
+  double *elevref_dt;
+  double *cosinc_dt;
+  double *etrtilt_dt;
+
+  /* Per degree of tilt */
+  double *cosinc_dtilt;
+  double *etrtilt_dtilt;
+
+  /* Per degree of aspect */
+  double *cosinc_daspect;
+  double *etrtilt_daspect;
+};
+
+/*============================================================================
+ *    Int function S_solpos_jacobian
+ *
+ *    Validates every row of batch (as S_validate_batch; the S_TILT and
+ *    S_ETR stages are run whatever batch->base->function selects) and
+ *    fills the non-null columns of out for the valid rows.  Rows with
+ *    errors get NaN.
+ *
+ *    OUTPUTS: errors[i] (S_solpos return code) and the columns of out
+ *
+ *    RETURNS: The OR of all row codes
+ *----------------------------------------------------------------------------*/
+int S_solpos_jacobian(const posbatch *batch, int *errors,
+                      const posjacobian *out);
+
+}  // namespace solpos
+
+#endif  // SOLPOS_JACOBIAN_H_
@@ -0,0 +1,135 @@
+#include "jacobian.h"
+
+#include <cmath>
+#include <vector>
+
+#include "dual.h"
+#include "gtest/gtest.h"
+
+namespace solpos {
+namespace {
+
+TEST(DualTest, ChainRule) {
+  dual<2> x = dual<2>::seed(0.3, 0);
+  dual<2> y = dual<2>::seed(1.2, 1);
+  dual<2> f = sin(x) * y / (1.0 + x * x) + pow(y, 3.0) - atan2(y, x);
+  double r2 = 0.09 + 1.44;
+  EXPECT_NEAR(f.d[0],
+              std::cos(0.3) * 1.2 / 1.09 -
+                  std::sin(0.3) * 1.2 * 0.6 / (1.09 * 1.09) + 1.2 / r2,
+              1e-12);
+  EXPECT_NEAR(f.d[1], std::sin(0.3) / 1.09 + 3.0 * 1.44 - 0.3 / r2, 1e-12);
+  EXPECT_NEAR(acos(x).d[0], -1.0 / std::sqrt(1.0 - 0.09), 1e-12);
+  EXPECT_EQ(abs(-x).d[0], 1.0);
+  EXPECT_TRUE(x < y);
+  EXPECT_TRUE(x > 0.2);
+}
+
+class JacobianTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    S_init(&base);
+    base.function = S_ALL | S_EPOCH;
+    base.latitude = 35.05;
+    base.longitude = -106.62;
+    base.timezone = -7.0;
+    base.press = 840.0;
+    base.temp = 25.0;
+    base.tilt = 30.0;
+    base.aspect = 160.0;
+
+    /* sunrise to past sunset, every 20 minutes */
+    const long long start = S_epoch(2018, 6, 21, 4, 0, 0, base.timezone);
+    for (int i = 0; i < kRows; ++i) epoch[i] = start + 1200LL * i;
+    batch = {};
+    batch.base = &base;
+    batch.count = kRows;
+    batch.epoch = epoch;
+  }
+
+  /* S_solpos of row i with epoch offset by dt seconds */
+  posdata At(int i, long long dt, double dtilt = 0.0, double daspect = 0.0) {
+    posdata pd = base;
+    pd.epoch = epoch[i] + dt;
+    pd.tilt += dtilt;
+    pd.aspect += daspect;
+    EXPECT_EQ(S_solpos(&pd), 0);
+    return pd;
+  }
+
+  static const int kRows = 54;
+  posdata base;
+  posbatch batch;
+  long long epoch[kRows];
+};
+
+TEST_F(JacobianTest, MatchesSolposAndFiniteDifferences) {
+  std::vector<double> azim(kRows), elevref(kRows), cosinc(kRows),
+      etrtilt(kRows), azim_dt(kRows), elevref_dt(kRows), cosinc_dt(kRows),
+      cosinc_dtilt(kRows), cosinc_daspect(kRows), etrtilt_dtilt(kRows);
+  int errors[kRows];
+  posjacobian out = {};
+  out.azim = azim.data();
+  out.elevref = elevref.data();
+  out.cosinc = cosinc.data();
+  out.etrtilt = etrtilt.data();
+  out.azim_dt = azim_dt.data();
+  out.elevref_dt = elevref_dt.data();
+  out.cosinc_dt = cosinc_dt.data();
+  out.cosinc_dtilt = cosinc_dtilt.data();
+  out.cosinc_daspect = cosinc_daspect.data();
+  out.etrtilt_dtilt = etrtilt_dtilt.data();
+  ASSERT_EQ(S_solpos_jacobian(&batch, errors, &out), 0);
+
+  int day = 0;
+  for (int i = 0; i < kRows; ++i) {
+    posdata pd = At(i, 0);
+    EXPECT_EQ(azim[i], pd.azim) << "row " << i;
+    EXPECT_EQ(elevref[i], pd.elevref) << "row " << i;
+    EXPECT_EQ(cosinc[i], pd.cosinc) << "row " << i;
+    EXPECT_EQ(etrtilt[i], pd.etrtilt) << "row " << i;
+
+    /* away from the refraction formula's seams and the night clamp */
+    if (pd.elevetr < 6.0 || pd.elevetr > 84.0) continue;
+    ++day;
+    posdata later = At(i, 10), earlier = At(i, -10);
+    EXPECT_NEAR(azim_dt[i], (later.azim - earlier.azim) / 20.0, 1e-7)
+        << "row " << i;
+    EXPECT_NEAR(elevref_dt[i], (later.elevref - earlier.elevref) / 20.0,
+                1e-7);
+    EXPECT_NEAR(cosinc_dt[i], (later.cosinc - earlier.cosinc) / 20.0, 1e-9);
+
+    posdata up = At(i, 0, 1e-3), down = At(i, 0, -1e-3);
+    EXPECT_NEAR(cosinc_dtilt[i], (up.cosinc - down.cosinc) / 2e-3, 1e-8);
+    if (pd.cosinc > 0.0) {
+      EXPECT_NEAR(etrtilt_dtilt[i], (up.etrtilt - down.etrtilt) / 2e-3, 1e-5);
+    }
+    up = At(i, 0, 0.0, 1e-3);
+    down = At(i, 0, 0.0, -1e-3);
+    EXPECT_NEAR(cosinc_daspect[i], (up.cosinc - down.cosinc) / 2e-3, 1e-8);
+  }
+  EXPECT_GT(day, 30);
+
+  /* rising in the morning, at under 15 degrees an hour; setting later */
+  EXPECT_GT(elevref_dt[12], 0.0);
+  EXPECT_LT(elevref_dt[12], 15.0 / 3600.0);
+  EXPECT_LT(elevref_dt[40], 0.0);
+}
+
+TEST_F(JacobianTest, ErrorRowsAreNaN) {
+  epoch[3] = -1000000000000LL;
+  std::vector<double> cosinc(kRows), azim_dt(kRows);
+  int errors[kRows];
+  posjacobian out = {};
+  out.cosinc = cosinc.data();
+  out.azim_dt = azim_dt.data();
+  EXPECT_NE(S_solpos_jacobian(&batch, errors, &out), 0);
+  EXPECT_NE(errors[3], 0);
+  EXPECT_TRUE(std::isnan(cosinc[3]));
+  EXPECT_TRUE(std::isnan(azim_dt[3]));
+  EXPECT_EQ(errors[4], 0);
+  EXPECT_FALSE(std::isnan(azim_dt[4]));
+}
+
+}  // namespace
+}  // namespace solpos
@@ -0,0 +1,78 @@
+/*============================================================================
+ *
+ *    NAME:  lru.h
+ *
+ *    Contains:
+ *        internal::lru_cache  (fixed-capacity map evicting the least
+ *                              recently used entry)
+ *
+ *    A list in recency order plus a hash index into it; find and insert
+ *    are O(1).  find never allocates.  Once the cache is full an eviction
+ *    reuses the oldest list node, but its index entry is erased and a new
+ *    one made (node reuse needs C++17 extract), so each eviction frees and
+ *    allocates one hash node.  Not thread-safe.  Not part of the public
+ *    API.
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_LRU_H_
+#define SOLPOS_LRU_H_
+
+#include <cstddef>
+#include <list>
+#include <unordered_map>
+#include <utility>
+
+namespace solpos {
+namespace internal {
+
+template <typename K, typename V, typename Hash, typename Eq>
+struct lru_cache {
+  typedef std::list<std::pair<K, V> > entries;
+
+  explicit lru_cache(size_t capacity) : capacity(capacity) {
+    index.reserve(capacity);
+  }
+
+  /* The value of key, now the most recent, or nullptr */
+  const V *find(const K &key) {
+    typename map::iterator it = index.find(key);
+    if (it == index.end()) return nullptr;
+    order.splice(order.begin(), order, it->second);
+    return &it->second->second;
+  }
+
+  /* Adds or replaces key as the most recent entry */
+  void insert(const K &key, const V &value) {
+    if (capacity == 0) return;
+    typename map::iterator it = index.find(key);
+    if (it != index.end()) {
+      it->second->second = value;
+      order.splice(order.begin(), order, it->second);
+      return;
+    }
+    if (index.size() >= capacity) {
+      /* reuse the oldest node */
+      typename entries::iterator last = --order.end();
+      index.erase(last->first);
+      last->first = key;
+      last->second = value;
+      order.splice(order.begin(), order, last);
+    } else {
+      order.push_front(std::make_pair(key, value));
+    }
+    index[key] = order.begin();
+  }
+
+  size_t size() const { return index.size(); }
+
+  typedef std::unordered_map<K, typename entries::iterator, Hash, Eq> map;
+
+  const size_t capacity;
+  entries order; /* most recent first */
+  map index;
+};
+
+}  // namespace internal
+}  // namespace solpos
+
+#endif  // SOLPOS_LRU_H_
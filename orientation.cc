@@ -0,0 +1,308 @@
+/*============================================================================
+ *    Contains:
+ *        S_orientation_optimize
+ *
+ *        The sun table is built a block of kBlock samples at a time
+ *        (positions, then clear-sky irradiance, into stack columns) and
+ *        keeps daytime rows only.  Orientations are evaluated kBlock table
+ *        rows at a time against a whole row of grid aspects, so each block
+ *        is read from cache once per tilt.
+ *----------------------------------------------------------------------------*/
+#include "orientation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "batch.h"
+#include "parallel.h"
+
+namespace solpos {
+
+/*============================================================================
+*    Local constants, types and function prototypes
+============================================================================*/
+static const int kBlock = 512;
+static const double kDegreesToRadians = M_PI / 180.0;
+static const double kNaN = std::numeric_limits<double>::quiet_NaN();
+static const double kGolden = 0.6180339887498949; /* (sqrt(5) - 1) / 2 */
+
+/* Daytime sun vectors of one site's year, scaled by beam irradiance times
+   the sample interval (Wh/m^2); x east, y north, z up */
+struct suntable {
+  std::vector<double> x, y, z;
+  double diffuse; /* annual DHI, Wh/m^2 */
+  double ground;  /* annual albedo * GHI, Wh/m^2 */
+};
+
+static int build_table(const orientsite *site, const orientspec *spec,
+                       suntable *table);
+static void beam_totals(const suntable *table, int normals, const double *nx,
+                        const double *ny, const double *nz, double *total);
+static double energy(const suntable *table, double tilt, double aspect);
+template <typename F>
+static double golden(F f, double lo, double hi, double tol);
+static void optimize_site(const orientsite *site, const orientspec *spec,
+                          int *error, orientresult *result);
+
+/*============================================================================
+ *    Local int function build_table
+ *
+ *    Samples the year of site into table; returns the S_solpos code of
+ *    the site's inputs
+ *----------------------------------------------------------------------------*/
+static int build_table(const orientsite *site, const orientspec *spec,
+                       suntable *table) {
+  double zenref[kBlock], azim[kBlock], coszen[kBlock], etrn[kBlock],
+      ampress[kBlock], ghi[kBlock], dni[kBlock], dhi[kBlock];
+  long long epoch[kBlock];
+  int daynum[kBlock], codes[kBlock];
+  posdata base = site->site;
+  /* whole days of samples, so that no tail of the year is dropped */
+  if ((spec->step < 1) || (spec->step > 480) || (1440 % spec->step != 0))
+    return 1L << S_INTRVL_ERROR;
+  if (spec->tilts < 2) return 1L << S_TILT_ERROR;
+  if (spec->aspects < 2) return 1L << S_ASPECT_ERROR;
+  const long long interval = spec->step * 60LL;
+  const double hours = spec->step / 60.0;
+
+  /* Each sample is taken at the middle of its interval (what S_solpos
+     does with interval set and the epoch at the interval's end), so the
+     last one stays inside the year: an end epoch of 1 JAN of the next
+     year is past the S_EPOCH limits for 2050. */
+  base.function =
+      S_EPOCH | ((S_SOLAZM | S_REFRAC | S_AMASS | S_ETR) & ~L_DOY);
+  base.interval = 0;
+  base.epochfrac = 0.0;
+  const long long start = S_epoch(base.year, 1, 1, 0, 0, 0, base.timezone);
+  const long long end = S_epoch(base.year + 1, 1, 1, 0, 0, 0, base.timezone);
+  const long long samples = (end - start) / interval;
+
+  /* the first sample stands for the whole site */
+  base.epoch = start + interval / 2;
+  int code = S_validate(&base);
+  if (code) return code;
+
+  table->x.clear();
+  table->y.clear();
+  table->z.clear();
+  table->diffuse = table->ground = 0.0;
+
+  for (long long first = 0; first < samples; first += kBlock) {
+    int n = static_cast<int>(std::min<long long>(kBlock, samples - first));
+    for (int i = 0; i < n; ++i) {
+      epoch[i] = start + (first + i) * interval + interval / 2;
+      daynum[i] = static_cast<int>((first + i) * interval / 86400) + 1;
+    }
+
+    posbatch batch = {};
+    batch.base = &base;
+    batch.count = n;
+    batch.epoch = epoch;
+    poscolumns columns = {};
+    columns.zenref = zenref;
+    columns.azim = azim;
+    columns.coszen = coszen;
+    columns.etrn = etrn;
+    columns.ampress = ampress;
+    code = S_solpos_columns(&batch, codes, &columns);
+    if (code) return code;
+
+    const double *beam = etrn;
+    if (spec->model == S_ORIENT_CLEARSKY) {
+      clearskydata cs = {};
+      cs.count = n;
+      cs.coszen = coszen;
+      cs.ampress = ampress;
+      cs.etrn = etrn;
+      cs.daynum = daynum;
+      cs.ghi = ghi;
+      cs.dni = dni;
+      cs.dhi = dhi;
+      S_clearsky_ineichen(1, &site->sky, &cs);
+      for (int i = 0; i < n; ++i) {
+        table->diffuse += dhi[i] * hours;
+        table->ground += site->albedo * ghi[i] * hours;
+      }
+      beam = dni;
+    }
+
+    for (int i = 0; i < n; ++i) {
+      if (!(coszen[i] > 0.0 && beam[i] > 0.0)) continue;
+      double w = beam[i] * hours;
+      double sz = std::sin(kDegreesToRadians * zenref[i]);
+      table->x.push_back(w * sz * std::sin(kDegreesToRadians * azim[i]));
+      table->y.push_back(w * sz * std::cos(kDegreesToRadians * azim[i]));
+      table->z.push_back(w * coszen[i]);
+    }
+  }
+  return 0;
+}
+
+/*============================================================================
+ *    Local void function beam_totals
+ *
+ *    total[k] = sum over table rows of max(0, n_k . s) for normals
+ *    (nx[k], ny[k], nz[k]), k < normals
+ *----------------------------------------------------------------------------*/
+static void beam_totals(const suntable *table, int normals, const double *nx,
+                        const double *ny, const double *nz, double *total) {
+  const int rows = static_cast<int>(table->x.size());
+  const double *x = table->x.data(), *y = table->y.data(),
+               *z = table->z.data();
+
+  for (int k = 0; k < normals; ++k) total[k] = 0.0;
+  for (int first = 0; first < rows; first += kBlock) {
+    int n = std::min(kBlock, rows - first);
+    for (int k = 0; k < normals; ++k) {
+      double sum = 0.0;
+      for (int i = first; i < first + n; ++i) {
+        double d = nx[k] * x[i] + ny[k] * y[i] + nz[k] * z[i];
+        sum += d > 0.0 ? d : 0.0;
+      }
+      total[k] += sum;
+    }
+  }
+}
+
+/*============================================================================
+ *    Local double function energy
+ *
+ *    Annual irradiation on the surface at tilt and aspect, Wh/m^2
+ *----------------------------------------------------------------------------*/
+static double energy(const suntable *table, double tilt, double aspect) {
+  double st = std::sin(kDegreesToRadians * tilt);
+  double ct = std::cos(kDegreesToRadians * tilt);
+  double nx = st * std::sin(kDegreesToRadians * aspect);
+  double ny = st * std::cos(kDegreesToRadians * aspect);
+  double beam;
+
+  beam_totals(table, 1, &nx, &ny, &ct, &beam);
+  return beam + table->diffuse * (1.0 + ct) / 2.0 +
+         table->ground * (1.0 - ct) / 2.0;
+}
+
+/*============================================================================
+ *    Local double function golden
+ *
+ *    The x in [lo, hi] maximizing f, by golden-section search to within
+ *    tol
+ *----------------------------------------------------------------------------*/
+template <typename F>
+static double golden(F f, double lo, double hi, double tol) {
+  double a = hi - kGolden * (hi - lo), b = lo + kGolden * (hi - lo);
+  double fa = f(a), fb = f(b);
+
+  while (hi - lo > tol) {
+    if (fa < fb) {
+      lo = a;
+      a = b;
+      fa = fb;
+      b = lo + kGolden * (hi - lo);
+      fb = f(b);
+    } else {
+      hi = b;
+      b = a;
+      fb = fa;
+      a = hi - kGolden * (hi - lo);
+      fa = f(a);
+    }
+  }
+  return (lo + hi) / 2.0;
+}
+
+/*============================================================================
+ *    Local void function optimize_site
+ *----------------------------------------------------------------------------*/
+static void optimize_site(const orientsite *site, const orientspec *spec,
+                          int *error, orientresult *result) {
+  suntable table;
+
+  *error = build_table(site, spec, &table);
+  if (*error) {
+    result->tilt = result->aspect = result->energy = kNaN;
+    if (result->surface && (spec->tilts > 0) && (spec->aspects > 0))
+      std::fill(result->surface,
+                result->surface + spec->tilts * spec->aspects, kNaN);
+    return;
+  }
+
+  /* the grid, a row of aspects per pass over the table */
+  const double dtilt = (spec->tilt_max - spec->tilt_min) / (spec->tilts - 1);
+  const double daspect =
+      (spec->aspect_max - spec->aspect_min) / (spec->aspects - 1);
+  std::vector<double> nx(spec->aspects), ny(spec->aspects),
+      nz(spec->aspects), row(spec->aspects);
+  double best = -1.0, tilt = spec->tilt_min, aspect = spec->aspect_min;
+
+  for (int t = 0; t < spec->tilts; ++t) {
+    double beta = spec->tilt_min + t * dtilt;
+    double st = std::sin(kDegreesToRadians * beta);
+    double ct = std::cos(kDegreesToRadians * beta);
+    for (int a = 0; a < spec->aspects; ++a) {
+      double gamma = spec->aspect_min + a * daspect;
+      nx[a] = st * std::sin(kDegreesToRadians * gamma);
+      ny[a] = st * std::cos(kDegreesToRadians * gamma);
+      nz[a] = ct;
+    }
+    beam_totals(&table, spec->aspects, nx.data(), ny.data(), nz.data(),
+                row.data());
+    for (int a = 0; a < spec->aspects; ++a) {
+      double e = row[a] + table.diffuse * (1.0 + ct) / 2.0 +
+                 table.ground * (1.0 - ct) / 2.0;
+      if (result->surface) result->surface[t * spec->aspects + a] = e;
+      if (e > best) {
+        best = e;
+        tilt = beta;
+        aspect = spec->aspect_min + a * daspect;
+      }
+    }
+  }
+
+  /* golden-section refinement within a grid step, a coordinate at a time */
+  if (spec->tolerance > 0.0) {
+    double t = tilt, a = aspect;
+    for (int round = 0; round < 8; ++round) {
+      double t0 = t, a0 = a;
+      t = golden([&](double x) { return energy(&table, x, a); },
+                 std::max(spec->tilt_min, t - dtilt),
+                 std::min(spec->tilt_max, t + dtilt), spec->tolerance);
+      a = golden([&](double x) { return energy(&table, t, x); },
+                 std::max(spec->aspect_min, a - daspect),
+                 std::min(spec->aspect_max, a + daspect), spec->tolerance);
+      if (std::fabs(t - t0) < spec->tolerance &&
+          std::fabs(a - a0) < spec->tolerance)
+        break;
+    }
+    double e = energy(&table, t, a);
+    if (e > best) {
+      best = e;
+      tilt = t;
+      aspect = a;
+    }
+  }
+
+  result->tilt = tilt;
+  result->aspect = aspect;
+  result->energy = best;
+}
+
+/*============================================================================
+ *    Int function S_orientation_optimize
+ *----------------------------------------------------------------------------*/
+int S_orientation_optimize(int sites, const orientsite *site,
+                           const orientspec *spec, int threads, int *errors,
+                           orientresult *result) {
+  int summary = 0;
+
+  /* one site is a year of samples: worth a thread of its own */
+  internal::parallel_for(sites, threads, [&](int first, int count) {
+    for (int s = first; s < first + count; ++s)
+      optimize_site(&site[s], spec, &errors[s], &result[s]);
+  }, 1);
+  for (int s = 0; s < sites; ++s) summary |= errors[s];
+  return summary;
+}
+
+}  // namespace solpos
@@ -0,0 +1,105 @@
+/*============================================================================
+ *
+ *    NAME:  orientation.h
+ *
+ *    Contains:
+ *        S_orientation_optimize  (the fixed tilt and aspect with the most
+ *                                 annual irradiation, per site)
+ *
+ *            INPUTS:     sites (a posdata with location, year and
+ *                        atmosphere each, plus clear-sky parameters), and
+ *                        the orientation grid to search
+ *
+ *            OUTPUTS:    per site the optimum tilt and aspect, its annual
+ *                        irradiation, and optionally the irradiation over
+ *                        the whole grid (the sensitivity surface)
+ *
+ *    Objectives:
+ *        S_ORIENT_ETR       etrtilt summed over the year (no atmosphere)
+ *        S_ORIENT_CLEARSKY  Ineichen-Perez clear-sky beam on the surface
+ *                           plus isotropic sky diffuse and ground
+ *                           reflection (clearsky.h, transpose.h)
+ *
+ *    Each site's year is sampled once, every spec->step minutes (each
+ *    sample at the middle of the interval it stands for), into a table of
+ *    daytime sun vectors, each scaled by its beam irradiance times the
+ *    interval.  An orientation's beam total is then the sum of
+ *    max(0, n . s) over the table for the surface normal n, which equals
+ *    the etrtilt or beam POA of tilt() summed over the same samples,
+ *    without a position calculation per orientation.  The diffuse and ground terms are
+ *    annual totals times the view factors.
+ *
+ *    The grid is evaluated in full, then the best grid point is refined by
+ *    golden-section search, alternating tilt and aspect, within one grid
+ *    step of it.  Sites run in parallel.
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_ORIENTATION_H_
+#define SOLPOS_ORIENTATION_H_
+
+#include "clearsky.h"
+#include "solpos.h"
+
+namespace solpos {
+
+enum { S_ORIENT_ETR = 1, S_ORIENT_CLEARSKY };
+
+struct orientsite {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  posdata site;          /* I:  latitude, longitude, timezone, year, press,
+                                temp, solcon; other members are ignored */
+  clearskysite sky;      /* I:  S_ORIENT_CLEARSKY turbidity and elevation */
+  double albedo;         /* I:  S_ORIENT_CLEARSKY ground reflectance */
+};
+
+struct orientspec {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  int model;             /* I:  S_ORIENT_ETR or S_ORIENT_CLEARSKY */
+  int step;              /* I:  Minutes between samples, a divisor of 1440
+                                up to 480 (else S_INTRVL_ERROR) */
+  int tilts;             /* I:  Grid tilts, evenly spaced from tilt_min to
+                                tilt_max inclusive (at least 2, else
+                                S_TILT_ERROR) */
+  double tilt_min;       /* I:  degrees from horizontal */
+  double tilt_max;
+  int aspects;           /* I:  Grid aspects, likewise (at least 2, else
+                                S_ASPECT_ERROR) */
+  double aspect_min;     /* I:  degrees east of north */
+  double aspect_max;
+  double tolerance;      /* I:  Refinement stops within this many degrees
+                                (0 = grid only) */
+};
+
+struct orientresult {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  double tilt;           /* O:  Optimum tilt, degrees */
+  double aspect;         /* O:  Optimum aspect, degrees */
+  double energy;         /* O:  Annual irradiation at the optimum, Wh/m^2 */
+  double *surface;       /* I:  Optional tilts * aspects entries, filled
+                                with the annual irradiation at grid point
+                                [tilt * aspects + aspect] (nullptr = not
+                                wanted) */
+};
+
+/*============================================================================
+ *    Int function S_orientation_optimize
+ *
+ *    Optimizes the orientation of each of sites sites, spread over threads
+ *    threads (0 = one per hardware thread).
+ *
+ *    OUTPUTS: errors[s] (S_solpos return code for the site's inputs, or
+ *             for an unusable spec) and result[s]; sites with errors get
+ *             NaN results
+ *
+ *    RETURNS: The OR of all site codes
+ *----------------------------------------------------------------------------*/
+int S_orientation_optimize(int sites, const orientsite *site,
+                           const orientspec *spec, int threads, int *errors,
+                           orientresult *result);
+
+}  // namespace solpos
+
+#endif  // SOLPOS_ORIENTATION_H_
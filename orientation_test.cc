@@ -0,0 +1,146 @@
+#include "orientation.h"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace solpos {
+namespace {
+
+orientsite Site(double latitude, double longitude, double timezone) {
+  orientsite site = {};
+  S_init(&site.site);
+  site.site.latitude = latitude;
+  site.site.longitude = longitude;
+  site.site.timezone = timezone;
+  site.site.year = 2019;
+  site.sky.linke = 3.0;
+  site.sky.elevation = 1600.0;
+  site.albedo = 0.2;
+  return site;
+}
+
+orientspec Spec(int model) {
+  orientspec spec = {};
+  spec.model = model;
+  spec.step = 60;
+  spec.tilts = 10;
+  spec.tilt_min = 0.0;
+  spec.tilt_max = 90.0;
+  spec.aspects = 13;
+  spec.aspect_min = 0.0;
+  spec.aspect_max = 360.0;
+  spec.tolerance = 0.01;
+  return spec;
+}
+
+TEST(OrientationTest, GridMatchesEtrtiltSum) {
+  orientsite site = Site(35.05, -106.62, -7.0);
+  orientspec spec = Spec(S_ORIENT_ETR);
+  std::vector<double> surface(spec.tilts * spec.aspects);
+  orientresult result = {};
+  result.surface = surface.data();
+  int error;
+  ASSERT_EQ(S_orientation_optimize(1, &site, &spec, 1, &error, &result), 0);
+
+  /* tilt 30 (grid row 3), aspect 180 (grid column 6), summed by S_solpos */
+  posdata pd = site.site;
+  pd.function = S_ALL | S_EPOCH;
+  pd.epochfrac = 0.0;
+  pd.tilt = 30.0;
+  pd.aspect = 180.0;
+  const long long start = S_epoch(2019, 1, 1, 0, 0, 0, pd.timezone);
+  double sum = 0.0;
+  for (int hour = 0; hour < 8760; ++hour) {
+    pd.epoch = start + 3600LL * hour + 1800;
+    ASSERT_EQ(S_solpos(&pd), 0);
+    sum += pd.etrtilt;
+  }
+  EXPECT_NEAR(surface[3 * spec.aspects + 6], sum, 1e-9 * sum);
+
+  /* south-facing (to within the skew of hourly samples), tilted near the
+     latitude, and no grid point does better than the refined optimum */
+  EXPECT_NEAR(result.aspect, 180.0, 3.0);
+  EXPECT_GT(result.tilt, 30.0);
+  EXPECT_LT(result.tilt, 40.0);
+  EXPECT_GE(result.energy,
+            *std::max_element(surface.begin(), surface.end()));
+}
+
+TEST(OrientationTest, SitesInParallel) {
+  orientsite sites[3] = {Site(35.05, -106.62, -7.0), Site(-33.9, 18.4, 2.0),
+                         Site(60.2, 24.9, 2.0)};
+  orientspec spec = Spec(S_ORIENT_CLEARSKY);
+  orientresult one[3] = {}, three[3] = {};
+  int errors[3];
+  ASSERT_EQ(S_orientation_optimize(3, sites, &spec, 1, errors, one), 0);
+  ASSERT_EQ(S_orientation_optimize(3, sites, &spec, 3, errors, three), 0);
+  for (int s = 0; s < 3; ++s) {
+    EXPECT_EQ(one[s].tilt, three[s].tilt) << "site " << s;
+    EXPECT_EQ(one[s].aspect, three[s].aspect) << "site " << s;
+    EXPECT_EQ(one[s].energy, three[s].energy) << "site " << s;
+  }
+
+  /* the southern site faces north, at either end of the aspect range */
+  EXPECT_LT(std::min(one[1].aspect, 360.0 - one[1].aspect), 2.0);
+  EXPECT_NEAR(one[0].aspect, 180.0, 2.0);
+  EXPECT_NEAR(one[2].aspect, 180.0, 2.0);
+  /* clear-sky yields: the desert beats the north */
+  EXPECT_GT(one[0].energy, one[2].energy);
+  EXPECT_GT(one[2].tilt, one[0].tilt);
+}
+
+TEST(OrientationTest, LastYearOfTheRange) {
+  /* the year's last interval ends at 1 JAN 2051, past the limits */
+  orientsite site = Site(35.05, -106.62, -7.0);
+  site.site.year = 2050;
+  orientspec spec = Spec(S_ORIENT_ETR);
+  orientresult result = {};
+  int error = -1;
+  EXPECT_EQ(S_orientation_optimize(1, &site, &spec, 1, &error, &result), 0);
+  EXPECT_EQ(error, 0);
+  EXPECT_GT(result.tilt, 30.0);
+  EXPECT_LT(result.tilt, 40.0);
+}
+
+TEST(OrientationTest, SiteErrors) {
+  orientsite sites[2] = {Site(35.05, -106.62, -7.0), Site(95.0, 0.0, 0.0)};
+  orientspec spec = Spec(S_ORIENT_ETR);
+  spec.tolerance = 0.0;
+  std::vector<double> surface(spec.tilts * spec.aspects);
+  orientresult results[2] = {};
+  results[1].surface = surface.data();
+  int errors[2];
+  EXPECT_EQ(S_orientation_optimize(2, sites, &spec, 0, errors, results),
+            1L << S_LAT_ERROR);
+  EXPECT_EQ(errors[0], 0);
+  EXPECT_TRUE(std::isnan(results[1].tilt));
+  EXPECT_TRUE(std::isnan(surface[5]));
+  /* grid only: the optimum is a grid point */
+  EXPECT_EQ(std::fmod(results[0].tilt, 10.0), 0.0);
+  EXPECT_EQ(std::fmod(results[0].aspect, 30.0), 0.0);
+
+  spec.step = 0;
+  EXPECT_EQ(S_orientation_optimize(1, sites, &spec, 0, errors, results),
+            1L << S_INTRVL_ERROR);
+  spec.step = 7; /* would drop the tail of the year */
+  EXPECT_EQ(S_orientation_optimize(1, sites, &spec, 0, errors, results),
+            1L << S_INTRVL_ERROR);
+
+  spec.step = 60;
+  spec.tilts = 1;
+  EXPECT_EQ(S_orientation_optimize(1, sites, &spec, 0, errors, results),
+            1L << S_TILT_ERROR);
+  EXPECT_TRUE(std::isnan(results[0].tilt));
+  spec.tilts = 10;
+  spec.aspects = -3;
+  results[0].surface = surface.data();
+  EXPECT_EQ(S_orientation_optimize(1, sites, &spec, 0, errors, results),
+            1L << S_ASPECT_ERROR);
+  EXPECT_TRUE(std::isnan(results[0].energy));
+}
+
+}  // namespace
+}  // namespace solpos
@@ -0,0 +1,73 @@
+/*============================================================================
+ *
+ *    NAME:  parallel.h
+ *
+ *    Contains:
+ *        internal::parallel_for  (splits rows [0, count) into contiguous
+ *                                 ranges and runs them on worker threads)
+ *
+ *    Used by the batch stages of this package that are worth spreading
+ *    over cores.  Not part of the public API.
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_PARALLEL_H_
+#define SOLPOS_PARALLEL_H_
+
+#include <thread>
+#include <vector>
+
+namespace solpos {
+namespace internal {
+
+/* Rows below which a batch is not worth a second thread */
+const int kMinRowsPerThread = 4096;
+
+/*============================================================================
+ *    Int function thread_count
+ *
+ *    Threads to use for count rows when the caller asked for threads
+ *    (0 = one per hardware thread), giving each at least min_rows.
+ *----------------------------------------------------------------------------*/
+inline int thread_count(int threads, int count,
+                        int min_rows = kMinRowsPerThread) {
+  if (threads <= 0)
+    threads = static_cast<int>(std::thread::hardware_concurrency());
+  if (threads <= 0) threads = 1;
+  int most = count / (min_rows > 0 ? min_rows : 1);
+  if (threads > most) threads = most;
+  return threads > 1 ? threads : 1;
+}
+
+/*============================================================================
+ *    Void function parallel_for
+ *
+ *    Calls fn(first, n) once per range, on thread_count(threads, count,
+ *    min_rows) threads; the calling thread takes the first range.  fn must
+ *    be safe to run concurrently on disjoint ranges.
+ *----------------------------------------------------------------------------*/
+template <typename Fn>
+void parallel_for(int count, int threads, Fn fn,
+                  int min_rows = kMinRowsPerThread) {
+  threads = thread_count(threads, count, min_rows);
+  if (threads == 1) {
+    if (count > 0) fn(0, count);
+    return;
+  }
+
+  std::vector<std::thread> workers;
+  workers.reserve(threads - 1);
+  int step = count / threads, extra = count % threads;
+  int n0 = step + (extra > 0), first = n0;
+  for (int t = 1; t < threads; ++t) {
+    int n = step + (t < extra);
+    workers.push_back(std::thread(fn, first, n));
+    first += n;
+  }
+  fn(0, n0);
+  for (size_t t = 0; t < workers.size(); ++t) workers[t].join();
+}
+
+}  // namespace internal
+}  // namespace solpos
+
+#endif  // SOLPOS_PARALLEL_H_
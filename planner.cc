@@ -0,0 +1,303 @@
+/*============================================================================
+ *    Contains:
+ *        S_solpos_planned
+ *----------------------------------------------------------------------------*/
+#include "planner.h"
+
+#include <algorithm>
+#include <functional>
+#include <limits>
+#include <map>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "solpos_internal.h"
+
+namespace solpos {
+
+/*============================================================================
+*    Local constants, types and function prototypes
+============================================================================*/
+static const double kNaN = std::numeric_limits<double>::quiet_NaN();
+
+/* The stage behind each column of poscolumns, in internal::kPosColumn
+   order */
+static const int kColumnStage[internal::kPosColumns] = {
+    L_AMASS, L_AMASS, L_SOLAZM, L_TILT,  L_REFRAC, L_GEOM,
+    L_REFRAC, L_GEOM, L_ETR,    L_ETR,   L_TILT,   L_GEOM,
+    L_PRIME, L_SBCF,  L_SRSS,   L_SRSS,  L_PRIME,  L_REFRAC};
+
+/* What the planner knows of one site */
+struct plansite {
+  long long first; /* first epoch in the 1950 - 2050 limits */
+  long long last;  /* one past the last such epoch */
+  int clock;       /* index of its (timezone, interval) */
+  int function;    /* the function last validated for it, */
+  int code;        /* and the S_validate code of the site under it */
+  int queries;     /* its valid queries */
+};
+
+/* A valid query as planned */
+struct planitem {
+  long long epoch;
+  double epochfrac;
+  int site;
+  int function;
+  int query;
+  int group; /* index of its (epoch, epochfrac, clock) */
+  int slot;  /* row of its results in the staging area */
+};
+
+/* Key of a shared group */
+struct groupkey {
+  long long epoch;
+  double epochfrac;
+  int clock;
+
+  bool operator==(const groupkey &other) const {
+    return (epoch == other.epoch) && (epochfrac == other.epochfrac) &&
+           (clock == other.clock);
+  }
+};
+
+struct groupkey_hash {
+  size_t operator()(const groupkey &key) const {
+    return std::hash<long long>()(key.epoch) * 31 +
+           std::hash<double>()(key.epochfrac) * 7 + key.clock;
+  }
+};
+
+static void stage_row(const posdata *pd, int function,
+                      const std::vector<int> &wanted, double *row);
+static void overlay_site(const posdata *site, posdata *pd);
+
+/*============================================================================
+ *    Local void function stage_row
+ *
+ *    Puts the wanted columns (indices into poscolumns) of pd in row, NaN
+ *    for the stages function leaves out
+ *----------------------------------------------------------------------------*/
+static void stage_row(const posdata *pd, int function,
+                      const std::vector<int> &wanted, double *row) {
+  for (size_t j = 0; j < wanted.size(); ++j) {
+    int k = wanted[j];
+    row[j] =
+        (function & kColumnStage[k]) ? pd->*internal::kPosMember[k] : kNaN;
+  }
+}
+
+/*============================================================================
+ *    Local void function overlay_site
+ *
+ *    Puts the inputs the stages after the geometry read from the site into
+ *    pd, which holds the shared terms of another site
+ *----------------------------------------------------------------------------*/
+static void overlay_site(const posdata *site, posdata *pd) {
+  pd->latitude = site->latitude;
+  pd->longitude = site->longitude;
+  pd->press = site->press;
+  pd->temp = site->temp;
+  pd->tilt = site->tilt;
+  pd->aspect = site->aspect;
+  pd->solcon = site->solcon;
+  pd->sbwid = site->sbwid;
+  pd->sbrad = site->sbrad;
+  pd->sbsky = site->sbsky;
+}
+
+/*============================================================================
+ *    Int function S_solpos_planned
+ *----------------------------------------------------------------------------*/
+int S_solpos_planned(int sites, const posdata *site, int count,
+                     const posquery *query, int *errors,
+                     const poscolumns *out, planstats *stats) {
+  std::vector<int> wanted; /* the columns of out that are not nullptr */
+  std::vector<plansite> plan(sites);
+  std::map<std::pair<double, int>, int> clocks;
+  std::unordered_map<long long, int> checked; /* (site, function) codes */
+  std::unordered_map<groupkey, int, groupkey_hash> groups;
+  std::vector<planitem> item;    /* valid queries, in the order given */
+  std::vector<planitem> planned; /* the same, group by group */
+  std::vector<int> start;        /* where each group begins in planned */
+  std::vector<planitem> series;  /* those not in a shared group */
+  std::vector<std::pair<int, int> > copies; /* (query, slot) of every
+                                               valid query */
+  std::vector<double> stage;     /* wanted columns of each slot */
+  planstats counted = {0, 0, 0, 0, 0};
+  int summary = 0;
+
+  for (int i = 0; i < count; ++i)
+    if ((query[i].site < 0) || (query[i].site >= sites)) return -1;
+  for (int k = 0; k < internal::kPosColumns; ++k)
+    if (out->*internal::kPosColumn[k]) wanted.push_back(k);
+
+  for (int s = 0; s < sites; ++s) {
+    std::pair<double, int> key(site[s].timezone, site[s].interval);
+    std::map<std::pair<double, int>, int>::iterator it = clocks.find(key);
+    if (it == clocks.end())
+      it = clocks.insert(std::make_pair(key, static_cast<int>(clocks.size())))
+               .first;
+    plan[s].first = S_epoch(1950, 1, 1, 0, 0, 0, site[s].timezone);
+    plan[s].last = S_epoch(2051, 1, 1, 0, 0, 0, site[s].timezone);
+    plan[s].clock = it->second;
+    plan[s].function = 0; /* (never a query's: S_EPOCH is always set) */
+    plan[s].queries = 0;
+  }
+
+  /* Errors: the site under each function once, then each epoch; the
+     valid queries are numbered by group as they come */
+  item.reserve(count);
+  for (int i = 0; i < count; ++i) {
+    const posquery &q = query[i];
+    plansite &p = plan[q.site];
+    int f = (q.function ? q.function : site[q.site].function) | S_EPOCH;
+
+    if (f != p.function) {
+      long long key = (static_cast<long long>(q.site) << 32) |
+                      static_cast<unsigned int>(f);
+      std::unordered_map<long long, int>::iterator it = checked.find(key);
+      if (it == checked.end()) {
+        posdata check = site[q.site];
+        check.function = f;
+        check.epoch = p.first;
+        check.epochfrac = 0.0;
+        it = checked.insert(std::make_pair(key, S_validate(&check))).first;
+      }
+      p.function = f;
+      p.code = it->second;
+    }
+    errors[i] = p.code;
+    if (f & L_GEOM) {
+      if ((q.epoch < p.first) || (q.epoch >= p.last))
+        errors[i] |= (1L << S_YEAR_ERROR);
+      if (!((q.epochfrac >= 0.0) && (q.epochfrac < 1.0)))
+        errors[i] |= (1L << S_SECOND_ERROR);
+    }
+    summary |= errors[i];
+    if (errors[i] != 0) {
+      for (size_t j = 0; j < wanted.size(); ++j)
+        (out->*internal::kPosColumn[wanted[j]])[i] = kNaN;
+      continue;
+    }
+
+    /* (+ 0.0 makes -0.0 hash as the 0.0 it equals) */
+    groupkey key = {q.epoch, q.epochfrac + 0.0, p.clock};
+    int group = groups.insert(std::make_pair(key, static_cast<int>(
+                                                      groups.size())))
+                    .first->second;
+    if (group == static_cast<int>(start.size())) start.push_back(0);
+    ++start[group];
+    ++p.queries;
+    planitem x = {q.epoch, q.epochfrac, q.site, f, i, group, -1};
+    item.push_back(x);
+  }
+
+  /* Plan: two stable counting sorts, by site and then by group, so that
+     each group is a run (the groups in the order they first came) with
+     the queries of each of its sites together */
+  planned.resize(item.size());
+  {
+    std::vector<int> next(sites);
+    for (int s = 0, at = 0; s < sites; at += plan[s++].queries) next[s] = at;
+    for (size_t k = 0; k < item.size(); ++k)
+      planned[next[item[k].site]++] = item[k];
+  }
+  for (size_t g = 0, at = 0; g < start.size(); ++g) {
+    int n = start[g];
+    start[g] = static_cast<int>(at);
+    at += n;
+  }
+  start.push_back(static_cast<int>(item.size()));
+  {
+    std::vector<int> next(start.begin(), start.end() - 1);
+    for (size_t k = 0; k < planned.size(); ++k)
+      item[next[planned[k].group]++] = planned[k];
+    item.swap(planned);
+  }
+
+  copies.reserve(planned.size());
+  for (size_t g = 0; g + 1 < start.size(); ++g) {
+    planitem *first = &planned[start[g]], *last = &planned[start[g + 1]];
+    planitem *kept = first;
+    int geom = 0;
+
+    /* identical queries (of one site, so in one run): compute the first,
+       copy it to the rest */
+    for (planitem *x = first; x != last;) {
+      planitem *run = kept;
+      for (int s = x->site; (x != last) && (x->site == s); ++x) {
+        planitem *y = run;
+        while ((y != kept) && (y->function != x->function)) ++y;
+        if (y == kept) {
+          *kept = *x;
+          kept->slot = counted.unique++;
+          geom += (x->function & L_GEOM) != 0;
+          ++kept;
+        } else {
+          ++counted.duplicates;
+        }
+        copies.push_back(std::make_pair(x->query, y->slot));
+      }
+    }
+    stage.resize(counted.unique * wanted.size());
+
+    /* Shared group: two or more sites (or masks) at one epoch and clock */
+    if (geom < 2) {
+      series.insert(series.end(), first, kept);
+      continue;
+    }
+
+    posdata shared = site[first->site];
+    shared.function = S_EPOCH | S_GEOM;
+    shared.epoch = first->epoch;
+    shared.epochfrac = first->epochfrac;
+    internal::compute(&shared);
+    ++counted.groups;
+
+    for (planitem *x = first; x != kept; ++x) {
+      if (!(x->function & L_GEOM)) {
+        series.push_back(*x);
+        continue;
+      }
+      posdata pd = shared;
+      overlay_site(&site[x->site], &pd);
+      pd.function = x->function;
+      internal::compute_local(&pd);
+      stage_row(&pd, x->function, wanted, &stage[x->slot * wanted.size()]);
+      ++counted.shared;
+    }
+  }
+
+  /* Time series: the rest per (site, function), in time order */
+  std::sort(series.begin(), series.end(),
+            [](const planitem &a, const planitem &b) {
+              if (a.site != b.site) return a.site < b.site;
+              if (a.function != b.function) return a.function < b.function;
+              if (a.epoch != b.epoch) return a.epoch < b.epoch;
+              return a.epochfrac < b.epochfrac;
+            });
+  for (size_t k = 0; k < series.size(); ++k) {
+    const planitem &x = series[k];
+    posdata pd = site[x.site];
+    pd.function = x.function;
+    pd.epoch = x.epoch;
+    pd.epochfrac = x.epochfrac;
+    internal::compute(&pd);
+    stage_row(&pd, x.function, wanted, &stage[x.slot * wanted.size()]);
+  }
+  counted.series = static_cast<int>(series.size());
+
+  /* Scatter: a pass of nothing but stores, so that the cache misses of
+     writing in query order overlap */
+  for (size_t k = 0; k < copies.size(); ++k) {
+    const double *row = &stage[copies[k].second * wanted.size()];
+    for (size_t j = 0; j < wanted.size(); ++j)
+      (out->*internal::kPosColumn[wanted[j]])[copies[k].first] = row[j];
+  }
+
+  if (stats) *stats = counted;
+  return summary;
+}
+
+}  // namespace solpos
@@ -0,0 +1,88 @@
+/*============================================================================
+ *
+ *    NAME:  planner.h
+ *
+ *    Contains:
+ *        S_solpos_planned  (runs an unordered list of solar position
+ *                           queries, each with its own site, time and
+ *                           function mask, planned for shared work)
+ *
+ *            INPUTS:     a table of sites (posdata, as for S_solpos) and
+ *                        queries naming a site, an epoch and a function
+ *
+ *            OUTPUTS:    per-query error codes and the selected output
+ *                        columns, in query order
+ *
+ *    Plans before computing: valid queries are grouped by epoch and clock
+ *    (timezone and interval) with a hash table and laid out group by group,
+ *    each site's queries together, by two counting sorts, so the order
+ *    they come in costs nothing.  Identical queries are computed once.  A
+ *    group of two or more sites shares its date and ecliptic terms (one
+ *    S_GEOM computation, then the hour angle and later stages per site);
+ *    queries left over run as time series per (site, function), the site
+ *    validated once for each function.  Results are staged in plan order
+ *    and scattered to query order at the end.  They are bitwise those of
+ *    S_solpos with S_EPOCH.
+ *
+ *    Usage:
+ *         posquery q[n];                 (q[i].site indexes site[])
+ *         ...
+ *         poscolumns out = {};
+ *         out.azim = azim;               (the columns wanted)
+ *         int summary = S_solpos_planned(sites, site, n, q, errors, &out,
+ *                                        nullptr);
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_PLANNER_H_
+#define SOLPOS_PLANNER_H_
+
+#include "batch.h"
+#include "solpos.h"
+
+namespace solpos {
+
+struct posquery {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  int site;              /* I:  Index of the site in the site table */
+  int function;          /* I:  S_solpos function mask (S_EPOCH is implied;
+                                0 = the site's own function) */
+  long long epoch;       /* I:  Unix time */
+  double epochfrac;      /* I:  Fraction of a second added to epoch */
+};
+
+struct planstats {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  int unique;            /* O:  Distinct valid queries computed */
+  int duplicates;        /* O:  Queries copied from an identical one */
+  int shared;            /* O:  Queries computed over shared S_GEOM terms */
+  int groups;            /* O:  S_GEOM computations they shared */
+  int series;            /* O:  Queries computed as per-site time series */
+};
+
+/*============================================================================
+ *    Int function S_solpos_planned
+ *
+ *    Computes query[0 .. count - 1] against site[0 .. sites - 1].  A
+ *    column of out gets, per query, the posdata member of that name when
+ *    the query's function selects its stage (L_GEOM for declin, erv and
+ *    hrang; L_REFRAC for coszen, elevref and zenref; L_AMASS
+ *    for amass and ampress; L_PRIME for prime and unprime; L_SBCF; L_SRSS
+ *    for sretr and ssetr; L_SOLAZM for azim; L_ETR for etr and etrn;
+ *    L_TILT for cosinc and etrtilt), and NaN otherwise or for a query with
+ *    an error.
+ *
+ *    OUTPUTS: errors[i] = the S_solpos return code of query i, the columns
+ *             of out, and *stats (when not nullptr)
+ *
+ *    RETURNS: The OR of all query codes, or -1 (and nothing computed) when
+ *             a query names a site outside the table
+ *----------------------------------------------------------------------------*/
+int S_solpos_planned(int sites, const posdata *site, int count,
+                     const posquery *query, int *errors,
+                     const poscolumns *out, planstats *stats);
+
+}  // namespace solpos
+
+#endif  // SOLPOS_PLANNER_H_
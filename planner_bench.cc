@@ -0,0 +1,109 @@
+/*============================================================================
+ *    Benchmark of the query planner against row-by-row S_solpos
+ *
+ *        planner_bench [sites] [times] [duplicates]
+ *
+ *    Every site at every time (a minute apart) with one of three function
+ *    masks, plus the given share (percent) of repeated queries.  Prints
+ *    queries per second of S_solpos per query and of S_solpos_planned,
+ *    each on the queries in site-major order and shuffled.
+ *----------------------------------------------------------------------------*/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+#include "planner.h"
+
+namespace {
+
+using solpos::posdata;
+using solpos::posquery;
+
+typedef std::chrono::steady_clock Clock;
+
+double seconds_since(Clock::time_point t0) {
+  return std::chrono::duration<double>(Clock::now() - t0).count();
+}
+
+/* Queries per second of S_solpos called per query */
+double scalar_rate(const std::vector<posdata> &site,
+                   const std::vector<posquery> &q, double *sink) {
+  Clock::time_point t0 = Clock::now();
+  for (size_t i = 0; i < q.size(); ++i) {
+    posdata pd = site[q[i].site];
+    pd.function = q[i].function | S_EPOCH;
+    pd.epoch = q[i].epoch;
+    pd.epochfrac = q[i].epochfrac;
+    solpos::S_solpos(&pd);
+    *sink += pd.azim;
+  }
+  return q.size() / seconds_since(t0);
+}
+
+/* Queries per second of S_solpos_planned */
+double planned_rate(const std::vector<posdata> &site,
+                    const std::vector<posquery> &q, double *sink) {
+  const int n = static_cast<int>(q.size());
+  std::vector<int> errors(n);
+  std::vector<double> azim(n), elevref(n), etrtilt(n);
+  solpos::poscolumns out = {};
+  out.azim = azim.data();
+  out.elevref = elevref.data();
+  out.etrtilt = etrtilt.data();
+
+  Clock::time_point t0 = Clock::now();
+  solpos::S_solpos_planned(static_cast<int>(site.size()), site.data(), n,
+                           q.data(), errors.data(), &out, nullptr);
+  double rate = n / seconds_since(t0);
+  *sink += azim[n / 2];
+  return rate;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  int sites = argc > 1 ? std::atoi(argv[1]) : 500;
+  int times = argc > 2 ? std::atoi(argv[2]) : 400;
+  int duplicates = argc > 3 ? std::atoi(argv[3]) : 20;
+  const double tz[4] = {-8.0, -7.0, -6.0, -5.0};
+  const int masks[3] = {S_ALL & ~L_DOY, (S_SOLAZM | S_REFRAC) & ~L_DOY,
+                        (S_TILT | S_ETR) & ~L_DOY};
+
+  std::vector<posdata> site(sites);
+  for (int s = 0; s < sites; ++s) {
+    solpos::S_init(&site[s]);
+    site[s].timezone = tz[s % 4];
+    site[s].latitude = 30.0 + 0.02 * s;
+    site[s].longitude = 15.0 * tz[s % 4] + 0.003 * s;
+    site[s].tilt = 20.0 + s % 10;
+  }
+
+  const long long start = solpos::S_epoch(2022, 6, 1, 5, 0, 0, 0.0);
+  std::vector<posquery> q;
+  std::mt19937 rng(1);
+  for (int s = 0; s < sites; ++s) {
+    for (int t = 0; t < times; ++t) {
+      posquery x = {s, masks[(s + t) % 3], start + 60LL * t, 0.0};
+      q.push_back(x);
+      if (static_cast<int>(rng() % 100) < duplicates) q.push_back(x);
+    }
+  }
+  std::vector<posquery> shuffled = q;
+  std::shuffle(shuffled.begin(), shuffled.end(), rng);
+
+  double sink = 0.0;
+  std::printf("%zu queries over %d sites and %d times\n", q.size(), sites,
+              times);
+  std::printf("  S_solpos per query, ordered   %12.0f /s\n",
+              scalar_rate(site, q, &sink));
+  std::printf("  S_solpos per query, shuffled  %12.0f /s\n",
+              scalar_rate(site, shuffled, &sink));
+  std::printf("  S_solpos_planned, ordered     %12.0f /s\n",
+              planned_rate(site, q, &sink));
+  std::printf("  S_solpos_planned, shuffled    %12.0f /s\n",
+              planned_rate(site, shuffled, &sink));
+  return sink == 0.12345 ? 1 : 0;
+}
@@ -0,0 +1,143 @@
+#include "planner.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "solpos_internal.h"
+
+namespace solpos {
+namespace {
+
+using internal::kPosColumn;
+using internal::kPosColumns;
+using internal::kPosMember;
+
+/* Output columns of n rows, every one wanted */
+struct Columns {
+  explicit Columns(int n) : data(kPosColumns, std::vector<double>(n)) {
+    for (int k = 0; k < kPosColumns; ++k) out.*kPosColumn[k] = data[k].data();
+  }
+  std::vector<std::vector<double> > data;
+  poscolumns out;
+};
+
+std::vector<posdata> Sites() {
+  std::vector<posdata> site(6);
+  for (int s = 0; s < 6; ++s) {
+    S_init(&site[s]);
+    site[s].latitude = 25.0 + 4.0 * s;
+    site[s].longitude = -80.0 - 5.0 * s;
+    site[s].timezone = s < 4 ? -5.0 : -7.0;
+    site[s].interval = s == 5 ? 3600 : 0;
+    site[s].tilt = 10.0 * s;
+    site[s].aspect = 180.0;
+    site[s].temp = 5.0 * s;
+  }
+  return site;
+}
+
+/* Query i against S_solpos: columns of stages its mask runs match
+   bitwise, the rest are NaN */
+void ExpectSolpos(const posdata &site, const posquery &q, const Columns &c,
+                  int i) {
+  posdata pd = site;
+  pd.function = (q.function ? q.function : site.function) | S_EPOCH;
+  pd.epoch = q.epoch;
+  pd.epochfrac = q.epochfrac;
+  ASSERT_EQ(S_solpos(&pd), 0) << "query " << i;
+
+  const int stage[kPosColumns] = {
+      L_AMASS, L_AMASS,  L_SOLAZM, L_TILT, L_REFRAC, L_GEOM,
+      L_REFRAC, L_GEOM,  L_ETR,    L_ETR,  L_TILT,   L_GEOM,
+      L_PRIME, L_SBCF,   L_SRSS,   L_SRSS, L_PRIME,  L_REFRAC};
+  for (int k = 0; k < kPosColumns; ++k) {
+    const double got = (c.out.*kPosColumn[k])[i];
+    if (pd.function & stage[k])
+      EXPECT_EQ(got, pd.*kPosMember[k]) << "query " << i << " col " << k;
+    else
+      EXPECT_TRUE(std::isnan(got)) << "query " << i << " col " << k;
+  }
+}
+
+TEST(PlannerTest, ShuffledMixMatchesSolpos) {
+  std::vector<posdata> site = Sites();
+  const long long t = S_epoch(2020, 3, 20, 6, 0, 0, -5.0);
+  const int masks[4] = {0, S_SOLAZM, S_REFRAC | S_TILT, S_ETR | S_SRSS};
+
+  std::vector<posquery> q;
+  for (int m = 0; m < 20; ++m) {
+    for (int s = 0; s < 6; ++s) {
+      posquery x = {s, masks[(m + s) % 4], t + 1800 * m, 0.0};
+      q.push_back(x);
+      if (m % 5 == 0) q.push_back(x); /* a duplicate */
+    }
+  }
+  posquery lone = {2, S_GEOM, t + 7, 0.25}; /* no other site at this time */
+  q.push_back(lone);
+  posquery date_only = {3, S_DOY, t, 0.0}; /* no S_GEOM to share */
+  q.push_back(date_only);
+  std::shuffle(q.begin(), q.end(), std::mt19937(7));
+
+  const int n = static_cast<int>(q.size());
+  std::vector<int> errors(n, -1);
+  Columns c(n);
+  planstats stats;
+  ASSERT_EQ(S_solpos_planned(6, site.data(), n, q.data(), errors.data(),
+                             &c.out, &stats),
+            0);
+  for (int i = 0; i < n; ++i) {
+    EXPECT_EQ(errors[i], 0);
+    ExpectSolpos(site[q[i].site], q[i], c, i);
+  }
+
+  EXPECT_EQ(stats.duplicates, 24);
+  EXPECT_EQ(stats.unique + stats.duplicates, n);
+  EXPECT_EQ(stats.shared + stats.series, stats.unique);
+  /* sites 0 - 3 share a clock; 4 and 5 are alone on theirs */
+  EXPECT_EQ(stats.groups, 20);
+  EXPECT_EQ(stats.series, 2 * 20 + 2);
+}
+
+TEST(PlannerTest, ErrorsFollowEachQuerysMask) {
+  std::vector<posdata> site = Sites();
+  site[1].temp = 150.0; /* bad only for refraction */
+  site[2].latitude = 95.0;
+  const long long t = S_epoch(2020, 6, 1, 12, 0, 0, -5.0);
+  std::vector<posquery> q = {
+      {1, S_SOLAZM, t, 0.0},       {1, S_REFRAC, t, 0.0},
+      {2, S_SOLAZM, t, 0.0},       {0, S_SOLAZM, t, 1.5},
+      {0, S_SOLAZM, -(1LL << 40), 0.0}, {0, S_SOLAZM, t, 0.0},
+  };
+  const int n = static_cast<int>(q.size());
+  std::vector<int> errors(n);
+  Columns c(n);
+  int summary = S_solpos_planned(6, site.data(), n, q.data(), errors.data(),
+                                 &c.out, nullptr);
+
+  EXPECT_EQ(errors[0], 0);
+  EXPECT_EQ(errors[1], 1L << S_TEMP_ERROR);
+  EXPECT_EQ(errors[2], 1L << S_LAT_ERROR);
+  EXPECT_EQ(errors[3], 1L << S_SECOND_ERROR);
+  EXPECT_EQ(errors[4], 1L << S_YEAR_ERROR);
+  EXPECT_EQ(errors[5], 0);
+  EXPECT_EQ(summary, (1L << S_TEMP_ERROR) | (1L << S_LAT_ERROR) |
+                         (1L << S_SECOND_ERROR) | (1L << S_YEAR_ERROR));
+  EXPECT_TRUE(std::isnan(c.out.azim[1]));
+  EXPECT_TRUE(std::isnan(c.out.azim[4]));
+  ExpectSolpos(site[1], q[0], c, 0);
+  ExpectSolpos(site[0], q[5], c, 5);
+
+  q.push_back({6, S_SOLAZM, t, 0.0});
+  std::vector<int> more(n + 1);
+  Columns d(n + 1);
+  EXPECT_EQ(S_solpos_planned(6, site.data(), n + 1, q.data(), more.data(),
+                             &d.out, nullptr),
+            -1);
+}
+
+}  // namespace
+}  // namespace solpos
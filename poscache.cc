@@ -0,0 +1,327 @@
+/*============================================================================
+ *    Contains:
+ *        S_poscache_create, S_poscache_site, S_poscache_get,
+ *        S_poscache_stats, S_poscache_destroy
+ *----------------------------------------------------------------------------*/
+#include "poscache.h"
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+
+#include "realtime.h"
+#include "ring.h"
+
+namespace solpos {
+
+/*============================================================================
+*    Local constants, types and function prototypes
+============================================================================*/
+/* Counter stripes, so threads hitting at once do not share a line */
+static const int kStripes = 16;
+
+/* No entry has this tag: a site handle is never negative */
+static const long long kNoTag = -1;
+
+/* One entry; seq is odd while it is rewritten */
+struct cacheentry {
+  std::atomic<unsigned> seq;
+  std::atomic<bool> referenced;
+  std::atomic<long long> tag;  /* site << 32 | function */
+  std::atomic<long long> epoch;
+  std::atomic<double> azim, elevref, cosinc, etr, etrn, etrtilt, amass;
+};
+
+struct cacheshard {
+  std::mutex mu;                           /* held by writers only */
+  std::unique_ptr<cacheentry[]> entries;   /* buckets * kPosCacheWays */
+  std::unique_ptr<unsigned char[]> hand;   /* CLOCK hand of each bucket */
+};
+
+struct cachecounters {
+  std::atomic<long long> hits, misses, evictions;
+  char pad[internal::kCacheLine];
+};
+
+struct poscache {
+  poscachespec spec;
+  unsigned long long shard_mask;
+  unsigned long long bucket_mask;
+  std::unique_ptr<cacheshard[]> shards;
+
+  std::mutex site_mu;                      /* held by S_poscache_site */
+  std::unique_ptr<posdata[]> sites;
+  std::atomic<int> site_count;
+
+  cachecounters counters[kStripes];
+};
+
+static std::atomic<int> next_stripe(0);
+
+static unsigned long long mix(unsigned long long key);
+static cachecounters &counters(poscache *cache);
+static bool read_entry(cacheentry &entry, long long tag, long long epoch,
+                       posentry *out);
+static void store_entry(poscache *cache, cacheshard &shard,
+                        unsigned long long bucket, long long tag,
+                        const posentry &value);
+
+/*============================================================================
+ *    Local unsigned long long function mix
+ *
+ *    The splitmix64 finalizer
+ *----------------------------------------------------------------------------*/
+static unsigned long long mix(unsigned long long key) {
+  key ^= key >> 30;
+  key *= 0xbf58476d1ce4e5b9ULL;
+  key ^= key >> 27;
+  key *= 0x94d049bb133111ebULL;
+  return key ^ (key >> 31);
+}
+
+/*============================================================================
+ *    Local cachecounters function counters
+ *
+ *    The counter stripe of the calling thread
+ *----------------------------------------------------------------------------*/
+static cachecounters &counters(poscache *cache) {
+  static thread_local int stripe =
+      next_stripe.fetch_add(1, std::memory_order_relaxed) % kStripes;
+
+  return cache->counters[stripe];
+}
+
+/*============================================================================
+ *    Local bool function read_entry
+ *
+ *    RETURNS: true with *out filled if entry holds (tag, epoch) and was not
+ *             rewritten during the copy
+ *----------------------------------------------------------------------------*/
+static bool read_entry(cacheentry &entry, long long tag, long long epoch,
+                       posentry *out) {
+  unsigned seq = entry.seq.load(std::memory_order_acquire);
+  posentry value;
+
+  if (seq & 1) return false;
+  if ((entry.tag.load(std::memory_order_relaxed) != tag) ||
+      (entry.epoch.load(std::memory_order_relaxed) != epoch))
+    return false;
+
+  value.epoch = epoch;
+  value.azim = entry.azim.load(std::memory_order_relaxed);
+  value.elevref = entry.elevref.load(std::memory_order_relaxed);
+  value.cosinc = entry.cosinc.load(std::memory_order_relaxed);
+  value.etr = entry.etr.load(std::memory_order_relaxed);
+  value.etrn = entry.etrn.load(std::memory_order_relaxed);
+  value.etrtilt = entry.etrtilt.load(std::memory_order_relaxed);
+  value.amass = entry.amass.load(std::memory_order_relaxed);
+
+  std::atomic_thread_fence(std::memory_order_acquire);
+  if (entry.seq.load(std::memory_order_relaxed) != seq) return false;
+
+  /* only a clear bit is written, so hot entries stay read-only */
+  if (!entry.referenced.load(std::memory_order_relaxed))
+    entry.referenced.store(true, std::memory_order_relaxed);
+  *out = value;
+  return true;
+}
+
+/*============================================================================
+ *    Local void function store_entry
+ *
+ *    Puts value in the bucket unless another thread has already, taking
+ *    an empty way or else the first unreferenced one from the bucket's
+ *    hand on, clearing reference bits on the way
+ *----------------------------------------------------------------------------*/
+static void store_entry(poscache *cache, cacheshard &shard,
+                        unsigned long long bucket, long long tag,
+                        const posentry &value) {
+  std::lock_guard<std::mutex> lock(shard.mu);
+  cacheentry *ways = &shard.entries[bucket * kPosCacheWays];
+  cacheentry *victim = nullptr;
+  int way;
+
+  for (way = 0; way < kPosCacheWays; ++way) {
+    long long held = ways[way].tag.load(std::memory_order_relaxed);
+    if ((held == tag) &&
+        (ways[way].epoch.load(std::memory_order_relaxed) == value.epoch))
+      return;
+    if ((held == kNoTag) && !victim) victim = &ways[way];
+  }
+
+  if (!victim) {
+    unsigned char &hand = shard.hand[bucket];
+    for (;;) {
+      cacheentry &entry = ways[hand];
+      hand = static_cast<unsigned char>((hand + 1) % kPosCacheWays);
+      if (!entry.referenced.load(std::memory_order_relaxed)) {
+        victim = &entry;
+        break;
+      }
+      entry.referenced.store(false, std::memory_order_relaxed);
+    }
+    counters(cache).evictions.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  /* mark the entry, then write it, then publish it */
+  unsigned seq = victim->seq.load(std::memory_order_relaxed);
+  victim->seq.store(seq + 1, std::memory_order_relaxed);
+  std::atomic_thread_fence(std::memory_order_release);
+  victim->referenced.store(false, std::memory_order_relaxed);
+  victim->tag.store(tag, std::memory_order_relaxed);
+  victim->epoch.store(value.epoch, std::memory_order_relaxed);
+  victim->azim.store(value.azim, std::memory_order_relaxed);
+  victim->elevref.store(value.elevref, std::memory_order_relaxed);
+  victim->cosinc.store(value.cosinc, std::memory_order_relaxed);
+  victim->etr.store(value.etr, std::memory_order_relaxed);
+  victim->etrn.store(value.etrn, std::memory_order_relaxed);
+  victim->etrtilt.store(value.etrtilt, std::memory_order_relaxed);
+  victim->amass.store(value.amass, std::memory_order_relaxed);
+  victim->seq.store(seq + 2, std::memory_order_release);
+}
+
+/*============================================================================
+ *    Int function S_poscache_create
+ *----------------------------------------------------------------------------*/
+int S_poscache_create(const poscachespec *spec, poscache **cache) {
+  std::unique_ptr<poscache> made;
+  long long shards = 1, buckets = 1;
+
+  *cache = nullptr;
+  if (spec->quantum < 1) return (1L << S_INTRVL_ERROR);
+
+  while (shards < spec->shards) shards *= 2;
+  while (shards * buckets * kPosCacheWays < spec->entries) buckets *= 2;
+
+  made.reset(new poscache);
+  made->spec = *spec;
+  made->spec.shards = static_cast<int>(shards);
+  made->spec.entries = static_cast<int>(shards * buckets * kPosCacheWays);
+  if (made->spec.sites < 0) made->spec.sites = 0;
+  made->shard_mask = static_cast<unsigned long long>(shards - 1);
+  made->bucket_mask = static_cast<unsigned long long>(buckets - 1);
+
+  made->shards.reset(new cacheshard[shards]);
+  for (long long s = 0; s < shards; ++s) {
+    cacheshard &shard = made->shards[s];
+    shard.entries.reset(new cacheentry[buckets * kPosCacheWays]);
+    shard.hand.reset(new unsigned char[buckets]());
+    for (long long e = 0; e < buckets * kPosCacheWays; ++e) {
+      shard.entries[e].seq.store(0, std::memory_order_relaxed);
+      shard.entries[e].referenced.store(false, std::memory_order_relaxed);
+      shard.entries[e].tag.store(kNoTag, std::memory_order_relaxed);
+    }
+  }
+
+  made->sites.reset(new posdata[made->spec.sites]);
+  made->site_count.store(0, std::memory_order_relaxed);
+  for (int i = 0; i < kStripes; ++i) {
+    made->counters[i].hits.store(0, std::memory_order_relaxed);
+    made->counters[i].misses.store(0, std::memory_order_relaxed);
+    made->counters[i].evictions.store(0, std::memory_order_relaxed);
+  }
+  *cache = made.release();
+  return 0;
+}
+
+/*============================================================================
+ *    Int function S_poscache_site
+ *----------------------------------------------------------------------------*/
+int S_poscache_site(poscache *cache, const posdata *site, int *handle) {
+  std::lock_guard<std::mutex> lock(cache->site_mu);
+  int count = cache->site_count.load(std::memory_order_relaxed);
+  posdata every = *site;
+  rtcontext ctx;
+  int retval;
+
+  if (count >= cache->spec.sites) return -1;
+
+  /* every input any mask may use; the date comes from the epoch */
+  every.function = S_ALL & ~L_DOY;
+  if ((retval = S_rt_init(&ctx, &every)) != 0) return retval;
+
+  /* outputs of stages a mask leaves out read 0 */
+  posdata &stored = cache->sites[count];
+  stored = *site;
+  stored.azim = stored.elevref = stored.cosinc = 0.0;
+  stored.etr = stored.etrn = stored.etrtilt = stored.amass = 0.0;
+
+  cache->site_count.store(count + 1, std::memory_order_release);
+  *handle = count;
+  return 0;
+}
+
+/*============================================================================
+ *    Int function S_poscache_get
+ *----------------------------------------------------------------------------*/
+int S_poscache_get(poscache *cache, int site, long long epoch, int function,
+                   posentry *entry) {
+  const long long quantum = cache->spec.quantum;
+  long long tag, at;
+  unsigned long long hash, bucket;
+  posentry value;
+  posdata pd;
+  int retval;
+
+  if ((site < 0) ||
+      (site >= cache->site_count.load(std::memory_order_acquire)))
+    return -1;
+
+  at = epoch - epoch % quantum;
+  if (epoch % quantum < 0) at -= quantum;
+  function |= S_EPOCH;
+  tag = (static_cast<long long>(site) << 32) |
+        static_cast<unsigned int>(function);
+
+  hash = mix(mix(static_cast<unsigned long long>(tag)) ^
+             static_cast<unsigned long long>(at));
+  cacheshard &shard = cache->shards[hash & cache->shard_mask];
+  bucket = (hash >> 32) & cache->bucket_mask;
+  cacheentry *ways = &shard.entries[bucket * kPosCacheWays];
+
+  for (int way = 0; way < kPosCacheWays; ++way) {
+    if (read_entry(ways[way], tag, at, entry)) {
+      counters(cache).hits.fetch_add(1, std::memory_order_relaxed);
+      return 0;
+    }
+  }
+
+  pd = cache->sites[site];
+  pd.function = function;
+  pd.epoch = at;
+  pd.epochfrac = 0.0;
+  if ((retval = S_solpos(&pd)) != 0) return retval;
+
+  value.epoch = at;
+  value.azim = pd.azim;
+  value.elevref = pd.elevref;
+  value.cosinc = pd.cosinc;
+  value.etr = pd.etr;
+  value.etrn = pd.etrn;
+  value.etrtilt = pd.etrtilt;
+  value.amass = pd.amass;
+  counters(cache).misses.fetch_add(1, std::memory_order_relaxed);
+  store_entry(cache, shard, bucket, tag, value);
+  *entry = value;
+  return 0;
+}
+
+/*============================================================================
+ *    Void function S_poscache_stats
+ *----------------------------------------------------------------------------*/
+void S_poscache_stats(const poscache *cache, poscachestats *stats) {
+  stats->hits = stats->misses = stats->evictions = 0;
+  for (int i = 0; i < kStripes; ++i) {
+    const cachecounters &c = cache->counters[i];
+    stats->hits += c.hits.load(std::memory_order_relaxed);
+    stats->misses += c.misses.load(std::memory_order_relaxed);
+    stats->evictions += c.evictions.load(std::memory_order_relaxed);
+  }
+}
+
+/*============================================================================
+ *    Void function S_poscache_destroy
+ *----------------------------------------------------------------------------*/
+void S_poscache_destroy(poscache *cache) { delete cache; }
+
+}  // namespace solpos
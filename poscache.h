@@ -0,0 +1,121 @@
+/*============================================================================
+ *
+ *    NAME:  poscache.h
+ *
+ *    Contains:
+ *        S_poscache_create   (a concurrent cache of solar positions)
+ *        S_poscache_site     (registers a site, giving its handle)
+ *        S_poscache_get      (the position of a site at a quantized time,
+ *                             from the cache or computed and cached)
+ *        S_poscache_stats    (hit, miss and eviction counters)
+ *        S_poscache_destroy
+ *
+ *            INPUTS:     per site a posdata (as for S_rt_init); per query a
+ *                        site handle, epoch and function mask
+ *
+ *            OUTPUTS:    posentry: azim, elevref, cosinc, etr, etrn,
+ *                        etrtilt and amass at the epoch rounded down to the
+ *                        quantum
+ *
+ *    For repeated queries of the same site and minute.  Entries are keyed
+ *    by (site handle, quantized epoch, function mask) and hashed to one of
+ *    spec.shards shards, then to a bucket of kPosCacheWays entries within
+ *    it.  Reads take no lock and write nothing shared on a hit: each entry
+ *    is a sequence lock (a counter, odd while the entry is rewritten, read
+ *    before and after the copy), and the CLOCK reference bit is stored only
+ *    when it is clear.  A miss computes the entry with S_solpos and takes
+ *    the shard's lock to store it, evicting by CLOCK (second chance) among
+ *    the ways of its bucket.  Memory is fixed at creation.
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_POSCACHE_H_
+#define SOLPOS_POSCACHE_H_
+
+#include "solpos.h"
+
+namespace solpos {
+
+/* Entries per bucket */
+const int kPosCacheWays = 8;
+
+struct poscachespec {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  int entries;           /* I:  Entries in all (rounded up to shards times a
+                                power of two of buckets) */
+  int shards;            /* I:  Independently locked parts (rounded up to a
+                                power of two) */
+  int quantum;           /* I:  Seconds epochs are rounded down to, >= 1
+                                (1 or 60, say) */
+  int sites;             /* I:  Most sites that can be registered */
+};
+
+struct posentry {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  long long epoch;       /* O:  Quantized Unix time of the entry */
+  double azim;           /* O:  posdata::azim */
+  double elevref;        /* O:  posdata::elevref */
+  double cosinc;         /* O:  posdata::cosinc */
+  double etr;            /* O:  posdata::etr */
+  double etrn;           /* O:  posdata::etrn */
+  double etrtilt;        /* O:  posdata::etrtilt */
+  double amass;          /* O:  posdata::amass */
+};                       /* (outputs of stages not in the mask are 0) */
+
+struct poscachestats {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  long long hits;        /* O:  Queries answered from the cache */
+  long long misses;      /* O:  Queries computed */
+  long long evictions;   /* O:  Entries replaced */
+};
+
+struct poscache; /* opaque */
+
+/*============================================================================
+ *    Int function S_poscache_create
+ *
+ *    RETURNS: 0 with *cache set, or (1L << S_INTRVL_ERROR) for a quantum
+ *             below 1 (*cache is nullptr then)
+ *----------------------------------------------------------------------------*/
+int S_poscache_create(const poscachespec *spec, poscache **cache);
+
+/*============================================================================
+ *    Int function S_poscache_site
+ *
+ *    Validates site (every input S_ALL uses) and registers it.  Safe to
+ *    call while other threads query.
+ *
+ *    RETURNS: 0 with *handle set, the S_solpos error code of the site, or
+ *             -1 when spec.sites sites are registered already
+ *----------------------------------------------------------------------------*/
+int S_poscache_site(poscache *cache, const posdata *site, int *handle);
+
+/*============================================================================
+ *    Int function S_poscache_get
+ *
+ *    The entry of site handle site at epoch (rounded down to the quantum)
+ *    for the stages of function (S_EPOCH is implied).  Any number of
+ *    threads may call it at once.
+ *
+ *    RETURNS: 0 with *entry filled, (1L << S_YEAR_ERROR) for an epoch
+ *             outside the local years 1950 - 2050, or -1 for an unknown
+ *             handle (errors are not cached)
+ *----------------------------------------------------------------------------*/
+int S_poscache_get(poscache *cache, int site, long long epoch, int function,
+                   posentry *entry);
+
+/*============================================================================
+ *    Void function S_poscache_stats
+ *----------------------------------------------------------------------------*/
+void S_poscache_stats(const poscache *cache, poscachestats *stats);
+
+/*============================================================================
+ *    Void function S_poscache_destroy
+ *----------------------------------------------------------------------------*/
+void S_poscache_destroy(poscache *cache);
+
+}  // namespace solpos
+
+#endif  // SOLPOS_POSCACHE_H_
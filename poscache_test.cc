@@ -0,0 +1,188 @@
+#include "poscache.h"
+
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "solpos.h"
+
+namespace solpos {
+namespace {
+
+posdata Site(double latitude) {
+  posdata pd;
+  S_init(&pd);
+  pd.latitude = latitude;
+  pd.longitude = -105.18;
+  pd.timezone = -7.0;
+  pd.tilt = 30.0;
+  pd.aspect = 180.0;
+  return pd;
+}
+
+void ExpectSolpos(double latitude, long long epoch, int function,
+                  const posentry &e) {
+  posdata pd = Site(latitude);
+  pd.azim = pd.elevref = pd.cosinc = pd.etr = 0.0; /* stages not run */
+  pd.etrn = pd.etrtilt = pd.amass = 0.0;
+  pd.function = function | S_EPOCH;
+  pd.epoch = epoch;
+  ASSERT_EQ(S_solpos(&pd), 0);
+  EXPECT_EQ(e.epoch, epoch);
+  EXPECT_EQ(e.azim, pd.azim);
+  EXPECT_EQ(e.elevref, pd.elevref);
+  EXPECT_EQ(e.cosinc, pd.cosinc);
+  EXPECT_EQ(e.etr, pd.etr);
+  EXPECT_EQ(e.etrn, pd.etrn);
+  EXPECT_EQ(e.etrtilt, pd.etrtilt);
+  EXPECT_EQ(e.amass, pd.amass);
+}
+
+TEST(PosCacheTest, QuantizedEntriesMatchSolpos) {
+  poscachespec spec = {1024, 4, 60, 4};
+  poscache *cache;
+  ASSERT_EQ(S_poscache_create(&spec, &cache), 0);
+  posdata site = Site(39.74);
+  int handle;
+  ASSERT_EQ(S_poscache_site(cache, &site, &handle), 0);
+
+  const long long noon = S_epoch(2021, 6, 21, 12, 0, 0, -7.0);
+  posentry e;
+  ASSERT_EQ(S_poscache_get(cache, handle, noon + 59, S_ALL, &e), 0);
+  ExpectSolpos(39.74, noon, S_ALL, e);
+  ASSERT_EQ(S_poscache_get(cache, handle, noon, S_ALL, &e), 0);
+  ExpectSolpos(39.74, noon, S_ALL, e);
+  ASSERT_EQ(S_poscache_get(cache, handle, noon + 60, S_ALL, &e), 0);
+  ExpectSolpos(39.74, noon + 60, S_ALL, e);
+
+  /* another mask is another entry */
+  ASSERT_EQ(S_poscache_get(cache, handle, noon + 30, S_SOLAZM, &e), 0);
+  ExpectSolpos(39.74, noon, S_SOLAZM, e);
+  EXPECT_EQ(e.etrtilt, 0.0);
+
+  poscachestats stats;
+  S_poscache_stats(cache, &stats);
+  EXPECT_EQ(stats.hits, 1);
+  EXPECT_EQ(stats.misses, 3);
+  EXPECT_EQ(stats.evictions, 0);
+  S_poscache_destroy(cache);
+}
+
+TEST(PosCacheTest, ClockGivesReferencedEntriesASecondChance) {
+  /* one shard of one bucket */
+  poscachespec spec = {kPosCacheWays, 1, 1, 1};
+  poscache *cache;
+  ASSERT_EQ(S_poscache_create(&spec, &cache), 0);
+  posdata site = Site(20.0);
+  int handle;
+  ASSERT_EQ(S_poscache_site(cache, &site, &handle), 0);
+
+  const long long t = S_epoch(2021, 3, 1, 9, 0, 0, -7.0);
+  posentry e;
+  poscachestats stats;
+  for (int i = 0; i < kPosCacheWays; ++i)
+    ASSERT_EQ(S_poscache_get(cache, handle, t + i, S_ALL, &e), 0);
+  for (int i = 0; i < kPosCacheWays / 2; ++i)
+    ASSERT_EQ(S_poscache_get(cache, handle, t + i, S_ALL, &e), 0);
+  ASSERT_EQ(S_poscache_get(cache, handle, t + 100, S_ALL, &e), 0);
+  S_poscache_stats(cache, &stats);
+  EXPECT_EQ(stats.misses, kPosCacheWays + 1);
+  EXPECT_EQ(stats.evictions, 1);
+
+  /* the first unreferenced entry went; the referenced ones stayed */
+  ASSERT_EQ(S_poscache_get(cache, handle, t, S_ALL, &e), 0);
+  S_poscache_stats(cache, &stats);
+  EXPECT_EQ(stats.misses, kPosCacheWays + 1);
+  ASSERT_EQ(S_poscache_get(cache, handle, t + kPosCacheWays / 2, S_ALL, &e),
+            0);
+  ExpectSolpos(20.0, t + kPosCacheWays / 2, S_ALL, e);
+  S_poscache_stats(cache, &stats);
+  EXPECT_EQ(stats.misses, kPosCacheWays + 2);
+  EXPECT_EQ(stats.evictions, 2);
+  S_poscache_destroy(cache);
+}
+
+TEST(PosCacheTest, ConcurrentReadersAndWriters) {
+  poscachespec spec = {64, 4, 60, 8};
+  poscache *cache;
+  ASSERT_EQ(S_poscache_create(&spec, &cache), 0);
+  const int sites = 3, minutes = 40, threads = 4, rounds = 2000;
+  int handle[sites];
+  for (int s = 0; s < sites; ++s) {
+    posdata site = Site(10.0 + 15.0 * s);
+    ASSERT_EQ(S_poscache_site(cache, &site, &handle[s]), 0);
+  }
+
+  /* more keys than entries, so readers race evictions */
+  const long long t = S_epoch(2021, 9, 1, 7, 0, 0, -7.0);
+  std::vector<posentry> want(sites * minutes);
+  for (int s = 0; s < sites; ++s) {
+    for (int m = 0; m < minutes; ++m) {
+      posdata pd = Site(10.0 + 15.0 * s);
+      pd.function = S_ALL | S_EPOCH;
+      pd.epoch = t + 60 * m;
+      ASSERT_EQ(S_solpos(&pd), 0);
+      want[s * minutes + m].azim = pd.azim;
+      want[s * minutes + m].amass = pd.amass;
+    }
+  }
+
+  std::vector<int> bad(threads, 0);
+  std::vector<std::thread> workers;
+  for (int w = 0; w < threads; ++w) {
+    workers.push_back(std::thread([&, w] {
+      posentry e;
+      for (int r = 0; r < rounds; ++r) {
+        int s = (r + w) % sites, m = (r * 7 + w) % minutes;
+        if (S_poscache_get(cache, handle[s], t + 60 * m + w, S_ALL, &e)) {
+          ++bad[w];
+          continue;
+        }
+        const posentry &x = want[s * minutes + m];
+        bad[w] += (e.epoch != t + 60 * m) | (e.azim != x.azim) |
+                  (e.amass != x.amass);
+      }
+    }));
+  }
+  for (std::thread &w : workers) w.join();
+  for (int w = 0; w < threads; ++w) EXPECT_EQ(bad[w], 0) << "thread " << w;
+
+  poscachestats stats;
+  S_poscache_stats(cache, &stats);
+  EXPECT_EQ(stats.hits + stats.misses,
+            static_cast<long long>(threads) * rounds);
+  EXPECT_GT(stats.evictions, 0);
+  S_poscache_destroy(cache);
+}
+
+TEST(PosCacheTest, Errors) {
+  poscachespec spec = {16, 1, 0, 1};
+  poscache *cache;
+  EXPECT_EQ(S_poscache_create(&spec, &cache), 1L << S_INTRVL_ERROR);
+  EXPECT_EQ(cache, nullptr);
+
+  spec.quantum = 1;
+  ASSERT_EQ(S_poscache_create(&spec, &cache), 0);
+  posdata site = Site(95.0);
+  int handle = -1;
+  EXPECT_EQ(S_poscache_site(cache, &site, &handle), 1L << S_LAT_ERROR);
+  site = Site(40.0);
+  ASSERT_EQ(S_poscache_site(cache, &site, &handle), 0);
+  EXPECT_EQ(S_poscache_site(cache, &site, &handle), -1); /* full */
+
+  posentry e;
+  EXPECT_EQ(S_poscache_get(cache, handle + 1, 0, S_ALL, &e), -1);
+  EXPECT_EQ(S_poscache_get(cache, -1, 0, S_ALL, &e), -1);
+  EXPECT_EQ(S_poscache_get(cache, handle,
+                           S_epoch(1949, 6, 1, 0, 0, 0, -7.0), S_ALL, &e),
+            1L << S_YEAR_ERROR);
+
+  poscachestats stats;
+  S_poscache_stats(cache, &stats);
+  EXPECT_EQ(stats.hits + stats.misses, 0);
+  S_poscache_destroy(cache);
+}
+
+}  // namespace
+}  // namespace solpos
@@ -0,0 +1,179 @@
+/*============================================================================
+ *    Contains:
+ *        S_qc, S_qc_batch
+ *
+ *        Rows are processed in blocks of kBlock so that the per-row limit
+ *        terms fit in stack scratch columns; each test is then its own
+ *        branch-free pass over the block.
+ *----------------------------------------------------------------------------*/
+#include "qc.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#include "parallel.h"
+
+namespace solpos {
+
+/*============================================================================
+*    Local constants and function prototypes
+============================================================================*/
+static const int kBlock = 512;
+static const double kCos75 = 0.25881904510252074;   /* cos(75 degrees) */
+static const double kCos93 = -0.052335956242943835; /* cos(93 degrees) */
+
+static void or_limits(const double *x, int n, double lo, double scale,
+                      double offset, const double *sa, const double *mupow,
+                      int bit, int *flags);
+static void or_night(const double *x, int n, const double *cz, int *flags);
+static int qc_block(const qcdata *qc, int first, int n, int *flags);
+
+/*============================================================================
+ *    Local void function or_limits
+ *
+ *    Sets bit in flags[i] for every x[i] below lo or above
+ *    sa[i] * scale * mupow[i] + offset, and S_QC_MISSING for NaN x[i].
+ *----------------------------------------------------------------------------*/
+static void or_limits(const double *x, int n, double lo, double scale,
+                      double offset, const double *sa, const double *mupow,
+                      int bit, int *flags) {
+  for (int i = 0; i < n; ++i) {
+    double hi = sa[i] * scale * mupow[i] + offset;
+    flags[i] |= ((x[i] < lo) | (x[i] > hi)) * bit |
+                (x[i] != x[i]) * S_QC_MISSING;
+  }
+}
+
+/*============================================================================
+ *    Local void function or_night
+ *
+ *    Sets S_QC_NIGHT for every x[i] above S_QC_NIGHT_LIMIT with the sun
+ *    at least 3 degrees below the horizon.
+ *----------------------------------------------------------------------------*/
+static void or_night(const double *x, int n, const double *cz, int *flags) {
+  for (int i = 0; i < n; ++i)
+    flags[i] |= ((cz[i] <= kCos93) & (x[i] > S_QC_NIGHT_LIMIT)) * S_QC_NIGHT;
+}
+
+/*============================================================================
+ *    Local int function qc_block
+ *
+ *    Runs every test on rows [first, first + n), n <= kBlock
+ *----------------------------------------------------------------------------*/
+static int qc_block(const qcdata *qc, int first, int n, int *flags) {
+  double mu[kBlock], sa[kBlock], mu12[kBlock], mu02[kBlock];
+  const double *cz = qc->coszen + first;
+  const double *erv = qc->erv + first;
+  const double *ghi = qc->ghi ? qc->ghi + first : nullptr;
+  const double *dni = qc->dni ? qc->dni + first : nullptr;
+  const double *dhi = qc->dhi ? qc->dhi + first : nullptr;
+  int summary = 0;
+
+  if (n <= 0) return 0;
+  for (int i = 0; i < n; ++i) {
+    mu[i] = cz[i] > 0.0 ? cz[i] : 0.0;
+    sa[i] = qc->solcon * erv[i];
+    flags[i] = ((cz[i] != cz[i]) | (sa[i] != sa[i])) * S_QC_POSITION;
+  }
+  for (int i = 0; i < n; ++i) mu12[i] = std::pow(mu[i], 1.2);
+
+  if (ghi) {
+    or_limits(ghi, n, -4.0, 1.5, 100.0, sa, mu12, S_QC_GHI_PPL, flags);
+    or_limits(ghi, n, -2.0, 1.2, 50.0, sa, mu12, S_QC_GHI_ERL, flags);
+    or_night(ghi, n, cz, flags);
+  }
+  if (dhi) {
+    or_limits(dhi, n, -4.0, 0.95, 50.0, sa, mu12, S_QC_DHI_PPL, flags);
+    or_limits(dhi, n, -2.0, 0.75, 30.0, sa, mu12, S_QC_DHI_ERL, flags);
+    or_night(dhi, n, cz, flags);
+  }
+  if (dni) {
+    for (int i = 0; i < n; ++i) mu02[i] = std::pow(mu[i], 0.2);
+    for (int i = 0; i < n; ++i)
+      flags[i] |= ((dni[i] < -4.0) | (dni[i] > sa[i])) * S_QC_DNI_PPL;
+    or_limits(dni, n, -2.0, 0.95, 10.0, sa, mu02, S_QC_DNI_ERL, flags);
+    or_night(dni, n, cz, flags);
+  }
+
+  if (ghi && dni && dhi) {
+    for (int i = 0; i < n; ++i) {
+      double sum = dhi[i] + dni[i] * mu[i];
+      double limit = cz[i] > kCos75 ? 0.08 : 0.15;
+      int tested = (cz[i] > kCos93) & (sum > 50.0);
+      flags[i] |= (tested & (std::fabs(ghi[i] / sum - 1.0) > limit)) *
+                  S_QC_CLOSURE;
+    }
+  }
+  if (ghi && dhi) {
+    for (int i = 0; i < n; ++i) {
+      double limit = cz[i] > kCos75 ? 1.05 : 1.10;
+      int tested = (cz[i] > kCos93) & (ghi[i] > 50.0);
+      flags[i] |= (tested & (dhi[i] >= limit * ghi[i])) * S_QC_DIFFUSE;
+    }
+  }
+
+  /* without a position only S_QC_POSITION and S_QC_MISSING mean anything */
+  for (int i = 0; i < n; ++i) {
+    int keep = (flags[i] & S_QC_POSITION) ? S_QC_POSITION | S_QC_MISSING : ~0;
+    flags[i] &= keep;
+    summary |= flags[i];
+  }
+  return summary;
+}
+
+/*============================================================================
+ *    Int function S_qc
+ *----------------------------------------------------------------------------*/
+int S_qc(const qcdata *qc, int *flags) {
+  int summary = 0;
+
+  for (int first = 0; first < qc->count; first += kBlock)
+    summary |= qc_block(qc, first, std::min(kBlock, qc->count - first),
+                        flags + first);
+  return summary;
+}
+
+/*============================================================================
+ *    Int function S_qc_batch
+ *----------------------------------------------------------------------------*/
+int S_qc_batch(const posbatch *batch, const double *ghi, const double *dni,
+               const double *dhi, int threads, int *flags) {
+  posdata base = *batch->base;
+  posbatch work = *batch;
+  std::atomic<int> summary(0);
+
+  /* only what the limits need: coszen (S_REFRAC) and erv (L_GEOM) */
+  base.function = (base.function & (L_DOY | S_EPOCH)) | (S_REFRAC & ~L_DOY);
+  work.base = &base;
+
+  internal::parallel_for(batch->count, threads, [&](int first, int count) {
+    int errors[kBlock];
+    double cz[kBlock], erv[kBlock];
+    int local = 0;
+
+    for (int b = first; b < first + count; b += kBlock) {
+      int n = std::min(kBlock, first + count - b);
+      posbatch slice;
+      poscolumns columns = {};
+      columns.coszen = cz;
+      columns.erv = erv;
+      S_batch_slice(&work, b, n, &slice);
+      S_solpos_columns(&slice, errors, &columns);
+
+      qcdata qc = {};
+      qc.count = n;
+      qc.ghi = ghi ? ghi + b : nullptr;
+      qc.dni = dni ? dni + b : nullptr;
+      qc.dhi = dhi ? dhi + b : nullptr;
+      qc.coszen = cz;
+      qc.erv = erv;
+      qc.solcon = base.solcon;
+      local |= S_qc(&qc, flags + b);
+    }
+    summary.fetch_or(local);
+  });
+  return summary.load();
+}
+
+}  // namespace solpos
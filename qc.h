@@ -0,0 +1,105 @@
+/*============================================================================
+ *
+ *    NAME:  qc.h
+ *
+ *    Contains:
+ *        S_qc        (flags measured irradiance that fails the BSRN
+ *                     quality-control tests, given solar position columns)
+ *        S_qc_batch  (the same, computing the positions from a posbatch
+ *                     block by block, on several threads)
+ *
+ *    Tests (Long and Dutton, BSRN Global Network recommended QC tests,
+ *    V2.0), with Sa = solcon * erv and mu0 = coszen (0 when negative):
+ *
+ *        Physically possible limits (PPL), W/m^2
+ *            -4 < GHI < Sa * 1.5  * mu0^1.2 + 100
+ *            -4 < DHI < Sa * 0.95 * mu0^1.2 + 50
+ *            -4 < DNI < Sa
+ *        Extremely rare limits (ERL), W/m^2
+ *            -2 < GHI < Sa * 1.2  * mu0^1.2 + 50
+ *            -2 < DHI < Sa * 0.75 * mu0^1.2 + 30
+ *            -2 < DNI < Sa * 0.95 * mu0^0.2 + 10
+ *        Closure, when DHI + DNI * mu0 > 50 and zenith < 93 degrees
+ *            | GHI / (DHI + DNI * mu0) - 1 | <= 0.08 (zenith < 75)
+ *                                             0.15 (zenith >= 75)
+ *        Diffuse ratio, when GHI > 50 and zenith < 93 degrees
+ *            DHI / GHI < 1.05 (zenith < 75), 1.10 (zenith >= 75)
+ *        Night, when zenith >= 93 degrees
+ *            GHI, DHI and DNI <= S_QC_NIGHT_LIMIT
+ *
+ *    A row's flags are the OR of the S_QC_* bits of the tests it fails.
+ *    Tests that need a column that was not given (nullptr) are skipped;
+ *    NaN readings set S_QC_MISSING instead of failing the tests.
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_QC_H_
+#define SOLPOS_QC_H_
+
+#include "batch.h"
+
+namespace solpos {
+
+/*============================================================================
+ *
+ *     Flag bits
+ *
+ *----------------------------------------------------------------------------*/
+#define S_QC_GHI_PPL 0x0001  /* GHI outside physically possible limits */
+#define S_QC_DNI_PPL 0x0002  /* DNI outside physically possible limits */
+#define S_QC_DHI_PPL 0x0004  /* DHI outside physically possible limits */
+#define S_QC_GHI_ERL 0x0008  /* GHI outside extremely rare limits */
+#define S_QC_DNI_ERL 0x0010  /* DNI outside extremely rare limits */
+#define S_QC_DHI_ERL 0x0020  /* DHI outside extremely rare limits */
+#define S_QC_CLOSURE 0x0040  /* GHI disagrees with DHI + DNI * mu0 */
+#define S_QC_DIFFUSE 0x0080  /* DHI / GHI too high */
+#define S_QC_NIGHT 0x0100    /* Irradiance with the sun below the horizon */
+#define S_QC_MISSING 0x0200  /* A given reading is NaN */
+#define S_QC_POSITION 0x0400 /* No solar position for the row */
+
+/* Largest reading accepted at night, W/m^2 */
+#define S_QC_NIGHT_LIMIT 5.0
+
+struct qcdata {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  int count;          /* I:  Number of rows */
+  const double *ghi;  /* I:  Global horizontal irradiance, W/m^2 */
+  const double *dni;  /* I:  Direct normal irradiance, W/m^2 */
+  const double *dhi;  /* I:  Diffuse horizontal irradiance, W/m^2 */
+  const double *coszen; /* I:  Cosine of refraction corrected solar zenith
+                                (posdata::coszen); NaN = no position */
+  const double *erv;  /* I:  Earth radius vector (posdata::erv) */
+  double solcon;      /* I:  Solar constant (posdata::solcon) */
+};
+
+/*============================================================================
+ *    Int function S_qc
+ *
+ *    Runs the tests on every row, in branch-free column passes.
+ *
+ *    OUTPUTS: flags[i] = S_QC_* bits of row i
+ *
+ *    RETURNS: The OR of all row flags
+ *----------------------------------------------------------------------------*/
+int S_qc(const qcdata *qc, int *flags);
+
+/*============================================================================
+ *    Int function S_qc_batch
+ *
+ *    Computes coszen and erv for each row of batch (only the S_REFRAC
+ *    stages, in the date mode of batch->base->function) a block at a time
+ *    into scratch columns and runs S_qc on them, with no posdata per row.
+ *    Rows that S_solpos would reject get S_QC_POSITION.  ghi, dni and dhi
+ *    have batch->count entries (or are nullptr).
+ *
+ *    threads is the number of threads to use, 0 for one per hardware
+ *    thread; small batches run on the calling thread alone.
+ *
+ *    RETURNS: The OR of all row flags
+ *----------------------------------------------------------------------------*/
+int S_qc_batch(const posbatch *batch, const double *ghi, const double *dni,
+               const double *dhi, int threads, int *flags);
+
+}  // namespace solpos
+
+#endif  // SOLPOS_QC_H_
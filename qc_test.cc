@@ -0,0 +1,163 @@
+#include "qc.h"
+
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace solpos {
+namespace {
+
+const double kNaN = std::numeric_limits<double>::quiet_NaN();
+
+/* One row at a time, so each case reads as inputs -> flags */
+int QcRow(double ghi, double dni, double dhi, double coszen) {
+  double erv = 1.0;
+  qcdata qc = {};
+  qc.count = 1;
+  qc.ghi = &ghi;
+  qc.dni = &dni;
+  qc.dhi = &dhi;
+  qc.coszen = &coszen;
+  qc.erv = &erv;
+  qc.solcon = 1367.0;
+  int flags;
+  EXPECT_EQ(S_qc(&qc, &flags), flags);
+  return flags;
+}
+
+TEST(QcTest, ConsistentClearSkyPasses) {
+  /* zenith 30 degrees: 900 * 0.866 + 100 = 879 */
+  EXPECT_EQ(QcRow(879.4, 900.0, 100.0, 0.8660254), 0);
+  /* and a quiet night */
+  EXPECT_EQ(QcRow(0.0, 0.0, 0.5, -0.5), 0);
+}
+
+TEST(QcTest, Limits) {
+  const double cz = 0.8660254;
+  /* GHI PPL: 1367 * 1.5 * 0.8413 + 100 = 1825 */
+  EXPECT_TRUE(QcRow(1900.0, 900.0, 100.0, cz) & S_QC_GHI_PPL);
+  EXPECT_TRUE(QcRow(-5.0, 0.0, 0.0, cz) & S_QC_GHI_PPL);
+  /* ERL but not PPL: 1367 * 1.2 * 0.8413 + 50 = 1430 */
+  int flags = QcRow(1500.0, 900.0, 100.0, cz);
+  EXPECT_TRUE(flags & S_QC_GHI_ERL);
+  EXPECT_FALSE(flags & S_QC_GHI_PPL);
+  flags = QcRow(-3.0, 0.0, 0.0, cz);
+  EXPECT_TRUE(flags & S_QC_GHI_ERL);
+  EXPECT_FALSE(flags & S_QC_GHI_PPL);
+
+  /* DNI above the solar constant is never possible */
+  EXPECT_TRUE(QcRow(1000.0, 1400.0, 100.0, cz) & S_QC_DNI_PPL);
+  /* DNI ERL: 1367 * 0.95 * 0.9716 + 10 = 1272 */
+  flags = QcRow(1000.0, 1300.0, 100.0, cz);
+  EXPECT_TRUE(flags & S_QC_DNI_ERL);
+  EXPECT_FALSE(flags & S_QC_DNI_PPL);
+
+  /* DHI PPL: 1367 * 0.95 * 0.8413 + 50 = 1143 */
+  EXPECT_TRUE(QcRow(1200.0, 0.0, 1200.0, cz) & S_QC_DHI_PPL);
+}
+
+TEST(QcTest, ComparisonTests) {
+  const double cz = 0.8660254;
+  /* 10% high at zenith 30 fails closure; 10% high at zenith 80 does not */
+  EXPECT_TRUE(QcRow(967.0, 900.0, 100.0, cz) & S_QC_CLOSURE);
+  const double cz80 = 0.17364818;
+  EXPECT_FALSE(QcRow(1.1 * (100.0 + 500.0 * cz80), 500.0, 100.0, cz80) &
+               S_QC_CLOSURE);
+  /* too little signal to test */
+  EXPECT_FALSE(QcRow(40.0, 0.0, 20.0, cz) & S_QC_CLOSURE);
+
+  /* diffuse above global */
+  EXPECT_TRUE(QcRow(300.0, 0.0, 320.0, cz) & S_QC_DIFFUSE);
+  EXPECT_FALSE(QcRow(300.0, 0.0, 300.0, cz) & S_QC_DIFFUSE);
+  EXPECT_FALSE(QcRow(300.0, 0.0, 320.0, cz80) & S_QC_DIFFUSE);
+}
+
+TEST(QcTest, NightMissingAndPosition) {
+  EXPECT_TRUE(QcRow(20.0, 0.0, 0.0, -0.2) & S_QC_NIGHT);
+  EXPECT_TRUE(QcRow(0.0, 20.0, 0.0, -0.2) & S_QC_NIGHT);
+  /* twilight between 90 and 93 degrees is not night */
+  EXPECT_FALSE(QcRow(20.0, 0.0, 20.0, -0.03) & S_QC_NIGHT);
+
+  EXPECT_EQ(QcRow(kNaN, 900.0, 100.0, 0.8660254), S_QC_MISSING);
+  EXPECT_EQ(QcRow(5000.0, kNaN, 100.0, kNaN), S_QC_POSITION | S_QC_MISSING);
+}
+
+TEST(QcTest, OptionalColumns) {
+  double ghi = 1900.0, coszen = 0.8660254, erv = 1.0;
+  qcdata qc = {};
+  qc.count = 1;
+  qc.ghi = &ghi;
+  qc.coszen = &coszen;
+  qc.erv = &erv;
+  qc.solcon = 1367.0;
+  int flags;
+  EXPECT_EQ(S_qc(&qc, &flags), S_QC_GHI_PPL | S_QC_GHI_ERL);
+}
+
+TEST(QcTest, BatchMatchesColumns) {
+  posdata base;
+  S_init(&base);
+  base.function = S_ALL & ~S_DOY;
+  base.latitude = 39.74;
+  base.longitude = -105.18;
+  base.timezone = -7.0;
+  base.year = 2020;
+  base.month = 6;
+  base.day = 21;
+  base.second = 0;
+
+  /* Ten days at one-minute resolution, one hour out of range */
+  const int count = 10 * 1440;
+  std::vector<int> day(count), hour(count), minute(count);
+  std::vector<double> ghi(count), dni(count), dhi(count);
+  for (int i = 0; i < count; ++i) {
+    day[i] = 21 + i / 1440;
+    hour[i] = i % 1440 / 60;
+    minute[i] = i % 60;
+    ghi[i] = 400.0 + (i % 7) * 150.0;
+    dni[i] = 600.0 + (i % 5) * 200.0;
+    dhi[i] = 80.0 + (i % 3) * 40.0;
+  }
+  hour[100] = 25;
+
+  posbatch batch = {};
+  batch.base = &base;
+  batch.count = count;
+  batch.day = day.data();
+  batch.hour = hour.data();
+  batch.minute = minute.data();
+
+  std::vector<int> errors(count);
+  std::vector<double> coszen(count), erv(count);
+  poscolumns columns = {};
+  columns.coszen = coszen.data();
+  columns.erv = erv.data();
+  S_solpos_columns(&batch, errors.data(), &columns);
+
+  qcdata qc = {};
+  qc.count = count;
+  qc.ghi = ghi.data();
+  qc.dni = dni.data();
+  qc.dhi = dhi.data();
+  qc.coszen = coszen.data();
+  qc.erv = erv.data();
+  qc.solcon = base.solcon;
+  std::vector<int> expected(count);
+  int summary = S_qc(&qc, expected.data());
+  EXPECT_TRUE(summary & S_QC_NIGHT);
+  EXPECT_EQ(expected[100], S_QC_POSITION);
+
+  for (int threads = 1; threads <= 4; threads += 3) {
+    std::vector<int> flags(count, -1);
+    EXPECT_EQ(S_qc_batch(&batch, ghi.data(), dni.data(), dhi.data(), threads,
+                         flags.data()),
+              summary);
+    for (int i = 0; i < count; ++i)
+      ASSERT_EQ(flags[i], expected[i]) << "row " << i;
+  }
+}
+
+}  // namespace
+}  // namespace solpos
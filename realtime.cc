@@ -0,0 +1,51 @@
+/*============================================================================
+ *    Contains:
+ *        S_rt_init, S_rt_solpos
+ *----------------------------------------------------------------------------*/
+#include "realtime.h"
+
+#include "solpos_internal.h"
+
+namespace solpos {
+
+/*============================================================================
+ *    Int function S_rt_init
+ *----------------------------------------------------------------------------*/
+int S_rt_init(rtcontext *ctx, const posdata *site) {
+  posdata check;
+
+  ctx->site = *site;
+  ctx->site.function |= S_EPOCH | S_GEOM;
+
+  /* the local dates 1 JAN 1950 through 31 DEC 2050 of S_validate */
+  ctx->first = S_epoch(1950, 1, 1, 0, 0, 0, site->timezone);
+  ctx->last = S_epoch(2051, 1, 1, 0, 0, 0, site->timezone);
+
+  /* validate the site with an epoch known to be in range */
+  check = ctx->site;
+  check.epoch = ctx->first;
+  check.epochfrac = 0.0;
+  return S_validate(&check);
+}
+
+/*============================================================================
+ *    Int function S_rt_solpos
+ *----------------------------------------------------------------------------*/
+int S_rt_solpos(const rtcontext *ctx, long long epoch, double epochfrac,
+                posdata *out) {
+  int retval = 0;
+
+  if ((epoch < ctx->first) || (epoch >= ctx->last))
+    retval |= (1L << S_YEAR_ERROR);
+  if (!((epochfrac >= 0.0) && (epochfrac < 1.0)))
+    retval |= (1L << S_SECOND_ERROR);
+  if (retval != 0) return retval;
+
+  *out = ctx->site;
+  out->epoch = epoch;
+  out->epochfrac = epochfrac;
+  internal::compute_realtime(out);
+  return 0;
+}
+
+}  // namespace solpos
@@ -0,0 +1,72 @@
+/*============================================================================
+ *
+ *    NAME:  realtime.h
+ *
+ *    Contains:
+ *        S_rt_init    (validates a site once into a real-time context)
+ *        S_rt_solpos  (solar position of the context's site at an epoch,
+ *                      with bounded latency)
+ *
+ *            INPUTS:     a posdata with the site (latitude, longitude,
+ *                        timezone, interval, press, temp, tilt, aspect,
+ *                        solcon, sbwid, sbrad, sbsky, function); per call
+ *                        an epoch and epochfrac
+ *
+ *            OUTPUTS:    the posdata of S_solpos for that epoch
+ *
+ *    For controllers calling at a fixed rate, where jitter matters more
+ *    than throughput.  The site is validated once by S_rt_init; each call
+ *    then checks only the epoch against limits worked out at init and runs
+ *    closed forms of the stages: no allocation, no I/O, no pow and no
+ *    data-dependent loops (tan^3, tan^5 and the shadowband cube are
+ *    products, the air mass power is exp/log and the true solar time wrap
+ *    is one floor).  S_solpos itself keeps its own forms, so results agree
+ *    with S_solpos with S_EPOCH to a few ULPs rather than bitwise, and
+ *    tstfix is in [-720, 720) where S_solpos allows 720.  realtime_bench
+ *    compares the latency of the two.
+ *
+ *    A context is read-only after S_rt_init, so one context may serve
+ *    several threads.
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_REALTIME_H_
+#define SOLPOS_REALTIME_H_
+
+#include "solpos.h"
+
+namespace solpos {
+
+struct rtcontext {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  posdata site;          /* O:  The validated site */
+  long long first;       /* O:  First epoch in the 1950 - 2050 limits */
+  long long last;        /* O:  One past the last such epoch */
+};
+
+/*============================================================================
+ *    Int function S_rt_init
+ *
+ *    Copies the site of *site into *ctx, adds S_EPOCH and S_GEOM to its
+ *    function and validates everything but the date and time.
+ *
+ *    RETURNS: 0, or the S_solpos error code of the site (ctx is then not
+ *             usable)
+ *----------------------------------------------------------------------------*/
+int S_rt_init(rtcontext *ctx, const posdata *site);
+
+/*============================================================================
+ *    Int function S_rt_solpos
+ *
+ *    Fills *out as S_solpos would for the site of ctx at epoch + epochfrac.
+ *
+ *    RETURNS: 0, or (1L << S_YEAR_ERROR) and/or (1L << S_SECOND_ERROR) for
+ *             an epoch outside the limits or epochfrac outside [0, 1);
+ *             *out is untouched then
+ *----------------------------------------------------------------------------*/
+int S_rt_solpos(const rtcontext *ctx, long long epoch, double epochfrac,
+                posdata *out);
+
+}  // namespace solpos
+
+#endif  // SOLPOS_REALTIME_H_
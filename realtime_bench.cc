@@ -0,0 +1,94 @@
+/*============================================================================
+ *    Worst-case latency benchmark of S_rt_solpos
+ *
+ *        realtime_bench [calls]
+ *
+ *    Times each call separately, at epochs spread evenly through a year
+ *    (one a second at 31536000 calls), and prints the p50, p99, p99.9 and
+ *    maximum latency in nanoseconds.  S_solpos on the same epochs is timed
+ *    alongside for comparison.  The clock reads are inside the timed
+ *    interval, so the figures include their cost (tens of ns); the maximum
+ *    includes any preemption, so run pinned at real-time priority (taskset,
+ *    chrt) for a WCET figure.
+ *----------------------------------------------------------------------------*/
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "realtime.h"
+
+namespace {
+
+using solpos::posdata;
+
+typedef std::chrono::steady_clock Clock;
+
+/* 31,536,000 seconds in a year: spread the calls evenly through one */
+const long long kYear = 365LL * 86400;
+
+void report(const char *name, std::vector<long long> *ns) {
+  std::sort(ns->begin(), ns->end());
+  size_t n = ns->size();
+  std::printf("%-12s p50 %6lld  p99 %6lld  p99.9 %6lld  max %8lld ns\n", name,
+              (*ns)[n / 2], (*ns)[n * 99 / 100], (*ns)[n * 999 / 1000],
+              ns->back());
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  long long calls = argc > 1 ? std::atoll(argv[1]) : 1000000;
+  if (calls < 1) calls = 1;
+  long long step = std::max(1LL, kYear / calls);
+
+  posdata site;
+  solpos::S_init(&site);
+  site.latitude = 35.05;
+  site.longitude = -106.62;
+  site.timezone = -7.0;
+  site.tilt = 30.0;
+  site.aspect = 180.0;
+
+  solpos::rtcontext ctx;
+  if (solpos::S_rt_init(&ctx, &site) != 0) {
+    std::fprintf(stderr, "bad site\n");
+    return 1;
+  }
+  long long start = solpos::S_epoch(2021, 1, 1, 0, 0, 0, site.timezone);
+
+  /* all memory up front; the timed loops neither allocate nor print */
+  std::vector<long long> rt(calls), full(calls);
+  posdata out, pd = ctx.site;
+  double sink = 0.0;
+
+  for (long long i = 0; i < 1000; ++i) /* warm caches and branch history */
+    solpos::S_rt_solpos(&ctx, start + i, 0.0, &out);
+
+  for (long long i = 0; i < calls; ++i) {
+    long long epoch = start + i * step;
+    Clock::time_point t0 = Clock::now();
+    solpos::S_rt_solpos(&ctx, epoch, 0.0, &out);
+    Clock::time_point t1 = Clock::now();
+    sink += out.azim;
+    rt[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0)
+                .count();
+  }
+
+  for (long long i = 0; i < calls; ++i) {
+    pd.epoch = start + i * step;
+    Clock::time_point t0 = Clock::now();
+    solpos::S_solpos(&pd);
+    Clock::time_point t1 = Clock::now();
+    sink += pd.azim;
+    full[i] = std::chrono::duration_cast<std::chrono::nanoseconds>(t1 - t0)
+                  .count();
+  }
+
+  std::printf("%lld calls, one every %lld s (checksum %.3f)\n", calls, step,
+              sink);
+  report("S_rt_solpos", &rt);
+  report("S_solpos", &full);
+  return 0;
+}
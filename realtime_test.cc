@@ -0,0 +1,92 @@
+#include "realtime.h"
+
+#include <cmath>
+
+#include "gtest/gtest.h"
+
+namespace solpos {
+namespace {
+
+posdata Site() {
+  posdata site;
+  S_init(&site);
+  site.latitude = 35.05;
+  site.longitude = -106.62;
+  site.timezone = -7.0;
+  site.tilt = 30.0;
+  site.aspect = 135.0;
+  site.interval = 0;
+  return site;
+}
+
+/* Every output S_ALL sets, which are all the stages, to a few ULPs (the
+   closed forms of S_rt_solpos are not those of S_solpos) */
+void ExpectClose(const posdata &a, const posdata &b) {
+  EXPECT_EQ(a.year, b.year);
+  EXPECT_EQ(a.daynum, b.daynum);
+  EXPECT_EQ(a.hour * 3600 + a.minute * 60 + a.second,
+            b.hour * 3600 + b.minute * 60 + b.second);
+  const double posdata::*outputs[] = {
+      &posdata::amass,   &posdata::ampress, &posdata::azim,
+      &posdata::cosinc,  &posdata::coszen,  &posdata::declin,
+      &posdata::elevref, &posdata::eqntim,  &posdata::erv,
+      &posdata::etr,     &posdata::etrn,    &posdata::etrtilt,
+      &posdata::hrang,   &posdata::prime,   &posdata::sbcf,
+      &posdata::sretr,   &posdata::ssetr,   &posdata::ssha,
+      &posdata::tst,     &posdata::tstfix,  &posdata::unprime,
+      &posdata::zenref};
+  for (const double posdata::*m : outputs)
+    ASSERT_NEAR(a.*m, b.*m, 1e-12 * (1.0 + std::fabs(b.*m)));
+}
+
+TEST(RealtimeTest, MatchesSolpos) {
+  posdata site = Site();
+  rtcontext ctx;
+  ASSERT_EQ(S_rt_init(&ctx, &site), 0);
+
+  /* once a second through a summer day, and a few far-off epochs */
+  long long start = S_epoch(2021, 6, 21, 0, 0, 0, -7.0);
+  for (long long t = 0; t < 86400 + 6; ++t) {
+    long long epoch = start + t;
+    if (t >= 86400) epoch = S_epoch(1950 + 20 * (t - 86400), 3, 1, 5, 0, 0,
+                                    -7.0);
+    double frac = (t % 4) * 0.25;
+    posdata rt, want = site;
+    want.function |= S_EPOCH;
+    want.epoch = epoch;
+    want.epochfrac = frac;
+    ASSERT_EQ(S_solpos(&want), 0);
+    ASSERT_EQ(S_rt_solpos(&ctx, epoch, frac, &rt), 0);
+    ExpectClose(rt, want);
+    if (HasFatalFailure()) FAIL() << "epoch " << epoch;
+    ASSERT_GE(rt.tstfix, -720.0);
+    ASSERT_LT(rt.tstfix, 720.0);
+  }
+}
+
+TEST(RealtimeTest, Errors) {
+  posdata site = Site();
+  rtcontext ctx;
+  site.latitude = 91.0;
+  EXPECT_EQ(S_rt_init(&ctx, &site), 1L << S_LAT_ERROR);
+
+  site = Site();
+  ASSERT_EQ(S_rt_init(&ctx, &site), 0);
+  posdata out;
+  out.azim = 123.0;
+  /* the local year limits, not the UTC ones */
+  EXPECT_EQ(S_rt_solpos(&ctx, S_epoch(1950, 1, 1, 0, 0, 0, -7.0), 0.0, &out),
+            0);
+  EXPECT_EQ(S_rt_solpos(&ctx, S_epoch(1949, 12, 31, 23, 59, 59, -7.0), 0.0,
+                        &out),
+            1L << S_YEAR_ERROR);
+  EXPECT_EQ(S_rt_solpos(&ctx, S_epoch(2051, 1, 1, 0, 0, 0, -7.0), 0.0, &out),
+            1L << S_YEAR_ERROR);
+  out.azim = 123.0;
+  EXPECT_EQ(S_rt_solpos(&ctx, S_epoch(2000, 1, 1, 0, 0, 0, -7.0), 1.0, &out),
+            1L << S_SECOND_ERROR);
+  EXPECT_EQ(out.azim, 123.0);
+}
+
+}  // namespace
+}  // namespace solpos
@@ -0,0 +1,167 @@
+/*============================================================================
+ *
+ *    NAME:  ring.h
+ *
+ *    Contains:
+ *        internal::spsc_ring  (bounded lock-free queue, one producer thread
+ *                              and one consumer thread)
+ *        internal::mpmc_ring  (bounded lock-free queue, any number of each)
+ *
+ *    Both hold a power of two of trivially copyable items and never
+ *    allocate after construction; push fails when full and pop when empty,
+ *    leaving the caller to decide how to wait.  Used by the streaming
+ *    modules of this package.  Not part of the public API.
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_RING_H_
+#define SOLPOS_RING_H_
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+
+namespace solpos {
+namespace internal {
+
+/* Bytes kept between indices written by different threads */
+const int kCacheLine = 64;
+
+/* Smallest power of two >= n, at least 2 */
+inline size_t ring_size(size_t n) {
+  size_t size = 2;
+  while (size < n) size *= 2;
+  return size;
+}
+
+/*============================================================================
+ *    Struct spsc_ring
+ *
+ *    Lamport's ring, with each side caching the other's index so that it
+ *    touches the shared one only when the cached value runs out.
+ *----------------------------------------------------------------------------*/
+template <typename T>
+struct spsc_ring {
+  explicit spsc_ring(size_t capacity)
+      : mask(ring_size(capacity) - 1),
+        items(new T[mask + 1]),
+        head(0),
+        tail_seen(0),
+        tail(0),
+        head_seen(0) {}
+
+  /* Producer side */
+  bool push(const T &item) {
+    size_t t = tail.load(std::memory_order_relaxed);
+    if (t - head_seen > mask) {
+      head_seen = head.load(std::memory_order_acquire);
+      if (t - head_seen > mask) return false;
+    }
+    items[t & mask] = item;
+    tail.store(t + 1, std::memory_order_release);
+    return true;
+  }
+
+  /* Consumer side */
+  bool pop(T *item) {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h == tail_seen) {
+      tail_seen = tail.load(std::memory_order_acquire);
+      if (h == tail_seen) return false;
+    }
+    *item = items[h & mask];
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  const size_t mask;
+  std::unique_ptr<T[]> items;
+
+  char pad0[kCacheLine];
+  std::atomic<size_t> head; /* next to pop, written by the consumer */
+  size_t tail_seen;         /* consumer's copy of tail */
+  char pad1[kCacheLine];
+  std::atomic<size_t> tail; /* next to push, written by the producer */
+  size_t head_seen;         /* producer's copy of head */
+  char pad2[kCacheLine];
+};
+
+/*============================================================================
+ *    Struct mpmc_ring
+ *
+ *    Vyukov's bounded queue: each cell carries a sequence number telling
+ *    whether it is free for the push of a lap or full for its pop, and the
+ *    two sides claim cells by compare-and-swap on their index.
+ *----------------------------------------------------------------------------*/
+template <typename T>
+struct mpmc_ring {
+  struct cell {
+    std::atomic<size_t> seq;
+    T item;
+  };
+
+  explicit mpmc_ring(size_t capacity)
+      : mask(ring_size(capacity) - 1), cells(new cell[mask + 1]) {
+    for (size_t i = 0; i <= mask; ++i)
+      cells[i].seq.store(i, std::memory_order_relaxed);
+    head.store(0, std::memory_order_relaxed);
+    tail.store(0, std::memory_order_relaxed);
+  }
+
+  bool push(const T &item) {
+    size_t pos = tail.load(std::memory_order_relaxed);
+    cell *c;
+    for (;;) {
+      c = &cells[pos & mask];
+      size_t seq = c->seq.load(std::memory_order_acquire);
+      std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq - pos);
+      if (diff == 0) {
+        if (tail.compare_exchange_weak(pos, pos + 1,
+                                       std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false; /* full: the cell still holds last lap's item */
+      } else {
+        pos = tail.load(std::memory_order_relaxed);
+      }
+    }
+    c->item = item;
+    c->seq.store(pos + 1, std::memory_order_release);
+    return true;
+  }
+
+  bool pop(T *item) {
+    size_t pos = head.load(std::memory_order_relaxed);
+    cell *c;
+    for (;;) {
+      c = &cells[pos & mask];
+      size_t seq = c->seq.load(std::memory_order_acquire);
+      std::ptrdiff_t diff = static_cast<std::ptrdiff_t>(seq - (pos + 1));
+      if (diff == 0) {
+        if (head.compare_exchange_weak(pos, pos + 1,
+                                       std::memory_order_relaxed))
+          break;
+      } else if (diff < 0) {
+        return false; /* empty */
+      } else {
+        pos = head.load(std::memory_order_relaxed);
+      }
+    }
+    *item = c->item;
+    c->seq.store(pos + mask + 1, std::memory_order_release);
+    return true;
+  }
+
+  const size_t mask;
+  std::unique_ptr<cell[]> cells;
+
+  char pad0[kCacheLine];
+  std::atomic<size_t> head; /* next cell to pop */
+  char pad1[kCacheLine];
+  std::atomic<size_t> tail; /* next cell to push */
+  char pad2[kCacheLine];
+};
+
+}  // namespace internal
+}  // namespace solpos
+
+#endif  // SOLPOS_RING_H_
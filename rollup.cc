@@ -0,0 +1,155 @@
+/*============================================================================
+ *    Contains:
+ *        S_solpos_rollup
+ *----------------------------------------------------------------------------*/
+#include "rollup.h"
+
+#include <algorithm>
+
+#include "parallel.h"
+#include "realtime.h"
+#include "solpos_internal.h"
+
+namespace solpos {
+
+/*============================================================================
+*    Local function prototypes
+============================================================================*/
+static int bucket_key(const posdata *pdat, int bucket);
+static void open_bucket(const posdata *pdat, int bucket, rollup *r);
+static void fold(double x, rollstat *stat);
+static int roll_site(int s, const posdata *site, const rollspec *spec,
+                     rollsink sink, void *context);
+
+/*============================================================================
+ *    Local int function bucket_key
+ *
+ *    A number that differs between any two buckets of one year range
+ *----------------------------------------------------------------------------*/
+static int bucket_key(const posdata *pdat, int bucket) {
+  int key = pdat->year * 13 + pdat->month;
+
+  if (bucket != S_ROLL_MONTH) key = key * 32 + pdat->day;
+  if (bucket == S_ROLL_HOUR) key = key * 24 + pdat->hour;
+  return key;
+}
+
+/*============================================================================
+ *    Local void function open_bucket
+ *
+ *    Starts r at the bucket holding pdat, with the first sample pdat
+ *----------------------------------------------------------------------------*/
+static void open_bucket(const posdata *pdat, int bucket, rollup *r) {
+  r->year = pdat->year;
+  r->month = pdat->month;
+  r->day = bucket == S_ROLL_MONTH ? 1 : pdat->day;
+  r->hour = bucket == S_ROLL_HOUR ? pdat->hour : 0;
+  r->start =
+      S_epoch(r->year, r->month, r->day, r->hour, 0, 0, pdat->timezone);
+  r->samples = 0;
+  r->sunup = 0;
+  r->etr.sum = 0.0;
+  r->etr.min = r->etr.max = pdat->etr;
+  r->etrn.sum = 0.0;
+  r->etrn.min = r->etrn.max = pdat->etrn;
+  r->etrtilt.sum = 0.0;
+  r->etrtilt.min = r->etrtilt.max = pdat->etrtilt;
+  r->elevref.sum = 0.0;
+  r->elevref.min = r->elevref.max = pdat->elevref;
+}
+
+/*============================================================================
+ *    Local void function fold
+ *----------------------------------------------------------------------------*/
+static void fold(double x, rollstat *stat) {
+  stat->sum += x;
+  stat->min = std::min(stat->min, x);
+  stat->max = std::max(stat->max, x);
+}
+
+/*============================================================================
+ *    Local int function roll_site
+ *
+ *    The series of one site, bucket by bucket into sink
+ *----------------------------------------------------------------------------*/
+static int roll_site(int s, const posdata *site, const rollspec *spec,
+                     rollsink sink, void *context) {
+  posdata pd = *site;
+  rtcontext ctx;
+  rollup r;
+  long long midnight = 0; /* of the local date today */
+  int today = 0, key = 0;
+  int retval;
+
+  pd.function = (S_REFRAC | S_ETR | S_TILT) & ~L_DOY;
+  retval = S_rt_init(&ctx, &pd);
+  if (retval != 0) return retval;
+  if (spec->samples == 0) return 0;
+
+  /* the series is checked whole, so no sample can fail and each runs
+     the stages of S_solpos directly */
+  const long long last =
+      spec->start + static_cast<long long>(spec->samples - 1) * spec->step;
+  if ((spec->start < ctx.first) || (last >= ctx.last))
+    return 1L << S_YEAR_ERROR;
+
+  r.site = s;
+  for (int k = 0; k < spec->samples; ++k) {
+    const long long epoch =
+        spec->start + static_cast<long long>(k) * spec->step;
+    pd = ctx.site;
+    pd.epoch = epoch;
+    pd.epochfrac = 0.0;
+    internal::compute(&pd);
+
+    /* the date comes with the sample, the hour (L_TST's) is not run */
+    const int date = bucket_key(&pd, S_ROLL_DAY);
+    if ((k == 0) || (date != today)) {
+      midnight = S_epoch(pd.year, pd.month, pd.day, 0, 0, 0, pd.timezone);
+      today = date;
+    }
+    pd.hour = static_cast<int>((epoch - midnight) / 3600);
+
+    const int now = bucket_key(&pd, spec->bucket);
+    if ((k == 0) || (now != key)) {
+      if (k > 0) sink(context, &r);
+      open_bucket(&pd, spec->bucket, &r);
+      key = now;
+    }
+
+    r.samples += 1;
+    r.sunup += pd.elevref > 0.0;
+    fold(pd.etr, &r.etr);
+    fold(pd.etrn, &r.etrn);
+    fold(pd.etrtilt, &r.etrtilt);
+    fold(pd.elevref, &r.elevref);
+  }
+  sink(context, &r);
+  return 0;
+}
+
+/*============================================================================
+ *    Int function S_solpos_rollup
+ *----------------------------------------------------------------------------*/
+int S_solpos_rollup(int sites, const posdata *site, const rollspec *spec,
+                    int threads, int *errors, rollsink sink, void *context) {
+  int summary = 0;
+
+  if ((spec->step < 1) || (spec->samples < 0) ||
+      (spec->bucket < S_ROLL_HOUR) || (spec->bucket > S_ROLL_MONTH))
+    return 1L << S_INTRVL_ERROR;
+
+  /* one site per range: a site is a whole series */
+  internal::parallel_for(
+      sites, threads,
+      [&](int first, int n) {
+        for (int s = first; s < first + n; ++s)
+          errors[s] = roll_site(s, &site[s], spec, sink, context);
+      },
+      1);
+
+  for (int s = 0; s < sites; ++s) summary |= errors[s];
+  return summary;
+}
+
+}  // namespace solpos
@@ -0,0 +1,109 @@
+/*============================================================================
+ *
+ *    NAME:  rollup.h
+ *
+ *    Contains:
+ *        S_solpos_rollup  (hourly, daily or monthly aggregates of a regular
+ *                          time series of sun positions, per site, with no
+ *                          per-sample output)
+ *
+ *            INPUTS:     a table of sites (posdata, as for S_rt_init) and
+ *                        a rollspec: first epoch, step, samples and bucket
+ *
+ *            OUTPUTS:    one rollup per site and calendar bucket, handed
+ *                        to a sink as each bucket closes
+ *
+ *    Reports want hourly mean ETR, daily insolation, monthly highest sun
+ *    and sun-hours, not the samples behind them.  Each site is validated
+ *    once (S_rt_init) and the series generated from spec, so there are no
+ *    input rows either; every sample runs the S_REFRAC, S_ETR and S_TILT
+ *    stages and is folded into one accumulator (count, sum, min, max of a
+ *    few outputs) that is emitted and reset when the sample's local
+ *    standard time enters the next bucket.  Buckets follow the site's
+ *    timezone; the first and last may be partial.
+ *
+ *    From a rollup r over samples step seconds apart:
+ *         mean ETR                r.etr.sum / r.samples       W/sq m
+ *         extraterrestrial
+ *           insolation            r.etr.sum * step / 3600     Wh/sq m
+ *         sun-hours               r.sunup * step / 3600.0     h
+ *         highest sun             r.elevref.max               degrees
+ *
+ *    Usage:
+ *         rollspec spec = {start, 60, 525600, S_ROLL_DAY};
+ *         int summary = S_solpos_rollup(sites, site, &spec, 0, errors,
+ *                                       sink, context);
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_ROLLUP_H_
+#define SOLPOS_ROLLUP_H_
+
+#include "solpos.h"
+
+namespace solpos {
+
+/* Buckets of rollspec */
+#define S_ROLL_HOUR 1  /* local standard clock hour */
+#define S_ROLL_DAY 2   /* local standard calendar day */
+#define S_ROLL_MONTH 3 /* local standard calendar month */
+
+struct rollspec {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  long long start;       /* I:  Epoch of the first sample */
+  int step;              /* I:  Seconds between samples, >= 1 */
+  int samples;           /* I:  Samples per site, >= 0 */
+  int bucket;            /* I:  S_ROLL_HOUR, S_ROLL_DAY or S_ROLL_MONTH */
+};
+
+/* Sum, least and greatest of one output over a bucket's samples */
+struct rollstat {
+  double sum;
+  double min;
+  double max;
+};
+
+struct rollup {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  int site;              /* O:  Index of the site in the site table */
+  long long start;       /* O:  Epoch at which the bucket begins */
+  int year;              /* O:  Local standard year, month, day and hour at */
+  int month;             /*     which the bucket begins (day 1 for months, */
+  int day;               /*     hour 0 for days and months) */
+  int hour;
+  int samples;           /* O:  Samples in the bucket */
+  int sunup;             /* O:  Those with elevref > 0 */
+  rollstat etr;          /* O:  posdata::etr, W/sq m */
+  rollstat etrn;         /* O:  posdata::etrn, W/sq m */
+  rollstat etrtilt;      /* O:  posdata::etrtilt, W/sq m */
+  rollstat elevref;      /* O:  posdata::elevref, degrees */
+};
+
+/* Receives each rollup of S_solpos_rollup, in time order within a site.
+   With more than one thread, calls for different sites may overlap. */
+typedef void (*rollsink)(void *context, const rollup *r);
+
+/*============================================================================
+ *    Int function S_solpos_rollup
+ *
+ *    For each of site[0 .. sites - 1], computes the series spec->start +
+ *    k * spec->step, k < spec->samples, and calls sink(context, &r) per
+ *    bucket.  The function switch of each site is replaced by S_REFRAC,
+ *    S_ETR and S_TILT; the other inputs are the site's.  Sites are spread
+ *    over threads (0 = one per hardware thread).  A site with an error
+ *    gives no rollups.
+ *
+ *    OUTPUTS: errors[s] = 0, the S_rt_init code of site s, or
+ *             (1L << S_YEAR_ERROR) for a series reaching outside its
+ *             1950 - 2050 local dates
+ *
+ *    RETURNS: The OR of all site codes, or (1L << S_INTRVL_ERROR) (and
+ *             nothing computed) for a bad step, samples or bucket
+ *----------------------------------------------------------------------------*/
+int S_solpos_rollup(int sites, const posdata *site, const rollspec *spec,
+                    int threads, int *errors, rollsink sink, void *context);
+
+}  // namespace solpos
+
+#endif  // SOLPOS_ROLLUP_H_
@@ -0,0 +1,168 @@
+#include "rollup.h"
+
+#include <algorithm>
+#include <mutex>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace solpos {
+namespace {
+
+/* Collects the rollups of a call; safe across threads */
+struct Rollups {
+  std::mutex mu;
+  std::vector<rollup> all;
+};
+
+void Collect(void *context, const rollup *r) {
+  Rollups *c = static_cast<Rollups *>(context);
+  std::lock_guard<std::mutex> lock(c->mu);
+  c->all.push_back(*r);
+}
+
+posdata Site(double latitude) {
+  posdata pd;
+  S_init(&pd);
+  pd.latitude = latitude;
+  pd.longitude = -105.0;
+  pd.timezone = -7.0;
+  pd.tilt = 30.0;
+  pd.aspect = 180.0;
+  return pd;
+}
+
+/* The rollup of samples [first, first + n) of spec, by S_solpos */
+rollup Expected(const posdata &site, const rollspec &spec, int first, int n) {
+  rollup r = {};
+  for (int k = first; k < first + n; ++k) {
+    posdata pd = site;
+    pd.function = S_EPOCH | ((S_REFRAC | S_ETR | S_TILT) & ~L_DOY);
+    pd.epoch = spec.start + static_cast<long long>(k) * spec.step;
+    pd.epochfrac = 0.0;
+    EXPECT_EQ(S_solpos(&pd), 0);
+    const double x[4] = {pd.etr, pd.etrn, pd.etrtilt, pd.elevref};
+    rollstat *stat[4] = {&r.etr, &r.etrn, &r.etrtilt, &r.elevref};
+    for (int j = 0; j < 4; ++j) {
+      if (k == first) stat[j]->min = stat[j]->max = x[j];
+      stat[j]->sum += x[j];
+      stat[j]->min = std::min(stat[j]->min, x[j]);
+      stat[j]->max = std::max(stat[j]->max, x[j]);
+    }
+    r.samples += 1;
+    r.sunup += pd.elevref > 0.0;
+  }
+  return r;
+}
+
+void ExpectStats(const rollup &got, const rollup &want) {
+  EXPECT_EQ(got.samples, want.samples);
+  EXPECT_EQ(got.sunup, want.sunup);
+  const rollstat *g[4] = {&got.etr, &got.etrn, &got.etrtilt, &got.elevref};
+  const rollstat *w[4] = {&want.etr, &want.etrn, &want.etrtilt,
+                          &want.elevref};
+  for (int j = 0; j < 4; ++j) {
+    EXPECT_EQ(g[j]->sum, w[j]->sum) << "stat " << j;
+    EXPECT_EQ(g[j]->min, w[j]->min) << "stat " << j;
+    EXPECT_EQ(g[j]->max, w[j]->max) << "stat " << j;
+  }
+}
+
+TEST(RollupTest, HoursAndDaysMatchSolpos) {
+  posdata site = Site(40.0);
+  /* from 23:30 local: a partial first hour and day */
+  const long long start = S_epoch(2021, 6, 20, 23, 30, 0, -7.0);
+  rollspec spec = {start, 60, 2 * 1440 + 30, S_ROLL_HOUR};
+  int error = -1;
+  Rollups hours;
+  ASSERT_EQ(S_solpos_rollup(1, &site, &spec, 1, &error, Collect, &hours), 0);
+  EXPECT_EQ(error, 0);
+  ASSERT_EQ(hours.all.size(), 49u);
+  EXPECT_EQ(hours.all[0].samples, 30);
+  EXPECT_EQ(hours.all[0].hour, 23);
+  EXPECT_EQ(hours.all[1].start, S_epoch(2021, 6, 21, 0, 0, 0, -7.0));
+  EXPECT_EQ(hours.all[13].day, 21);
+  EXPECT_EQ(hours.all[13].hour, 12);
+  ExpectStats(hours.all[0], Expected(site, spec, 0, 30));
+  ExpectStats(hours.all[13], Expected(site, spec, 30 + 12 * 60, 60));
+
+  spec.bucket = S_ROLL_DAY;
+  Rollups days;
+  ASSERT_EQ(S_solpos_rollup(1, &site, &spec, 1, &error, Collect, &days), 0);
+  ASSERT_EQ(days.all.size(), 3u);
+  EXPECT_EQ(days.all[1].year, 2021);
+  EXPECT_EQ(days.all[1].month, 6);
+  EXPECT_EQ(days.all[1].day, 21);
+  EXPECT_EQ(days.all[1].hour, 0);
+  EXPECT_EQ(days.all[1].start, S_epoch(2021, 6, 21, 0, 0, 0, -7.0));
+  EXPECT_EQ(days.all[2].samples, 1440);
+  ExpectStats(days.all[1], Expected(site, spec, 30, 1440));
+  /* near the solstice at 40 N: about 15 sun-hours, the sun up to 73.5 */
+  EXPECT_NEAR(days.all[1].sunup / 60.0, 15.0, 0.3);
+  EXPECT_NEAR(days.all[1].elevref.max, 73.5, 0.3);
+}
+
+TEST(RollupTest, MonthsAcrossThreads) {
+  std::vector<posdata> site;
+  for (int s = 0; s < 4; ++s) site.push_back(Site(-30.0 + 20.0 * s));
+  /* hourly from 1 JAN through 31 MAR 2020, a leap year */
+  rollspec spec = {S_epoch(2020, 1, 1, 0, 0, 0, -7.0), 3600, 91 * 24,
+                   S_ROLL_MONTH};
+  std::vector<int> errors(4, -1);
+  Rollups months;
+  ASSERT_EQ(S_solpos_rollup(4, site.data(), &spec, 4, errors.data(), Collect,
+                            &months),
+            0);
+  ASSERT_EQ(months.all.size(), 12u);
+
+  const int days[3] = {31, 29, 31};
+  for (size_t i = 0; i < months.all.size(); ++i) {
+    const rollup &r = months.all[i];
+    int first = 0;
+    for (int m = 1; m < r.month; ++m) first += days[m - 1] * 24;
+    EXPECT_EQ(r.day, 1);
+    EXPECT_EQ(r.samples, days[r.month - 1] * 24);
+    ExpectStats(r, Expected(site[r.site], spec, first, r.samples));
+  }
+}
+
+TEST(RollupTest, Errors) {
+  std::vector<posdata> site;
+  site.push_back(Site(95.0));
+  site.push_back(Site(40.0));
+  site.push_back(Site(40.0));
+  site[2].timezone = -12.0;
+  /* the last hour of 2050, local: later for the west of the table */
+  rollspec spec = {S_epoch(2050, 12, 31, 23, 0, 0, -7.0), 60, 60, S_ROLL_DAY};
+  std::vector<int> errors(3, -1);
+  Rollups got;
+  EXPECT_EQ(S_solpos_rollup(3, site.data(), &spec, 1, errors.data(), Collect,
+                            &got),
+            1L << S_LAT_ERROR);
+  EXPECT_EQ(errors[0], 1L << S_LAT_ERROR);
+  EXPECT_EQ(errors[1], 0);
+  EXPECT_EQ(errors[2], 0);
+  ASSERT_EQ(got.all.size(), 2u);
+
+  spec.samples = 61;
+  got.all.clear();
+  EXPECT_EQ(S_solpos_rollup(3, site.data(), &spec, 1, errors.data(), Collect,
+                            &got),
+            (1L << S_LAT_ERROR) | (1L << S_YEAR_ERROR));
+  EXPECT_EQ(errors[1], 1L << S_YEAR_ERROR);
+  EXPECT_EQ(errors[2], 0);
+  EXPECT_EQ(got.all.size(), 1u);
+
+  spec.step = 0;
+  EXPECT_EQ(S_solpos_rollup(3, site.data(), &spec, 1, errors.data(), Collect,
+                            &got),
+            1L << S_INTRVL_ERROR);
+  spec.step = 60;
+  spec.bucket = 4;
+  EXPECT_EQ(S_solpos_rollup(3, site.data(), &spec, 1, errors.data(), Collect,
+                            &got),
+            1L << S_INTRVL_ERROR);
+}
+
+}  // namespace
+}  // namespace solpos
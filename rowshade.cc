@@ -0,0 +1,194 @@
+/*============================================================================
+ *    Contains:
+ *        S_rowshade, S_rowshade_batch
+ *
+ *        Rows are sorted into groups of identical geometry, each with its
+ *        trig and front-row edge worked out once.  Timestamps go through in
+ *        blocks of kBlock: the sun vector of the block is computed once,
+ *        then each group is a branch-free pass over the block whose result
+ *        is copied to the group's rows.
+ *----------------------------------------------------------------------------*/
+#include "rowshade.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+#include <tuple>
+#include <vector>
+
+#include "parallel.h"
+
+namespace solpos {
+
+/*============================================================================
+*    Local constants, types and function prototypes
+============================================================================*/
+static const int kBlock = 512;
+static const double kDegreesToRadians = M_PI / 180.0;
+static const double kNaN = std::numeric_limits<double>::quiet_NaN();
+
+/* Rows order[first .. first + count - 1], all of one geometry */
+struct rowgroup {
+  double st, ct; /* sine and cosine of tilt */
+  double sa, ca; /* sine and cosine of aspect */
+  double au, av; /* top edge of the front row, from the bottom edge */
+  double width;
+  int first, count;
+};
+
+static void make_groups(int rows, const rowgeometry *geometry,
+                        std::vector<int> *order,
+                        std::vector<rowgroup> *groups);
+static void shade_block(const std::vector<rowgroup> &groups, const int *order,
+                        int first, int n, const double *azim,
+                        const double *elevref, const double *etrn,
+                        const rowshadedata *data);
+
+/*============================================================================
+ *    Local void function make_groups
+ *----------------------------------------------------------------------------*/
+static void make_groups(int rows, const rowgeometry *geometry,
+                        std::vector<int> *order,
+                        std::vector<rowgroup> *groups) {
+  auto key = [geometry](int r) {
+    const rowgeometry &g = geometry[r];
+    return std::make_tuple(g.tilt, g.aspect, g.pitch, g.width, g.slope);
+  };
+
+  order->resize(rows);
+  for (int r = 0; r < rows; ++r) (*order)[r] = r;
+  std::sort(order->begin(), order->end(),
+            [&key](int a, int b) { return key(a) < key(b); });
+
+  groups->clear();
+  for (int k = 0; k < rows; ++k) {
+    int r = (*order)[k];
+    if (k > 0 && key(r) == key((*order)[k - 1])) {
+      ++groups->back().count;
+      continue;
+    }
+    const rowgeometry &g = geometry[r];
+    rowgroup group;
+    group.st = std::sin(kDegreesToRadians * g.tilt);
+    group.ct = std::cos(kDegreesToRadians * g.tilt);
+    group.sa = std::sin(kDegreesToRadians * g.aspect);
+    group.ca = std::cos(kDegreesToRadians * g.aspect);
+    group.au = g.pitch - g.width * group.ct;
+    group.av = g.width * group.st - g.pitch * std::tan(kDegreesToRadians *
+                                                       g.slope);
+    group.width = g.width;
+    group.first = k;
+    group.count = 1;
+    groups->push_back(group);
+  }
+}
+
+/*============================================================================
+ *    Local void function shade_block
+ *
+ *    Outputs of timestamps [first, first + n) of data, n <= kBlock, from
+ *    their positions azim[0 .. n - 1] and so on
+ *----------------------------------------------------------------------------*/
+static void shade_block(const std::vector<rowgroup> &groups, const int *order,
+                        int first, int n, const double *azim,
+                        const double *elevref, const double *etrn,
+                        const rowshadedata *data) {
+  double sx[kBlock], sy[kBlock], v[kBlock], shaded[kBlock], etrtilt[kBlock];
+  const size_t bytes = n * sizeof(double);
+
+  /* the sun vector, east, north and up */
+  for (int t = 0; t < n; ++t) {
+    double ce = std::cos(kDegreesToRadians * elevref[t]);
+    sx[t] = ce * std::sin(kDegreesToRadians * azim[t]);
+    sy[t] = ce * std::cos(kDegreesToRadians * azim[t]);
+    v[t] = std::sin(kDegreesToRadians * elevref[t]);
+  }
+
+  for (const rowgroup &g : groups) {
+    for (int t = 0; t < n; ++t) {
+      double u = sx[t] * g.sa + sy[t] * g.ca; /* along aspect */
+      double cosinc = g.st * u + g.ct * v[t];
+      double f = (g.av * u - g.au * v[t]) / (cosinc * g.width);
+      f = f < 0.0 ? 0.0 : f;
+      f = f > 1.0 ? 1.0 : f;
+      int lit = (cosinc > 0.0) & (v[t] > 0.0);
+      shaded[t] = lit ? f : 0.0;
+      if (etrn) etrtilt[t] = lit ? etrn[t] * cosinc * (1.0 - f) : 0.0;
+    }
+    for (int k = g.first; k < g.first + g.count; ++k) {
+      size_t at = static_cast<size_t>(order[k]) * data->count + first;
+      if (data->shaded) std::memcpy(data->shaded + at, shaded, bytes);
+      if (data->etrtilt && etrn)
+        std::memcpy(data->etrtilt + at, etrtilt, bytes);
+    }
+  }
+}
+
+/*============================================================================
+ *    Void function S_rowshade
+ *----------------------------------------------------------------------------*/
+void S_rowshade(int rows, const rowgeometry *geometry,
+                const rowshadedata *data, int threads) {
+  std::vector<int> order;
+  std::vector<rowgroup> groups;
+  make_groups(rows, geometry, &order, &groups);
+
+  internal::parallel_for(data->count, threads, [&](int first, int count) {
+    for (int b = first; b < first + count; b += kBlock) {
+      int n = std::min(kBlock, first + count - b);
+      shade_block(groups, order.data(), b, n, data->azim + b,
+                  data->elevref + b, data->etrn ? data->etrn + b : nullptr,
+                  data);
+    }
+  }, std::max(1, internal::kMinRowsPerThread / std::max(rows, 1)));
+}
+
+/*============================================================================
+ *    Int function S_rowshade_batch
+ *----------------------------------------------------------------------------*/
+int S_rowshade_batch(const posbatch *batch, int rows,
+                     const rowgeometry *geometry, const rowshadedata *data,
+                     int threads, int *errors) {
+  std::vector<int> order;
+  std::vector<rowgroup> groups;
+  posdata base = *batch->base;
+  posbatch work = *batch;
+  rowshadedata out = *data;
+  int summary = 0;
+
+  make_groups(rows, geometry, &order, &groups);
+  base.function = (base.function & (L_DOY | S_EPOCH)) |
+                  ((S_SOLAZM | S_REFRAC | S_ETR) & ~L_DOY);
+  work.base = &base;
+  out.count = batch->count;
+
+  internal::parallel_for(batch->count, threads, [&](int first, int count) {
+    double azim[kBlock], elevref[kBlock], etrn[kBlock];
+    for (int b = first; b < first + count; b += kBlock) {
+      int n = std::min(kBlock, first + count - b);
+      posbatch slice;
+      poscolumns columns = {};
+      columns.azim = azim;
+      columns.elevref = elevref;
+      columns.etrn = etrn;
+      S_batch_slice(&work, b, n, &slice);
+      S_solpos_columns(&slice, errors + b, &columns);
+      shade_block(groups, order.data(), b, n, azim, elevref, etrn, &out);
+
+      for (int t = b; t < b + n; ++t) {
+        if (errors[t] == 0) continue;
+        for (int r = 0; r < rows; ++r) {
+          size_t at = static_cast<size_t>(r) * out.count + t;
+          if (out.shaded) out.shaded[at] = kNaN;
+          if (out.etrtilt) out.etrtilt[at] = kNaN;
+        }
+      }
+    }
+  }, std::max(1, internal::kMinRowsPerThread / std::max(rows, 1)));
+
+  for (int t = 0; t < batch->count; ++t) summary |= errors[t];
+  return summary;
+}
+
+}  // namespace solpos
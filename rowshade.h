@@ -0,0 +1,100 @@
+/*============================================================================
+ *
+ *    NAME:  rowshade.h
+ *
+ *    Contains:
+ *        S_rowshade        (shaded fraction and shaded etrtilt of rows of
+ *                           fixed collectors, from sun position columns)
+ *        S_rowshade_batch  (the same, computing the positions from a
+ *                           posbatch)
+ *
+ *            INPUTS:     per timestamp azim, elevref and etrn; per row its
+ *                        tilt, aspect, pitch, collector width and terrain
+ *                        slope
+ *
+ *            OUTPUTS:    per row and timestamp the fraction of the
+ *                        collector width shaded by the row in front, and
+ *                        etrtilt of the unshaded part
+ *
+ *    Rows are long and parallel, with horizontal axes across the aspect
+ *    direction, so the geometry is two-dimensional in the vertical plane
+ *    along aspect.  The row in front (toward aspect) stands pitch meters
+ *    ahead, slope degrees lower (the ground falls toward aspect when slope
+ *    is positive).  With the sun vector (u, v) in that plane, u toward
+ *    aspect and v up, and the collector normal (sin tilt, cos tilt), the
+ *    shadow of the front row's top edge reaches
+ *
+ *        s = (a_v u - a_u v) / cosinc
+ *
+ *    up the collector from its bottom edge, with (a_u, a_v) the top edge of
+ *    the front row relative to that bottom edge and cosinc = u sin tilt +
+ *    v cos tilt (the cosinc of tilt()).  The shaded fraction is s / width
+ *    clipped to [0, 1], and 0 with the sun at or below the horizon or
+ *    behind the collector.  Shaded etrtilt = etrn * cosinc * (1 - shaded).
+ *    End effects and shading from the row behind are not modelled.
+ *
+ *    Rows with identical geometry are computed once and copied.  Outputs
+ *    are laid out row-major: entry r * count + t is row r at time t.
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_ROWSHADE_H_
+#define SOLPOS_ROWSHADE_H_
+
+#include "batch.h"
+
+namespace solpos {
+
+struct rowgeometry {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  double tilt;           /* I:  Collector tilt, degrees from horizontal */
+  double aspect;         /* I:  Collector azimuth, degrees east of north */
+  double pitch;          /* I:  Horizontal distance to the row in front along
+                                aspect, m */
+  double width;          /* I:  Collector slant width, m */
+  double slope;          /* I:  Terrain slope toward aspect, degrees */
+};
+
+struct rowshadedata {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  int count;             /* I:  Number of timestamps */
+  const double *azim;    /* I:  posdata::azim */
+  const double *elevref; /* I:  posdata::elevref */
+  const double *etrn;    /* I:  posdata::etrn (needed for etrtilt only) */
+
+  /* Output columns, rows * count entries (nullptr = not wanted) */
+  double *shaded;        /* O:  Shaded fraction of the collector width */
+  double *etrtilt;       /* O:  ETR on the unshaded part, W/m^2 of row */
+};
+
+/*============================================================================
+ *    Void function S_rowshade
+ *
+ *    Fills the outputs of data for rows rows with geometry[0 .. rows - 1],
+ *    spreading the timestamps over threads threads (0 = one per hardware
+ *    thread).
+ *----------------------------------------------------------------------------*/
+void S_rowshade(int rows, const rowgeometry *geometry,
+                const rowshadedata *data, int threads);
+
+/*============================================================================
+ *    Int function S_rowshade_batch
+ *
+ *    Computes azim, elevref and etrn for each row of batch (the S_SOLAZM,
+ *    S_REFRAC and S_ETR stages, a block at a time on each thread) and
+ *    shades them in the same pass; the count, azim, elevref and etrn
+ *    members of data are taken from the batch.  Timestamps with errors get
+ *    NaN outputs for every row.
+ *
+ *    OUTPUTS: errors[t] (S_solpos return code) and the columns of data
+ *
+ *    RETURNS: The OR of all timestamp codes
+ *----------------------------------------------------------------------------*/
+int S_rowshade_batch(const posbatch *batch, int rows,
+                     const rowgeometry *geometry, const rowshadedata *data,
+                     int threads, int *errors);
+
+}  // namespace solpos
+
+#endif  // SOLPOS_ROWSHADE_H_
@@ -0,0 +1,140 @@
+#include "rowshade.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace solpos {
+namespace {
+
+const double kD = M_PI / 180.0;
+
+TEST(RowShadeTest, ProfileAngleFormula) {
+  /* the flat-ground formula 1 - pitch sin(a) / (width sin(a + tilt)), with
+     a the profile angle: tan(a) = tan(elevation) / cos(azimuth - aspect) */
+  const double azim[4] = {180.0, 150.0, 215.0, 180.0};
+  const double elev[4] = {15.0, 20.0, 10.0, 60.0};
+  const double etrn[4] = {1360.0, 1360.0, 1360.0, 1360.0};
+  rowgeometry row = {30.0, 180.0, 5.0, 2.0, 0.0};
+  double shaded[4], etrtilt[4];
+  rowshadedata data = {4, azim, elev, etrn, shaded, etrtilt};
+  S_rowshade(1, &row, &data, 1);
+
+  for (int t = 0; t < 4; ++t) {
+    double a = std::atan(std::tan(elev[t] * kD) /
+                         std::cos((azim[t] - row.aspect) * kD));
+    double want = 1.0 - row.pitch * std::sin(a) /
+                            (row.width * std::sin(a + row.tilt * kD));
+    want = std::max(0.0, std::min(1.0, want));
+    EXPECT_NEAR(shaded[t], want, 1e-12) << "time " << t;
+
+    double cosinc =
+        std::cos((90.0 - elev[t]) * kD) * std::cos(row.tilt * kD) +
+        std::sin((90.0 - elev[t]) * kD) * std::sin(row.tilt * kD) *
+            std::cos((azim[t] - row.aspect) * kD);
+    EXPECT_NEAR(etrtilt[t], 1360.0 * cosinc * (1.0 - want), 1e-9);
+  }
+  EXPECT_GT(shaded[0], 0.05);
+  EXPECT_EQ(shaded[3], 0.0);
+}
+
+TEST(RowShadeTest, VerticalRowsSlopeAndNight) {
+  const double azim[3] = {180.0, 180.0, 180.0};
+  const double elev[3] = {20.0, 20.0, -2.0};
+  rowgeometry rows[3] = {{90.0, 180.0, 2.0, 1.0, 0.0},
+                         {90.0, 180.0, 2.0, 1.0, 5.0},
+                         {90.0, 180.0, 2.0, 1.0, -5.0}};
+  double shaded[9];
+  rowshadedata data = {3, azim, elev, nullptr, shaded, nullptr};
+  S_rowshade(3, rows, &data, 1);
+
+  EXPECT_NEAR(shaded[0], 1.0 - 2.0 * std::tan(20.0 * kD), 1e-12);
+  /* ground falling toward the sun lowers the front row */
+  EXPECT_NEAR(shaded[3], 1.0 - 2.0 * (std::tan(20.0 * kD) +
+                                      std::tan(5.0 * kD)), 1e-12);
+  EXPECT_GT(shaded[6], shaded[0]);
+  EXPECT_EQ(shaded[2], 0.0);
+  EXPECT_EQ(shaded[5], 0.0);
+}
+
+TEST(RowShadeTest, BatchMatchesSolpos) {
+  posdata base;
+  S_init(&base);
+  base.function = S_ALL & ~S_DOY;
+  base.latitude = 35.05;
+  base.longitude = -106.62;
+  base.timezone = -7.0;
+  base.year = 2018;
+  base.month = 12;
+  base.day = 21;
+  base.second = 0;
+
+  const int count = 1440;
+  std::vector<int> hour(count), minute(count), errors(count);
+  for (int t = 0; t < count; ++t) {
+    hour[t] = t / 60;
+    minute[t] = t % 60;
+  }
+  minute[700] = 60;
+  posbatch batch = {};
+  batch.base = &base;
+  batch.count = count;
+  batch.hour = hour.data();
+  batch.minute = minute.data();
+
+  /* two geometries, interleaved, and one row too far apart to shade */
+  const int rows = 5;
+  rowgeometry geometry[rows] = {
+      {25.0, 180.0, 4.0, 2.0, 0.0}, {25.0, 170.0, 4.5, 2.0, 1.0},
+      {25.0, 180.0, 4.0, 2.0, 0.0}, {25.0, 170.0, 4.5, 2.0, 1.0},
+      {25.0, 180.0, 1e6, 2.0, 0.0}};
+  std::vector<double> shaded(rows * count), etrtilt(rows * count);
+  rowshadedata data = {};
+  data.shaded = shaded.data();
+  data.etrtilt = etrtilt.data();
+  EXPECT_EQ(S_rowshade_batch(&batch, rows, geometry, &data, 1,
+                             errors.data()),
+            1L << S_MINUTE_ERROR);
+
+  std::vector<double> shaded4(rows * count), etrtilt4(rows * count);
+  data.shaded = shaded4.data();
+  data.etrtilt = etrtilt4.data();
+  S_rowshade_batch(&batch, rows, geometry, &data, 4, errors.data());
+  /* bitwise, NaN rows included */
+  EXPECT_EQ(std::memcmp(shaded.data(), shaded4.data(),
+                        shaded.size() * sizeof(double)),
+            0);
+  EXPECT_EQ(std::memcmp(etrtilt.data(), etrtilt4.data(),
+                        etrtilt.size() * sizeof(double)),
+            0);
+
+  int shaded_rows = 0;
+  for (int t = 0; t < count; ++t) {
+    if (errors[t]) {
+      EXPECT_TRUE(std::isnan(shaded[t]));
+      EXPECT_TRUE(std::isnan(etrtilt[4 * count + t]));
+      continue;
+    }
+    EXPECT_EQ(shaded[t], shaded[2 * count + t]);
+    EXPECT_EQ(etrtilt[count + t], etrtilt[3 * count + t]);
+    EXPECT_EQ(shaded[4 * count + t], 0.0);
+
+    posdata pd = base;
+    pd.hour = hour[t];
+    pd.minute = minute[t];
+    pd.tilt = 25.0;
+    pd.aspect = 180.0;
+    ASSERT_EQ(S_solpos(&pd), 0);
+    EXPECT_NEAR(etrtilt[4 * count + t], pd.etrtilt, 1e-9) << "time " << t;
+    EXPECT_NEAR(etrtilt[t], pd.etrtilt * (1.0 - shaded[t]), 1e-9);
+    shaded_rows += shaded[t] > 0.0;
+  }
+  /* the winter sun is low: mornings and afternoons are shaded */
+  EXPECT_GT(shaded_rows, 60);
+}
+
+}  // namespace
+}  // namespace solpos
@@ -0,0 +1,125 @@
+/*============================================================================
+ *    Contains:
+ *        S_solpos_select
+ *----------------------------------------------------------------------------*/
+#include "select.h"
+
+#include <vector>
+
+#include "solpos_internal.h"
+
+namespace solpos {
+
+/*============================================================================
+*    Local constants and function prototypes
+============================================================================*/
+/* Rows whose posdata are held between the tests and the later stages */
+static const int kBlock = 256;
+
+/* The stages (with those they depend on) behind each column of
+   poscolumns, in internal::kPosColumn order */
+static const int kColumnStages[internal::kPosColumns] = {
+    S_AMASS,  S_AMASS,  S_SOLAZM, S_TILT,        S_REFRAC, S_GEOM,
+    S_REFRAC, S_GEOM,   S_ETR,    S_ETR,         S_TILT | S_ETR,
+    S_GEOM,   S_PRIME,  S_SBCF,   S_SRSS,        S_SRSS,   S_PRIME,
+    S_REFRAC};
+
+static int test_stages(int tests);
+
+/*============================================================================
+ *    Local int function test_stages
+ *
+ *    The stages (with those they depend on) the tests need
+ *----------------------------------------------------------------------------*/
+static int test_stages(int tests) {
+  int stages = 0;
+
+  if (tests & S_KEEP_ELEVETR) stages |= S_ZENETR;
+  if (tests & S_KEEP_ELEVREF) stages |= S_REFRAC;
+  if (tests & S_KEEP_COSINC) stages |= S_TILT;
+  return stages;
+}
+
+/*============================================================================
+ *    Int function S_solpos_select
+ *----------------------------------------------------------------------------*/
+int S_solpos_select(const posbatch *batch, const posfilter *filter,
+                    int *errors, const poscolumns *out, int *rows,
+                    int *kept) {
+  const int tests = filter->tests;
+  const int date = batch->base->function & (S_EPOCH | L_DOY);
+  std::vector<int> wanted; /* the columns of out that are not nullptr */
+  int full, first, later, summary;
+  posdata base;
+  posbatch reduced;
+
+  /* The function switch: what the columns and tests need, and no more
+     (the S_* masks carry L_DOY, the date form, so it is put back) */
+  full = test_stages(tests);
+  for (int k = 0; k < internal::kPosColumns; ++k) {
+    if (!(out->*internal::kPosColumn[k])) continue;
+    wanted.push_back(k);
+    full |= kColumnStages[k];
+  }
+  full = (full & ~L_DOY) | date;
+
+  /* Run first: the stages of the tests (tilt reads etrn, so etr goes with
+     it when wanted); later: the rest, on the date and geometry done */
+  first = (test_stages(tests) & ~L_DOY) | date;
+  if ((first & L_TILT) && (full & L_ETR)) first |= L_ETR;
+  if (tests == 0) first = full;
+  later = full & ~first & ~(S_EPOCH | L_GEOM | L_DOY);
+
+  base = *batch->base;
+  base.function = full;
+  reduced = *batch;
+  reduced.base = &base;
+  summary = S_validate_batch(&reduced, errors);
+
+  std::vector<posdata> block(kBlock);
+  int pass[kBlock], keep[kBlock];
+  int n = 0;
+
+  for (int start = 0; start < batch->count; start += kBlock) {
+    const int size =
+        batch->count - start < kBlock ? batch->count - start : kBlock;
+
+    for (int j = 0; j < size; ++j) {
+      posdata &pd = block[j];
+      pass[j] = 0;
+      if (errors[start + j] != 0) continue;
+      S_batch_row(&reduced, start + j, &pd);
+      pd.function = first;
+      internal::compute(&pd);
+      pass[j] = (!(tests & S_KEEP_ELEVETR) | (pd.elevetr > filter->elevetr)) &
+                (!(tests & S_KEEP_ELEVREF) | (pd.elevref > filter->elevref)) &
+                (!(tests & S_KEEP_COSINC) | (pd.cosinc > filter->cosinc));
+    }
+
+    /* pack the passing rows: always store, advance by the test */
+    int m = 0;
+    for (int j = 0; j < size; ++j) {
+      keep[m] = j;
+      m += pass[j];
+    }
+
+    for (int k = 0; k < m; ++k) {
+      posdata &pd = block[keep[k]];
+      if (later != 0) {
+        pd.function = later;
+        internal::compute_local(&pd);
+      }
+      for (size_t c = 0; c < wanted.size(); ++c) {
+        const int j = wanted[c];
+        (out->*internal::kPosColumn[j])[n + k] = pd.*internal::kPosMember[j];
+      }
+      if (rows) rows[n + k] = start + keep[k];
+    }
+    n += m;
+  }
+
+  *kept = n;
+  return summary;
+}
+
+}  // namespace solpos
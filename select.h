@@ -0,0 +1,70 @@
+/*============================================================================
+ *
+ *    NAME:  select.h
+ *
+ *    Contains:
+ *        S_solpos_select  (runs a batch, keeping only the rows that pass
+ *                          simple tests and only the columns asked for)
+ *
+ *            INPUTS:     a posbatch, a posfilter of tests and the output
+ *                        columns wanted (the non-null ones of poscolumns)
+ *
+ *            OUTPUTS:    per-row error codes; the wanted columns of the
+ *                        passing rows, packed, with their row numbers
+ *
+ *    Pushes the projection and the tests down into the stages.  The
+ *    function switch of batch->base is replaced by just the stages the
+ *    wanted columns and the tests need (its date form, S_EPOCH or L_DOY, is
+ *    kept).  Rows are taken a block at a time: each runs the stages its
+ *    tests need first (refraction and azimuth ahead of the others when
+ *    needed, which changes no value), the tests are applied, the passing
+ *    rows are packed with a branch-free index compaction, and only they run
+ *    the remaining stages and have their columns written, contiguously.
+ *    Values are bitwise those of S_solpos with that function.
+ *
+ *    A zenith threshold z is the elevation threshold 90 - z.
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_SELECT_H_
+#define SOLPOS_SELECT_H_
+
+#include "batch.h"
+
+namespace solpos {
+
+/* Tests of posfilter */
+#define S_KEEP_ELEVETR 0x0001 /* elevetr > posfilter::elevetr (the cheapest:
+                                 decided before refraction) */
+#define S_KEEP_ELEVREF 0x0002 /* elevref > posfilter::elevref */
+#define S_KEEP_COSINC 0x0004  /* cosinc > posfilter::cosinc */
+
+struct posfilter {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  int tests;             /* I:  OR of the S_KEEP_* tests a row must all pass
+                                (0 keeps every valid row) */
+  double elevetr;        /* I:  Unrefracted elevation threshold, degrees */
+  double elevref;        /* I:  Refracted elevation threshold, degrees */
+  double cosinc;         /* I:  Incidence cosine threshold (0 = the sun in
+                                front of the surface) */
+};
+
+/*============================================================================
+ *    Int function S_solpos_select
+ *
+ *    Validates the batch under the reduced function switch, then computes
+ *    it as described above.  Rows with errors are never kept.
+ *
+ *    OUTPUTS: errors[i] for every row i; for k < *kept, each wanted column
+ *             entry k and rows[k] (when not nullptr) for the k-th row kept,
+ *             in row order
+ *
+ *    RETURNS: The OR of all row codes
+ *----------------------------------------------------------------------------*/
+int S_solpos_select(const posbatch *batch, const posfilter *filter,
+                    int *errors, const poscolumns *out, int *rows,
+                    int *kept);
+
+}  // namespace solpos
+
+#endif  // SOLPOS_SELECT_H_
@@ -0,0 +1,130 @@
+#include "select.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace solpos {
+namespace {
+
+/* A day at one site, a row every ten minutes, with a tilted surface */
+struct Day {
+  Day() : epoch(144), temp(144, 10.0) {
+    S_init(&base);
+    base.function = S_EPOCH | (S_ALL & ~L_DOY);
+    base.latitude = 40.0;
+    base.longitude = -105.0;
+    base.timezone = -7.0;
+    base.tilt = 40.0;
+    base.aspect = 135.0;
+    const long long t = S_epoch(2021, 9, 22, 0, 0, 0, -7.0);
+    for (int i = 0; i < 144; ++i) epoch[i] = t + 600LL * i;
+    batch = posbatch();
+    batch.base = &base;
+    batch.count = 144;
+    batch.epoch = epoch.data();
+    batch.temp = temp.data();
+  }
+  posdata base;
+  std::vector<long long> epoch;
+  std::vector<double> temp;
+  posbatch batch;
+};
+
+/* Row i of the batch under S_solpos with function */
+posdata Solpos(const posbatch &batch, int i, int function) {
+  posdata pd;
+  S_batch_row(&batch, i, &pd);
+  pd.function = function;
+  S_solpos(&pd);
+  return pd;
+}
+
+TEST(SelectTest, KeepsSunUpRowsWithTheirColumns) {
+  Day d;
+  std::vector<int> errors(144), rows(144);
+  std::vector<double> azim(144), elevref(144), etrtilt(144);
+  poscolumns out = {};
+  out.azim = azim.data();
+  out.elevref = elevref.data();
+  out.etrtilt = etrtilt.data();
+  posfilter filter = {S_KEEP_ELEVREF, 0.0, 0.0, 0.0};
+  int kept = -1;
+
+  ASSERT_EQ(S_solpos_select(&d.batch, &filter, errors.data(), &out,
+                            rows.data(), &kept),
+            0);
+  ASSERT_GT(kept, 60);
+  ASSERT_LT(kept, 84);
+
+  const int function = S_EPOCH | ((S_SOLAZM | S_REFRAC | S_TILT | S_ETR) &
+                                  ~L_DOY);
+  int k = 0;
+  for (int i = 0; i < 144; ++i) {
+    EXPECT_EQ(errors[i], 0);
+    posdata pd = Solpos(d.batch, i, function);
+    if (pd.elevref <= 0.0) continue;
+    ASSERT_LT(k, kept);
+    EXPECT_EQ(rows[k], i);
+    EXPECT_EQ(azim[k], pd.azim) << "row " << i;
+    EXPECT_EQ(elevref[k], pd.elevref) << "row " << i;
+    EXPECT_EQ(etrtilt[k], pd.etrtilt) << "row " << i;
+    ++k;
+  }
+  EXPECT_EQ(k, kept);
+}
+
+TEST(SelectTest, TestsCombineAndSkipErrorRows) {
+  Day d;
+  d.temp[70] = 150.0; /* bad only for refraction */
+  std::vector<int> errors(144), rows(144);
+  std::vector<double> cosinc(144), amass(144);
+  poscolumns out = {};
+  out.cosinc = cosinc.data();
+  out.amass = amass.data();
+  posfilter filter = {S_KEEP_ELEVETR | S_KEEP_COSINC, 10.0, 0.0, 0.5};
+  int kept = -1;
+
+  EXPECT_EQ(S_solpos_select(&d.batch, &filter, errors.data(), &out,
+                            rows.data(), &kept),
+            1L << S_TEMP_ERROR);
+  EXPECT_EQ(errors[70], 1L << S_TEMP_ERROR);
+  ASSERT_GT(kept, 0);
+
+  const int function = S_EPOCH | ((S_ZENETR | S_TILT | S_AMASS) & ~L_DOY);
+  int k = 0;
+  for (int i = 0; i < 144; ++i) {
+    if (i == 70) continue;
+    posdata pd = Solpos(d.batch, i, function);
+    if (pd.elevetr <= 10.0 || pd.cosinc <= 0.5) continue;
+    ASSERT_LT(k, kept);
+    EXPECT_EQ(rows[k], i);
+    EXPECT_EQ(cosinc[k], pd.cosinc) << "row " << i;
+    EXPECT_EQ(amass[k], pd.amass) << "row " << i;
+    ++k;
+  }
+  EXPECT_EQ(k, kept);
+  for (int j = 0; j < kept; ++j) EXPECT_NE(rows[j], 70);
+}
+
+TEST(SelectTest, NoTestsKeepsEveryValidRow) {
+  Day d;
+  d.temp[3] = -150.0;
+  std::vector<int> errors(144);
+  std::vector<double> declin(144);
+  poscolumns out = {};
+  out.declin = declin.data();
+  posfilter filter = {0, 0.0, 0.0, 0.0};
+  int kept = -1;
+
+  /* declin needs no refraction, so the bad temperature is not checked */
+  EXPECT_EQ(S_solpos_select(&d.batch, &filter, errors.data(), &out, nullptr,
+                            &kept),
+            0);
+  ASSERT_EQ(kept, 144);
+  for (int i = 0; i < 144; ++i)
+    EXPECT_EQ(declin[i], Solpos(d.batch, i, S_EPOCH | S_GEOM).declin);
+}
+
+}  // namespace
+}  // namespace solpos
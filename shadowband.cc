@@ -0,0 +1,109 @@
+/*============================================================================
+ *    Contains:
+ *        S_sbcf_init, S_sbcf_day, S_sbcf_apply
+ *----------------------------------------------------------------------------*/
+#include "shadowband.h"
+
+#include <climits>
+#include <cmath>
+#include <limits>
+
+namespace solpos {
+
+/*============================================================================
+*    Local constants and function prototypes
+============================================================================*/
+static const long long kSecondsPerDay = 86400;
+static const long long kNoDay = LLONG_MIN;
+
+static long long offset_seconds(const sbcfcache *cache);
+static long long local_day(long long epoch, long long offset);
+static double day_factor(sbcfcache *cache, long long day);
+
+/*============================================================================
+ *    Local long long function offset_seconds
+ *
+ *    The site's standard time zone, in seconds east
+ *----------------------------------------------------------------------------*/
+static long long offset_seconds(const sbcfcache *cache) {
+  return std::llround(cache->site.timezone * 3600.0);
+}
+
+/*============================================================================
+ *    Local long long function local_day
+ *
+ *    Days since 1 JAN 1970 of Unix time epoch on the local standard clock
+ *----------------------------------------------------------------------------*/
+static long long local_day(long long epoch, long long offset) {
+  long long local = epoch + offset;
+  long long day = local / kSecondsPerDay;
+  return day - (local % kSecondsPerDay < 0);
+}
+
+/*============================================================================
+ *    Local double function day_factor
+ *
+ *    The correction factor of local day, from the cache or S_solpos
+ *----------------------------------------------------------------------------*/
+static double day_factor(sbcfcache *cache, long long day) {
+  if (day == cache->day) return cache->sbcf;
+
+  posdata pd = cache->site;
+  pd.function = S_SBCF | S_EPOCH;
+  pd.epoch = day * kSecondsPerDay + kSecondsPerDay / 2 - offset_seconds(cache);
+  pd.epochfrac = 0.0;
+  pd.interval = 0;
+
+  cache->day = day;
+  cache->sbcf = S_solpos(&pd) == 0 ? pd.sbcf
+                                   : std::numeric_limits<double>::quiet_NaN();
+  return cache->sbcf;
+}
+
+/*============================================================================
+ *    Void function S_sbcf_init
+ *----------------------------------------------------------------------------*/
+void S_sbcf_init(const posdata *site, sbcfcache *cache) {
+  S_init(&cache->site);
+  cache->site.latitude = site->latitude;
+  cache->site.longitude = site->longitude;
+  cache->site.timezone = site->timezone;
+  cache->site.press = site->press;
+  cache->site.temp = site->temp;
+  cache->site.sbwid = site->sbwid;
+  cache->site.sbrad = site->sbrad;
+  cache->site.sbsky = site->sbsky;
+  cache->day = kNoDay;
+  cache->sbcf = std::numeric_limits<double>::quiet_NaN();
+}
+
+/*============================================================================
+ *    Double function S_sbcf_day
+ *----------------------------------------------------------------------------*/
+double S_sbcf_day(sbcfcache *cache, long long epoch) {
+  return day_factor(cache, local_day(epoch, offset_seconds(cache)));
+}
+
+/*============================================================================
+ *    Void function S_sbcf_apply
+ *----------------------------------------------------------------------------*/
+void S_sbcf_apply(sbcfcache *cache, int count, const long long *epoch,
+                  const double *raw, double *corrected) {
+  long long offset = offset_seconds(cache);
+  int i = 0;
+
+  while (i < count) {
+    long long day = local_day(epoch[i], offset);
+    long long start = day * kSecondsPerDay - offset;
+    long long end = start + kSecondsPerDay;
+    double factor = day_factor(cache, day);
+
+    /* the rest of this day's run, then one multiply loop over it */
+    int j = i + 1;
+    while (j < count && epoch[j] >= start && epoch[j] < end) ++j;
+    for (int k = i; k < j; ++k) corrected[k] = raw[k] * factor;
+    i = j;
+  }
+}
+
+}  // namespace solpos
@@ -0,0 +1,64 @@
+/*============================================================================
+ *
+ *    NAME:  shadowband.h
+ *
+ *    Contains:
+ *        S_sbcf_init   (prepares a per-site shadowband correction cache)
+ *        S_sbcf_day    (the correction factor of one day)
+ *        S_sbcf_apply  (corrects a column of diffuse readings taken under
+ *                       a shadowband or by a rotating shadowband radiometer)
+ *
+ *    The Drummond correction depends only on latitude, declination and the
+ *    sunset hour angle, so it is one number per site and day.  The cache
+ *    computes it with S_solpos (S_SBCF stages, at local standard noon) the
+ *    first time a day is seen and reuses it for every reading of that day;
+ *    runs of readings from the same day are scaled in a single loop.
+ *
+ *    S_solpos evaluates the declination at each timestamp, so its sbcf
+ *    drifts within a day by up to a few parts in 10^4; the cached value is
+ *    the one at noon.
+ *
+ *    Keep one sbcfcache per site.
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_SHADOWBAND_H_
+#define SOLPOS_SHADOWBAND_H_
+
+#include "solpos.h"
+
+namespace solpos {
+
+struct sbcfcache {
+  posdata site;    /* Site, time zone and shadowband geometry */
+  long long day;   /* Cached local day, days since 1 JAN 1970 */
+  double sbcf;     /* Its correction factor (NaN if out of range) */
+};
+
+/*============================================================================
+ *    Void function S_sbcf_init
+ *
+ *    Copies latitude, longitude, timezone, sbwid, sbrad, sbsky (and press
+ *    and temp) from site into an empty cache.
+ *----------------------------------------------------------------------------*/
+void S_sbcf_init(const posdata *site, sbcfcache *cache);
+
+/*============================================================================
+ *    Double function S_sbcf_day
+ *
+ *    RETURNS: The correction factor for the local standard day containing
+ *             Unix time epoch, or NaN if S_solpos rejects the site or day
+ *----------------------------------------------------------------------------*/
+double S_sbcf_day(sbcfcache *cache, long long epoch);
+
+/*============================================================================
+ *    Void function S_sbcf_apply
+ *
+ *    corrected[i] = raw[i] * the correction factor of the day of epoch[i]
+ *    (Unix times, best in ascending order; corrected may be raw)
+ *----------------------------------------------------------------------------*/
+void S_sbcf_apply(sbcfcache *cache, int count, const long long *epoch,
+                  const double *raw, double *corrected);
+
+}  // namespace solpos
+
+#endif  // SOLPOS_SHADOWBAND_H_
@@ -0,0 +1,89 @@
+#include "shadowband.h"
+
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace solpos {
+namespace {
+
+/* Atlanta, GA, as in solpos_test */
+void InitAtlanta(posdata *pdat) {
+  S_init(pdat);
+  pdat->longitude = -84.43;
+  pdat->latitude = 33.65;
+  pdat->timezone = -5.0;
+}
+
+TEST(ShadowbandTest, MatchesSolposThroughTheDay) {
+  posdata site;
+  InitAtlanta(&site);
+  sbcfcache cache;
+  S_sbcf_init(&site, &cache);
+
+  /* 22 JUL 1999 in local standard time, every 20 minutes */
+  long long midnight = S_epoch(1999, 7, 22, 0, 0, 0, -5.0);
+  double noon = S_sbcf_day(&cache, midnight + 43200);
+  EXPECT_NEAR(noon, 1.201910, 1e-4);
+  for (int s = 0; s < 86400; s += 1200) {
+    posdata pd = site;
+    pd.function = S_SBCF | S_EPOCH;
+    pd.epoch = midnight + s;
+    ASSERT_EQ(S_solpos(&pd), 0);
+    EXPECT_NEAR(S_sbcf_day(&cache, pd.epoch), pd.sbcf, 3e-4 * pd.sbcf);
+    EXPECT_EQ(S_sbcf_day(&cache, pd.epoch), noon);
+  }
+
+  /* the next local day is a different one */
+  EXPECT_NE(S_sbcf_day(&cache, midnight + 86400), noon);
+  EXPECT_EQ(S_sbcf_day(&cache, midnight - 1),
+            S_sbcf_day(&cache, midnight - 86400));
+}
+
+TEST(ShadowbandTest, ApplyAcrossDays) {
+  posdata site;
+  InitAtlanta(&site);
+  sbcfcache cache, check;
+  S_sbcf_init(&site, &cache);
+  S_sbcf_init(&site, &check);
+
+  /* three days at 10-second resolution, with one reading out of order */
+  long long start = S_epoch(2010, 12, 30, 12, 0, 0, -5.0);
+  std::vector<long long> epoch;
+  std::vector<double> raw;
+  for (long long t = start; t < start + 3 * 86400; t += 10) {
+    epoch.push_back(t);
+    raw.push_back(100.0 + (t % 97));
+  }
+  epoch[epoch.size() / 2] = start;
+
+  std::vector<double> corrected(raw.size());
+  S_sbcf_apply(&cache, static_cast<int>(raw.size()), epoch.data(), raw.data(),
+               corrected.data());
+  for (size_t i = 0; i < raw.size(); ++i)
+    ASSERT_EQ(corrected[i], raw[i] * S_sbcf_day(&check, epoch[i]))
+        << "row " << i;
+
+  /* in place */
+  S_sbcf_apply(&cache, static_cast<int>(raw.size()), epoch.data(), raw.data(),
+               raw.data());
+  EXPECT_EQ(raw, corrected);
+}
+
+TEST(ShadowbandTest, OutOfRange) {
+  posdata site;
+  InitAtlanta(&site);
+  sbcfcache cache;
+  S_sbcf_init(&site, &cache);
+
+  EXPECT_TRUE(std::isnan(S_sbcf_day(&cache, S_epoch(2051, 6, 1, 0, 0, 0, 0))));
+  EXPECT_FALSE(std::isnan(S_sbcf_day(&cache, S_epoch(2050, 6, 1, 0, 0, 0, 0))));
+
+  site.latitude = 95.0;
+  S_sbcf_init(&site, &cache);
+  EXPECT_TRUE(std::isnan(S_sbcf_day(&cache, S_epoch(2000, 6, 1, 0, 0, 0, 0))));
+}
+
+}  // namespace
+}  // namespace solpos
@@ -54,6 +54,10 @@
  *           INPUTS:     long integer S_solpos return value, posdata*
  *           OUTPUTS:    text to stderr
  *
+ *       S_decode_list, S_format_error, S_errstats_*
+ *                     (allocation-free alternatives to S_decode for callers
+ *                      that check many rows or handle errors themselves)
+ *
  *    Usage:
  *         In calling program, just after other 'includes', insert:
  *
@@ -90,23 +94,14 @@
 #include <cmath>
 #include <cstdio>
 #include <cstring>
-#include <iostream>
+
+#include "solpos_internal.h"
+#include "solpos_stages.h"
 
 namespace solpos {
 
-/*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
- *
- * Structures defined for this module
- *
- *++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
-struct trigdata /* used to pass calculated values locally */
-{
-  double cd; /* cosine of the declination */
-  double ch; /* cosine of the hour angle */
-  double cl; /* cosine of the latitude */
-  double sd; /* sine of the declination */
-  double sl; /* sine of the latitude */
-};
+/* used to pass calculated values locally (see solpos_stages.h) */
+typedef internal::trigdata<double> trigdata;
 
 /*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
  *
@@ -118,6 +113,11 @@ static int month_days[2][13] = {
     {0, 0, 31, 60, 91, 121, 152, 182, 213, 244, 274, 305, 335}};
 /* cumulative number of days prior to beginning of month */
 
+static constexpr long long kSecondsPerDay = 86400;
+static constexpr long long kEpoch1950 = -631152000; /* 1 JAN 1950 00:00 */
+static constexpr long long kEpoch2051 = 2556144000; /* 1 JAN 2051 00:00 */
+static constexpr long long kEpochJ2000 = 946728000; /* 1 JAN 2000 12:00 */
+
 static constexpr double kRadiansToDegrees =
     180.0 / M_PI; /* converts from radians to degrees */
 static constexpr double kDegreesToRadians =
@@ -126,22 +126,22 @@ static constexpr double kDegreesToRadians =
 /*============================================================================
 *    Local function prototypes
 ============================================================================*/
-static int validate(posdata *pdat);
 static void dom2doy(posdata *pdat);
 static void doy2dom(posdata *pdat);
+static void epoch2doy(posdata *pdat);
+static long long floor_div(long long num, long long den);
+static long long days_from_civil(int year, int month, int day);
+static void civil_from_days(long long days, int *year, int *month, int *day);
+static long long timezone_seconds(double timezone);
 static void geometry(posdata *pdat);
-static void zen_no_ref(posdata *pdat, trigdata *tdat);
+static void stages(posdata *pdat, trigdata *tdat, bool closed);
 static void ssha(posdata *pdat, trigdata *tdat);
-static void sbcf(posdata *pdat, trigdata *tdat);
-static void tst(posdata *pdat);
+static void sbcf(posdata *pdat, trigdata *tdat, bool closed);
+static void tst(posdata *pdat, bool closed);
 static void srss(posdata *pdat);
-static void sazm(posdata *pdat, trigdata *tdat);
-static void refrac(posdata *pdat);
-static void amass(posdata *pdat);
+static void amass(posdata *pdat, bool closed);
 static void prime(posdata *pdat);
 static void etr(posdata *pdat);
-static void tilt(posdata *pdat);
-static void localtrig(posdata *pdat, trigdata *tdat);
 
 /*============================================================================
  *    Long integer function S_solpos, adapted from the VAX solar libraries
@@ -180,21 +180,30 @@ static void localtrig(posdata *pdat, trigdata *tdat);
 int S_solpos(posdata *pdat) {
   int retval;
 
-  trigdata trigdat, *tdat;
+  if ((retval = S_validate(pdat)) != 0) /* validate the inputs */
+    return retval;
 
-  tdat = &trigdat; /* point to the structure */
+  internal::compute(pdat);
+  return 0;
+}
 
-  /* initialize the trig structure */
-  tdat->sd = -999.0; /* flag to force calculation of trig data */
-  tdat->cd = 1.0;
-  tdat->ch = 1.0; /* set the rest of these to something safe */
-  tdat->cl = 1.0;
-  tdat->sl = 1.0;
+namespace internal {
 
-  if ((retval = validate(pdat)) != 0) /* validate the inputs */
-    return retval;
+/*============================================================================
+ *    Void function compute
+ *
+ *    Runs the functions selected by pdat->function on inputs that have
+ *    already been validated.  Shared by S_solpos and the batch entry points.
+ *----------------------------------------------------------------------------*/
+void compute(posdata *pdat) {
+  trigdata<double> trigdat, *tdat;
 
-  if (pdat->function & L_DOY)
+  tdat = &trigdat; /* point to the structure */
+  init_trig(tdat); /* initialize the trig structure */
+
+  if (pdat->function & S_EPOCH)
+    epoch2doy(pdat); /* convert input epoch to local date */
+  else if (pdat->function & L_DOY)
     doy2dom(pdat); /* convert input doy to month-day */
   else
     dom2doy(pdat); /* convert input month-day to doy */
@@ -202,42 +211,50 @@ int S_solpos(posdata *pdat) {
   if (pdat->function & L_GEOM)
     geometry(pdat); /* do basic geometry calculations */
 
-  if (pdat->function & L_ZENETR) /* etr at non-refracted zenith angle */
-    zen_no_ref(pdat, tdat);
-
-  if (pdat->function & L_SSHA) /* Sunset hour calculation */
-    ssha(pdat, tdat);
-
-  if (pdat->function & L_SBCF) /* Shadowband correction factor */
-    sbcf(pdat, tdat);
-
-  if (pdat->function & L_TST) /* true solar time */
-    tst(pdat);
+  stages(pdat, tdat, false);
+}
 
-  if (pdat->function & L_SRSS) /* sunrise/sunset calculations */
-    srss(pdat);
+/*============================================================================
+ *    Void function compute_local
+ *
+ *    Runs the functions selected by pdat->function on a pdat whose date
+ *    and S_GEOM terms through gmst already hold those of its epoch,
+ *    timezone and interval (from compute on another site sharing them):
+ *    only the hour angle and the stages after geometry are run.
+ *----------------------------------------------------------------------------*/
+void compute_local(posdata *pdat) {
+  trigdata<double> trigdat, *tdat;
 
-  if (pdat->function & L_SOLAZM) /* solar azimuth calculations */
-    sazm(pdat, tdat);
+  tdat = &trigdat; /* point to the structure */
+  init_trig(tdat); /* initialize the trig structure */
 
-  if (pdat->function & L_REFRAC) /* atmospheric refraction calculations */
-    refrac(pdat);
+  if (pdat->function & L_GEOM)
+    hour_angle(pdat); /* the site's end of the geometry */
 
-  if (pdat->function & L_AMASS) /* airmass calculations */
-    amass(pdat);
+  stages(pdat, tdat, false);
+}
 
-  if (pdat->function & L_PRIME) /* kt-prime/unprime calculations */
-    prime(pdat);
+/*============================================================================
+ *    Void function compute_realtime
+ *
+ *    As compute for an S_EPOCH | S_GEOM pdat, but with the closed forms of
+ *    the stages: no pow and no loops, so that the cost of a call does not
+ *    depend on its inputs.  Results agree with compute to a few ULPs.
+ *----------------------------------------------------------------------------*/
+void compute_realtime(posdata *pdat) {
+  trigdata<double> trigdat, *tdat;
 
-  if (pdat->function & L_ETR) /* ETR and ETRN (refracted) */
-    etr(pdat);
+  tdat = &trigdat; /* point to the structure */
+  init_trig(tdat); /* initialize the trig structure */
 
-  if (pdat->function & L_TILT) /* tilt calculations */
-    tilt(pdat);
+  epoch2doy(pdat); /* convert input epoch to local date */
+  geometry(pdat);  /* do basic geometry calculations */
 
-  return 0;
+  stages(pdat, tdat, true);
 }
 
+}  // namespace internal
+
 /*============================================================================
  *    Void function S_init
  *
@@ -264,6 +281,8 @@ void S_init(posdata *pdat) {
   pdat->month = -99;        /* Month number (Jan = 1, Feb = 2, etc.) */
   pdat->second = -99;       /* Second of minute, 0 - 59 */
   pdat->year = -99;         /* 4-digit year */
+  pdat->epoch = -9999999999LL; /* Unix time (year 1653) */
+  pdat->epochfrac = 0.0;       /* Fraction of a second added to epoch */
   pdat->interval = 0;       /* instantaneous measurement interval */
   pdat->aspect = 180.0;     /* Azimuth of panel surface (direction it
                                   faces) N=0, E=90, S=180, W=270 */
@@ -281,15 +300,26 @@ void S_init(posdata *pdat) {
 }
 
 /*============================================================================
- *    Local int function validate
+ *    Int function S_validate
  *
  *    Validates the input parameters
  *----------------------------------------------------------------------------*/
-static int validate(posdata *pdat) {
+int S_validate(const posdata *pdat) {
   int retval = 0; /* start with no errors */
 
   /* No absurd dates, please. */
-  if (pdat->function & L_GEOM) {
+  if ((pdat->function & L_GEOM) && (pdat->function & S_EPOCH)) {
+    /* The date and time are derived from epoch; only its year can be off */
+    long long local = pdat->epoch + timezone_seconds(pdat->timezone);
+
+    if ((local < kEpoch1950) || (local >= kEpoch2051)) {
+      retval |= (1L << S_YEAR_ERROR);
+    }
+
+    if (!((pdat->epochfrac >= 0.0) && (pdat->epochfrac < 1.0))) {
+      retval |= (1L << S_SECOND_ERROR);
+    }
+  } else if (pdat->function & L_GEOM) {
     if ((pdat->year < 1950) || (pdat->year > 2050)) { /* limits of algoritm */
       retval |= (1L << S_YEAR_ERROR);
     }
@@ -326,7 +356,10 @@ static int validate(posdata *pdat) {
 
     if ((pdat->hour == 24) && (pdat->second > 0)) /* no more than 24 hrs */
       retval |= ((1L << S_HOUR_ERROR) | (1L << S_SECOND_ERROR));
+  }
 
+  /* No absurd time zones, intervals or locations, please. */
+  if (pdat->function & L_GEOM) {
     if (std::abs(pdat->timezone) > 12.0) {
       retval |= (1L << S_TZONE_ERROR);
     }
@@ -441,21 +474,122 @@ static void doy2dom(posdata *pdat) {
   pdat->day = pdat->daynum - month_days[leap][imon];
 }
 
+/*============================================================================
+ *    Local void function epoch2doy
+ *
+ *    This function computes the local standard date (and, for L_TST, the
+ *    time of day) from Unix time.
+ *
+ *    Requires (from posdata parameter):
+ *            epoch
+ *            timezone
+ *
+ *    Returns (via the posdata parameter):
+ *            year, month, day, daynum
+ *            hour, minute, second (only with L_TST)
+ *----------------------------------------------------------------------------*/
+static void epoch2doy(posdata *pdat) {
+  long long local; /* seconds since 1 JAN 1970, local standard time */
+  long long days;  /* days since 1 JAN 1970, local standard time */
+  int leap;        /* leap year switch */
+  int seconds;     /* seconds since local midnight */
+
+  local = pdat->epoch + timezone_seconds(pdat->timezone);
+  days = floor_div(local, kSecondsPerDay);
+  civil_from_days(days, &pdat->year, &pdat->month, &pdat->day);
+
+  leap = ((pdat->year % 4) == 0) &&
+         (((pdat->year % 100) != 0) || ((pdat->year % 400) == 0));
+  pdat->daynum = pdat->day + month_days[leap][pdat->month];
+
+  if (pdat->function & L_TST) {
+    seconds = static_cast<int>(local - days * kSecondsPerDay);
+    pdat->hour = seconds / 3600;
+    pdat->minute = seconds / 60 % 60;
+    pdat->second = seconds % 60;
+  }
+}
+
+/*============================================================================
+ *    Local long long function floor_div
+ *
+ *    Integer division rounding toward negative infinity (den > 0)
+ *----------------------------------------------------------------------------*/
+static long long floor_div(long long num, long long den) {
+  long long quot = num / den;
+
+  if ((num % den) < 0) --quot;
+  return quot;
+}
+
+/*============================================================================
+ *    Local long long function days_from_civil
+ *
+ *    Days since 1 JAN 1970 of a proleptic Gregorian date.
+ *       Hinnant, H.  2013.  chrono-Compatible Low-Level Date Algorithms.
+ *----------------------------------------------------------------------------*/
+static long long days_from_civil(int year, int month, int day) {
+  long long y = year - (month <= 2);
+  long long era = floor_div(y, 400);
+  long long yoe = y - era * 400; /* year of era, [0, 399] */
+  long long doy = (153 * (month + (month > 2 ? -3 : 9)) + 2) / 5 + day - 1;
+  long long doe = yoe * 365 + yoe / 4 - yoe / 100 + doy; /* [0, 146096] */
+
+  return era * 146097 + doe - 719468;
+}
+
+/*============================================================================
+ *    Local void function civil_from_days
+ *
+ *    Inverse of days_from_civil
+ *----------------------------------------------------------------------------*/
+static void civil_from_days(long long days, int *year, int *month, int *day) {
+  long long z = days + 719468;
+  long long era = floor_div(z, 146097);
+  long long doe = z - era * 146097; /* day of era, [0, 146096] */
+  long long yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+  long long doy = doe - (365 * yoe + yoe / 4 - yoe / 100); /* from 1 MAR */
+  long long mp = (5 * doy + 2) / 153; /* month from March, [0, 11] */
+
+  *day = static_cast<int>(doy - (153 * mp + 2) / 5 + 1);
+  *month = static_cast<int>(mp < 10 ? mp + 3 : mp - 9);
+  *year = static_cast<int>(yoe + era * 400 + (*month <= 2));
+}
+
+/*============================================================================
+ *    Local long long function timezone_seconds
+ *
+ *    Time zone offset rounded to whole seconds
+ *----------------------------------------------------------------------------*/
+static long long timezone_seconds(double timezone) {
+  return std::llround(timezone * 3600.0);
+}
+
+/*============================================================================
+ *    Long long function S_epoch
+ *----------------------------------------------------------------------------*/
+long long S_epoch(int year, int month, int day, int hour, int minute,
+                  int second, double timezone) {
+  return days_from_civil(year, month, day) * kSecondsPerDay + hour * 3600LL +
+         minute * 60LL + second - timezone_seconds(timezone);
+}
+
 /*============================================================================
  *    Local Void function geometry
  *
  *    Does the underlying geometry for a given time and location
  *----------------------------------------------------------------------------*/
 static void geometry(posdata *pdat) {
-  double bottom; /* denominator (bottom) of the fraction */
   double c2;     /* cosine of d2 */
   double cd;     /* cosine of the day angle or delination */
   double d2;     /* pdat->dayang times two */
   double delta;  /* difference between current year and 1949 */
   double s2;     /* sine of d2 */
   double sd;     /* sine of the day angle */
-  double top;    /* numerator (top) of the fraction */
+  double sec;    /* fractional seconds less half the interval */
   int leap;      /* leap year counter */
+  long long days;  /* whole days since noon 1 JAN 2000 */
+  long long local; /* seconds since local standard midnight */
 
   /* Day angle */
   /*  Iqbal, M.  1983.  An Introduction to Solar Radiation.
@@ -474,155 +608,93 @@ static void geometry(posdata *pdat) {
   pdat->erv = 1.000110 + 0.034221 * cd + 0.001280 * sd;
   pdat->erv += 0.000719 * c2 + 0.000077 * s2;
 
-  /* Universal Coordinated (Greenwich standard) time */
-  /*  Michalsky, J.  1988.  The Astronomical Almanac's algorithm for
-      approximate solar position (1950-2050).  Solar Energy 40 (3),
-      pp. 227-235. */
-  pdat->utime = pdat->hour * 3600.0 + pdat->minute * 60.0 + pdat->second -
-                (double)pdat->interval / 2.0;
-  pdat->utime = pdat->utime / 3600.0 - pdat->timezone;
-
-  /* Julian Day minus 2,400,000 days (to eliminate roundoff errors) */
-  /*  Michalsky, J.  1988.  The Astronomical Almanac's algorithm for
-      approximate solar position (1950-2050).  Solar Energy 40 (3),
-      pp. 227-235. */
-
-  /* No adjustment for century non-leap years since this function is
-     bounded by 1950 - 2050 */
-  delta = pdat->year - 1949;
-  leap = static_cast<int>(delta / 4.0);
-  pdat->julday =
-      32916.5 + delta * 365.0 + leap + pdat->daynum + pdat->utime / 24.0;
-
-  /* Time used in the calculation of ecliptic coordinates */
-  /* Noon 1 JAN 2000 = 2,400,000 + 51,545 days Julian Date */
-  /*  Michalsky, J.  1988.  The Astronomical Almanac's algorithm for
-      approximate solar position (1950-2050).  Solar Energy 40 (3),
-      pp. 227-235. */
-  pdat->ectime = pdat->julday - 51545.0;
-
-  /* Mean longitude */
-  /*  Michalsky, J.  1988.  The Astronomical Almanac's algorithm for
-      approximate solar position (1950-2050).  Solar Energy 40 (3),
-      pp. 227-235. */
-  pdat->mnlong = 280.460 + 0.9856474 * pdat->ectime;
-
-  /* (dump the multiples of 360, so the answer is between 0 and 360) */
-  pdat->mnlong -= 360.0 * static_cast<int>(pdat->mnlong / 360.0);
-  if (pdat->mnlong < 0.0) pdat->mnlong += 360.0;
-
-  /* Mean anomaly */
-  /*  Michalsky, J.  1988.  The Astronomical Almanac's algorithm for
-      approximate solar position (1950-2050).  Solar Energy 40 (3),
-      pp. 227-235. */
-  pdat->mnanom = 357.528 + 0.9856003 * pdat->ectime;
-
-  /* (dump the multiples of 360, so the answer is between 0 and 360) */
-  pdat->mnanom -= 360.0 * static_cast<int>(pdat->mnanom / 360.0);
-  if (pdat->mnanom < 0.0) pdat->mnanom += 360.0;
-
-  /* Ecliptic longitude */
-  /*  Michalsky, J.  1988.  The Astronomical Almanac's algorithm for
-      approximate solar position (1950-2050).  Solar Energy 40 (3),
-      pp. 227-235. */
-  pdat->eclong = pdat->mnlong +
-                 1.915 * std::sin(pdat->mnanom * kDegreesToRadians) +
-                 0.020 * sin(2.0 * pdat->mnanom * kDegreesToRadians);
-
-  /* (dump the multiples of 360, so the answer is between 0 and 360) */
-  pdat->eclong -= 360.0 * static_cast<int>(pdat->eclong / 360.0);
-  if (pdat->eclong < 0.0) pdat->eclong += 360.0;
-
-  /* Obliquity of the ecliptic */
-  /*  Michalsky, J.  1988.  The Astronomical Almanac's algorithm for
-      approximate solar position (1950-2050).  Solar Energy 40 (3),
-      pp. 227-235. */
-
-  /* 02 Feb 2001 SMW corrected sign in the following line */
-  /*  pdat->ecobli = 23.439 + 4.0e-07 * pdat->ectime;     */
-  pdat->ecobli = 23.439 - 4.0e-07 * pdat->ectime;
-
-  /* Declination */
-  /*  Michalsky, J.  1988.  The Astronomical Almanac's algorithm for
-      approximate solar position (1950-2050).  Solar Energy 40 (3),
-      pp. 227-235. */
-  pdat->declin =
-      kRadiansToDegrees * std::asin(std::sin(pdat->ecobli * kDegreesToRadians) *
-                                    std::sin(pdat->eclong * kDegreesToRadians));
-
-  /* Right ascension */
-  /*  Michalsky, J.  1988.  The Astronomical Almanac's algorithm for
-      approximate solar position (1950-2050).  Solar Energy 40 (3),
-      pp. 227-235. */
-  top = std::cos(kDegreesToRadians * pdat->ecobli) *
-        std::sin(kDegreesToRadians * pdat->eclong);
-  bottom = std::cos(kDegreesToRadians * pdat->eclong);
-
-  pdat->rascen = kRadiansToDegrees * atan2(top, bottom);
-
-  /* (make it a positive angle) */
-  if (pdat->rascen < 0.0) pdat->rascen += 360.0;
-
-  /* Greenwich mean sidereal time */
-  /*  Michalsky, J.  1988.  The Astronomical Almanac's algorithm for
-      approximate solar position (1950-2050).  Solar Energy 40 (3),
-      pp. 227-235. */
-  pdat->gmst = 6.697375 + 0.0657098242 * pdat->ectime + pdat->utime;
-
-  /* (dump the multiples of 24, so the answer is between 0 and 24) */
-  pdat->gmst -= 24.0 * static_cast<int>(pdat->gmst / 24.0);
-  if (pdat->gmst < 0.0) pdat->gmst += 24.0;
-
-  /* Local mean sidereal time */
-  /*  Michalsky, J.  1988.  The Astronomical Almanac's algorithm for
-      approximate solar position (1950-2050).  Solar Energy 40 (3),
-      pp. 227-235. */
-  pdat->lmst = pdat->gmst * 15.0 + pdat->longitude;
-
-  /* (dump the multiples of 360, so the answer is between 0 and 360) */
-  pdat->lmst -= 360.0 * static_cast<int>(pdat->lmst / 360.0);
-  if (pdat->lmst < 0.0) pdat->lmst += 360.0;
-
-  /* Hour angle */
-  /*  Michalsky, J.  1988.  The Astronomical Almanac's algorithm for
-      approximate solar position (1950-2050).  Solar Energy 40 (3),
-      pp. 227-235. */
-  pdat->hrang = pdat->lmst - pdat->rascen;
-
-  /* (force it between -180 and 180 degrees) */
-  if (pdat->hrang < -180.0)
-    pdat->hrang += 360.0;
-  else if (pdat->hrang > 180.0)
-    pdat->hrang -= 360.0;
+  if (pdat->function & S_EPOCH) {
+    /* Time used in the calculation of ecliptic coordinates, as whole days
+       and seconds since noon 1 JAN 2000 so that no precision is lost */
+    sec = pdat->epochfrac - (double)pdat->interval / 2.0;
+    days = floor_div(pdat->epoch - kEpochJ2000, kSecondsPerDay);
+    pdat->ectime =
+        days + (pdat->epoch - kEpochJ2000 - days * kSecondsPerDay + sec) /
+                   86400.0;
+    pdat->julday = pdat->ectime + 51545.0;
+
+    /* Universal time, from local standard midnight as below */
+    local = pdat->epoch + timezone_seconds(pdat->timezone);
+    local -= floor_div(local, kSecondsPerDay) * kSecondsPerDay;
+    pdat->utime = (local + sec) / 3600.0 - pdat->timezone;
+  } else {
+    /* Universal Coordinated (Greenwich standard) time */
+    /*  Michalsky, J.  1988.  The Astronomical Almanac's algorithm for
+        approximate solar position (1950-2050).  Solar Energy 40 (3),
+        pp. 227-235. */
+    pdat->utime = pdat->hour * 3600.0 + pdat->minute * 60.0 + pdat->second -
+                  (double)pdat->interval / 2.0;
+    pdat->utime = pdat->utime / 3600.0 - pdat->timezone;
+
+    /* Julian Day minus 2,400,000 days (to eliminate roundoff errors) */
+    /*  Michalsky, J.  1988.  The Astronomical Almanac's algorithm for
+        approximate solar position (1950-2050).  Solar Energy 40 (3),
+        pp. 227-235. */
+
+    /* No adjustment for century non-leap years since this function is
+       bounded by 1950 - 2050 */
+    delta = pdat->year - 1949;
+    leap = static_cast<int>(delta / 4.0);
+    pdat->julday =
+        32916.5 + delta * 365.0 + leap + pdat->daynum + pdat->utime / 24.0;
+
+    /* Time used in the calculation of ecliptic coordinates */
+    /* Noon 1 JAN 2000 = 2,400,000 + 51,545 days Julian Date */
+    /*  Michalsky, J.  1988.  The Astronomical Almanac's algorithm for
+        approximate solar position (1950-2050).  Solar Energy 40 (3),
+        pp. 227-235. */
+    pdat->ectime = pdat->julday - 51545.0;
+  }
+
+  /* Ecliptic coordinates through hour angle */
+  internal::ecliptic(pdat);
 }
 
 /*============================================================================
- *    Local Void function zen_no_ref
+ *    Local Void function stages
  *
- *    ETR solar zenith angle
- *       Iqbal, M.  1983.  An Introduction to Solar Radiation.
- *            Academic Press, NY., page 15
+ *    The functions selected by pdat->function after the geometry; closed
+ *    picks the closed forms of sbcf, tst, refrac and amass (no pow, no
+ *    loops) for the real-time path over those of S_solpos
  *----------------------------------------------------------------------------*/
-static void zen_no_ref(posdata *pdat, trigdata *tdat) {
-  double cz; /* cosine of the solar zenith angle */
+static void stages(posdata *pdat, trigdata *tdat, bool closed) {
+  if (pdat->function & L_ZENETR) /* etr at non-refracted zenith angle */
+    internal::zen_no_ref(pdat, tdat);
 
-  localtrig(pdat, tdat);
-  cz = tdat->sd * tdat->sl + tdat->cd * tdat->cl * tdat->ch;
+  if (pdat->function & L_SSHA) /* Sunset hour calculation */
+    ssha(pdat, tdat);
 
-  /* (watch out for the roundoff errors) */
-  if (std::abs(cz) > 1.0) {
-    if (cz >= 0.0)
-      cz = 1.0;
-    else
-      cz = -1.0;
-  }
+  if (pdat->function & L_SBCF) /* Shadowband correction factor */
+    sbcf(pdat, tdat, closed);
 
-  pdat->zenetr = std::acos(cz) * kRadiansToDegrees;
+  if (pdat->function & L_TST) /* true solar time */
+    tst(pdat, closed);
 
-  /* (limit the degrees below the horizon to 9 [+90 -> 99]) */
-  if (pdat->zenetr > 99.0) pdat->zenetr = 99.0;
+  if (pdat->function & L_SRSS) /* sunrise/sunset calculations */
+    srss(pdat);
 
-  pdat->elevetr = 90.0 - pdat->zenetr;
+  if (pdat->function & L_SOLAZM) /* solar azimuth calculations */
+    internal::sazm(pdat, tdat);
+
+  if (pdat->function & L_REFRAC) /* atmospheric refraction calculations */
+    internal::refrac(pdat, closed);
+
+  if (pdat->function & L_AMASS) /* airmass calculations */
+    amass(pdat, closed);
+
+  if (pdat->function & L_PRIME) /* kt-prime/unprime calculations */
+    prime(pdat);
+
+  if (pdat->function & L_ETR) /* ETR and ETRN (refracted) */
+    etr(pdat);
+
+  if (pdat->function & L_TILT) /* tilt calculations */
+    internal::tilt(pdat);
 }
 
 /*============================================================================
@@ -636,7 +708,7 @@ static void ssha(posdata *pdat, trigdata *tdat) {
   double cssha; /* cosine of the sunset hour angle */
   double cdcl;  /* ( cd * cl ) */
 
-  localtrig(pdat, tdat);
+  internal::localtrig(pdat, tdat);
   cdcl = tdat->cd * tdat->cl;
 
   if (std::abs(cdcl) >= 0.001) {
@@ -663,11 +735,12 @@ static void ssha(posdata *pdat, trigdata *tdat) {
  *       Drummond, A. J.  1956.  A contribution to absolute pyrheliometry.
  *            Q. J. R. Meteorol. Soc. 82, pp. 481-493
  *----------------------------------------------------------------------------*/
-static void sbcf(posdata *pdat, trigdata *tdat) {
-  double p, t1, t2; /* used to compute sbcf */
+static void sbcf(posdata *pdat, trigdata *tdat, bool closed) {
+  double cd3, p, t1, t2; /* used to compute sbcf */
 
-  localtrig(pdat, tdat);
-  p = 0.6366198 * pdat->sbwid / pdat->sbrad * std::pow(tdat->cd, 3);
+  internal::localtrig(pdat, tdat);
+  cd3 = closed ? tdat->cd * tdat->cd * tdat->cd : std::pow(tdat->cd, 3);
+  p = 0.6366198 * pdat->sbwid / pdat->sbrad * cd3;
   t1 = tdat->sl * tdat->sd * pdat->ssha * kDegreesToRadians;
   t2 = tdat->cl * tdat->cd * std::sin(pdat->ssha * kDegreesToRadians);
   pdat->sbcf = pdat->sbsky + 1.0 / (1.0 - p * (t1 + t2));
@@ -681,16 +754,24 @@ static void sbcf(posdata *pdat, trigdata *tdat) {
  *        Iqbal, M.  1983.  An Introduction to Solar Radiation.
  *            Academic Press, NY., page 13
  *----------------------------------------------------------------------------*/
-static void tst(posdata *pdat) {
+static void tst(posdata *pdat, bool closed) {
   pdat->tst = (180.0 + pdat->hrang) * 4.0;
-  pdat->tstfix =
-      pdat->tst - (double)pdat->hour * 60.0 - pdat->minute -
-      (double)pdat->second / 60.0 +
-      (double)pdat->interval / 120.0; /* add back half of the interval */
-
-  /* bound tstfix to this day */
-  while (pdat->tstfix > 720.0) pdat->tstfix -= 1440.0;
-  while (pdat->tstfix < -720.0) pdat->tstfix += 1440.0;
+  if (pdat->function & S_EPOCH) /* keeps epochfrac; utime has the interval */
+    pdat->tstfix = pdat->tst - (pdat->utime + pdat->timezone) * 60.0;
+  else
+    pdat->tstfix =
+        pdat->tst - (double)pdat->hour * 60.0 - pdat->minute -
+        (double)pdat->second / 60.0 +
+        (double)pdat->interval / 120.0; /* add back half of the interval */
+
+  /* bound tstfix to this day; the closed form, in whole days at once,
+     bounds it to [-720, 720) */
+  if (closed) {
+    pdat->tstfix -= 1440.0 * std::floor((pdat->tstfix + 720.0) / 1440.0);
+  } else {
+    while (pdat->tstfix > 720.0) pdat->tstfix -= 1440.0;
+    while (pdat->tstfix < -720.0) pdat->tstfix += 1440.0;
+  }
 
   pdat->eqntim = pdat->tstfix + 60.0 * pdat->timezone - 4.0 * pdat->longitude;
 }
@@ -713,85 +794,6 @@ static void srss(posdata *pdat) {
   }
 }
 
-/*============================================================================
- *    Local Void function sazm
- *
- *    Solar azimuth angle
- *       Iqbal, M.  1983.  An Introduction to Solar Radiation.
- *            Academic Press, NY., page 15
- *----------------------------------------------------------------------------*/
-static void sazm(posdata *pdat, trigdata *tdat) {
-  double ca;   /* cosine of the solar azimuth angle */
-  double ce;   /* cosine of the solar elevation */
-  double cecl; /* ( ce * cl ) */
-  double se;   /* sine of the solar elevation */
-
-  localtrig(pdat, tdat);
-  ce = std::cos(kDegreesToRadians * pdat->elevetr);
-  se = std::sin(kDegreesToRadians * pdat->elevetr);
-
-  pdat->azim = 180.0;
-  cecl = ce * tdat->cl;
-  if (std::abs(cecl) >= 0.001) {
-    ca = (se * tdat->sl - tdat->sd) / cecl;
-    if (ca > 1.0)
-      ca = 1.0;
-    else if (ca < -1.0)
-      ca = -1.0;
-
-    pdat->azim = 180.0 - std::acos(ca) * kRadiansToDegrees;
-    if (pdat->hrang > 0) pdat->azim = 360.0 - pdat->azim;
-  }
-}
-
-/*============================================================================
- *    Local Int function refrac
- *
- *    Refraction correction, degrees
- *        Zimmerman, John C.  1981.  Sun-pointing programs and their
- *            accuracy.
- *            SAND81-0761, Experimental Systems Operation Division 4721,
- *            Sandia National Laboratories, Albuquerque, NM.
- *----------------------------------------------------------------------------*/
-static void refrac(posdata *pdat) {
-  double prestemp; /* temporary pressure/temperature correction */
-  double refcor;   /* temporary refraction correction */
-  double tanelev;  /* tangent of the solar elevation angle */
-
-  /* If the sun is near zenith, the algorithm bombs; refraction near 0 */
-  if (pdat->elevetr > 85.0) refcor = 0.0;
-
-  /* Otherwise, we have refraction */
-  else {
-    tanelev = std::tan(kDegreesToRadians * pdat->elevetr);
-    if (pdat->elevetr >= 5.0)
-      refcor = 58.1 / tanelev - 0.07 / (std::pow(tanelev, 3)) +
-               0.000086 / (std::pow(tanelev, 5));
-    else if (pdat->elevetr >= -0.575)
-      refcor =
-          1735.0 +
-          pdat->elevetr *
-              (-518.2 +
-               pdat->elevetr *
-                   (103.4 + pdat->elevetr * (-12.79 + pdat->elevetr * 0.711)));
-    else
-      refcor = -20.774 / tanelev;
-
-    prestemp = (pdat->press * 283.0) / (1013.0 * (273.0 + pdat->temp));
-    refcor *= prestemp / 3600.0;
-  }
-
-  /* Refracted solar elevation angle */
-  pdat->elevref = pdat->elevetr + refcor;
-
-  /* (limit the degrees below the horizon to 9) */
-  if (pdat->elevref < -9.0) pdat->elevref = -9.0;
-
-  /* Refracted solar zenith angle */
-  pdat->zenref = 90.0 - pdat->elevref;
-  pdat->coszen = std::cos(kDegreesToRadians * pdat->zenref);
-}
-
 /*============================================================================
  *    Local Void function  amass
  *
@@ -800,14 +802,16 @@ static void refrac(posdata *pdat) {
  *            tables and approximation formula.  Applied Optics 28 (22),
  *            pp. 4735-4738
  *----------------------------------------------------------------------------*/
-static void amass(posdata *pdat) {
+static void amass(posdata *pdat, bool closed) {
+  double coszen; /* cosine of the refracted zenith angle */
+
   if (pdat->zenref > 93.0) {
     pdat->amass = -1.0;
     pdat->ampress = -1.0;
   } else {
-    pdat->amass =
-        1.0 / (std::cos(kDegreesToRadians * pdat->zenref) +
-               0.50572 * std::pow((96.07995 - pdat->zenref), -1.6364));
+    coszen = std::cos(kDegreesToRadians * pdat->zenref);
+    pdat->amass = closed ? internal::air_mass_closed(pdat->zenref, coszen)
+                         : internal::air_mass(pdat->zenref, coszen);
 
     pdat->ampress = pdat->amass * pdat->press / 1013.0;
   }
@@ -824,7 +828,7 @@ static void amass(posdata *pdat) {
  *            insolation conditions. Solar Energy 45 (2), pp. 111-114
  *----------------------------------------------------------------------------*/
 static void prime(posdata *pdat) {
-  pdat->unprime = 1.031 * exp(-1.4 / (0.9 + 9.4 / pdat->amass)) + 0.1;
+  pdat->unprime = internal::unprime_factor(pdat->amass);
   pdat->prime = 1.0 / pdat->unprime;
 }
 
@@ -844,63 +848,82 @@ static void etr(posdata *pdat) {
 }
 
 /*============================================================================
- *    Local Void function localtrig
- *
- *    Does trig on internal variable used by several functions
- *----------------------------------------------------------------------------*/
-static void localtrig(posdata *pdat, trigdata *tdat) {
-/* define masks to prevent calculation of uninitialized variables */
-#define SD_MASK (L_ZENETR | L_SSHA | S_SBCF | S_SOLAZM)
-#define SL_MASK (L_ZENETR | L_SSHA | S_SBCF | S_SOLAZM)
-#define CL_MASK (L_ZENETR | L_SSHA | S_SBCF | S_SOLAZM)
-#define CD_MASK (L_ZENETR | L_SSHA | S_SBCF)
-#define CH_MASK (L_ZENETR)
-
-  if (tdat->sd < -900.0) /* sd was initialized -999 as flag */
-  {
-    tdat->sd = 1.0; /* reflag as having completed calculations */
-    if (pdat->function | CD_MASK)
-      tdat->cd = std::cos(kDegreesToRadians * pdat->declin);
-    if (pdat->function | CH_MASK)
-      tdat->ch = std::cos(kDegreesToRadians * pdat->hrang);
-    if (pdat->function | CL_MASK)
-      tdat->cl = std::cos(kDegreesToRadians * pdat->latitude);
-    if (pdat->function | SD_MASK)
-      tdat->sd = std::sin(kDegreesToRadians * pdat->declin);
-    if (pdat->function | SL_MASK)
-      tdat->sl = std::sin(kDegreesToRadians * pdat->latitude);
-  }
-}
+ *    Names of the input parameters, indexed by S_*_ERROR code
+ *----------------------------------------------------------------------------*/
+static const char *const error_names[S_ERROR_COUNT] = {
+    "year",
+    "month",
+    "day-of-month",
+    "day-of-year",
+    "hour",
+    "minute",
+    "second",
+    "time zone",
+    "interval",
+    "latitude",
+    "longitude",
+    "temperature",
+    "pressure",
+    "tilt",
+    "aspect",
+    "shadowband width",
+    "shadowband radius",
+    "shadowband sky factor",
+};
 
 /*============================================================================
- *    Local Void function tilt
- *
- *    ETR on a tilted surface
- *----------------------------------------------------------------------------*/
-static void tilt(posdata *pdat) {
-  double ca; /* cosine of the solar azimuth angle */
-  double cp; /* cosine of the panel aspect */
-  double ct; /* cosine of the panel tilt */
-  double sa; /* sine of the solar azimuth angle */
-  double sp; /* sine of the panel aspect */
-  double st; /* sine of the panel tilt */
-  double sz; /* sine of the refraction corrected solar zenith angle */
-
-  /* Cosine of the angle between the sun and a tipped flat surface,
-     useful for calculating solar energy on tilted surfaces */
-  ca = std::cos(kDegreesToRadians * pdat->azim);
-  cp = std::cos(kDegreesToRadians * pdat->aspect);
-  ct = std::cos(kDegreesToRadians * pdat->tilt);
-  sa = std::sin(kDegreesToRadians * pdat->azim);
-  sp = std::sin(kDegreesToRadians * pdat->aspect);
-  st = std::sin(kDegreesToRadians * pdat->tilt);
-  sz = std::sin(kDegreesToRadians * pdat->zenref);
-  pdat->cosinc = pdat->coszen * ct + sz * st * (ca * cp + sa * sp);
-
-  if (pdat->cosinc > 0.0)
-    pdat->etrtilt = pdat->etrn * pdat->cosinc;
-  else
-    pdat->etrtilt = 0.0;
+ *    Local int function format_line
+ *
+ *    Writes the S_decode line for a single error code (snprintf semantics)
+ *----------------------------------------------------------------------------*/
+static int format_line(int error, const posdata *pdat, char *buf, int size) {
+  static const char kPrefix[] = "S_decode ==> Please fix the";
+  const char *name = error_names[error];
+
+  switch (error) {
+    case S_YEAR_ERROR:
+      return snprintf(buf, size, "%s %s: %d [1950-2050]\n", kPrefix, name,
+                      pdat->year);
+    case S_MONTH_ERROR:
+      return snprintf(buf, size, "%s %s: %d\n", kPrefix, name, pdat->month);
+    case S_DAY_ERROR:
+      return snprintf(buf, size, "%s %s: %d\n", kPrefix, name, pdat->day);
+    case S_DOY_ERROR:
+      return snprintf(buf, size, "%s %s: %d\n", kPrefix, name, pdat->daynum);
+    case S_HOUR_ERROR:
+      return snprintf(buf, size, "%s %s: %d\n", kPrefix, name, pdat->hour);
+    case S_MINUTE_ERROR:
+      return snprintf(buf, size, "%s %s: %d\n", kPrefix, name, pdat->minute);
+    case S_SECOND_ERROR:
+      return snprintf(buf, size, "%s %s: %d\n", kPrefix, name, pdat->second);
+    case S_TZONE_ERROR:
+      return snprintf(buf, size, "%s %s: %g\n", kPrefix, name,
+                      pdat->timezone);
+    case S_INTRVL_ERROR:
+      return snprintf(buf, size, "%s %s: %d\n", kPrefix, name,
+                      pdat->interval);
+    case S_LAT_ERROR:
+      return snprintf(buf, size, "%s %s: %g\n", kPrefix, name,
+                      pdat->latitude);
+    case S_LON_ERROR:
+      return snprintf(buf, size, "%s %s: %g\n", kPrefix, name,
+                      pdat->longitude);
+    case S_TEMP_ERROR:
+      return snprintf(buf, size, "%s %s: %g\n", kPrefix, name, pdat->temp);
+    case S_PRESS_ERROR:
+      return snprintf(buf, size, "%s %s: %g\n", kPrefix, name, pdat->press);
+    case S_TILT_ERROR:
+      return snprintf(buf, size, "%s %s: %g\n", kPrefix, name, pdat->tilt);
+    case S_ASPECT_ERROR:
+      return snprintf(buf, size, "%s %s: %g\n", kPrefix, name, pdat->aspect);
+    case S_SBWID_ERROR:
+      return snprintf(buf, size, "%s %s: %g\n", kPrefix, name, pdat->sbwid);
+    case S_SBRAD_ERROR:
+      return snprintf(buf, size, "%s %s: %g\n", kPrefix, name, pdat->sbrad);
+    case S_SBSKY_ERROR:
+      return snprintf(buf, size, "%s %s: %g\n", kPrefix, name, pdat->sbsky);
+  }
+  return 0;
 }
 
 /*============================================================================
@@ -910,80 +933,120 @@ static void tilt(posdata *pdat) {
  *
  *    Requires the long integer return value from S_solpos
  *
- *    Returns descriptive text to stderr
+ *    Returns descriptive text to stderr (in a single write)
  *----------------------------------------------------------------------------*/
 void S_decode(int code, posdata *pdat) {
-  if (code & (1L << S_YEAR_ERROR)) {
-    std::cerr << "S_decode ==> Please fix the year: " << pdat->year
-              << " [1950-2050]" << std::endl;
-  }
-  if (code & (1L << S_MONTH_ERROR)) {
-    std::cerr << "S_decode ==> Please fix the month: " << pdat->month
-              << std::endl;
-  }
-  if (code & (1L << S_DAY_ERROR)) {
-    std::cerr << "S_decode ==> Please fix the day-of-month: " << pdat->day
-              << std::endl;
-  }
-  if (code & (1L << S_DOY_ERROR)) {
-    std::cerr << "S_decode ==> Please fix the day-of-year: " << pdat->daynum
-              << std::endl;
-  }
-  if (code & (1L << S_HOUR_ERROR)) {
-    std::cerr << "S_decode ==> Please fix the hour: " << pdat->hour
-              << std::endl;
-  }
-  if (code & (1L << S_MINUTE_ERROR)) {
-    std::cerr << "S_decode ==> Please fix the minute: " << pdat->minute
-              << std::endl;
-  }
-  if (code & (1L << S_SECOND_ERROR)) {
-    std::cerr << "S_decode ==> Please fix the second: " << pdat->second
-              << std::endl;
-  }
-  if (code & (1L << S_TZONE_ERROR)) {
-    std::cerr << "S_decode ==> Please fix the time zone: " << pdat->timezone
-              << std::endl;
-  }
-  if (code & (1L << S_INTRVL_ERROR)) {
-    std::cerr << "S_decode ==> Please fix the interval: " << pdat->interval
-              << std::endl;
-  }
-  if (code & (1L << S_LAT_ERROR)) {
-    std::cerr << "S_decode ==> Please fix the latitude: " << pdat->latitude
-              << std::endl;
-  }
-  if (code & (1L << S_LON_ERROR)) {
-    std::cerr << "S_decode ==> Please fix the longitude: " << pdat->longitude
-              << std::endl;
-  }
-  if (code & (1L << S_TEMP_ERROR)) {
-    std::cerr << "S_decode ==> Please fix the temperature: " << pdat->temp
-              << std::endl;
-  }
-  if (code & (1L << S_PRESS_ERROR)) {
-    std::cerr << "S_decode ==> Please fix the pressure: " << pdat->press
-              << std::endl;
-  }
-  if (code & (1L << S_TILT_ERROR)) {
-    std::cerr << "S_decode ==> Please fix the tilt: " << pdat->tilt
-              << std::endl;
+  char buf[S_ERROR_COUNT * 80]; /* longest line is well under 80 chars */
+
+  if (code == 0) return;
+  S_format_error(code, pdat, buf, sizeof(buf));
+  fputs(buf, stderr);
+}
+
+/*============================================================================
+ *    Int function S_decode_list
+ *
+ *    Lists the error codes set in the S_solpos return value
+ *----------------------------------------------------------------------------*/
+int S_decode_list(int code, int *errors, int max_errors) {
+  int count = 0;
+
+  for (int error = 0; error < S_ERROR_COUNT; ++error) {
+    if (code & (1L << error)) {
+      if (count < max_errors) errors[count] = error;
+      ++count;
+    }
   }
-  if (code & (1L << S_ASPECT_ERROR)) {
-    std::cerr << "S_decode ==> Please fix the aspect: " << pdat->aspect
-              << std::endl;
+  return count;
+}
+
+/*============================================================================
+ *    Const char* function S_error_name
+ *----------------------------------------------------------------------------*/
+const char *S_error_name(int error) {
+  if ((error < 0) || (error >= S_ERROR_COUNT)) return "unknown";
+  return error_names[error];
+}
+
+/*============================================================================
+ *    Int function S_format_error
+ *
+ *    Formats the S_decode text into buf without allocating
+ *----------------------------------------------------------------------------*/
+int S_format_error(int code, const posdata *pdat, char *buf, int size) {
+  int len = 0; /* length of the full text so far */
+
+  if (size > 0) buf[0] = '\0';
+  for (int error = 0; error < S_ERROR_COUNT; ++error) {
+    if (code & (1L << error)) {
+      if (len < size)
+        len += format_line(error, pdat, buf + len, size - len);
+      else
+        len += format_line(error, pdat, nullptr, 0);
+    }
   }
-  if (code & (1L << S_SBWID_ERROR)) {
-    std::cerr << "S_decode ==> Please fix the shadowband width: " << pdat->sbwid
-              << std::endl;
+  return len;
+}
+
+/*============================================================================
+ *    Local void function keep_lowest
+ *
+ *    Inserts row into the ascending list of the (at most S_ERRSTATS_ROWS)
+ *    lowest row indices, of which kept are currently valid
+ *----------------------------------------------------------------------------*/
+static void keep_lowest(long long *first, long long kept, long long row) {
+  int i;
+
+  if (kept > S_ERRSTATS_ROWS) kept = S_ERRSTATS_ROWS;
+  if ((kept == S_ERRSTATS_ROWS) && (row >= first[kept - 1])) return;
+
+  /* (rows normally arrive in order, so this loop rarely runs) */
+  i = (kept < S_ERRSTATS_ROWS) ? static_cast<int>(kept) : S_ERRSTATS_ROWS - 1;
+  while ((i > 0) && (first[i - 1] > row)) {
+    first[i] = first[i - 1];
+    --i;
   }
-  if (code & (1L << S_SBRAD_ERROR)) {
-    std::cerr << "S_decode ==> Please fix the shadowband radius: "
-              << pdat->sbrad << std::endl;
+  first[i] = row;
+}
+
+/*============================================================================
+ *    Void function S_errstats_init
+ *----------------------------------------------------------------------------*/
+void S_errstats_init(errstats *stats) { memset(stats, 0, sizeof(*stats)); }
+
+/*============================================================================
+ *    Void function S_errstats_add
+ *
+ *    Counts one row; the error bits are only examined for bad rows
+ *----------------------------------------------------------------------------*/
+void S_errstats_add(errstats *stats, int code, long long row) {
+  ++stats->rows;
+  if (code == 0) return;
+
+  ++stats->bad_rows;
+  for (int error = 0; error < S_ERROR_COUNT; ++error) {
+    if (code & (1L << error)) {
+      keep_lowest(stats->first[error], stats->count[error], row);
+      ++stats->count[error];
+    }
   }
-  if (code & (1L << S_SBSKY_ERROR)) {
-    std::cerr << "S_decode ==> Please fix the shadowband sky factor: "
-              << pdat->sbsky << std::endl;
+}
+
+/*============================================================================
+ *    Void function S_errstats_merge
+ *----------------------------------------------------------------------------*/
+void S_errstats_merge(errstats *stats, const errstats *from) {
+  stats->rows += from->rows;
+  stats->bad_rows += from->bad_rows;
+  for (int error = 0; error < S_ERROR_COUNT; ++error) {
+    long long n = from->count[error];
+
+    if (n > S_ERRSTATS_ROWS) n = S_ERRSTATS_ROWS;
+    for (long long i = 0; i < n; ++i) {
+      keep_lowest(stats->first[error], stats->count[error] + i,
+                  from->first[error][i]);
+    }
+    stats->count[error] += from->count[error];
   }
 }
 
@@ -8,6 +8,8 @@
  *            INPUTS:     (from posdata)
  *                          year, month, day, hour, minute, second,
  *                          latitude, longitude, timezone, interval
+ *                          (epoch, epochfrac replace the date and time
+ *                           when the S_EPOCH switch is set)
  *            OPTIONAL:   (from posdata; defaults from S_init function)
  *                            press   DEFAULT 1013.0 (standard pressure)
  *                            temp    DEFAULT   10.0 (standard temperature)
@@ -32,6 +34,8 @@
  *    National Renewable Energy Laboratory
  *    25 March 1998
  *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_H_
+#define SOLPOS_H_
 
 namespace solpos {
 
@@ -55,6 +59,9 @@ namespace solpos {
 #define L_ETR 0x1000
 #define L_ALL 0xFFFF
 
+/* Input mode switch, outside L_ALL (see S_EPOCH in posdata below) */
+#define S_EPOCH 0x10000
+
 /*============================================================================
  *
  *     Define the bit-wise masks for each function
@@ -101,8 +108,9 @@ enum {
   S_ASPECT_ERROR, /* 14   aspect                -360 -   360   */
   S_SBWID_ERROR,  /* 15   shadow band width (cm)   1 -   100   */
   S_SBRAD_ERROR,  /* 16   shadow band radius (cm)  1 -   100   */
-  S_SBSKY_ERROR
-}; /* 17   shadow band sky factor  -1 -     1   */
+  S_SBSKY_ERROR,  /* 17   shadow band sky factor  -1 -     1   */
+  S_ERROR_COUNT   /*      number of error codes above         */
+};
 
 struct posdata {
   /***** ALPHABETICAL LIST OF COMMON VARIABLES *****/
@@ -137,6 +145,14 @@ struct posdata {
          pdat->function |= S_DOY (sets daynum input)
          pdat->function &= ~S_DOY (sets month and day input)
 
+     The S_EPOCH switch overrides both date forms: the time is then
+     taken from epoch (Unix seconds, UTC) and epochfrac, and julday and
+     ectime are computed from them with exact integer arithmetic.  year,
+     month, day and daynum become outputs, in local standard time
+     (timezone); hour, minute and second are only filled in when the
+     L_TST function needs them.  S_EPOCH is not part of S_ALL:
+         pdat->function |= S_EPOCH (sets epoch input)
+
      Whichever date form is used, S_solpos will
      calculate and return the variables(s) of the
      other form.  See the soltest.c program for
@@ -175,6 +191,11 @@ struct posdata {
   int year;     /* I:              4-digit year (2-digit year is NOT
                                     allowed */
 
+  long long epoch; /* I:  S_EPOCH  Unix time (seconds since 1 JAN 1970
+                                     00:00 UTC), used instead of the date
+                                     and time above when the S_EPOCH
+                                     switch is set. */
+
   /***** FLOATS *****/
 
   double amass;    /* O:  S_AMASS    Relative optical airmass */
@@ -200,6 +221,8 @@ struct posdata {
   double elevref;  /* O:  S_REFRAC   Solar elevation angle,
                                       deg. from horizon, refracted */
   double eqntim;   /* T:  S_TST      Equation of time (TST - LMT), minutes */
+  double epochfrac; /* I: S_EPOCH    Fraction of a second added to epoch,
+                                      0 - 1, DEFAULT = 0 */
   double erv;      /* T:  S_GEOM     Earth radius vector
                                       (multiplied to solar constant) */
   double etr;      /* O:  S_ETR      Extraterrestrial (top-of-atmosphere)
@@ -336,6 +359,29 @@ VARIABLE      Mask       Required Variables
  *----------------------------------------------------------------------------*/
 int S_solpos(posdata *pdat);
 
+/*============================================================================
+ *    Int function S_validate
+ *
+ *    This function checks the inputs of S_solpos against the ranges listed
+ *    with the error codes above, for the functions selected in
+ *    pdat->function, without computing anything.
+ *
+ *    RETURNS: Long int status code, identical to that of S_solpos
+ *----------------------------------------------------------------------------*/
+int S_validate(const posdata *pdat);
+
+/*============================================================================
+ *    Long long function S_epoch
+ *
+ *    Converts a date and local standard time to Unix time, using exact
+ *    integer (proleptic Gregorian) arithmetic.  month must be 1 - 12; the
+ *    other fields are carried, so hour 24 is midnight of the next day.
+ *
+ *    RETURNS: Seconds since 1 JAN 1970 00:00 UTC
+ *----------------------------------------------------------------------------*/
+long long S_epoch(int year, int month, int day, int hour, int minute,
+                  int second, double timezone);
+
 /*============================================================================
  *    Void function S_init
  *
@@ -362,4 +408,75 @@ void S_init(posdata *pdat);
  *----------------------------------------------------------------------------*/
 void S_decode(int code, posdata *pdat);
 
+/*============================================================================
+ *    Int function S_decode_list
+ *
+ *    This function decodes the error codes from S_solpos return value
+ *    into a list of S_*_ERROR enumerators, without any output or
+ *    allocation.
+ *
+ *    INPUTS: Long integer S_solpos return value, caller array of at least
+ *            max_errors ints (S_ERROR_COUNT always suffices)
+ *
+ *    RETURNS: Number of error codes set in the return value.  At most
+ *             max_errors of them are written, in ascending bit order.
+ *----------------------------------------------------------------------------*/
+int S_decode_list(int code, int *errors, int max_errors);
+
+/*============================================================================
+ *    Const char* function S_error_name
+ *
+ *    Returns the name of the input parameter an S_*_ERROR enumerator
+ *    refers to ("year", "shadowband width", ...), or "unknown".
+ *----------------------------------------------------------------------------*/
+const char *S_error_name(int error);
+
+/*============================================================================
+ *    Int function S_format_error
+ *
+ *    This function writes the same descriptive text as S_decode into a
+ *    caller supplied buffer instead of stderr.  The text is always NUL
+ *    terminated (when size > 0) and is truncated to fit.
+ *
+ *    INPUTS: Long integer S_solpos return value, struct posdata*,
+ *            buffer and its size in bytes
+ *
+ *    RETURNS: Length of the full text, excluding the NUL (as snprintf).
+ *----------------------------------------------------------------------------*/
+int S_format_error(int code, const posdata *pdat, char *buf, int size);
+
+/*============================================================================
+ *
+ *     Batch error aggregation
+ *
+ *     An errstats accumulates the S_solpos return values of a bulk job:
+ *     the number of rows seen, the number of rows with any error, and for
+ *     each error bit the number of offending rows together with the
+ *     S_ERRSTATS_ROWS lowest offending row indices.  Nothing is allocated
+ *     and valid rows cost one compare, so it may be updated per row.
+ *     Use one errstats per thread and S_errstats_merge them at the end.
+ *
+ *----------------------------------------------------------------------------*/
+#define S_ERRSTATS_ROWS 8
+
+struct errstats {
+  long long rows;      /* Rows added */
+  long long bad_rows;  /* Rows with a non-zero return code */
+  long long count[S_ERROR_COUNT];  /* Rows with each error bit set */
+  long long first[S_ERROR_COUNT][S_ERRSTATS_ROWS];
+  /* Lowest offending row indices, ascending;
+     min(count, S_ERRSTATS_ROWS) are valid */
+};
+
+/* Clears all counters */
+void S_errstats_init(errstats *stats);
+
+/* Records the S_solpos return value of the row with the given index */
+void S_errstats_add(errstats *stats, int code, long long row);
+
+/* Adds the counters of from into stats (e.g. per-thread partials) */
+void S_errstats_merge(errstats *stats, const errstats *from);
+
 }  // namespace solpos
+
+#endif  // SOLPOS_H_
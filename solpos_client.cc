@@ -0,0 +1,137 @@
+/*============================================================================
+ *    Contains:
+ *        S_client_open, S_client_query, S_client_close
+ *----------------------------------------------------------------------------*/
+#include "solpos_client.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <new>
+
+struct S_client {
+  int fd;
+};
+
+/*============================================================================
+*    Local function prototypes
+============================================================================*/
+static int send_all(int fd, const void *data, size_t size);
+static int recv_all(int fd, void *data, size_t size);
+
+/*============================================================================
+ *    Local int function send_all
+ *
+ *    RETURNS: 0, or -1 with errno set
+ *----------------------------------------------------------------------------*/
+static int send_all(int fd, const void *data, size_t size) {
+  const char *at = static_cast<const char *>(data);
+
+  while (size > 0) {
+    ssize_t n = send(fd, at, size, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return -1;
+    }
+    at += n;
+    size -= static_cast<size_t>(n);
+  }
+  return 0;
+}
+
+/*============================================================================
+ *    Local int function recv_all
+ *
+ *    RETURNS: 0, or -1 with errno set (ECONNRESET at end of stream)
+ *----------------------------------------------------------------------------*/
+static int recv_all(int fd, void *data, size_t size) {
+  char *at = static_cast<char *>(data);
+
+  while (size > 0) {
+    ssize_t n = recv(fd, at, size, 0);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return -1;
+    }
+    if (n == 0) {
+      errno = ECONNRESET;
+      return -1;
+    }
+    at += n;
+    size -= static_cast<size_t>(n);
+  }
+  return 0;
+}
+
+/*============================================================================
+ *    Pointer function S_client_open
+ *----------------------------------------------------------------------------*/
+S_client *S_client_open(const char *path) {
+  struct sockaddr_un addr;
+  S_client *client;
+  int fd;
+
+  if (strlen(path) >= sizeof(addr.sun_path)) {
+    errno = ENAMETOOLONG;
+    return nullptr;
+  }
+  memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  strcpy(addr.sun_path, path);
+
+  fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+  if (fd < 0) return nullptr;
+  if (connect(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) <
+      0) {
+    int saved = errno;
+    close(fd);
+    errno = saved;
+    return nullptr;
+  }
+
+  client = new (std::nothrow) S_client;
+  if (client == nullptr) {
+    close(fd);
+    errno = ENOMEM;
+    return nullptr;
+  }
+  client->fd = fd;
+  return client;
+}
+
+/*============================================================================
+ *    Int function S_client_query
+ *----------------------------------------------------------------------------*/
+int S_client_query(S_client *client, int count, const S_wirequery *query,
+                   S_wireanswer *answer) {
+  S_wireheader header;
+
+  if ((count < 0) || (count > S_WIRE_MAX_COUNT)) {
+    errno = EINVAL;
+    return -1;
+  }
+  header.magic = S_WIRE_QUERY;
+  header.count = static_cast<unsigned int>(count);
+  if (send_all(client->fd, &header, sizeof(header)) < 0) return -1;
+  if (send_all(client->fd, query, count * sizeof(S_wirequery)) < 0) return -1;
+
+  if (recv_all(client->fd, &header, sizeof(header)) < 0) return -1;
+  if ((header.magic != S_WIRE_ANSWER) ||
+      (header.count != static_cast<unsigned int>(count))) {
+    errno = EPROTO;
+    return -1;
+  }
+  return recv_all(client->fd, answer, count * sizeof(S_wireanswer));
+}
+
+/*============================================================================
+ *    Void function S_client_close
+ *----------------------------------------------------------------------------*/
+void S_client_close(S_client *client) {
+  if (client == nullptr) return;
+  close(client->fd);
+  delete client;
+}
@@ -0,0 +1,103 @@
+/*============================================================================
+ *
+ *    NAME:  solpos_client.h
+ *
+ *    Contains:
+ *        S_client_open   (connects to a solpos_server socket)
+ *        S_client_query  (one batch of positions, sent and answered)
+ *        S_client_close
+ *
+ *        and the wire format of the solpos_server protocol.
+ *
+ *    Plain C, so that any service on the host can link it.  A request is
+ *    an S_wireheader (magic S_WIRE_QUERY, count) followed by count
+ *    S_wirequery records; the answer is an S_wireheader (magic
+ *    S_WIRE_ANSWER, the same count) followed by count S_wireanswer records
+ *    in the same order.  Both ends are on one host, so fields are in host
+ *    byte order.  A connection carries any number of requests, one at a
+ *    time.
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_CLIENT_H_
+#define SOLPOS_CLIENT_H_
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define S_WIRE_QUERY 0x31515053  /* "SPQ1" */
+#define S_WIRE_ANSWER 0x31415053 /* "SPA1" */
+#define S_WIRE_MAX_COUNT 65536   /* Most records in one request */
+
+typedef struct S_wireheader {
+  unsigned int magic;
+  unsigned int count;
+} S_wireheader;
+
+typedef struct S_wirequery {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  double latitude;       /* I:  posdata::latitude */
+  double longitude;      /* I:  posdata::longitude */
+  double timezone;       /* I:  posdata::timezone */
+  double press;          /* I:  posdata::press */
+  double temp;           /* I:  posdata::temp */
+  double tilt;           /* I:  posdata::tilt */
+  double aspect;         /* I:  posdata::aspect */
+  long long epoch;       /* I:  Unix time (the server may quantize it) */
+  int interval;          /* I:  posdata::interval */
+  int function;          /* I:  The L_ and S_ masks of solpos.h (S_EPOCH is
+                                implied; 0 = S_ALL) */
+} S_wirequery;
+
+typedef struct S_wireanswer {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  long long epoch;       /* O:  Unix time the answer is for */
+  int error;             /* O:  S_solpos return code */
+  int reserved;
+  double azim;           /* O:  posdata::azim */
+  double elevref;        /* O:  posdata::elevref */
+  double cosinc;         /* O:  posdata::cosinc */
+  double etr;            /* O:  posdata::etr */
+  double etrn;           /* O:  posdata::etrn */
+  double etrtilt;        /* O:  posdata::etrtilt */
+  double amass;          /* O:  posdata::amass */
+  double declin;         /* O:  posdata::declin */
+  double hrang;          /* O:  posdata::hrang */
+  double sretr;          /* O:  posdata::sretr */
+  double ssetr;          /* O:  posdata::ssetr */
+} S_wireanswer;          /* (outputs of stages not run are 0) */
+
+typedef struct S_client S_client; /* opaque */
+
+/*============================================================================
+ *    Pointer function S_client_open
+ *
+ *    RETURNS: A connection to the server listening on the Unix domain
+ *             socket at path, or NULL with errno set
+ *----------------------------------------------------------------------------*/
+S_client *S_client_open(const char *path);
+
+/*============================================================================
+ *    Int function S_client_query
+ *
+ *    Sends query[0 .. count - 1] (count <= S_WIRE_MAX_COUNT) and waits for
+ *    answer[0 .. count - 1].  One thread at a time per client.
+ *
+ *    RETURNS: 0, or -1 with errno set (EPROTO for a malformed answer); the
+ *             connection is unusable after an error
+ *----------------------------------------------------------------------------*/
+int S_client_query(S_client *client, int count, const S_wirequery *query,
+                   S_wireanswer *answer);
+
+/*============================================================================
+ *    Void function S_client_close
+ *----------------------------------------------------------------------------*/
+void S_client_close(S_client *client);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  // SOLPOS_CLIENT_H_
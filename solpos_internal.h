@@ -0,0 +1,68 @@
+/*============================================================================
+ *
+ *    NAME:  solpos_internal.h
+ *
+ *    Contains:
+ *        Entry points and tables shared between solpos.cc and the batch
+ *        modules of this package.  They skip input validation and are not
+ *        part of the public API; call S_solpos instead.
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_INTERNAL_H_
+#define SOLPOS_INTERNAL_H_
+
+#include <cmath>
+
+#include "solpos.h"
+
+namespace solpos {
+
+struct poscolumns; /* batch.h */
+
+namespace internal {
+
+/* Runs the functions selected by pdat->function, without validation */
+void compute(posdata *pdat);
+
+/* As compute, but with the date and S_GEOM terms through gmst already in
+   pdat (shared by sites of one epoch, timezone and interval): runs only
+   the hour angle and the stages after the geometry */
+void compute_local(posdata *pdat);
+
+/* As compute for an S_EPOCH | S_GEOM pdat, with the closed forms of the
+   stages (no pow, no loops) for S_rt_solpos; agrees to a few ULPs */
+void compute_realtime(posdata *pdat);
+
+/* Kasten and Young relative air mass at refracted zenith zenref (degrees),
+   whose cosine is coszen; -1 when zenref is beyond 93 degrees */
+inline double air_mass(double zenref, double coszen) {
+  return zenref > 93.0
+             ? -1.0
+             : 1.0 / (coszen + 0.50572 * std::pow(96.07995 - zenref, -1.6364));
+}
+
+/* As air_mass, with the power taken as exp(-1.6364 log x) (x >= 3.07): a
+   fixed cost, where pow of a non-integer exponent may take a slower path.
+   For the real-time path; agrees with air_mass to a few ULPs */
+inline double air_mass_closed(double zenref, double coszen) {
+  if (zenref > 93.0) return -1.0;
+  return 1.0 / (coszen +
+                0.50572 * std::exp(-1.6364 * std::log(96.07995 - zenref)));
+}
+
+/* The members of poscolumns in declaration order, and the posdata member
+   each one is filled from, for the modules that walk every column (see
+   batch.cc) */
+const int kPosColumns = 18;
+extern double *poscolumns::*const kPosColumn[kPosColumns];
+extern double posdata::*const kPosMember[kPosColumns];
+
+/* Perez unprime factor (Kt' to Kt) at relative air mass am */
+inline double unprime_factor(double am) {
+  return 1.031 * std::exp(-1.4 / (0.9 + 9.4 / am)) + 0.1;
+}
+
+}  // namespace internal
+}  // namespace solpos
+
+#endif  // SOLPOS_INTERNAL_H_
@@ -0,0 +1,151 @@
+/*============================================================================
+ *    solpos_loadgen: load generator for solpos_server
+ *
+ *        solpos_loadgen [--socket=PATH] [--clients=N] [--seconds=S]
+ *                       [--batch=N] [--sites=N]
+ *
+ *    Each client thread keeps one connection and sends requests of --batch
+ *    queries (random sites out of --sites, at times stepping a second per
+ *    request) for --seconds, checking every answer for errors.  Without
+ *    --socket it starts a server in-process on a private socket, so the
+ *    whole round trip runs locally.  Prints requests and queries per
+ *    second and the request latency (p50, p99, p99.9, max).
+ *----------------------------------------------------------------------------*/
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "solpos.h"
+#include "solpos_client.h"
+#include "solpos_server.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+/* The value of --name=value in arg, or nullptr */
+const char *flag(const char *arg, const char *name) {
+  size_t n = std::strlen(name);
+  if (std::strncmp(arg, "--", 2) != 0 || std::strncmp(arg + 2, name, n) != 0 ||
+      arg[2 + n] != '=')
+    return nullptr;
+  return arg + 3 + n;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  std::string path;
+  int clients = 16, seconds = 5, batch = 8, sites = 200;
+
+  for (int i = 1; i < argc; ++i) {
+    const char *v;
+    if ((v = flag(argv[i], "socket")))
+      path = v;
+    else if ((v = flag(argv[i], "clients")))
+      clients = std::max(1, std::atoi(v));
+    else if ((v = flag(argv[i], "seconds")))
+      seconds = std::max(1, std::atoi(v));
+    else if ((v = flag(argv[i], "batch")))
+      batch = std::min(std::max(1, std::atoi(v)), S_WIRE_MAX_COUNT);
+    else if ((v = flag(argv[i], "sites")))
+      sites = std::max(1, std::atoi(v));
+    else {
+      std::fprintf(stderr, "unknown argument %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  solpos::solposserver *server = nullptr;
+  if (path.empty()) {
+    path = "/tmp/solpos_loadgen_" + std::to_string(getpid()) + ".sock";
+    solpos::serverspec spec = {path.c_str(), 1 << 16, 1, 200, 4096, 0};
+    int code = solpos::S_server_start(&spec, &server);
+    if (code != 0) {
+      std::fprintf(stderr, "%s: %s\n", path.c_str(), std::strerror(code));
+      return 1;
+    }
+  }
+
+  const long long start = solpos::S_epoch(2022, 6, 1, 6, 0, 0, -7.0);
+  const Clock::time_point stop =
+      Clock::now() + std::chrono::seconds(seconds);
+  std::vector<std::vector<long long> > latency(clients);
+  std::atomic<long long> failed(0), errors(0);
+  std::vector<std::thread> threads;
+
+  for (int c = 0; c < clients; ++c) {
+    threads.push_back(std::thread([&, c] {
+      S_client *client = S_client_open(path.c_str());
+      if (!client) {
+        ++failed;
+        return;
+      }
+      std::vector<S_wirequery> q(batch);
+      std::vector<S_wireanswer> a(batch);
+      unsigned int seed = 12345u + c;
+      for (long long r = 0; Clock::now() < stop; ++r) {
+        for (int k = 0; k < batch; ++k) {
+          int site = static_cast<int>(rand_r(&seed) % sites);
+          S_wirequery &w = q[k];
+          std::memset(&w, 0, sizeof(w));
+          w.latitude = 25.0 + 20.0 * site / sites;
+          w.longitude = -120.0 + 40.0 * site / sites;
+          w.timezone = -7.0;
+          w.press = 1013.0;
+          w.temp = 15.0;
+          w.tilt = 25.0;
+          w.aspect = 180.0;
+          w.epoch = start + r;
+          w.function = (S_SOLAZM | S_REFRAC | S_TILT) & ~L_DOY;
+        }
+        Clock::time_point t0 = Clock::now();
+        if (S_client_query(client, batch, q.data(), a.data()) != 0) {
+          ++failed;
+          break;
+        }
+        latency[c].push_back(
+            std::chrono::duration_cast<std::chrono::nanoseconds>(
+                Clock::now() - t0)
+                .count());
+        for (int k = 0; k < batch; ++k) errors += a[k].error != 0;
+      }
+      S_client_close(client);
+    }));
+  }
+  for (size_t c = 0; c < threads.size(); ++c) threads[c].join();
+
+  std::vector<long long> all;
+  for (int c = 0; c < clients; ++c)
+    all.insert(all.end(), latency[c].begin(), latency[c].end());
+  std::sort(all.begin(), all.end());
+  size_t n = all.size();
+  std::printf("%d clients, %d queries per request, %d sites: %zu requests\n",
+              clients, batch, sites, n);
+  std::printf("%12.0f requests/s  %12.0f queries/s\n",
+              static_cast<double>(n) / seconds,
+              static_cast<double>(n) * batch / seconds);
+  if (n > 0)
+    std::printf("latency p50 %lld  p99 %lld  p99.9 %lld  max %lld ns\n",
+                all[n / 2], all[n * 99 / 100], all[n * 999 / 1000],
+                all[n - 1]);
+  std::printf("%lld failed connections, %lld answers with errors\n",
+              failed.load(), errors.load());
+
+  if (server) {
+    solpos::serverstats stats;
+    solpos::S_server_stats(server, &stats);
+    solpos::S_server_stop(server);
+    std::printf("server: %lld batches, %lld hits, %lld misses\n",
+                stats.batches, stats.hits, stats.misses);
+  }
+  return failed.load() == 0 ? 0 : 1;
+}
@@ -0,0 +1,436 @@
+/*============================================================================
+ *    Contains:
+ *        S_server_start, S_server_stats, S_server_stop
+ *----------------------------------------------------------------------------*/
+#include "solpos_server.h"
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "lru.h"
+#include "parallel.h"
+#include "solpos.h"
+
+namespace solpos {
+
+/*============================================================================
+*    Local constants, types and function prototypes
+============================================================================*/
+static_assert(sizeof(S_wirequery) == 72, "S_wirequery has padding");
+
+/* Queries below which a batch's misses are not worth a second thread */
+static const int kMinMissesPerThread = 256;
+
+/* A cache key: the query as computed (bytewise hash and equality) */
+struct querykey {
+  size_t operator()(const S_wirequery &q) const {
+    const unsigned char *b = reinterpret_cast<const unsigned char *>(&q);
+    size_t h = 14695981039346656037ULL; /* FNV-1a */
+    for (size_t i = 0; i < sizeof(q); ++i) h = (h ^ b[i]) * 1099511628211ULL;
+    return h;
+  }
+  bool operator()(const S_wirequery &a, const S_wirequery &b) const {
+    return std::memcmp(&a, &b, sizeof(a)) == 0;
+  }
+};
+
+/* One request, from its connection thread to the batcher and back */
+struct serverjob {
+  std::vector<S_wirequery> query;
+  std::vector<S_wireanswer> answer;
+  bool taken; /* by the batcher, which then always finishes it */
+  bool done;
+};
+
+struct solposserver {
+  serverspec spec;
+  std::string path;
+  int listen_fd;
+  std::thread acceptor, batcher;
+  internal::lru_cache<S_wirequery, S_wireanswer, querykey, querykey> cache;
+
+  std::mutex mu; /* guards everything below but the counters */
+  std::condition_variable work;  /* to the batcher: jobs or stop */
+  std::condition_variable done;  /* to connections: jobs done, or stop */
+  std::vector<serverjob *> pending;
+  size_t pending_queries;
+  std::set<int> connections;     /* open connection sockets */
+  bool stop;
+
+  std::atomic<long long> requests, queries, batches, hits, misses;
+
+  explicit solposserver(size_t entries) : cache(entries) {}
+};
+
+static int send_all(int fd, const void *data, size_t size);
+static int recv_all(int fd, void *data, size_t size);
+static long long floor_div(long long num, long long den);
+static void answer_query(const S_wirequery *q, S_wireanswer *a);
+static void serve(solposserver *server, const std::vector<serverjob *> &jobs);
+static void batch_loop(solposserver *server);
+static void connection_loop(solposserver *server, int fd);
+static void accept_loop(solposserver *server);
+
+/*============================================================================
+ *    Local int function send_all
+ *
+ *    RETURNS: 0, or -1 with errno set
+ *----------------------------------------------------------------------------*/
+static int send_all(int fd, const void *data, size_t size) {
+  const char *at = static_cast<const char *>(data);
+
+  while (size > 0) {
+    ssize_t n = send(fd, at, size, MSG_NOSIGNAL);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return -1;
+    }
+    at += n;
+    size -= static_cast<size_t>(n);
+  }
+  return 0;
+}
+
+/*============================================================================
+ *    Local int function recv_all
+ *
+ *    RETURNS: 0, or -1 at end of stream or with errno set
+ *----------------------------------------------------------------------------*/
+static int recv_all(int fd, void *data, size_t size) {
+  char *at = static_cast<char *>(data);
+
+  while (size > 0) {
+    ssize_t n = recv(fd, at, size, 0);
+    if (n < 0) {
+      if (errno == EINTR) continue;
+      return -1;
+    }
+    if (n == 0) return -1;
+    at += n;
+    size -= static_cast<size_t>(n);
+  }
+  return 0;
+}
+
+/*============================================================================
+ *    Local long long function floor_div
+ *
+ *    Integer division rounding toward negative infinity (den > 0)
+ *----------------------------------------------------------------------------*/
+static long long floor_div(long long num, long long den) {
+  long long quot = num / den;
+
+  if ((num % den) < 0) --quot;
+  return quot;
+}
+
+/*============================================================================
+ *    Local void function answer_query
+ *
+ *    S_solpos for a normalized query
+ *----------------------------------------------------------------------------*/
+static void answer_query(const S_wirequery *q, S_wireanswer *a) {
+  posdata pd;
+
+  std::memset(&pd, 0, sizeof(pd)); /* outputs of stages not run are 0 */
+  S_init(&pd);
+  pd.latitude = q->latitude;
+  pd.longitude = q->longitude;
+  pd.timezone = q->timezone;
+  pd.press = q->press;
+  pd.temp = q->temp;
+  pd.tilt = q->tilt;
+  pd.aspect = q->aspect;
+  pd.interval = q->interval;
+  pd.function = q->function;
+  pd.epoch = q->epoch;
+  pd.epochfrac = 0.0;
+
+  std::memset(a, 0, sizeof(*a));
+  a->epoch = q->epoch;
+  a->error = S_solpos(&pd);
+  if (a->error != 0) return;
+  a->azim = pd.azim;
+  a->elevref = pd.elevref;
+  a->cosinc = pd.cosinc;
+  a->etr = pd.etr;
+  a->etrn = pd.etrn;
+  a->etrtilt = pd.etrtilt;
+  a->amass = pd.amass;
+  a->declin = pd.declin;
+  a->hrang = pd.hrang;
+  a->sretr = pd.sretr;
+  a->ssetr = pd.ssetr;
+}
+
+/*============================================================================
+ *    Local void function serve
+ *
+ *    Answers every query of jobs, from the cache where it can
+ *----------------------------------------------------------------------------*/
+static void serve(solposserver *server, const std::vector<serverjob *> &jobs) {
+  const long long quantum = server->spec.quantum;
+  std::vector<S_wirequery> keys;
+  std::vector<S_wireanswer> computed;
+  std::vector<const S_wireanswer *> found;
+  std::vector<int> slot; /* per query, its entry in keys, or -1 if cached */
+  std::unordered_map<S_wirequery, int, querykey, querykey> batch_misses;
+  long long count = 0;
+
+  for (serverjob *job : jobs) count += job->query.size();
+  found.reserve(count);
+  slot.reserve(count);
+
+  /* look up every normalized query; collect the distinct misses */
+  for (serverjob *job : jobs) {
+    for (S_wirequery &q : job->query) {
+      q.epoch = floor_div(q.epoch, quantum) * quantum;
+      q.function = (q.function != 0 ? q.function : S_ALL) | S_EPOCH;
+      const S_wireanswer *hit = server->cache.find(q);
+      found.push_back(hit);
+      if (hit) {
+        slot.push_back(-1);
+        continue;
+      }
+      auto made = batch_misses.insert(
+          std::make_pair(q, static_cast<int>(keys.size())));
+      if (made.second) keys.push_back(q);
+      slot.push_back(made.first->second);
+    }
+  }
+  server->hits += count - static_cast<long long>(keys.size());
+  server->misses += keys.size();
+
+  computed.resize(keys.size());
+  internal::parallel_for(static_cast<int>(keys.size()), server->spec.threads,
+                         [&](int first, int n) {
+                           for (int i = first; i < first + n; ++i)
+                             answer_query(&keys[i], &computed[i]);
+                         },
+                         kMinMissesPerThread);
+
+  /* copy out before inserting: an insert may evict an entry found above */
+  size_t k = 0;
+  for (serverjob *job : jobs) {
+    job->answer.resize(job->query.size());
+    for (S_wireanswer &a : job->answer) {
+      a = slot[k] < 0 ? *found[k] : computed[slot[k]];
+      ++k;
+    }
+  }
+  for (size_t i = 0; i < keys.size(); ++i)
+    server->cache.insert(keys[i], computed[i]);
+}
+
+/*============================================================================
+ *    Local void function batch_loop
+ *
+ *    Body of the batching thread
+ *----------------------------------------------------------------------------*/
+static void batch_loop(solposserver *server) {
+  const std::chrono::microseconds window(server->spec.window);
+  const size_t batch = server->spec.batch > 0 ? server->spec.batch : ~size_t(0);
+  std::unique_lock<std::mutex> lock(server->mu);
+
+  for (;;) {
+    server->work.wait(lock, [server] {
+      return server->stop || !server->pending.empty();
+    });
+    if (server->stop) break;
+
+    /* let concurrent requests join this batch */
+    server->work.wait_for(lock, window, [server, batch] {
+      return server->stop || server->pending_queries >= batch;
+    });
+    if (server->stop) break;
+
+    std::vector<serverjob *> jobs;
+    jobs.swap(server->pending);
+    server->pending_queries = 0;
+    for (serverjob *job : jobs) job->taken = true;
+    lock.unlock();
+
+    serve(server, jobs);
+    ++server->batches;
+
+    lock.lock();
+    for (serverjob *job : jobs) job->done = true;
+    server->done.notify_all();
+  }
+}
+
+/*============================================================================
+ *    Local void function connection_loop
+ *
+ *    Body of the thread of connection fd; closes it when done
+ *----------------------------------------------------------------------------*/
+static void connection_loop(solposserver *server, int fd) {
+  serverjob job;
+  S_wireheader header;
+
+  while (recv_all(fd, &header, sizeof(header)) == 0) {
+    if ((header.magic != S_WIRE_QUERY) || (header.count > S_WIRE_MAX_COUNT))
+      break;
+    job.query.resize(header.count);
+    if (recv_all(fd, job.query.data(),
+                 header.count * sizeof(S_wirequery)) != 0)
+      break;
+
+    {
+      std::unique_lock<std::mutex> lock(server->mu);
+      if (server->stop) break;
+      job.taken = job.done = false;
+      server->pending.push_back(&job);
+      server->pending_queries += header.count;
+      server->work.notify_one();
+      server->done.wait(lock, [server, &job] {
+        return job.done || (server->stop && !job.taken);
+      });
+      if (!job.done) {
+        /* stopping before the batcher took it: withdraw the job */
+        for (size_t i = 0; i < server->pending.size(); ++i)
+          if (server->pending[i] == &job)
+            server->pending.erase(server->pending.begin() + i);
+        break;
+      }
+    }
+
+    /* (counted first, so a client that has its answer sees it counted) */
+    ++server->requests;
+    server->queries += header.count;
+    header.magic = S_WIRE_ANSWER;
+    if ((send_all(fd, &header, sizeof(header)) != 0) ||
+        (send_all(fd, job.answer.data(),
+                  header.count * sizeof(S_wireanswer)) != 0))
+      break;
+  }
+
+  std::lock_guard<std::mutex> lock(server->mu);
+  server->connections.erase(fd);
+  close(fd);
+  server->done.notify_all();
+}
+
+/*============================================================================
+ *    Local void function accept_loop
+ *
+ *    Body of the accepting thread
+ *----------------------------------------------------------------------------*/
+static void accept_loop(solposserver *server) {
+  for (;;) {
+    int fd = accept4(server->listen_fd, nullptr, nullptr, SOCK_CLOEXEC);
+    if (fd < 0) {
+      if ((errno == EINTR) || (errno == ECONNABORTED)) continue;
+      {
+        std::lock_guard<std::mutex> lock(server->mu);
+        if (server->stop) return;
+      }
+      /* out of descriptors or memory: give connections time to end */
+      std::this_thread::sleep_for(std::chrono::milliseconds(10));
+      continue;
+    }
+
+    std::lock_guard<std::mutex> lock(server->mu);
+    if (server->stop) {
+      close(fd);
+      return;
+    }
+    server->connections.insert(fd);
+    std::thread(connection_loop, server, fd).detach();
+  }
+}
+
+/*============================================================================
+ *    Int function S_server_start
+ *----------------------------------------------------------------------------*/
+int S_server_start(const serverspec *spec, solposserver **server) {
+  std::unique_ptr<solposserver> made(
+      new solposserver(spec->cache > 0 ? spec->cache : 0));
+  struct sockaddr_un addr;
+  int fd;
+
+  *server = nullptr;
+  if (std::strlen(spec->path) >= sizeof(addr.sun_path)) return ENAMETOOLONG;
+  std::memset(&addr, 0, sizeof(addr));
+  addr.sun_family = AF_UNIX;
+  std::strcpy(addr.sun_path, spec->path);
+
+  if ((fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0)) < 0) return errno;
+  unlink(spec->path); /* a stale socket from an earlier run */
+  if ((bind(fd, reinterpret_cast<struct sockaddr *>(&addr), sizeof(addr)) <
+       0) ||
+      (listen(fd, SOMAXCONN) < 0)) {
+    int saved = errno;
+    close(fd);
+    return saved;
+  }
+
+  made->spec = *spec;
+  made->path = spec->path;
+  made->spec.path = made->path.c_str();
+  if (made->spec.quantum < 1) made->spec.quantum = 1;
+  if (made->spec.window < 0) made->spec.window = 0;
+  made->listen_fd = fd;
+  made->pending_queries = 0;
+  made->stop = false;
+  made->requests = made->queries = made->batches = 0;
+  made->hits = made->misses = 0;
+
+  made->batcher = std::thread(batch_loop, made.get());
+  made->acceptor = std::thread(accept_loop, made.get());
+  *server = made.release();
+  return 0;
+}
+
+/*============================================================================
+ *    Void function S_server_stats
+ *----------------------------------------------------------------------------*/
+void S_server_stats(const solposserver *server, serverstats *stats) {
+  stats->requests = server->requests.load();
+  stats->queries = server->queries.load();
+  stats->batches = server->batches.load();
+  stats->hits = server->hits.load();
+  stats->misses = server->misses.load();
+}
+
+/*============================================================================
+ *    Void function S_server_stop
+ *----------------------------------------------------------------------------*/
+void S_server_stop(solposserver *server) {
+  if (!server) return;
+  {
+    std::lock_guard<std::mutex> lock(server->mu);
+    server->stop = true;
+    shutdown(server->listen_fd, SHUT_RDWR); /* wakes accept */
+    for (int fd : server->connections) shutdown(fd, SHUT_RDWR);
+  }
+  server->work.notify_all();
+  server->done.notify_all();
+  server->acceptor.join();
+  server->batcher.join();
+
+  /* the connection threads are detached: wait for the last to close */
+  {
+    std::unique_lock<std::mutex> lock(server->mu);
+    server->done.wait(lock, [server] { return server->connections.empty(); });
+  }
+  close(server->listen_fd);
+  unlink(server->path.c_str());
+  delete server;
+}
+
+}  // namespace solpos
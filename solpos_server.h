@@ -0,0 +1,84 @@
+/*============================================================================
+ *
+ *    NAME:  solpos_server.h
+ *
+ *    Contains:
+ *        S_server_start  (serves solar positions on a Unix domain socket)
+ *        S_server_stats  (counters of a running server)
+ *        S_server_stop
+ *
+ *            INPUTS:     requests of S_wirequery records (solpos_client.h)
+ *
+ *            OUTPUTS:    S_wireanswer records, in request order
+ *
+ *    One thread per connection reads requests and hands them to a single
+ *    batching thread, which waits up to spec.window microseconds after the
+ *    first for others to arrive (or until spec.batch queries are waiting),
+ *    then serves them all at once: each query looks up its key (the query
+ *    with its epoch rounded down to spec.quantum seconds and its function
+ *    normalized) in an LRU cache, the distinct misses run through S_solpos
+ *    spread over spec.threads threads, and their answers enter the cache.
+ *
+ *    A connection whose request is malformed (bad magic, too many
+ *    records) is closed.
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_SERVER_H_
+#define SOLPOS_SERVER_H_
+
+#include "solpos_client.h"
+
+namespace solpos {
+
+struct serverspec {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  const char *path;      /* I:  Socket path (a stale socket there is
+                                replaced) */
+  int cache;             /* I:  LRU cache entries (0 = no cache) */
+  int quantum;           /* I:  Seconds epochs are rounded down to (0 = 1) */
+  int window;            /* I:  Microseconds a batch waits for more
+                                requests */
+  int batch;             /* I:  Waiting queries that close a batch early
+                                (0 = no limit) */
+  int threads;           /* I:  Threads for the misses of a batch (0 = one
+                                per hardware thread) */
+};
+
+struct serverstats {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  long long requests;    /* O:  Requests answered */
+  long long queries;     /* O:  Records in them */
+  long long batches;     /* O:  Batches served */
+  long long hits;        /* O:  Queries answered from the cache or by an
+                                identical query of the same batch */
+  long long misses;      /* O:  Queries computed */
+};
+
+struct solposserver; /* opaque */
+
+/*============================================================================
+ *    Int function S_server_start
+ *
+ *    RETURNS: 0 with *server listening, or the errno of the socket call
+ *             that failed (*server is nullptr then)
+ *----------------------------------------------------------------------------*/
+int S_server_start(const serverspec *spec, solposserver **server);
+
+/*============================================================================
+ *    Void function S_server_stats
+ *----------------------------------------------------------------------------*/
+void S_server_stats(const solposserver *server, serverstats *stats);
+
+/*============================================================================
+ *    Void function S_server_stop
+ *
+ *    Closes the socket and every connection (requests in flight are not
+ *    answered), removes the socket file and frees the server.
+ *----------------------------------------------------------------------------*/
+void S_server_stop(solposserver *server);
+
+}  // namespace solpos
+
+#endif  // SOLPOS_SERVER_H_
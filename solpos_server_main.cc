@@ -0,0 +1,80 @@
+/*============================================================================
+ *    solpos_server: the solar position daemon
+ *
+ *        solpos_server [--socket=PATH] [--cache=N] [--quantum=S]
+ *                      [--window_us=N] [--batch=N] [--threads=N]
+ *
+ *    Serves S_wirequery requests (solpos_client.h) on the Unix domain
+ *    socket PATH until SIGINT or SIGTERM, then prints its counters.
+ *----------------------------------------------------------------------------*/
+#include <signal.h>
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#include "solpos_server.h"
+
+namespace {
+
+/* The value of --name=value in arg, or nullptr */
+const char *flag(const char *arg, const char *name) {
+  size_t n = std::strlen(name);
+  if (std::strncmp(arg, "--", 2) != 0 || std::strncmp(arg + 2, name, n) != 0 ||
+      arg[2 + n] != '=')
+    return nullptr;
+  return arg + 3 + n;
+}
+
+}  // namespace
+
+int main(int argc, char **argv) {
+  solpos::serverspec spec = {"/tmp/solpos.sock", 1 << 20, 1, 200, 4096, 0};
+
+  for (int i = 1; i < argc; ++i) {
+    const char *v;
+    if ((v = flag(argv[i], "socket")))
+      spec.path = v;
+    else if ((v = flag(argv[i], "cache")))
+      spec.cache = std::atoi(v);
+    else if ((v = flag(argv[i], "quantum")))
+      spec.quantum = std::atoi(v);
+    else if ((v = flag(argv[i], "window_us")))
+      spec.window = std::atoi(v);
+    else if ((v = flag(argv[i], "batch")))
+      spec.batch = std::atoi(v);
+    else if ((v = flag(argv[i], "threads")))
+      spec.threads = std::atoi(v);
+    else {
+      std::fprintf(stderr, "unknown argument %s\n", argv[i]);
+      return 2;
+    }
+  }
+
+  /* block the signals in every thread; this one waits for them below */
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  solpos::solposserver *server;
+  int code = solpos::S_server_start(&spec, &server);
+  if (code != 0) {
+    std::fprintf(stderr, "%s: %s\n", spec.path, std::strerror(code));
+    return 1;
+  }
+  std::fprintf(stderr, "listening on %s\n", spec.path);
+
+  int signal;
+  sigwait(&signals, &signal);
+
+  solpos::serverstats stats;
+  solpos::S_server_stats(server, &stats);
+  solpos::S_server_stop(server);
+  std::printf("%lld requests, %lld queries, %lld batches, %lld hits, "
+              "%lld misses\n",
+              stats.requests, stats.queries, stats.batches, stats.hits,
+              stats.misses);
+  return 0;
+}
@@ -0,0 +1,201 @@
+#include "solpos_server.h"
+
+#include <unistd.h>
+
+#include <cerrno>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "solpos.h"
+#include "solpos_client.h"
+
+namespace solpos {
+namespace {
+
+std::string SocketPath(const char *name) {
+  return "/tmp/solpos_" + std::string(name) + "_" +
+         std::to_string(getpid()) + ".sock";
+}
+
+S_wirequery Query(double latitude, long long epoch) {
+  S_wirequery q = {};
+  q.latitude = latitude;
+  q.longitude = -105.18;
+  q.timezone = -7.0;
+  q.press = 1013.0;
+  q.temp = 15.0;
+  q.tilt = 30.0;
+  q.aspect = 180.0;
+  q.epoch = epoch;
+  return q;
+}
+
+void ExpectSolpos(const S_wirequery &q, const S_wireanswer &a) {
+  posdata pd;
+  std::memset(&pd, 0, sizeof(pd)); /* stages not run leave 0 */
+  S_init(&pd);
+  pd.latitude = q.latitude;
+  pd.longitude = q.longitude;
+  pd.timezone = q.timezone;
+  pd.tilt = q.tilt;
+  pd.function = (q.function ? q.function : S_ALL) | S_EPOCH;
+  pd.epoch = a.epoch;
+  ASSERT_EQ(a.error, S_solpos(&pd));
+  if (a.error) return;
+  EXPECT_EQ(a.azim, pd.azim);
+  EXPECT_EQ(a.elevref, pd.elevref);
+  EXPECT_EQ(a.etrtilt, pd.etrtilt);
+  EXPECT_EQ(a.amass, pd.amass);
+  EXPECT_EQ(a.sretr, pd.sretr);
+}
+
+TEST(SolposServerTest, AnswersMatchSolpos) {
+  std::string path = SocketPath("answers");
+  serverspec spec = {path.c_str(), 1000, 60, 100, 0, 1};
+  solposserver *server;
+  ASSERT_EQ(S_server_start(&spec, &server), 0);
+  S_client *client = S_client_open(path.c_str());
+  ASSERT_NE(client, nullptr);
+
+  const long long noon = S_epoch(2021, 6, 21, 12, 0, 0, -7.0);
+  std::vector<S_wirequery> q;
+  for (int i = 0; i < 50; ++i) q.push_back(Query(39.74, noon + 37 * i));
+  q.push_back(Query(95.0, noon));          /* bad latitude */
+  q.push_back(Query(39.74, noon + 3599));  /* same minute as below */
+  q.push_back(Query(39.74, noon + 3540));
+  q.back().function = S_SOLAZM;
+  std::vector<S_wireanswer> a(q.size());
+  ASSERT_EQ(S_client_query(client, static_cast<int>(q.size()), q.data(),
+                           a.data()),
+            0);
+
+  for (size_t i = 0; i < q.size(); ++i) ExpectSolpos(q[i], a[i]);
+  EXPECT_EQ(a[1].epoch, noon); /* rounded down to the minute */
+  EXPECT_EQ(a[50].error, 1L << S_LAT_ERROR);
+  EXPECT_EQ(a[51].epoch, a[52].epoch);
+  EXPECT_EQ(a[52].etrtilt, 0.0); /* S_TILT not asked for */
+  EXPECT_NE(a[51].etrtilt, 0.0);
+
+  /* the same again comes from the cache */
+  serverstats before, after;
+  S_server_stats(server, &before);
+  ASSERT_EQ(S_client_query(client, static_cast<int>(q.size()), q.data(),
+                           a.data()),
+            0);
+  S_server_stats(server, &after);
+  EXPECT_EQ(after.requests, 2);
+  EXPECT_EQ(after.queries, 2 * static_cast<long long>(q.size()));
+  EXPECT_EQ(after.misses, before.misses);
+  EXPECT_EQ(after.hits - before.hits, static_cast<long long>(q.size()));
+  ExpectSolpos(q[10], a[10]);
+
+  S_client_close(client);
+  S_server_stop(server);
+  EXPECT_NE(access(path.c_str(), F_OK), 0);
+}
+
+TEST(SolposServerTest, LeastRecentlyUsedIsEvicted) {
+  std::string path = SocketPath("lru");
+  serverspec spec = {path.c_str(), 2, 1, 0, 0, 1};
+  solposserver *server;
+  ASSERT_EQ(S_server_start(&spec, &server), 0);
+  S_client *client = S_client_open(path.c_str());
+  ASSERT_NE(client, nullptr);
+
+  const long long t = S_epoch(2021, 3, 1, 9, 0, 0, -7.0);
+  S_wireanswer a;
+  serverstats stats;
+  const double lat[5] = {10.0, 20.0, 10.0, 30.0, 20.0};
+  const long long misses[5] = {1, 2, 2, 3, 4};
+  for (int i = 0; i < 5; ++i) {
+    S_wirequery q = Query(lat[i], t);
+    ASSERT_EQ(S_client_query(client, 1, &q, &a), 0);
+    S_server_stats(server, &stats);
+    EXPECT_EQ(stats.misses, misses[i]) << "query " << i;
+  }
+  S_client_close(client);
+  S_server_stop(server);
+}
+
+TEST(SolposServerTest, ConcurrentClientsAreBatched) {
+  std::string path = SocketPath("batched");
+  serverspec spec = {path.c_str(), 4096, 1, 2000, 0, 0};
+  solposserver *server;
+  ASSERT_EQ(S_server_start(&spec, &server), 0);
+
+  const long long t = S_epoch(2021, 9, 1, 7, 0, 0, -7.0);
+  const int clients = 8, requests = 20;
+  std::vector<int> bad(clients, 0);
+  std::vector<std::thread> threads;
+  for (int c = 0; c < clients; ++c) {
+    threads.push_back(std::thread([&, c] {
+      S_client *client = S_client_open(path.c_str());
+      if (!client) {
+        ++bad[c];
+        return;
+      }
+      for (int r = 0; r < requests; ++r) {
+        S_wirequery q[4];
+        S_wireanswer a[4];
+        for (int k = 0; k < 4; ++k) q[k] = Query(30.0 + k, t + 60 * r);
+        if (S_client_query(client, 4, q, a) != 0) {
+          ++bad[c];
+          break;
+        }
+        for (int k = 0; k < 4; ++k) {
+          posdata pd;
+          S_init(&pd);
+          pd.latitude = q[k].latitude;
+          pd.longitude = q[k].longitude;
+          pd.timezone = q[k].timezone;
+          pd.tilt = q[k].tilt;
+          pd.function = S_ALL | S_EPOCH;
+          pd.epoch = q[k].epoch;
+          bad[c] += (S_solpos(&pd) != 0) | (a[k].azim != pd.azim) |
+                    (a[k].epoch != q[k].epoch);
+        }
+      }
+      S_client_close(client);
+    }));
+  }
+  for (std::thread &t : threads) t.join();
+  for (int c = 0; c < clients; ++c) EXPECT_EQ(bad[c], 0) << "client " << c;
+
+  serverstats stats;
+  S_server_stats(server, &stats);
+  EXPECT_EQ(stats.requests, clients * requests);
+  EXPECT_LT(stats.batches, stats.requests);
+  /* every client asks the same things: at most 4 distinct per minute */
+  EXPECT_EQ(stats.misses, 4 * requests);
+  S_server_stop(server);
+}
+
+TEST(SolposServerTest, BadRequestsAndStop) {
+  std::string path = SocketPath("bad");
+  serverspec spec = {path.c_str(), 16, 1, 0, 0, 1};
+  solposserver *server;
+  ASSERT_EQ(S_server_start(&spec, &server), 0);
+
+  S_wireanswer a;
+  S_wirequery q = Query(20.0, S_epoch(2021, 1, 1, 0, 0, 0, -7.0));
+  S_client *client = S_client_open(path.c_str());
+  ASSERT_NE(client, nullptr);
+  EXPECT_EQ(S_client_query(client, S_WIRE_MAX_COUNT + 1, &q, &a), -1);
+  EXPECT_EQ(S_client_query(client, 1, &q, &a), 0);
+
+  /* an idle connection does not hold up stopping */
+  S_server_stop(server);
+  EXPECT_EQ(S_client_query(client, 1, &q, &a), -1);
+  S_client_close(client);
+  EXPECT_EQ(S_client_open(path.c_str()), nullptr);
+
+  serverspec bad = {"/nonexistent/dir/x.sock", 16, 1, 0, 0, 1};
+  EXPECT_EQ(S_server_start(&bad, &server), ENOENT);
+  EXPECT_EQ(server, nullptr);
+}
+
+}  // namespace
+}  // namespace solpos
@@ -0,0 +1,388 @@
+/*============================================================================
+ *
+ *    NAME:  solpos_stages.h
+ *
+ *    Contains:
+ *        The S_solpos stages from the ecliptic coordinates to the tilted
+ *        surface, templated on the posdata-like struct they work on: S_solpos
+ *        runs them on posdata (doubles), and jacobian.cc on a struct of
+ *        dual numbers.  Not part of the public API.
+ *
+ *        The struct needs the members named below, of one scalar type, plus
+ *        int function.  Elementary functions are called unqualified (after
+ *        using std::sin and so on), so a scalar type other than double
+ *        supplies its own by argument-dependent lookup, along with value()
+ *        for the branches that truncate.
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_STAGES_H_
+#define SOLPOS_STAGES_H_
+
+#include <cmath>
+
+#include "solpos.h"
+
+namespace solpos {
+namespace internal {
+
+static constexpr double kStageRadiansToDegrees = 180.0 / M_PI;
+static constexpr double kStageDegreesToRadians = M_PI / 180;
+
+/* Scalar type of a posdata-like struct */
+template <typename P>
+struct stage_scalar {
+  typedef decltype(P::hrang) type;
+};
+
+inline double value(double x) { return x; }
+
+template <typename T>
+struct trigdata /* used to pass calculated values locally */
+{
+  T cd; /* cosine of the declination */
+  T ch; /* cosine of the hour angle */
+  T cl; /* cosine of the latitude */
+  T sd; /* sine of the declination */
+  T sl; /* sine of the latitude */
+};
+
+/*============================================================================
+ *    Void function init_trig
+ *
+ *    Flags tdat for calculation on first use
+ *----------------------------------------------------------------------------*/
+template <typename T>
+void init_trig(trigdata<T> *tdat) {
+  tdat->sd = -999.0; /* flag to force calculation of trig data */
+  tdat->cd = 1.0;
+  tdat->ch = 1.0; /* set the rest of these to something safe */
+  tdat->cl = 1.0;
+  tdat->sl = 1.0;
+}
+
+/*============================================================================
+ *    Void function localtrig
+ *
+ *    Does trig on internal variable used by several functions
+ *----------------------------------------------------------------------------*/
+template <typename P, typename T>
+void localtrig(P *pdat, trigdata<T> *tdat) {
+/* define masks to prevent calculation of uninitialized variables */
+#define SD_MASK (L_ZENETR | L_SSHA | S_SBCF | S_SOLAZM)
+#define SL_MASK (L_ZENETR | L_SSHA | S_SBCF | S_SOLAZM)
+#define CL_MASK (L_ZENETR | L_SSHA | S_SBCF | S_SOLAZM)
+#define CD_MASK (L_ZENETR | L_SSHA | S_SBCF)
+#define CH_MASK (L_ZENETR)
+  using std::cos;
+  using std::sin;
+
+  if (tdat->sd < -900.0) /* sd was initialized -999 as flag */
+  {
+    tdat->sd = 1.0; /* reflag as having completed calculations */
+    if (pdat->function | CD_MASK)
+      tdat->cd = cos(kStageDegreesToRadians * pdat->declin);
+    if (pdat->function | CH_MASK)
+      tdat->ch = cos(kStageDegreesToRadians * pdat->hrang);
+    if (pdat->function | CL_MASK)
+      tdat->cl = cos(kStageDegreesToRadians * pdat->latitude);
+    if (pdat->function | SD_MASK)
+      tdat->sd = sin(kStageDegreesToRadians * pdat->declin);
+    if (pdat->function | SL_MASK)
+      tdat->sl = sin(kStageDegreesToRadians * pdat->latitude);
+  }
+#undef SD_MASK
+#undef SL_MASK
+#undef CL_MASK
+#undef CD_MASK
+#undef CH_MASK
+}
+
+/*============================================================================
+ *    Void function hour_angle
+ *
+ *    The site-dependent end of ecliptic(): from gmst, rascen and longitude
+ *    to the hour angle.  Sites sharing a time and timezone share the rest.
+ *----------------------------------------------------------------------------*/
+template <typename P>
+void hour_angle(P *pdat) {
+  /* Local mean sidereal time */
+  /*  Michalsky, J.  1988.  The Astronomical Almanac's algorithm for
+      approximate solar position (1950-2050).  Solar Energy 40 (3),
+      pp. 227-235. */
+  pdat->lmst = pdat->gmst * 15.0 + pdat->longitude;
+
+  /* (dump the multiples of 360, so the answer is between 0 and 360) */
+  pdat->lmst -= 360.0 * static_cast<int>(value(pdat->lmst) / 360.0);
+  if (pdat->lmst < 0.0) pdat->lmst += 360.0;
+
+  /* Hour angle */
+  /*  Michalsky, J.  1988.  The Astronomical Almanac's algorithm for
+      approximate solar position (1950-2050).  Solar Energy 40 (3),
+      pp. 227-235. */
+  pdat->hrang = pdat->lmst - pdat->rascen;
+
+  /* (force it between -180 and 180 degrees) */
+  if (pdat->hrang < -180.0)
+    pdat->hrang += 360.0;
+  else if (pdat->hrang > 180.0)
+    pdat->hrang -= 360.0;
+}
+
+/*============================================================================
+ *    Void function ecliptic
+ *
+ *    The part of geometry() after the time terms: from ectime and utime
+ *    to declination and hour angle
+ *----------------------------------------------------------------------------*/
+template <typename P>
+void ecliptic(P *pdat) {
+  typedef typename stage_scalar<P>::type T;
+  using std::asin;
+  using std::atan2;
+  using std::cos;
+  using std::sin;
+  T bottom; /* denominator (bottom) of the fraction */
+  T top;    /* numerator (top) of the fraction */
+
+  /* Mean longitude */
+  /*  Michalsky, J.  1988.  The Astronomical Almanac's algorithm for
+      approximate solar position (1950-2050).  Solar Energy 40 (3),
+      pp. 227-235. */
+  pdat->mnlong = 280.460 + 0.9856474 * pdat->ectime;
+
+  /* (dump the multiples of 360, so the answer is between 0 and 360) */
+  pdat->mnlong -= 360.0 * static_cast<int>(value(pdat->mnlong) / 360.0);
+  if (pdat->mnlong < 0.0) pdat->mnlong += 360.0;
+
+  /* Mean anomaly */
+  /*  Michalsky, J.  1988.  The Astronomical Almanac's algorithm for
+      approximate solar position (1950-2050).  Solar Energy 40 (3),
+      pp. 227-235. */
+  pdat->mnanom = 357.528 + 0.9856003 * pdat->ectime;
+
+  /* (dump the multiples of 360, so the answer is between 0 and 360) */
+  pdat->mnanom -= 360.0 * static_cast<int>(value(pdat->mnanom) / 360.0);
+  if (pdat->mnanom < 0.0) pdat->mnanom += 360.0;
+
+  /* Ecliptic longitude */
+  /*  Michalsky, J.  1988.  The Astronomical Almanac's algorithm for
+      approximate solar position (1950-2050).  Solar Energy 40 (3),
+      pp. 227-235. */
+  pdat->eclong = pdat->mnlong +
+                 1.915 * sin(pdat->mnanom * kStageDegreesToRadians) +
+                 0.020 * sin(2.0 * pdat->mnanom * kStageDegreesToRadians);
+
+  /* (dump the multiples of 360, so the answer is between 0 and 360) */
+  pdat->eclong -= 360.0 * static_cast<int>(value(pdat->eclong) / 360.0);
+  if (pdat->eclong < 0.0) pdat->eclong += 360.0;
+
+  /* Obliquity of the ecliptic */
+  /*  Michalsky, J.  1988.  The Astronomical Almanac's algorithm for
+      approximate solar position (1950-2050).  Solar Energy 40 (3),
+      pp. 227-235. */
+
+  /* 02 Feb 2001 SMW corrected sign in the following line */
+  /*  pdat->ecobli = 23.439 + 4.0e-07 * pdat->ectime;     */
+  pdat->ecobli = 23.439 - 4.0e-07 * pdat->ectime;
+
+  /* Declination */
+  /*  Michalsky, J.  1988.  The Astronomical Almanac's algorithm for
+      approximate solar position (1950-2050).  Solar Energy 40 (3),
+      pp. 227-235. */
+  pdat->declin =
+      kStageRadiansToDegrees * asin(sin(pdat->ecobli * kStageDegreesToRadians) *
+                                    sin(pdat->eclong * kStageDegreesToRadians));
+
+  /* Right ascension */
+  /*  Michalsky, J.  1988.  The Astronomical Almanac's algorithm for
+      approximate solar position (1950-2050).  Solar Energy 40 (3),
+      pp. 227-235. */
+  top = cos(kStageDegreesToRadians * pdat->ecobli) *
+        sin(kStageDegreesToRadians * pdat->eclong);
+  bottom = cos(kStageDegreesToRadians * pdat->eclong);
+
+  pdat->rascen = kStageRadiansToDegrees * atan2(top, bottom);
+
+  /* (make it a positive angle) */
+  if (pdat->rascen < 0.0) pdat->rascen += 360.0;
+
+  /* Greenwich mean sidereal time */
+  /*  Michalsky, J.  1988.  The Astronomical Almanac's algorithm for
+      approximate solar position (1950-2050).  Solar Energy 40 (3),
+      pp. 227-235. */
+  pdat->gmst = 6.697375 + 0.0657098242 * pdat->ectime + pdat->utime;
+
+  /* (dump the multiples of 24, so the answer is between 0 and 24) */
+  pdat->gmst -= 24.0 * static_cast<int>(value(pdat->gmst) / 24.0);
+  if (pdat->gmst < 0.0) pdat->gmst += 24.0;
+
+  hour_angle(pdat);
+}
+
+/*============================================================================
+ *    Void function zen_no_ref
+ *
+ *    ETR solar zenith angle
+ *       Iqbal, M.  1983.  An Introduction to Solar Radiation.
+ *            Academic Press, NY., page 15
+ *----------------------------------------------------------------------------*/
+template <typename P, typename T>
+void zen_no_ref(P *pdat, trigdata<T> *tdat) {
+  using std::abs;
+  using std::acos;
+  T cz; /* cosine of the solar zenith angle */
+
+  localtrig(pdat, tdat);
+  cz = tdat->sd * tdat->sl + tdat->cd * tdat->cl * tdat->ch;
+
+  /* (watch out for the roundoff errors) */
+  if (abs(cz) > 1.0) {
+    if (cz >= 0.0)
+      cz = 1.0;
+    else
+      cz = -1.0;
+  }
+
+  pdat->zenetr = acos(cz) * kStageRadiansToDegrees;
+
+  /* (limit the degrees below the horizon to 9 [+90 -> 99]) */
+  if (pdat->zenetr > 99.0) pdat->zenetr = 99.0;
+
+  pdat->elevetr = 90.0 - pdat->zenetr;
+}
+
+/*============================================================================
+ *    Void function sazm
+ *
+ *    Solar azimuth angle
+ *       Iqbal, M.  1983.  An Introduction to Solar Radiation.
+ *            Academic Press, NY., page 15
+ *----------------------------------------------------------------------------*/
+template <typename P, typename T>
+void sazm(P *pdat, trigdata<T> *tdat) {
+  using std::abs;
+  using std::acos;
+  using std::cos;
+  using std::sin;
+  T ca;   /* cosine of the solar azimuth angle */
+  T ce;   /* cosine of the solar elevation */
+  T cecl; /* ( ce * cl ) */
+  T se;   /* sine of the solar elevation */
+
+  localtrig(pdat, tdat);
+  ce = cos(kStageDegreesToRadians * pdat->elevetr);
+  se = sin(kStageDegreesToRadians * pdat->elevetr);
+
+  pdat->azim = 180.0;
+  cecl = ce * tdat->cl;
+  if (abs(cecl) >= 0.001) {
+    ca = (se * tdat->sl - tdat->sd) / cecl;
+    if (ca > 1.0)
+      ca = 1.0;
+    else if (ca < -1.0)
+      ca = -1.0;
+
+    pdat->azim = 180.0 - acos(ca) * kStageRadiansToDegrees;
+    if (pdat->hrang > 0) pdat->azim = 360.0 - pdat->azim;
+  }
+}
+
+/*============================================================================
+ *    Int function refrac
+ *
+ *    Refraction correction, degrees; closed takes tan^3 and tan^5 as
+ *    products (no pow) for the real-time path
+ *        Zimmerman, John C.  1981.  Sun-pointing programs and their
+ *            accuracy.
+ *            SAND81-0761, Experimental Systems Operation Division 4721,
+ *            Sandia National Laboratories, Albuquerque, NM.
+ *----------------------------------------------------------------------------*/
+template <typename P>
+void refrac(P *pdat, bool closed = false) {
+  typedef typename stage_scalar<P>::type T;
+  using std::cos;
+  using std::pow;
+  using std::tan;
+  T prestemp; /* temporary pressure/temperature correction */
+  T refcor;   /* temporary refraction correction */
+  T tanelev;  /* tangent of the solar elevation angle */
+  T tan2;     /* its square */
+
+  /* If the sun is near zenith, the algorithm bombs; refraction near 0 */
+  if (pdat->elevetr > 85.0) refcor = 0.0;
+
+  /* Otherwise, we have refraction */
+  else {
+    tanelev = tan(kStageDegreesToRadians * pdat->elevetr);
+    if (pdat->elevetr >= 5.0) {
+      if (closed) {
+        tan2 = tanelev * tanelev;
+        refcor = 58.1 / tanelev - 0.07 / (tan2 * tanelev) +
+                 0.000086 / (tan2 * tan2 * tanelev);
+      } else
+        refcor = 58.1 / tanelev - 0.07 / (pow(tanelev, 3)) +
+                 0.000086 / (pow(tanelev, 5));
+    } else if (pdat->elevetr >= -0.575)
+      refcor =
+          1735.0 +
+          pdat->elevetr *
+              (-518.2 +
+               pdat->elevetr *
+                   (103.4 + pdat->elevetr * (-12.79 + pdat->elevetr * 0.711)));
+    else
+      refcor = -20.774 / tanelev;
+
+    prestemp = (pdat->press * 283.0) / (1013.0 * (273.0 + pdat->temp));
+    refcor *= prestemp / 3600.0;
+  }
+
+  /* Refracted solar elevation angle */
+  pdat->elevref = pdat->elevetr + refcor;
+
+  /* (limit the degrees below the horizon to 9) */
+  if (pdat->elevref < -9.0) pdat->elevref = -9.0;
+
+  /* Refracted solar zenith angle */
+  pdat->zenref = 90.0 - pdat->elevref;
+  pdat->coszen = cos(kStageDegreesToRadians * pdat->zenref);
+}
+
+/*============================================================================
+ *    Void function tilt
+ *
+ *    ETR on a tilted surface
+ *----------------------------------------------------------------------------*/
+template <typename P>
+void tilt(P *pdat) {
+  typedef typename stage_scalar<P>::type T;
+  using std::cos;
+  using std::sin;
+  T ca; /* cosine of the solar azimuth angle */
+  T cp; /* cosine of the panel aspect */
+  T ct; /* cosine of the panel tilt */
+  T sa; /* sine of the solar azimuth angle */
+  T sp; /* sine of the panel aspect */
+  T st; /* sine of the panel tilt */
+  T sz; /* sine of the refraction corrected solar zenith angle */
+
+  /* Cosine of the angle between the sun and a tipped flat surface,
+     useful for calculating solar energy on tilted surfaces */
+  ca = cos(kStageDegreesToRadians * pdat->azim);
+  cp = cos(kStageDegreesToRadians * pdat->aspect);
+  ct = cos(kStageDegreesToRadians * pdat->tilt);
+  sa = sin(kStageDegreesToRadians * pdat->azim);
+  sp = sin(kStageDegreesToRadians * pdat->aspect);
+  st = sin(kStageDegreesToRadians * pdat->tilt);
+  sz = sin(kStageDegreesToRadians * pdat->zenref);
+  pdat->cosinc = pdat->coszen * ct + sz * st * (ca * cp + sa * sp);
+
+  if (pdat->cosinc > 0.0)
+    pdat->etrtilt = pdat->etrn * pdat->cosinc;
+  else
+    pdat->etrtilt = 0.0;
+}
+
+}  // namespace internal
+}  // namespace solpos
+
+#endif  // SOLPOS_STAGES_H_
@@ -329,5 +329,167 @@ TEST(SolPosTest, Works) {
   EXPECT_NEAR(pdat->amass, 1.00, 1e-2);
 }
 
+TEST(SolPosTest, DecodeList) {
+  posdata pd;
+  int errors[S_ERROR_COUNT];
+
+  S_init(&pd); /* required inputs are deliberately out of bounds */
+  int code = S_solpos(&pd);
+  int n = S_decode_list(code, errors, S_ERROR_COUNT);
+
+  ASSERT_EQ(n, 8);
+  EXPECT_EQ(errors[0], S_YEAR_ERROR);
+  EXPECT_EQ(errors[1], S_DOY_ERROR);
+  EXPECT_EQ(errors[2], S_HOUR_ERROR);
+  EXPECT_EQ(errors[7], S_LON_ERROR);
+  EXPECT_STREQ(S_error_name(errors[1]), "day-of-year");
+  EXPECT_STREQ(S_error_name(S_ERROR_COUNT), "unknown");
+
+  /* Only max_errors are written, but all are counted */
+  errors[1] = -1;
+  EXPECT_EQ(S_decode_list(code, errors, 1), 8);
+  EXPECT_EQ(errors[1], -1);
+  EXPECT_EQ(S_decode_list(0, errors, S_ERROR_COUNT), 0);
+}
+
+TEST(SolPosTest, FormatError) {
+  posdata pd;
+  char buf[256];
+
+  S_init(&pd);
+  pd.year = 99;
+  pd.timezone = -13.5;
+  int code = (1L << S_YEAR_ERROR) | (1L << S_TZONE_ERROR);
+
+  int len = S_format_error(code, &pd, buf, sizeof(buf));
+  EXPECT_STREQ(buf,
+               "S_decode ==> Please fix the year: 99 [1950-2050]\n"
+               "S_decode ==> Please fix the time zone: -13.5\n");
+  EXPECT_EQ(len, static_cast<int>(strlen(buf)));
+
+  /* Truncated output is still terminated and reports the full length */
+  char small[10];
+  EXPECT_EQ(S_format_error(code, &pd, small, sizeof(small)), len);
+  EXPECT_STREQ(small, "S_decode ");
+  EXPECT_EQ(S_format_error(0, &pd, buf, sizeof(buf)), 0);
+  EXPECT_STREQ(buf, "");
+}
+
+TEST(SolPosTest, ErrstatsAddAndMerge) {
+  errstats even, odd;
+
+  S_errstats_init(&even);
+  S_errstats_init(&odd);
+  for (long long row = 0; row < 100; ++row) {
+    int code = 0;
+    if (row % 10 == 3) code |= 1L << S_LAT_ERROR;
+    if (row == 42) code |= 1L << S_PRESS_ERROR;
+    S_errstats_add((row % 2) ? &odd : &even, code, row);
+  }
+  EXPECT_EQ(odd.count[S_LAT_ERROR], 10);
+  EXPECT_EQ(even.count[S_PRESS_ERROR], 1);
+
+  S_errstats_merge(&even, &odd);
+  EXPECT_EQ(even.rows, 100);
+  EXPECT_EQ(even.bad_rows, 11);
+  EXPECT_EQ(even.count[S_LAT_ERROR], 10);
+  EXPECT_EQ(even.count[S_PRESS_ERROR], 1);
+  EXPECT_EQ(even.count[S_YEAR_ERROR], 0);
+  EXPECT_EQ(even.first[S_PRESS_ERROR][0], 42);
+  for (int i = 0; i < S_ERRSTATS_ROWS; ++i)
+    EXPECT_EQ(even.first[S_LAT_ERROR][i], 10 * i + 3);
+
+  /* Out-of-order rows still keep the lowest indices */
+  errstats late;
+  S_errstats_init(&late);
+  S_errstats_add(&late, 1L << S_LAT_ERROR, 1);
+  S_errstats_merge(&even, &late);
+  EXPECT_EQ(even.first[S_LAT_ERROR][0], 1);
+  EXPECT_EQ(even.first[S_LAT_ERROR][1], 3);
+  EXPECT_EQ(even.first[S_LAT_ERROR][S_ERRSTATS_ROWS - 1], 63);
+}
+
+TEST(SolPosTest, EpochMatchesCalendarInput) {
+  const int kHours[] = {0, 5, 9, 12, 17, 23};
+  const int kDays[] = {1, 59, 60, 203, 366};
+
+  for (int year : {1951, 1999, 2000, 2024, 2050}) {
+    for (int daynum : kDays) {
+      for (int hour : kHours) {
+        posdata cal, ep;
+        S_init(&cal);
+        cal.longitude = -84.43;
+        cal.latitude = 33.65;
+        cal.timezone = -5.0;
+        cal.year = year;
+        cal.daynum = daynum;
+        cal.hour = hour;
+        cal.minute = 45;
+        cal.second = 37;
+        cal.interval = 60;
+        if ((daynum == 366) && (year % 4 != 0)) continue;
+        ASSERT_EQ(S_solpos(&cal), 0);
+
+        ep = cal;
+        ep.function |= S_EPOCH;
+        ep.epoch = S_epoch(cal.year, cal.month, cal.day, hour, 45, 37, -5.0);
+        ep.year = ep.month = ep.day = ep.daynum = -99;
+        ep.hour = ep.minute = ep.second = -99;
+        ASSERT_EQ(S_solpos(&ep), 0);
+
+        EXPECT_EQ(ep.year, year);
+        EXPECT_EQ(ep.daynum, daynum);
+        EXPECT_EQ(ep.month, cal.month);
+        EXPECT_EQ(ep.day, cal.day);
+        EXPECT_EQ(ep.hour, hour);
+        EXPECT_EQ(ep.minute, 45);
+        EXPECT_EQ(ep.second, 37);
+        EXPECT_NEAR(ep.julday, cal.julday, 1e-8);
+        EXPECT_NEAR(ep.utime, cal.utime, 1e-9);
+        EXPECT_NEAR(ep.zenref, cal.zenref, 1e-6);
+        EXPECT_NEAR(ep.azim, cal.azim, 1e-6);
+        EXPECT_NEAR(ep.tstfix, cal.tstfix, 1e-6);
+        EXPECT_NEAR(ep.sretr, cal.sretr, 1e-6);
+        EXPECT_NEAR(ep.etrtilt, cal.etrtilt, 1e-6);
+      }
+    }
+  }
+}
+
+TEST(SolPosTest, EpochInput) {
+  posdata pd;
+
+  EXPECT_EQ(S_epoch(1970, 1, 1, 0, 0, 0, 0.0), 0);
+  EXPECT_EQ(S_epoch(2000, 1, 1, 12, 0, 0, 0.0), 946728000);
+  EXPECT_EQ(S_epoch(1999, 12, 31, 24, 0, 0, -5.0), 946702800);
+  EXPECT_EQ(S_epoch(1950, 1, 1, 0, 0, 0, 0.0), -631152000);
+
+  S_init(&pd);
+  pd.function = S_REFRAC | S_EPOCH; /* no L_TST */
+  pd.latitude = 33.65;
+  pd.longitude = -84.43;
+  pd.timezone = -5.0;
+  EXPECT_EQ(S_solpos(&pd), 1L << S_YEAR_ERROR); /* S_init epoch */
+
+  /* Noon 1 JAN 2000 UTC is the ecliptic time origin */
+  pd.epoch = 946728000;
+  pd.epochfrac = 0.25;
+  ASSERT_EQ(S_solpos(&pd), 0);
+  EXPECT_EQ(pd.ectime, 0.25 / 86400.0);
+  EXPECT_EQ(pd.year, 2000);
+  EXPECT_EQ(pd.daynum, 1);
+  EXPECT_EQ(pd.hour, -99); /* local time of day is only set for L_TST */
+
+  pd.epochfrac = 1.0;
+  EXPECT_EQ(S_solpos(&pd), 1L << S_SECOND_ERROR);
+
+  /* The year limits apply to the local standard date */
+  pd.epochfrac = 0.0;
+  pd.epoch = S_epoch(2051, 1, 1, 0, 0, 0, 0.0) - 1;
+  EXPECT_EQ(S_solpos(&pd), 0);
+  pd.timezone = 1.0;
+  EXPECT_EQ(S_solpos(&pd), 1L << S_YEAR_ERROR);
+}
+
 }  // namespace
 }  // namespace solpos
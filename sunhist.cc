@@ -0,0 +1,153 @@
+/*============================================================================
+ *    Contains:
+ *        S_solpos_sunhist
+ *----------------------------------------------------------------------------*/
+#include "sunhist.h"
+
+#include <algorithm>
+#include <climits>
+#include <mutex>
+#include <vector>
+
+#include "parallel.h"
+#include "realtime.h"
+#include "solpos_internal.h"
+
+namespace solpos {
+
+/*============================================================================
+*    Local constants and function prototypes
+============================================================================*/
+/* Samples of one site per unit of work */
+static const int kChunk = 8192;
+
+static int open_site(const posdata *site, const histspec *spec,
+                     rtcontext *ctx);
+static void bin_samples(const rtcontext *ctx, const histspec *spec,
+                        int first, int count, double *hist,
+                        double *blocked);
+
+/*============================================================================
+ *    Local int function open_site
+ *
+ *    Validates a site and the whole series against it into *ctx
+ *----------------------------------------------------------------------------*/
+static int open_site(const posdata *site, const histspec *spec,
+                     rtcontext *ctx) {
+  posdata pd = *site;
+  int retval;
+
+  pd.function = (S_SOLAZM | S_REFRAC) & ~L_DOY;
+  if (spec->weight != S_HIST_HOURS) pd.function |= S_ETR & ~L_DOY;
+  if (spec->weight == S_HIST_ETRN_COSINC) pd.function |= S_TILT & ~L_DOY;
+  retval = S_rt_init(ctx, &pd);
+  if ((retval != 0) || (spec->samples == 0)) return retval;
+
+  const long long last =
+      spec->start + static_cast<long long>(spec->samples - 1) * spec->step;
+  if ((spec->start < ctx->first) || (last >= ctx->last))
+    return 1L << S_YEAR_ERROR;
+  return 0;
+}
+
+/*============================================================================
+ *    Local void function bin_samples
+ *
+ *    Adds the unscaled weights (1, etrn or etrn * cosinc) of samples
+ *    [first, first + count) to one site's hist and blocked
+ *----------------------------------------------------------------------------*/
+static void bin_samples(const rtcontext *ctx, const histspec *spec,
+                        int first, int count, double *hist,
+                        double *blocked) {
+  const double azim_scale = spec->azim_bins / 360.0;
+  const double elev_scale = spec->elev_bins / 90.0;
+  posdata pd;
+
+  /* open_site checked the whole series: the stages of S_solpos directly */
+  for (int k = first; k < first + count; ++k) {
+    pd = ctx->site;
+    pd.epoch = spec->start + static_cast<long long>(k) * spec->step;
+    pd.epochfrac = 0.0;
+    internal::compute(&pd);
+    if (!(pd.elevref > 0.0)) continue;
+
+    const int a = std::min(static_cast<int>(pd.azim * azim_scale),
+                           spec->azim_bins - 1);
+    const int e = std::min(static_cast<int>(pd.elevref * elev_scale),
+                           spec->elev_bins - 1);
+    double w = 1.0;
+    if (spec->weight == S_HIST_ETRN) w = pd.etrn;
+    if (spec->weight == S_HIST_ETRN_COSINC)
+      w = pd.etrn * std::max(pd.cosinc, 0.0);
+
+    if (spec->horizon && (pd.elevref <= spec->horizon[a])) {
+      if (blocked) blocked[e * spec->azim_bins + a] += w;
+    } else {
+      hist[e * spec->azim_bins + a] += w;
+    }
+  }
+}
+
+/*============================================================================
+ *    Int function S_solpos_sunhist
+ *----------------------------------------------------------------------------*/
+int S_solpos_sunhist(int sites, const posdata *site, const histspec *spec,
+                     int threads, int *errors, double *hist,
+                     double *blocked) {
+  std::mutex merge;
+  int summary = 0;
+
+  if ((spec->step < 1) || (spec->samples < 0) || (spec->azim_bins < 1) ||
+      (spec->elev_bins < 1) || (spec->weight < S_HIST_HOURS) ||
+      (spec->weight > S_HIST_ETRN_COSINC))
+    return 1L << S_INTRVL_ERROR;
+
+  const int cells = spec->azim_bins * spec->elev_bins;
+  const double hours = spec->step / 3600.0;
+  int size = kChunk, chunks;
+
+  /* fewer, longer chunks should sites * chunks pass INT_MAX */
+  if ((sites > 0) && ((spec->samples - 1) / size >= INT_MAX / sites))
+    size = spec->samples / (INT_MAX / sites) + 1;
+  chunks = std::max(1, (spec->samples + size - 1) / size);
+
+  /* units u = s * chunks + c, chunk c of site s; a range of them covers
+     whole sites but perhaps its first and last */
+  internal::parallel_for(
+      sites * chunks, threads,
+      [&](int first, int n) {
+        std::vector<double> local(cells), shade(blocked ? cells : 0);
+        rtcontext ctx;
+        int code = 0;
+
+        for (int u = first; u < first + n; ++u) {
+          const int s = u / chunks, c = u % chunks;
+          if ((u == first) || (c == 0)) {
+            code = open_site(&site[s], spec, &ctx);
+            if (c == 0) errors[s] = code;
+          }
+          if (code != 0) continue;
+
+          const int from = c * size;
+          bin_samples(&ctx, spec, from, std::min(size, spec->samples - from),
+                      local.data(), shade.empty() ? nullptr : shade.data());
+          if ((u + 1 < first + n) && (c + 1 < chunks)) continue;
+
+          /* leaving site s: add what this thread binned and clear it */
+          std::lock_guard<std::mutex> lock(merge);
+          double *to = hist + static_cast<long long>(s) * cells;
+          for (int i = 0; i < cells; ++i) to[i] += local[i] * hours;
+          std::fill(local.begin(), local.end(), 0.0);
+          if (!blocked) continue;
+          to = blocked + static_cast<long long>(s) * cells;
+          for (int i = 0; i < cells; ++i) to[i] += shade[i] * hours;
+          std::fill(shade.begin(), shade.end(), 0.0);
+        }
+      },
+      1);
+
+  for (int s = 0; s < sites; ++s) summary |= errors[s];
+  return summary;
+}
+
+}  // namespace solpos
@@ -0,0 +1,86 @@
+/*============================================================================
+ *
+ *    NAME:  sunhist.h
+ *
+ *    Contains:
+ *        S_solpos_sunhist  (azimuth by elevation histograms of the sun over
+ *                           a regular time series, per site, weighted by
+ *                           hours or energy, split by a horizon mask)
+ *
+ *            INPUTS:     a table of sites (posdata, as for S_rt_init) and
+ *                        a histspec: the series, the grid, the weight and
+ *                        an optional horizon
+ *
+ *            OUTPUTS:    per site, the weight of the samples with the sun
+ *                        above the horizon mask, and (optionally) of those
+ *                        with it up but behind the mask, per grid cell
+ *
+ *    Sun-path diagrams and solar-access studies bin a year of positions
+ *    into a fixed angular grid; this bins them as they are computed, so no
+ *    position is ever stored.  Each site's series is cut into chunks and
+ *    the (site, chunk) units spread over threads; a thread bins into its
+ *    own histogram and adds it to the site's output (under a lock) when it
+ *    moves on to another site, so a site split across threads is merged
+ *    and the others are added once.
+ *
+ *    Grid:  azimuth [0, 360) in azim_bins equal columns (as posdata::azim,
+ *           east of north), elevation (0, 90] in elev_bins equal rows;
+ *           cell (row e, column a) is hist[e * azim_bins + a].  Samples
+ *           with elevref <= 0 are not binned.
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_SUNHIST_H_
+#define SOLPOS_SUNHIST_H_
+
+#include "solpos.h"
+
+namespace solpos {
+
+/* Weights of histspec, per sample step seconds long */
+#define S_HIST_HOURS 1       /* hours: step / 3600 */
+#define S_HIST_ETRN 2        /* Wh/sq m normal: etrn * step / 3600 */
+#define S_HIST_ETRN_COSINC 3 /* Wh/sq m on the site's tilt and aspect:
+                                etrn * max(cosinc, 0) * step / 3600 */
+
+struct histspec {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  long long start;       /* I:  Epoch of the first sample */
+  int step;              /* I:  Seconds between samples, >= 1 */
+  int samples;           /* I:  Samples per site, >= 0 */
+  int azim_bins;         /* I:  Azimuth columns of the grid, >= 1 */
+  int elev_bins;         /* I:  Elevation rows of the grid, >= 1 */
+  int weight;            /* I:  S_HIST_HOURS, S_HIST_ETRN or
+                                S_HIST_ETRN_COSINC */
+  const double *horizon; /* I:  Elevation of the horizon and obstructions
+                                per azimuth column, degrees; a sample at
+                                or below it is blocked (nullptr = none) */
+};
+
+/*============================================================================
+ *    Int function S_solpos_sunhist
+ *
+ *    For each of site[0 .. sites - 1], computes the series spec->start +
+ *    k * spec->step, k < spec->samples (the S_SOLAZM and S_REFRAC stages,
+ *    with S_ETR and S_TILT as the weight needs; the other inputs are the
+ *    site's), and adds each sample's weight to its cell of the site's
+ *    histogram.  The (site, chunk) units are spread over threads (0 = one
+ *    per hardware thread).  A site with an error adds nothing.
+ *
+ *    OUTPUTS: errors[s] = 0, the S_rt_init code of site s, or
+ *             (1L << S_YEAR_ERROR) for a series reaching outside its
+ *             1950 - 2050 local dates; added to hist[s * cells + cell] for
+ *             samples not blocked, and to blocked[s * cells + cell] (when
+ *             not nullptr) for those blocked, cells = azim_bins * elev_bins.
+ *             The caller clears hist and blocked, or keeps adding to them.
+ *
+ *    RETURNS: The OR of all site codes, or (1L << S_INTRVL_ERROR) (and
+ *             nothing computed) for a bad step, samples, grid or weight
+ *----------------------------------------------------------------------------*/
+int S_solpos_sunhist(int sites, const posdata *site, const histspec *spec,
+                     int threads, int *errors, double *hist,
+                     double *blocked);
+
+}  // namespace solpos
+
+#endif  // SOLPOS_SUNHIST_H_
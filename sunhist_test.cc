@@ -0,0 +1,155 @@
+#include "sunhist.h"
+
+#include <algorithm>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace solpos {
+namespace {
+
+posdata Site(double latitude) {
+  posdata pd;
+  S_init(&pd);
+  pd.latitude = latitude;
+  pd.longitude = -105.0;
+  pd.timezone = -7.0;
+  pd.tilt = 35.0;
+  pd.aspect = 180.0;
+  return pd;
+}
+
+/* One site's histograms by S_solpos, sample by sample */
+void Expected(const posdata &site, const histspec &spec, double *hist,
+              double *blocked) {
+  const int cells = spec.azim_bins * spec.elev_bins;
+  std::fill(hist, hist + cells, 0.0);
+  std::fill(blocked, blocked + cells, 0.0);
+  for (int k = 0; k < spec.samples; ++k) {
+    posdata pd = site;
+    pd.function = S_EPOCH | ((S_SOLAZM | S_REFRAC | S_ETR | S_TILT) & ~L_DOY);
+    pd.epoch = spec.start + static_cast<long long>(k) * spec.step;
+    pd.epochfrac = 0.0;
+    ASSERT_EQ(S_solpos(&pd), 0);
+    if (pd.elevref <= 0.0) continue;
+    int a = static_cast<int>(pd.azim * (spec.azim_bins / 360.0));
+    int e = static_cast<int>(pd.elevref * (spec.elev_bins / 90.0));
+    a = std::min(a, spec.azim_bins - 1);
+    e = std::min(e, spec.elev_bins - 1);
+    double w = spec.step / 3600.0;
+    if (spec.weight == S_HIST_ETRN) w *= pd.etrn;
+    if (spec.weight == S_HIST_ETRN_COSINC)
+      w *= pd.etrn * std::max(pd.cosinc, 0.0);
+    bool hidden = spec.horizon && pd.elevref <= spec.horizon[a];
+    (hidden ? blocked : hist)[e * spec.azim_bins + a] += w;
+  }
+}
+
+TEST(SunhistTest, MatchesSolposAcrossThreads) {
+  std::vector<posdata> site;
+  site.push_back(Site(40.0));
+  site.push_back(Site(-20.0));
+  site.push_back(Site(65.0));
+  /* 20 days a minute apart: three chunks per site, split over threads */
+  histspec spec = {S_epoch(2021, 3, 10, 0, 0, 0, -7.0), 60, 20 * 1440, 36,
+                   9, S_HIST_ETRN_COSINC, nullptr};
+  std::vector<double> horizon(36, 5.0);
+  for (int a = 9; a < 18; ++a) horizon[a] = 25.0; /* a ridge to the SE */
+  spec.horizon = horizon.data();
+
+  const int cells = 36 * 9;
+  for (int threads = 1; threads <= 4; threads += 3) {
+    std::vector<int> errors(3, -1);
+    std::vector<double> hist(3 * cells), blocked(3 * cells);
+    ASSERT_EQ(S_solpos_sunhist(3, site.data(), &spec, threads, errors.data(),
+                               hist.data(), blocked.data()),
+              0);
+    for (int s = 0; s < 3; ++s) {
+      EXPECT_EQ(errors[s], 0);
+      std::vector<double> want(cells), want_blocked(cells);
+      Expected(site[s], spec, want.data(), want_blocked.data());
+      double seen = 0.0, hidden = 0.0;
+      for (int i = 0; i < cells; ++i) {
+        EXPECT_NEAR(hist[s * cells + i], want[i], 1e-9 * (1.0 + want[i]))
+            << "site " << s << " cell " << i << " threads " << threads;
+        EXPECT_NEAR(blocked[s * cells + i], want_blocked[i],
+                    1e-9 * (1.0 + want_blocked[i]))
+            << "site " << s << " cell " << i << " threads " << threads;
+        seen += hist[s * cells + i];
+        hidden += blocked[s * cells + i];
+      }
+      EXPECT_GT(seen, 0.0);
+      EXPECT_GT(hidden, 0.0);
+    }
+  }
+}
+
+TEST(SunhistTest, HoursAddUpToSunHours) {
+  posdata site = Site(40.0);
+  histspec spec = {S_epoch(2021, 6, 21, 0, 0, 0, -7.0), 60, 1440, 8, 3,
+                   S_HIST_HOURS, nullptr};
+  int error = -1;
+  std::vector<double> hist(24, 0.0);
+  ASSERT_EQ(S_solpos_sunhist(1, &site, &spec, 1, &error, hist.data(),
+                             nullptr),
+            0);
+
+  int sunup = 0;
+  for (int k = 0; k < spec.samples; ++k) {
+    posdata pd = site;
+    pd.function = S_EPOCH | (S_REFRAC & ~L_DOY);
+    pd.epoch = spec.start + 60LL * k;
+    S_solpos(&pd);
+    sunup += pd.elevref > 0.0;
+  }
+  double total = 0.0;
+  for (int i = 0; i < 24; ++i) total += hist[i];
+  EXPECT_NEAR(total, sunup / 60.0, 1e-9);
+  /* the sun never reaches 60 degrees elevation in the north */
+  EXPECT_EQ(hist[2 * 8 + 0], 0.0);
+  EXPECT_EQ(hist[2 * 8 + 7], 0.0);
+
+  /* adding a second call doubles it */
+  ASSERT_EQ(S_solpos_sunhist(1, &site, &spec, 1, &error, hist.data(),
+                             nullptr),
+            0);
+  total = 0.0;
+  for (int i = 0; i < 24; ++i) total += hist[i];
+  EXPECT_NEAR(total, 2.0 * sunup / 60.0, 1e-9);
+}
+
+TEST(SunhistTest, Errors) {
+  std::vector<posdata> site;
+  site.push_back(Site(40.0));
+  site.push_back(Site(40.0));
+  site[1].tilt = 200.0; /* bad only when tilt is computed */
+  histspec spec = {S_epoch(2021, 6, 21, 0, 0, 0, -7.0), 600, 144, 4, 2,
+                   S_HIST_ETRN, nullptr};
+  std::vector<int> errors(2, -1);
+  std::vector<double> hist(16, 0.0);
+  EXPECT_EQ(S_solpos_sunhist(2, site.data(), &spec, 1, errors.data(),
+                             hist.data(), nullptr),
+            0);
+
+  spec.weight = S_HIST_ETRN_COSINC;
+  std::fill(hist.begin(), hist.end(), 0.0);
+  EXPECT_EQ(S_solpos_sunhist(2, site.data(), &spec, 1, errors.data(),
+                             hist.data(), nullptr),
+            1L << S_TILT_ERROR);
+  EXPECT_EQ(errors[0], 0);
+  EXPECT_EQ(errors[1], 1L << S_TILT_ERROR);
+  for (int i = 8; i < 16; ++i) EXPECT_EQ(hist[i], 0.0);
+
+  spec.start = S_epoch(2050, 12, 31, 23, 0, 0, -7.0);
+  EXPECT_EQ(S_solpos_sunhist(1, site.data(), &spec, 1, errors.data(),
+                             hist.data(), nullptr),
+            1L << S_YEAR_ERROR);
+
+  spec.azim_bins = 0;
+  EXPECT_EQ(S_solpos_sunhist(1, site.data(), &spec, 1, errors.data(),
+                             hist.data(), nullptr),
+            1L << S_INTRVL_ERROR);
+}
+
+}  // namespace
+}  // namespace solpos
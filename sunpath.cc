@@ -0,0 +1,203 @@
+/*============================================================================
+ *    Contains:
+ *        S_sunpath_create, S_sunpath_fill, S_sunpath_read, S_sunpath_destroy
+ *----------------------------------------------------------------------------*/
+#include "sunpath.h"
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "realtime.h"
+
+namespace solpos {
+
+/*============================================================================
+*    Local constants, types and function prototypes
+============================================================================*/
+static const double kNaN = std::numeric_limits<double>::quiet_NaN();
+
+/* One sample; index is -1 while the producer rewrites it */
+struct sunslot {
+  std::atomic<long long> index;
+  std::atomic<int> error;
+  std::atomic<double> azim, elevref, etrn, cosinc;
+};
+
+struct sunpath {
+  rtcontext ctx;
+  sunpathspec spec;
+  long long mask;  /* slots - 1, slots a power of two >= samples + 2 */
+  std::unique_ptr<sunslot[]> slots;
+  long long next;  /* next sample index the producer computes */
+
+  std::thread producer;
+  std::mutex mu;
+  std::condition_variable wake;
+  bool stop;
+};
+
+static long long system_now(void *);
+static long long floor_div(long long num, long long den);
+static void produce(sunpath *path);
+
+/*============================================================================
+ *    Local long long function system_now
+ *----------------------------------------------------------------------------*/
+static long long system_now(void *) {
+  return std::chrono::duration_cast<std::chrono::seconds>(
+             std::chrono::system_clock::now().time_since_epoch())
+      .count();
+}
+
+/*============================================================================
+ *    Local long long function floor_div
+ *
+ *    Integer division rounding toward negative infinity (den > 0)
+ *----------------------------------------------------------------------------*/
+static long long floor_div(long long num, long long den) {
+  long long quot = num / den;
+
+  if ((num % den) < 0) --quot;
+  return quot;
+}
+
+/*============================================================================
+ *    Local void function produce
+ *
+ *    Body of the background thread: fills, then sleeps poll milliseconds
+ *    or until told to stop
+ *----------------------------------------------------------------------------*/
+static void produce(sunpath *path) {
+  std::chrono::milliseconds poll(path->spec.poll);
+  std::unique_lock<std::mutex> lock(path->mu);
+
+  while (!path->stop) {
+    lock.unlock();
+    S_sunpath_fill(path);
+    lock.lock();
+    path->wake.wait_for(lock, poll, [path] { return path->stop; });
+  }
+}
+
+/*============================================================================
+ *    Int function S_sunpath_create
+ *----------------------------------------------------------------------------*/
+int S_sunpath_create(const posdata *site, const sunpathspec *spec,
+                     int background, sunpath **path) {
+  std::unique_ptr<sunpath> made(new sunpath);
+  posdata stages = *site;
+  long long slots = 1;
+  int retval;
+
+  *path = nullptr;
+  if ((spec->step < 1) || (spec->samples < 1))
+    return (1L << S_INTRVL_ERROR);
+
+  /* azim, elevref, etrn and cosinc; the date comes from the epoch */
+  stages.function = (S_SOLAZM | S_REFRAC | S_ETR | S_TILT) & ~L_DOY;
+  if ((retval = S_rt_init(&made->ctx, &stages)) != 0) return retval;
+
+  made->spec = *spec;
+  if (!made->spec.clock) made->spec.clock = system_now;
+  if (made->spec.poll <= 0) made->spec.poll = spec->step * 250;
+
+  /* the samples ahead, the one at or before now and the one before it */
+  while (slots < spec->samples + 2LL) slots *= 2;
+  made->mask = slots - 1;
+  made->slots.reset(new sunslot[slots]);
+  for (long long i = 0; i < slots; ++i) made->slots[i].index.store(-1);
+  made->next = 0;
+  made->stop = false;
+
+  S_sunpath_fill(made.get());
+  if (background) made->producer = std::thread(produce, made.get());
+  *path = made.release();
+  return 0;
+}
+
+/*============================================================================
+ *    Void function S_sunpath_fill
+ *----------------------------------------------------------------------------*/
+void S_sunpath_fill(sunpath *path) {
+  const sunpathspec &spec = path->spec;
+  long long now = spec.clock(spec.clock_context);
+  long long current = floor_div(now - spec.start, spec.step);
+  long long last;
+  posdata pd;
+
+  /* samples older than now are of no use: skip them after a stall */
+  if (current < 0) current = 0;
+  last = current + spec.samples;
+  if (path->next < current) path->next = current;
+
+  for (; path->next <= last; ++path->next) {
+    long long i = path->next;
+    long long epoch = spec.start + i * spec.step;
+    sunslot &slot = path->slots[i & path->mask];
+    int error = S_rt_solpos(&path->ctx, epoch, 0.0, &pd);
+
+    /* mark the slot, then write it, then publish its new index */
+    slot.index.store(-1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    slot.error.store(error, std::memory_order_relaxed);
+    slot.azim.store(error ? kNaN : pd.azim, std::memory_order_relaxed);
+    slot.elevref.store(error ? kNaN : pd.elevref, std::memory_order_relaxed);
+    slot.etrn.store(error ? kNaN : pd.etrn, std::memory_order_relaxed);
+    slot.cosinc.store(error ? kNaN : pd.cosinc, std::memory_order_relaxed);
+    slot.index.store(i, std::memory_order_release);
+  }
+}
+
+/*============================================================================
+ *    Int function S_sunpath_read
+ *----------------------------------------------------------------------------*/
+int S_sunpath_read(const sunpath *path, long long epoch, int n,
+                   sunsample *out) {
+  const sunpathspec &spec = path->spec;
+  long long first = floor_div(epoch - spec.start, spec.step);
+  int k;
+
+  for (k = 0; k < n; ++k) {
+    long long i = first + k;
+    if (i < 0) break;
+    const sunslot &slot = path->slots[i & path->mask];
+    if (slot.index.load(std::memory_order_acquire) != i) break;
+
+    sunsample sample;
+    sample.epoch = spec.start + i * spec.step;
+    sample.error = slot.error.load(std::memory_order_relaxed);
+    sample.azim = slot.azim.load(std::memory_order_relaxed);
+    sample.elevref = slot.elevref.load(std::memory_order_relaxed);
+    sample.etrn = slot.etrn.load(std::memory_order_relaxed);
+    sample.cosinc = slot.cosinc.load(std::memory_order_relaxed);
+
+    /* rewritten meanwhile: sample i is gone */
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (slot.index.load(std::memory_order_relaxed) != i) break;
+    out[k] = sample;
+  }
+  return k;
+}
+
+/*============================================================================
+ *    Void function S_sunpath_destroy
+ *----------------------------------------------------------------------------*/
+void S_sunpath_destroy(sunpath *path) {
+  if (!path) return;
+  if (path->producer.joinable()) {
+    {
+      std::lock_guard<std::mutex> lock(path->mu);
+      path->stop = true;
+    }
+    path->wake.notify_one();
+    path->producer.join();
+  }
+  delete path;
+}
+
+}  // namespace solpos
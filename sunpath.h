@@ -0,0 +1,108 @@
+/*============================================================================
+ *
+ *    NAME:  sunpath.h
+ *
+ *    Contains:
+ *        S_sunpath_create   (a per-site lookahead buffer of sun positions,
+ *                            optionally kept filled by a background thread)
+ *        S_sunpath_fill     (one producer pass, for buffers without one)
+ *        S_sunpath_read     (lock-free read of upcoming samples)
+ *        S_sunpath_destroy  (stops the thread and frees the buffer)
+ *
+ *            INPUTS:     a posdata with the site (as for S_rt_init) and a
+ *                        sunpathspec: first sample epoch, step, samples to
+ *                        keep ahead and a clock
+ *
+ *            OUTPUTS:    sunsamples at epochs start + k * step
+ *
+ *    Tracker and heliostat controllers plan moves over the next minutes.
+ *    The producer keeps the samples from the one at or before the clock's
+ *    now through samples steps ahead of it, stepping forward from the last
+ *    sample it computed (with S_rt_solpos, so each costs the same) and
+ *    overwriting the oldest.  Readers never block or wait: each ring slot
+ *    carries the index of its sample, written last, and a read copies the
+ *    slot and checks the index before and after (a sequence lock), so a
+ *    slot being rewritten reads as missing instead of torn.
+ *
+ *    There must be exactly one producer: the background thread, or the
+ *    caller through S_sunpath_fill when created without one.  Any number of
+ *    threads may read at once.
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_SUNPATH_H_
+#define SOLPOS_SUNPATH_H_
+
+#include "solpos.h"
+
+namespace solpos {
+
+/* Current Unix time, seconds */
+typedef long long (*sunclock)(void *context);
+
+struct sunpathspec {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  long long start;       /* I:  Epoch of sample 0 */
+  int step;              /* I:  Seconds between samples, >= 1 */
+  int samples;           /* I:  Samples kept ahead of now, >= 1 */
+  sunclock clock;        /* I:  Source of now (nullptr = the system clock) */
+  void *clock_context;   /* I:  Passed to clock */
+  int poll;              /* I:  Milliseconds between producer passes
+                                (0 = a quarter of step) */
+};
+
+struct sunsample {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  long long epoch;       /* O:  Unix time of the sample */
+  int error;             /* O:  S_rt_solpos return code (outputs NaN if set) */
+  double azim;           /* O:  posdata::azim */
+  double elevref;        /* O:  posdata::elevref */
+  double etrn;           /* O:  posdata::etrn */
+  double cosinc;         /* O:  posdata::cosinc, of the site's tilt and
+                                aspect */
+};
+
+struct sunpath; /* opaque */
+
+/*============================================================================
+ *    Int function S_sunpath_create
+ *
+ *    Builds a buffer for site and spec and fills it once; with background
+ *    nonzero, starts a thread that runs S_sunpath_fill every spec->poll
+ *    milliseconds until S_sunpath_destroy.
+ *
+ *    RETURNS: 0 with *path set, or the S_rt_init code of the site, or
+ *             (1L << S_INTRVL_ERROR) for step or samples below 1 (*path is
+ *             nullptr then)
+ *----------------------------------------------------------------------------*/
+int S_sunpath_create(const posdata *site, const sunpathspec *spec,
+                     int background, sunpath **path);
+
+/*============================================================================
+ *    Void function S_sunpath_fill
+ *
+ *    Computes the samples missing up to spec->samples steps past now
+ *----------------------------------------------------------------------------*/
+void S_sunpath_fill(sunpath *path);
+
+/*============================================================================
+ *    Int function S_sunpath_read
+ *
+ *    Copies up to n consecutive samples into out, starting with the last
+ *    one at or before epoch.  Lock-free and wait-free.
+ *
+ *    RETURNS: Samples copied; fewer than n when the buffer does not (yet,
+ *             or any longer) hold the rest
+ *----------------------------------------------------------------------------*/
+int S_sunpath_read(const sunpath *path, long long epoch, int n,
+                   sunsample *out);
+
+/*============================================================================
+ *    Void function S_sunpath_destroy
+ *----------------------------------------------------------------------------*/
+void S_sunpath_destroy(sunpath *path);
+
+}  // namespace solpos
+
+#endif  // SOLPOS_SUNPATH_H_
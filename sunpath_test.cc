@@ -0,0 +1,171 @@
+#include "sunpath.h"
+
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "realtime.h"
+
+namespace solpos {
+namespace {
+
+long long FakeNow(void *context) {
+  return static_cast<std::atomic<long long> *>(context)->load();
+}
+
+posdata Site() {
+  posdata site;
+  S_init(&site);
+  site.latitude = 37.56;
+  site.longitude = -116.12;
+  site.timezone = -8.0;
+  site.tilt = 20.0;
+  site.aspect = 190.0;
+  return site;
+}
+
+/* The sample S_rt_solpos gives at epoch */
+void ExpectSample(const sunsample &s, long long epoch) {
+  posdata site = Site(), pd;
+  site.function = (S_SOLAZM | S_REFRAC | S_ETR | S_TILT) & ~L_DOY;
+  rtcontext ctx;
+  ASSERT_EQ(S_rt_init(&ctx, &site), 0);
+  ASSERT_EQ(S_rt_solpos(&ctx, epoch, 0.0, &pd), 0);
+  EXPECT_EQ(s.epoch, epoch);
+  EXPECT_EQ(s.error, 0);
+  EXPECT_EQ(s.azim, pd.azim);
+  EXPECT_EQ(s.elevref, pd.elevref);
+  EXPECT_EQ(s.etrn, pd.etrn);
+  EXPECT_EQ(s.cosinc, pd.cosinc);
+}
+
+TEST(SunPathTest, FillsAheadOfTheClock) {
+  posdata site = Site();
+  std::atomic<long long> now(S_epoch(2020, 6, 1, 10, 0, 30, -8.0));
+  sunpathspec spec = {};
+  spec.start = S_epoch(2020, 6, 1, 0, 0, 0, -8.0);
+  spec.step = 60;
+  spec.samples = 10;
+  spec.clock = FakeNow;
+  spec.clock_context = &now;
+
+  sunpath *path;
+  ASSERT_EQ(S_sunpath_create(&site, &spec, 0, &path), 0);
+
+  /* 10:00 (at or before now) through 10:10 */
+  sunsample out[20];
+  ASSERT_EQ(S_sunpath_read(path, now.load(), 20, out), 11);
+  for (int k = 0; k < 11; ++k) ExpectSample(out[k], spec.start + 600 * 60 +
+                                                        60 * k);
+  EXPECT_EQ(S_sunpath_read(path, now.load() - 60, 20, out), 0);
+  EXPECT_EQ(S_sunpath_read(path, now.load() + 600, 20, out), 1);
+
+  /* a minute on: one more ahead, the last but one still held */
+  now += 60;
+  S_sunpath_fill(path);
+  EXPECT_EQ(S_sunpath_read(path, now.load(), 20, out), 11);
+  EXPECT_EQ(S_sunpath_read(path, now.load() - 60, 20, out), 12);
+  EXPECT_EQ(out[0].epoch, spec.start + 600 * 60);
+
+  /* an hour's stall: restarts at now, the old samples are overwritten */
+  now += 3600;
+  S_sunpath_fill(path);
+  ASSERT_EQ(S_sunpath_read(path, now.load(), 20, out), 11);
+  ExpectSample(out[10], spec.start + 671 * 60);
+  EXPECT_EQ(S_sunpath_read(path, spec.start + 600 * 60, 20, out), 0);
+  S_sunpath_destroy(path);
+}
+
+TEST(SunPathTest, Errors) {
+  posdata site = Site();
+  sunpathspec spec = {};
+  spec.start = S_epoch(2050, 12, 31, 23, 58, 0, -8.0);
+  spec.step = 0;
+  spec.samples = 4;
+  std::atomic<long long> now(spec.start);
+  spec.clock = FakeNow;
+  spec.clock_context = &now;
+
+  sunpath *path = nullptr;
+  EXPECT_EQ(S_sunpath_create(&site, &spec, 0, &path), 1L << S_INTRVL_ERROR);
+  EXPECT_EQ(path, nullptr);
+  spec.step = 60;
+  site.longitude = 200.0;
+  EXPECT_EQ(S_sunpath_create(&site, &spec, 0, &path), 1L << S_LON_ERROR);
+
+  /* samples past 2050 carry the error */
+  site = Site();
+  ASSERT_EQ(S_sunpath_create(&site, &spec, 0, &path), 0);
+  sunsample out[5];
+  ASSERT_EQ(S_sunpath_read(path, spec.start, 5, out), 5);
+  EXPECT_EQ(out[1].error, 0);
+  EXPECT_EQ(out[2].error, 1L << S_YEAR_ERROR);
+  EXPECT_TRUE(std::isnan(out[4].azim));
+  S_sunpath_destroy(path);
+}
+
+TEST(SunPathTest, BackgroundThreadAndConcurrentReaders) {
+  posdata site = Site();
+  const long long start = S_epoch(2020, 3, 20, 6, 0, 0, -8.0);
+  std::atomic<long long> now(start);
+  sunpathspec spec = {};
+  spec.start = start;
+  spec.step = 1;
+  spec.samples = 8;
+  spec.clock = FakeNow;
+  spec.clock_context = &now;
+  spec.poll = 1;
+
+  sunpath *path;
+  ASSERT_EQ(S_sunpath_create(&site, &spec, 1, &path), 0);
+
+  /* readers check every sample they get against a fresh computation while
+     the clock races ahead, so the producer keeps overwriting */
+  std::atomic<bool> done(false);
+  std::atomic<long long> reads(0), bad(0);
+  std::vector<std::thread> readers;
+  for (int r = 0; r < 3; ++r) {
+    readers.push_back(std::thread([&] {
+      posdata s = site, pd;
+      s.function = (S_SOLAZM | S_REFRAC | S_ETR | S_TILT) & ~L_DOY;
+      rtcontext ctx;
+      S_rt_init(&ctx, &s);
+      sunsample out[4];
+      while (!done.load()) {
+        int n = S_sunpath_read(path, now.load(), 4, out);
+        for (int k = 0; k < n; ++k) {
+          S_rt_solpos(&ctx, out[k].epoch, 0.0, &pd);
+          bad += (out[k].azim != pd.azim) | (out[k].cosinc != pd.cosinc) |
+                 (out[k].etrn != pd.etrn) | (out[k].elevref != pd.elevref);
+        }
+        reads += n;
+      }
+    }));
+  }
+  for (int t = 0; t < 2000; ++t) {
+    now += 1;
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+  }
+  done = true;
+  for (std::thread &r : readers) r.join();
+
+  EXPECT_GT(reads.load(), 0);
+  EXPECT_EQ(bad.load(), 0);
+
+  /* the producer catches up with the final clock */
+  sunsample out[9];
+  int n = 0;
+  for (int tries = 0; tries < 5000 && n < 9; ++tries) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    n = S_sunpath_read(path, now.load(), 9, out);
+  }
+  ASSERT_EQ(n, 9);
+  ExpectSample(out[8], now.load() + 8);
+  S_sunpath_destroy(path);
+}
+
+}  // namespace
+}  // namespace solpos
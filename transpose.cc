@@ -0,0 +1,168 @@
+/*============================================================================
+ *    Contains:
+ *        S_perez_allsites1990, S_poa, S_poa_batch
+ *----------------------------------------------------------------------------*/
+#include "transpose.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+namespace solpos {
+
+/*============================================================================
+*    Local constants and function prototypes
+============================================================================*/
+static const int kBlock = 512;
+static const double kDegreesToRadians = M_PI / 180.0;
+static const double kCos85 = 0.08715574274765817; /* Perez zenith floor */
+static const double kCos89 = 0.01745240643728351; /* Hay-Davies floor */
+
+/* The output columns of poadata */
+static const int kOutputs = 4;
+static double *poadata::*const kOutput[kOutputs] = {
+    &poadata::poa, &poadata::beam, &poadata::sky, &poadata::ground};
+
+static void poa_block(int model, const poadata *pd, int first, int n);
+
+/* Perez, R., P. Ineichen, R. Seals, J. Michalsky and R. Stewart.  1990.
+   Modeling daylight availability and irradiance components from direct
+   and global irradiance.  Solar Energy 44 (5), pp. 271-289 */
+const perezcoeffs S_perez_allsites1990 = {{
+    {-0.008, 0.588, -0.062, -0.060, 0.072, -0.022},
+    {0.130, 0.683, -0.151, -0.019, 0.066, -0.029},
+    {0.330, 0.487, -0.221, 0.055, -0.064, -0.026},
+    {0.568, 0.187, -0.295, 0.109, -0.152, -0.014},
+    {0.873, -0.392, -0.362, 0.226, -0.462, 0.001},
+    {1.132, -1.237, -0.412, 0.288, -0.823, 0.056},
+    {1.060, -1.600, -0.359, 0.264, -1.127, 0.131},
+    {0.678, -0.327, -0.250, 0.156, -1.377, 0.251},
+}};
+
+/*============================================================================
+ *    Local void function poa_block
+ *
+ *    One model over rows [first, first + n), n <= kBlock
+ *----------------------------------------------------------------------------*/
+static void poa_block(int model, const poadata *pd, int first, int n) {
+  double ct[kBlock], st[kBlock], sky[kBlock];
+  const double *ghi = pd->ghi + first, *dni = pd->dni + first;
+  const double *dhi = pd->dhi + first, *cosinc = pd->cosinc + first;
+  const double *coszen = pd->coszen + first;
+
+  /* surface tilt */
+  if (pd->tilts) {
+    for (int i = 0; i < n; ++i) {
+      ct[i] = std::cos(kDegreesToRadians * pd->tilts[first + i]);
+      st[i] = std::sin(kDegreesToRadians * pd->tilts[first + i]);
+    }
+  } else {
+    std::fill(ct, ct + n, std::cos(kDegreesToRadians * pd->tilt));
+    std::fill(st, st + n, std::sin(kDegreesToRadians * pd->tilt));
+  }
+
+  /* sky diffuse */
+  if (model == S_POA_HAYDAVIES) {
+    const double *etrn = pd->etrn + first;
+    for (int i = 0; i < n; ++i) {
+      double ai = etrn[i] > 0.0 ? dni[i] / etrn[i] : 0.0;
+      double rb = std::max(cosinc[i], 0.0) / std::max(coszen[i], kCos89);
+      sky[i] = dhi[i] * (ai * rb + (1.0 - ai) * (1.0 + ct[i]) / 2.0);
+    }
+  } else if (model == S_POA_PEREZ) {
+    const perezcoeffs *table = pd->perez ? pd->perez : &S_perez_allsites1990;
+    const double *etrn = pd->etrn + first, *amass = pd->amass + first;
+    for (int i = 0; i < n; ++i) {
+      double z = std::acos(std::min(std::max(coszen[i], -1.0), 1.0));
+      double kz3 = 1.041 * z * z * z;
+      double eps = dhi[i] > 0.0
+                       ? ((dhi[i] + dni[i]) / dhi[i] + kz3) / (1.0 + kz3)
+                       : 1.0;
+      double delta = etrn[i] > 0.0 ? dhi[i] * amass[i] / etrn[i] : 0.0;
+      int bin = (eps >= 1.065) + (eps >= 1.23) + (eps >= 1.5) +
+                (eps >= 1.95) + (eps >= 2.8) + (eps >= 4.5) + (eps >= 6.2);
+      const double *f = table->f[bin];
+      double f1 = std::max(f[0] + f[1] * delta + f[2] * z, 0.0);
+      double f2 = f[3] + f[4] * delta + f[5] * z;
+      double rb = std::max(cosinc[i], 0.0) / std::max(coszen[i], kCos85);
+      double s = dhi[i] * ((1.0 - f1) * (1.0 + ct[i]) / 2.0 + f1 * rb +
+                           f2 * st[i]);
+      sky[i] = std::max(s, 0.0);
+    }
+  } else {
+    for (int i = 0; i < n; ++i) sky[i] = dhi[i] * (1.0 + ct[i]) / 2.0;
+  }
+
+  /* beam, ground and the sum */
+  for (int i = 0; i < n; ++i) {
+    double b = dni[i] * std::max(cosinc[i], 0.0);
+    double g = ghi[i] * pd->albedo * (1.0 - ct[i]) / 2.0;
+    if (pd->beam) pd->beam[first + i] = b;
+    if (pd->sky) pd->sky[first + i] = sky[i];
+    if (pd->ground) pd->ground[first + i] = g;
+    if (pd->poa) pd->poa[first + i] = b + sky[i] + g;
+  }
+}
+
+/*============================================================================
+ *    Void function S_poa
+ *----------------------------------------------------------------------------*/
+void S_poa(int model, const poadata *pd) {
+  for (int first = 0; first < pd->count; first += kBlock)
+    poa_block(model, pd, first, std::min(kBlock, pd->count - first));
+}
+
+/*============================================================================
+ *    Int function S_poa_batch
+ *----------------------------------------------------------------------------*/
+int S_poa_batch(const posbatch *batch, int model, const poadata *pd,
+                int *errors) {
+  const double nan = std::numeric_limits<double>::quiet_NaN();
+  double cosinc[kBlock], coszen[kBlock], etrn[kBlock], amass[kBlock];
+  posdata base = *batch->base;
+  posbatch work = *batch;
+  int summary = 0;
+
+  base.function = (base.function & (L_DOY | S_EPOCH)) |
+                  ((S_TILT | S_ETR | S_AMASS) & ~L_DOY);
+  work.base = &base;
+
+  for (int first = 0; first < batch->count; first += kBlock) {
+    int n = std::min(kBlock, batch->count - first);
+    posbatch slice;
+    poscolumns columns = {};
+    columns.cosinc = cosinc;
+    columns.coszen = coszen;
+    columns.etrn = etrn;
+    columns.amass = amass;
+    S_batch_slice(&work, first, n, &slice);
+    int codes = S_solpos_columns(&slice, errors + first, &columns);
+    summary |= codes;
+
+    /* the block as a poadata of its own, outputs offset to match */
+    poadata block = *pd;
+    block.count = n;
+    block.ghi = pd->ghi + first;
+    block.dni = pd->dni + first;
+    block.dhi = pd->dhi + first;
+    block.cosinc = cosinc;
+    block.coszen = coszen;
+    block.etrn = etrn;
+    block.amass = amass;
+    block.tilt = base.tilt;
+    block.tilts = batch->tilt ? batch->tilt + first : nullptr;
+    for (int k = 0; k < kOutputs; ++k)
+      if (block.*kOutput[k]) block.*kOutput[k] += first;
+    poa_block(model, &block, 0, n);
+
+    if (codes == 0) continue;
+    for (int i = 0; i < n; ++i) {
+      if (errors[first + i] == 0) continue;
+      for (int k = 0; k < kOutputs; ++k)
+        if (block.*kOutput[k]) (block.*kOutput[k])[i] = nan;
+    }
+  }
+  return summary;
+}
+
+}  // namespace solpos
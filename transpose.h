@@ -0,0 +1,99 @@
+/*============================================================================
+ *
+ *    NAME:  transpose.h
+ *
+ *    Contains:
+ *        S_poa        (plane-of-array irradiance from GHI, DNI and DHI)
+ *        S_poa_batch  (the same, computing the positions from a posbatch)
+ *
+ *            INPUTS:     measured irradiance columns, and the cosinc,
+ *                        coszen, etrn and amass columns that S_solpos
+ *                        (S_TILT, S_ETR, S_AMASS) computes for the surface
+ *
+ *            OUTPUTS:    total, beam, sky diffuse and ground-reflected
+ *                        irradiance on the tilted surface, W/m^2
+ *
+ *    Sky diffuse models:
+ *        S_POA_ISOTROPIC  Liu and Jordan (1963)
+ *        S_POA_HAYDAVIES  Hay and Davies (1980): circumsolar share set by
+ *                         the anisotropy index DNI / etrn
+ *        S_POA_PEREZ      Perez et al. (1990): circumsolar and horizon
+ *                         brightening from a table of coefficients binned
+ *                         by sky clearness
+ *    and in every model
+ *        beam   = DNI * max(cosinc, 0)
+ *        ground = GHI * albedo * (1 - cos(tilt)) / 2
+ *
+ *    The kernels are branch-free loops over the columns (the Perez bin is
+ *    a sum of compares, then a table gather).
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_TRANSPOSE_H_
+#define SOLPOS_TRANSPOSE_H_
+
+#include "batch.h"
+
+namespace solpos {
+
+enum { S_POA_ISOTROPIC = 1, S_POA_HAYDAVIES, S_POA_PEREZ };
+
+/* Perez coefficients per sky clearness bin (bin edges 1.065, 1.23, 1.5,
+   1.95, 2.8, 4.5, 6.2): f1 = f11 + f12 * delta + f13 * zenith (radians),
+   f2 likewise, as {f11, f12, f13, f21, f22, f23} */
+struct perezcoeffs {
+  double f[8][6];
+};
+
+/* The "allsitescomposite1990" set, the usual default */
+extern const perezcoeffs S_perez_allsites1990;
+
+struct poadata {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  int count;             /* I:  Number of rows */
+  const double *ghi;     /* I:  Global horizontal irradiance */
+  const double *dni;     /* I:  Direct normal irradiance */
+  const double *dhi;     /* I:  Diffuse horizontal irradiance */
+  const double *cosinc;  /* I:  posdata::cosinc */
+  const double *coszen;  /* I:  posdata::coszen */
+  const double *etrn;    /* I:  posdata::etrn (Hay-Davies and Perez) */
+  const double *amass;   /* I:  posdata::amass (Perez) */
+  double tilt;           /* I:  Surface tilt, degrees from horizontal */
+  const double *tilts;   /* I:  Optional per-row tilt (nullptr = tilt) */
+  double albedo;         /* I:  Ground reflectance */
+  const perezcoeffs *perez; /* I:  Perez table (nullptr = allsites1990) */
+
+  /* Output columns (nullptr = not wanted) */
+  double *poa;           /* O:  beam + sky + ground */
+  double *beam;          /* O:  Beam on the surface */
+  double *sky;           /* O:  Sky diffuse on the surface */
+  double *ground;        /* O:  Ground-reflected on the surface */
+};
+
+/*============================================================================
+ *    Void function S_poa
+ *
+ *    Fills the requested output columns of pd with model, one of the
+ *    S_POA_* values.
+ *----------------------------------------------------------------------------*/
+void S_poa(int model, const poadata *pd);
+
+/*============================================================================
+ *    Int function S_poa_batch
+ *
+ *    Computes cosinc, coszen, etrn and amass for each row of batch (the
+ *    S_TILT, S_ETR and S_AMASS stages, a block at a time; surface tilt and
+ *    aspect from the batch) and runs S_poa on them.  The position columns
+ *    and tilt of pd are ignored; its irradiance and output columns have
+ *    batch->count entries.  Rows with errors get NaN outputs.
+ *
+ *    OUTPUTS: errors[i] (S_solpos return code) and the columns of pd
+ *
+ *    RETURNS: The OR of all row codes
+ *----------------------------------------------------------------------------*/
+int S_poa_batch(const posbatch *batch, int model, const poadata *pd,
+                int *errors);
+
+}  // namespace solpos
+
+#endif  // SOLPOS_TRANSPOSE_H_
@@ -0,0 +1,142 @@
+#include "transpose.h"
+
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace solpos {
+namespace {
+
+/* A clear morning row on a 30 degree surface */
+struct Row {
+  double ghi = 700.0, dni = 800.0, dhi = 150.0, cosinc = 0.9, coszen = 0.6,
+         etrn = 1400.0, amass = 1.65;
+  double poa, beam, sky, ground;
+
+  poadata Data() {
+    poadata pd = {};
+    pd.count = 1;
+    pd.ghi = &ghi;
+    pd.dni = &dni;
+    pd.dhi = &dhi;
+    pd.cosinc = &cosinc;
+    pd.coszen = &coszen;
+    pd.etrn = &etrn;
+    pd.amass = &amass;
+    pd.tilt = 30.0;
+    pd.albedo = 0.2;
+    pd.poa = &poa;
+    pd.beam = &beam;
+    pd.sky = &sky;
+    pd.ground = &ground;
+    return pd;
+  }
+};
+
+TEST(TransposeTest, Models) {
+  Row row;
+  poadata pd = row.Data();
+
+  S_poa(S_POA_ISOTROPIC, &pd);
+  EXPECT_DOUBLE_EQ(row.beam, 720.0);
+  EXPECT_NEAR(row.ground, 9.378222, 1e-6);
+  EXPECT_NEAR(row.sky, 139.951905, 1e-6);
+  EXPECT_DOUBLE_EQ(row.poa, row.beam + row.sky + row.ground);
+
+  S_poa(S_POA_HAYDAVIES, &pd);
+  EXPECT_NEAR(row.sky, 188.550817, 1e-6);
+
+  S_poa(S_POA_PEREZ, &pd);
+  EXPECT_NEAR(row.sky, 199.717986, 1e-6);
+  EXPECT_DOUBLE_EQ(row.beam, 720.0);
+
+  /* a table of zeros leaves Perez isotropic */
+  perezcoeffs flat = {};
+  pd.perez = &flat;
+  S_poa(S_POA_PEREZ, &pd);
+  EXPECT_NEAR(row.sky, 139.951905, 1e-6);
+}
+
+TEST(TransposeTest, HorizontalSurfaceGivesGhi) {
+  Row row;
+  row.cosinc = row.coszen;
+  row.ghi = row.dhi + row.dni * row.coszen;
+  poadata pd = row.Data();
+  pd.tilt = 0.0;
+  for (int model = S_POA_ISOTROPIC; model <= S_POA_PEREZ; ++model) {
+    S_poa(model, &pd);
+    EXPECT_NEAR(row.poa, row.ghi, 1e-9) << "model " << model;
+  }
+}
+
+TEST(TransposeTest, BatchMatchesColumns) {
+  posdata base;
+  S_init(&base);
+  base.function = S_ALL & ~S_DOY;
+  base.latitude = 39.74;
+  base.longitude = -105.18;
+  base.timezone = -7.0;
+  base.year = 2019;
+  base.month = 9;
+  base.day = 1;
+  base.second = 0;
+  base.tilt = 35.0;
+  base.aspect = 200.0;
+
+  const int count = 24 * 12;
+  std::vector<int> hour(count), minute(count), errors(count);
+  std::vector<double> ghi(count), dni(count), dhi(count), tilt(count);
+  for (int i = 0; i < count; ++i) {
+    hour[i] = i / 12;
+    minute[i] = i % 12 * 5;
+    dni[i] = 10.0 * (i % 80);
+    dhi[i] = 40.0 + i % 50;
+    ghi[i] = dhi[i] + 0.5 * dni[i];
+    tilt[i] = 10.0 + i % 60;
+  }
+  minute[5] = 61;
+
+  posbatch batch = {};
+  batch.base = &base;
+  batch.count = count;
+  batch.hour = hour.data();
+  batch.minute = minute.data();
+  batch.tilt = tilt.data();
+
+  std::vector<double> cosinc(count), coszen(count), etrn(count),
+      amass(count), want(count), poa(count);
+  poscolumns columns = {};
+  columns.cosinc = cosinc.data();
+  columns.coszen = coszen.data();
+  columns.etrn = etrn.data();
+  columns.amass = amass.data();
+  int summary = S_solpos_columns(&batch, errors.data(), &columns);
+
+  poadata pd = {};
+  pd.count = count;
+  pd.ghi = ghi.data();
+  pd.dni = dni.data();
+  pd.dhi = dhi.data();
+  pd.cosinc = cosinc.data();
+  pd.coszen = coszen.data();
+  pd.etrn = etrn.data();
+  pd.amass = amass.data();
+  pd.tilts = tilt.data();
+  pd.albedo = 0.25;
+  pd.poa = want.data();
+  S_poa(S_POA_PEREZ, &pd);
+
+  pd.poa = poa.data();
+  EXPECT_EQ(S_poa_batch(&batch, S_POA_PEREZ, &pd, errors.data()), summary);
+  for (int i = 0; i < count; ++i) {
+    if (errors[i]) {
+      EXPECT_TRUE(std::isnan(poa[i])) << "row " << i;
+    } else {
+      EXPECT_DOUBLE_EQ(poa[i], want[i]) << "row " << i;
+    }
+  }
+}
+
+}  // namespace
+}  // namespace solpos
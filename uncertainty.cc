@@ -0,0 +1,369 @@
+/*============================================================================
+ *    Contains:
+ *        S_montecarlo
+ *----------------------------------------------------------------------------*/
+#include "uncertainty.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "parallel.h"
+#include "solpos_internal.h"
+
+namespace solpos {
+
+/*============================================================================
+*    Local constants, types and function prototypes
+============================================================================*/
+static const double kNaN = std::numeric_limits<double>::quiet_NaN();
+static const double kDegreesToRadians = M_PI / 180.0;
+
+/* Draws held between the perturb, stage and statistics passes */
+static const int kBlock = 256;
+
+/* Inputs perturbed, one generator stream each */
+enum { kLatitude, kLongitude, kSeconds, kPress, kTemp, kTilt, kAspect };
+
+/* P^2 estimate of one quantile */
+struct p2 {
+  double p;       /* quantile, 0 - 1 */
+  double q[5];    /* marker heights */
+  double n[5];    /* marker positions */
+  double want[5]; /* desired positions */
+  long long seen;
+};
+
+/* Streaming statistics of one quantity */
+struct accumulator {
+  long long count;
+  double mean, m2, min, max;
+  int quantiles;
+  p2 quantile[S_MC_MAX_PERCENTILES];
+};
+
+/* Streaming statistics of an angle, in degrees: the sums of the sine and
+   versine (1 - cos) of its offset from a reference, and the linear
+   statistics of that offset wrapped to [-180, 180) */
+struct angle_accumulator {
+  double reference;
+  double sum_sin, sum_versin;
+  accumulator offset;
+};
+
+static unsigned long long mix(unsigned long long z);
+static void sort_few(double *x, int count);
+static double normal(unsigned long long seed, long long row, int draw,
+                     int input);
+static void p2_init(p2 *est, double p);
+static void p2_add(p2 *est, double x);
+static double p2_value(const p2 *est);
+static void acc_init(accumulator *acc, const mcspec *spec);
+static void acc_add(accumulator *acc, double x);
+static void acc_result(const accumulator *acc, mcstats *stats);
+static void nan_stats(int quantiles, mcstats *stats);
+static double wrap360(double degrees);
+static void angle_init(angle_accumulator *acc, const mcspec *spec,
+                       double reference);
+static void angle_add(angle_accumulator *acc, double degrees);
+static void angle_result(const angle_accumulator *acc, mcstats *stats);
+
+/*============================================================================
+ *    Local unsigned long long function mix
+ *
+ *    The SplitMix64 finalizer: a bijective 64-bit hash
+ *----------------------------------------------------------------------------*/
+static unsigned long long mix(unsigned long long z) {
+  z += 0x9e3779b97f4a7c15ULL;
+  z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+  return z ^ (z >> 31);
+}
+
+/*============================================================================
+ *    Local double function normal
+ *
+ *    Standard normal deviate for counter (seed, row, draw, input), by the
+ *    Box-Muller transform of two hashed uniforms in (0, 1)
+ *----------------------------------------------------------------------------*/
+static double normal(unsigned long long seed, long long row, int draw,
+                     int input) {
+  unsigned long long key =
+      mix(seed ^ mix(static_cast<unsigned long long>(row)));
+  key = mix(key ^ (static_cast<unsigned long long>(draw) << 8 | input));
+  double u1 = ((key >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+  double u2 = ((mix(key) >> 11) + 0.5) * (1.0 / 9007199254740992.0);
+  return std::sqrt(-2.0 * std::log(u1)) * std::cos(2.0 * M_PI * u2);
+}
+
+/*============================================================================
+ *    Local void function sort_few
+ *
+ *    Insertion sort, for the five or fewer values of a P^2 start
+ *----------------------------------------------------------------------------*/
+static void sort_few(double *x, int count) {
+  for (int i = 1; i < count; ++i) {
+    double v = x[i];
+    int j = i;
+    for (; j > 0 && x[j - 1] > v; --j) x[j] = x[j - 1];
+    x[j] = v;
+  }
+}
+
+/*============================================================================
+ *    Local P^2 functions
+ *
+ *       Jain, R. and I. Chlamtac.  1985.  The P^2 algorithm for dynamic
+ *            calculation of quantiles and histograms without storing
+ *            observations.  Communications of the ACM 28 (10),
+ *            pp. 1076-1085
+ *----------------------------------------------------------------------------*/
+static void p2_init(p2 *est, double p) {
+  est->p = p;
+  est->seen = 0;
+}
+
+static void p2_add(p2 *est, double x) {
+  double *q = est->q, *n = est->n;
+  const double p = est->p;
+  const double step[5] = {0.0, p / 2.0, p, (1.0 + p) / 2.0, 1.0};
+  int k;
+
+  /* the first five observations become the markers */
+  if (est->seen < 5) {
+    q[est->seen++] = x;
+    if (est->seen == 5) {
+      sort_few(q, 5);
+      for (k = 0; k < 5; ++k) n[k] = k + 1;
+      est->want[0] = 1.0;
+      est->want[1] = 1.0 + 2.0 * p;
+      est->want[2] = 1.0 + 4.0 * p;
+      est->want[3] = 3.0 + 2.0 * p;
+      est->want[4] = 5.0;
+    }
+    return;
+  }
+  ++est->seen;
+
+  /* cell k holding x, widening the extremes if need be */
+  if (x < q[0]) {
+    q[0] = x;
+    k = 0;
+  } else if (x >= q[4]) {
+    q[4] = std::max(q[4], x);
+    k = 3;
+  } else {
+    for (k = 0; x >= q[k + 1]; ++k) {
+    }
+  }
+  for (int i = k + 1; i < 5; ++i) n[i] += 1.0;
+  for (int i = 0; i < 5; ++i) est->want[i] += step[i];
+
+  /* move the middle markers toward their desired positions */
+  for (int i = 1; i < 4; ++i) {
+    double d = est->want[i] - n[i];
+    if ((d >= 1.0 && n[i + 1] - n[i] > 1.0) ||
+        (d <= -1.0 && n[i - 1] - n[i] < -1.0)) {
+      double s = d > 0.0 ? 1.0 : -1.0;
+      double parabolic =
+          q[i] + s / (n[i + 1] - n[i - 1]) *
+                     ((n[i] - n[i - 1] + s) * (q[i + 1] - q[i]) /
+                          (n[i + 1] - n[i]) +
+                      (n[i + 1] - n[i] - s) * (q[i] - q[i - 1]) /
+                          (n[i] - n[i - 1]));
+      if (q[i - 1] < parabolic && parabolic < q[i + 1])
+        q[i] = parabolic;
+      else
+        q[i] += s * (q[i + static_cast<int>(s)] - q[i]) /
+                (n[i + static_cast<int>(s)] - n[i]);
+      n[i] += s;
+    }
+  }
+}
+
+static double p2_value(const p2 *est) {
+  if (est->seen >= 5) return est->q[2];
+  if (est->seen == 0) return kNaN;
+
+  /* too few for markers: the exact quantile of what there is */
+  double sorted[5];
+  int count = static_cast<int>(est->seen);
+  for (int k = 0; k < count; ++k) sorted[k] = est->q[k];
+  sort_few(sorted, count);
+  double at = est->p * (count - 1);
+  int below = static_cast<int>(at);
+  if (below + 1 >= count) return sorted[count - 1];
+  return sorted[below] + (at - below) * (sorted[below + 1] - sorted[below]);
+}
+
+/*============================================================================
+ *    Local accumulator functions (Welford's mean and variance plus P^2)
+ *----------------------------------------------------------------------------*/
+static void acc_init(accumulator *acc, const mcspec *spec) {
+  acc->count = 0;
+  acc->mean = acc->m2 = 0.0;
+  acc->min = std::numeric_limits<double>::infinity();
+  acc->max = -acc->min;
+  acc->quantiles = std::min(spec->percentiles, S_MC_MAX_PERCENTILES);
+  for (int k = 0; k < acc->quantiles; ++k)
+    p2_init(&acc->quantile[k], spec->percentile[k] / 100.0);
+}
+
+static void acc_add(accumulator *acc, double x) {
+  double delta = x - acc->mean;
+  acc->mean += delta / ++acc->count;
+  acc->m2 += delta * (x - acc->mean);
+  acc->min = std::min(acc->min, x);
+  acc->max = std::max(acc->max, x);
+  for (int k = 0; k < acc->quantiles; ++k) p2_add(&acc->quantile[k], x);
+}
+
+static void acc_result(const accumulator *acc, mcstats *stats) {
+  if (acc->count == 0) {
+    nan_stats(acc->quantiles, stats);
+    return;
+  }
+  stats->mean = acc->mean;
+  stats->stddev =
+      acc->count > 1 ? std::sqrt(acc->m2 / (acc->count - 1)) : 0.0;
+  stats->min = acc->min;
+  stats->max = acc->max;
+  for (int k = 0; k < acc->quantiles; ++k)
+    stats->percentile[k] = p2_value(&acc->quantile[k]);
+}
+
+static void nan_stats(int quantiles, mcstats *stats) {
+  stats->mean = stats->stddev = stats->min = stats->max = kNaN;
+  for (int k = 0; k < quantiles; ++k) stats->percentile[k] = kNaN;
+}
+
+/*============================================================================
+ *    Local angle accumulator functions (circular statistics)
+ *
+ *    The mean is the direction of the mean resultant vector and the
+ *    standard deviation sqrt(-2 ln R) of its length R, both taken about
+ *    the reference so that a spread across north is one spread.  Extremes
+ *    and percentiles are those of the offset, put back on the reference.
+ *       Mardia, K. V. and P. E. Jupp.  2000.  Directional Statistics.
+ *            Wiley, Chichester, pp. 17-19
+ *----------------------------------------------------------------------------*/
+static double wrap360(double degrees) {
+  return degrees - 360.0 * std::floor(degrees / 360.0);
+}
+
+static void angle_init(angle_accumulator *acc, const mcspec *spec,
+                       double reference) {
+  acc->reference = reference;
+  acc->sum_sin = acc->sum_versin = 0.0;
+  acc_init(&acc->offset, spec);
+}
+
+static void angle_add(angle_accumulator *acc, double degrees) {
+  double offset = degrees - acc->reference;
+  offset -= 360.0 * std::floor((offset + 180.0) / 360.0);
+  double half = std::sin(0.5 * kDegreesToRadians * offset);
+
+  acc->sum_sin += std::sin(kDegreesToRadians * offset);
+  acc->sum_versin += 2.0 * half * half; /* 1 - cos, without cancellation */
+  acc_add(&acc->offset, offset);
+}
+
+static void angle_result(const angle_accumulator *acc, mcstats *stats) {
+  const double n = static_cast<double>(acc->offset.count);
+  const double s = acc->sum_sin, v = acc->sum_versin;
+
+  acc_result(&acc->offset, stats);
+  if (acc->offset.count == 0) return;
+
+  /* R^2 = (s^2 + (n - v)^2) / n^2, so 1 - R^2 = (2nv - v^2 - s^2) / n^2 */
+  double spread = std::max((2.0 * n * v - v * v - s * s) / (n * n), 0.0);
+  stats->mean =
+      wrap360(acc->reference + std::atan2(s, n - v) / kDegreesToRadians);
+  stats->stddev = std::sqrt(-std::log1p(-spread)) / kDegreesToRadians;
+  stats->min = wrap360(acc->reference + stats->min);
+  stats->max = wrap360(acc->reference + stats->max);
+  for (int k = 0; k < acc->offset.quantiles; ++k)
+    stats->percentile[k] = wrap360(acc->reference + stats->percentile[k]);
+}
+
+/*============================================================================
+ *    Int function S_montecarlo
+ *----------------------------------------------------------------------------*/
+int S_montecarlo(const posbatch *batch, const mcspec *spec, int threads,
+                 int *errors, mcresult *out) {
+  posdata base = *batch->base;
+  posbatch work = *batch;
+  const int dates = base.function & (L_DOY | S_EPOCH);
+  const int quantiles = std::min(spec->percentiles, S_MC_MAX_PERCENTILES);
+
+  base.function = dates | ((S_TILT | S_ETR) & ~L_DOY);
+  work.base = &base;
+  int summary = S_validate_batch(&work, errors);
+
+  /* per-row work is heavy, so any two rows are worth two threads */
+  internal::parallel_for(batch->count, threads, [&](int first, int count) {
+    std::vector<posdata> block(kBlock);
+
+    for (int i = first; i < first + count; ++i) {
+      mcresult *result = &out[i];
+      if (errors[i]) {
+        nan_stats(quantiles, &result->cosinc);
+        nan_stats(quantiles, &result->etrtilt);
+        nan_stats(quantiles, &result->zenref);
+        nan_stats(quantiles, &result->azim);
+        continue;
+      }
+
+      /* the unperturbed sample, ephemeris and all; the draws only rerun
+         the stages after S_GEOM */
+      posdata sample;
+      S_batch_row(&work, i, &sample);
+      internal::compute(&sample);
+      sample.function = L_ZENETR | L_SOLAZM | L_REFRAC | L_ETR | L_TILT;
+
+      accumulator cosinc, etrtilt, zenref;
+      angle_accumulator azim;
+      acc_init(&cosinc, spec);
+      acc_init(&etrtilt, spec);
+      acc_init(&zenref, spec);
+      angle_init(&azim, spec, sample.azim);
+
+      for (int start = 0; start < spec->draws; start += kBlock) {
+        const int size = std::min(kBlock, spec->draws - start);
+
+        for (int j = 0; j < size; ++j) {
+          const int d = start + j;
+          posdata *pd = &block[j];
+          double dlon = spec->longitude * normal(spec->seed, i, d, kLongitude);
+          double dt = spec->seconds * normal(spec->seed, i, d, kSeconds);
+
+          *pd = sample;
+          pd->latitude += spec->latitude * normal(spec->seed, i, d, kLatitude);
+          pd->latitude = std::min(std::max(pd->latitude, -90.0), 90.0);
+          pd->longitude += dlon;
+          pd->hrang += dlon + dt / 240.0; /* 15 degrees per hour */
+          pd->hrang -= 360.0 * std::floor((pd->hrang + 180.0) / 360.0);
+          pd->press += spec->press * normal(spec->seed, i, d, kPress);
+          pd->temp += spec->temp * normal(spec->seed, i, d, kTemp);
+          pd->tilt += spec->tilt * normal(spec->seed, i, d, kTilt);
+          pd->aspect += spec->aspect * normal(spec->seed, i, d, kAspect);
+        }
+        for (int j = 0; j < size; ++j) internal::compute_local(&block[j]);
+        for (int j = 0; j < size; ++j) {
+          acc_add(&cosinc, block[j].cosinc);
+          acc_add(&etrtilt, block[j].etrtilt);
+          acc_add(&zenref, block[j].zenref);
+          angle_add(&azim, block[j].azim);
+        }
+      }
+      acc_result(&cosinc, &result->cosinc);
+      acc_result(&etrtilt, &result->etrtilt);
+      acc_result(&zenref, &result->zenref);
+      angle_result(&azim, &result->azim);
+    }
+  }, 1);
+  return summary;
+}
+
+}  // namespace solpos
@@ -0,0 +1,98 @@
+/*============================================================================
+ *
+ *    NAME:  uncertainty.h
+ *
+ *    Contains:
+ *        S_montecarlo  (propagates input uncertainty through S_solpos to
+ *                       cosinc, etrtilt, zenref and azim)
+ *
+ *            INPUTS:     a posbatch of samples (one row per timestamp and
+ *                        site), and normal standard deviations for
+ *                        latitude, longitude, time, press, temp, tilt and
+ *                        aspect
+ *
+ *            OUTPUTS:    per sample and quantity: mean, standard deviation,
+ *                        extremes and the requested percentiles
+ *
+ *    Draws come from a counter-based generator: each normal deviate is a
+ *    hash of (seed, sample row, draw, input), so results do not depend on
+ *    the number of threads or on how the rows are split between them.
+ *
+ *    Each sample's ephemeris (the S_GEOM stage: declination, right
+ *    ascension, sidereal time, erv) is computed once, unperturbed.  A
+ *    draw only moves the location and hour angle (longitude, and time at
+ *    15 degrees per hour) and reruns the stages after S_GEOM, which is
+ *    exact for location and leaves a time error of the declination drift
+ *    (under 0.02 degrees per hour).
+ *
+ *    Draws run in blocks: a block is perturbed, then staged, then folded
+ *    into the statistics.  Statistics are streamed: Welford's mean and
+ *    variance, and the P^2 estimator (Jain and Chlamtac 1985) for each
+ *    percentile, so no more than a block of draws is stored.
+ *
+ *    azim is an angle, so its statistics are circular: the mean direction
+ *    and sqrt(-2 ln R) for the mean resultant length R, in degrees, and
+ *    extremes and percentiles of the offset from the unperturbed azimuth,
+ *    wrapped to [-180, 180) and added back onto it.  All are in
+ *    [0, 360), so a spread across north has min > max.
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_UNCERTAINTY_H_
+#define SOLPOS_UNCERTAINTY_H_
+
+#include "batch.h"
+
+namespace solpos {
+
+#define S_MC_MAX_PERCENTILES 8
+
+struct mcspec {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  int draws;             /* I:  Draws per sample */
+  unsigned long long seed; /* I:  Generator seed */
+  double latitude;       /* I:  Standard deviation of latitude, degrees */
+  double longitude;      /* I:  Standard deviation of longitude, degrees */
+  double seconds;        /* I:  Standard deviation of the timestamp, s */
+  double press;          /* I:  Standard deviation of press, millibars */
+  double temp;           /* I:  Standard deviation of temp, degrees C */
+  double tilt;           /* I:  Standard deviation of tilt, degrees */
+  double aspect;         /* I:  Standard deviation of aspect, degrees */
+  int percentiles;       /* I:  Number of percentiles wanted */
+  double percentile[S_MC_MAX_PERCENTILES]; /* I:  Each in (0, 100) */
+};
+
+struct mcstats {
+  double mean;
+  double stddev;         /* sample standard deviation */
+  double min;
+  double max;
+  double percentile[S_MC_MAX_PERCENTILES]; /* as mcspec::percentile */
+};
+
+struct mcresult {
+  mcstats cosinc;
+  mcstats etrtilt;
+  mcstats zenref;
+  mcstats azim;
+};
+
+/*============================================================================
+ *    Int function S_montecarlo
+ *
+ *    Validates every row of batch (as S_validate_batch; the S_TILT and
+ *    S_ETR stages are run whatever batch->base->function selects) and
+ *    runs spec->draws perturbed evaluations of each valid row, spread
+ *    over threads threads (0 = one per hardware thread).
+ *
+ *    OUTPUTS: errors[i] (S_solpos return code) and out[i] per row; rows
+ *             with errors get NaN statistics
+ *
+ *    RETURNS: The OR of all row codes
+ *----------------------------------------------------------------------------*/
+int S_montecarlo(const posbatch *batch, const mcspec *spec, int threads,
+                 int *errors, mcresult *out);
+
+}  // namespace solpos
+
+#endif  // SOLPOS_UNCERTAINTY_H_
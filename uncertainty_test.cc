@@ -0,0 +1,176 @@
+#include "uncertainty.h"
+
+#include <cmath>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace solpos {
+namespace {
+
+class UncertaintyTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    S_init(&base);
+    base.function = S_ALL & ~S_DOY;
+    base.latitude = 35.05;
+    base.longitude = -106.62;
+    base.timezone = -7.0;
+    base.year = 2018;
+    base.month = 5;
+    base.day = 10;
+    base.second = 0;
+    base.tilt = 30.0;
+    base.aspect = 180.0;
+
+    for (int i = 0; i < kRows; ++i) {
+      hour[i] = 7 + i;
+      minute[i] = 15;
+    }
+    minute[3] = 60;
+    batch = {};
+    batch.base = &base;
+    batch.count = kRows;
+    batch.hour = hour;
+    batch.minute = minute;
+
+    spec = {};
+    spec.draws = 2000;
+    spec.seed = 42;
+    spec.percentiles = 3;
+    spec.percentile[0] = 5.0;
+    spec.percentile[1] = 50.0;
+    spec.percentile[2] = 95.0;
+  }
+
+  static const int kRows = 8;
+  posdata base;
+  posbatch batch;
+  mcspec spec;
+  int hour[kRows], minute[kRows], errors[kRows];
+};
+
+TEST_F(UncertaintyTest, ExactInputsGiveThePointValue) {
+  mcresult out[kRows];
+  spec.draws = 10;
+  EXPECT_EQ(S_montecarlo(&batch, &spec, 1, errors, out), 1L << S_MINUTE_ERROR);
+  for (int i = 0; i < kRows; ++i) {
+    if (i == 3) {
+      EXPECT_EQ(errors[i], 1L << S_MINUTE_ERROR);
+      EXPECT_TRUE(std::isnan(out[i].cosinc.mean));
+      EXPECT_TRUE(std::isnan(out[i].azim.percentile[2]));
+      continue;
+    }
+    posdata pd = base;
+    pd.hour = hour[i];
+    pd.minute = minute[i];
+    ASSERT_EQ(S_solpos(&pd), 0);
+    ASSERT_EQ(errors[i], 0);
+    EXPECT_NEAR(out[i].cosinc.mean, pd.cosinc, 1e-12) << "row " << i;
+    EXPECT_NEAR(out[i].etrtilt.mean, pd.etrtilt, 1e-9);
+    EXPECT_NEAR(out[i].zenref.mean, pd.zenref, 1e-9);
+    EXPECT_NEAR(out[i].azim.mean, pd.azim, 1e-9);
+    EXPECT_NEAR(out[i].zenref.stddev, 0.0, 1e-9);
+    EXPECT_EQ(out[i].azim.min, out[i].azim.max);
+    EXPECT_NEAR(out[i].azim.percentile[1], pd.azim, 1e-9);
+  }
+}
+
+TEST_F(UncertaintyTest, TiltSpread) {
+  mcresult out[kRows];
+  spec.tilt = 2.0;
+  S_montecarlo(&batch, &spec, 1, errors, out);
+
+  /* d(cosinc)/d(tilt) at the point value, in units of 1 / degree */
+  posdata pd = base;
+  pd.hour = hour[4];
+  pd.minute = minute[4];
+  ASSERT_EQ(S_solpos(&pd), 0);
+  posdata up = pd;
+  up.tilt += 0.01;
+  ASSERT_EQ(S_solpos(&up), 0);
+  double slope = (up.cosinc - pd.cosinc) / 0.01;
+
+  const mcstats &c = out[4].cosinc;
+  EXPECT_NEAR(c.stddev, std::fabs(slope) * 2.0, 0.1 * std::fabs(slope) * 2.0);
+  EXPECT_NEAR(c.mean, pd.cosinc, 0.01);
+  EXPECT_LT(c.min, c.percentile[0]);
+  EXPECT_LT(c.percentile[0], c.percentile[1]);
+  EXPECT_LT(c.percentile[1], c.percentile[2]);
+  EXPECT_LT(c.percentile[2], c.max);
+  EXPECT_NEAR(c.percentile[1], c.mean, 0.2 * c.stddev);
+  /* about 1.645 standard deviations either side for a normal spread */
+  EXPECT_NEAR(c.percentile[2] - c.percentile[0], 3.29 * c.stddev,
+              0.3 * c.stddev);
+  /* the solar position does not see the panel */
+  EXPECT_NEAR(out[4].zenref.stddev, 0.0, 1e-9);
+}
+
+/* wrapped azimuth difference, degrees */
+static double AzimDelta(double a, double b) {
+  double d = a - b;
+  return d - 360.0 * std::floor((d + 180.0) / 360.0);
+}
+
+TEST_F(UncertaintyTest, AzimuthAcrossNorth) {
+  mcresult out[kRows];
+  base.latitude = -30.0;
+  base.longitude = -105.0; /* on the timezone meridian */
+  for (int i = 0; i < kRows; ++i) {
+    hour[i] = 11;
+    minute[i] = 52 + i; /* around solar noon, sun to the north */
+  }
+  spec.seconds = 600.0;
+  EXPECT_EQ(S_montecarlo(&batch, &spec, 1, errors, out), 0);
+
+  for (int i = 0; i < kRows; ++i) {
+    posdata pd = base;
+    pd.hour = hour[i];
+    pd.minute = minute[i];
+    ASSERT_EQ(S_solpos(&pd), 0);
+    const mcstats &a = out[i].azim;
+    EXPECT_NEAR(AzimDelta(a.mean, pd.azim), 0.0, 0.5) << "row " << i;
+    EXPECT_GT(a.stddev, 1.0);
+    EXPECT_LT(a.stddev, 10.0);
+    EXPECT_NEAR(AzimDelta(a.percentile[1], pd.azim), 0.0, 0.5);
+    EXPECT_LT(AzimDelta(a.percentile[0], pd.azim), -a.stddev);
+    EXPECT_GT(AzimDelta(a.percentile[2], pd.azim), a.stddev);
+    EXPECT_GE(a.mean, 0.0);
+    EXPECT_LT(a.mean, 360.0);
+  }
+  /* some rows straddle north, and wrap their extremes */
+  int crossing = 0;
+  for (int i = 0; i < kRows; ++i) crossing += out[i].azim.min > out[i].azim.max;
+  EXPECT_GT(crossing, 0);
+}
+
+TEST_F(UncertaintyTest, ThreadsDoNotChangeResults) {
+  mcresult one[kRows], four[kRows];
+  spec.latitude = 0.01;
+  spec.longitude = 0.01;
+  spec.seconds = 30.0;
+  spec.press = 20.0;
+  spec.temp = 5.0;
+  spec.tilt = 1.0;
+  spec.aspect = 3.0;
+  spec.draws = 300;
+  int errors4[kRows];
+  EXPECT_EQ(S_montecarlo(&batch, &spec, 1, errors, one),
+            S_montecarlo(&batch, &spec, 4, errors4, four));
+  for (int i = 0; i < kRows; ++i) {
+    if (errors[i]) continue;
+    EXPECT_EQ(one[i].cosinc.mean, four[i].cosinc.mean) << "row " << i;
+    EXPECT_EQ(one[i].etrtilt.stddev, four[i].etrtilt.stddev);
+    EXPECT_EQ(one[i].zenref.percentile[0], four[i].zenref.percentile[0]);
+    EXPECT_EQ(one[i].azim.max, four[i].azim.max);
+    EXPECT_GT(one[i].zenref.stddev, 0.0);
+  }
+
+  /* another seed, other draws */
+  spec.seed = 43;
+  S_montecarlo(&batch, &spec, 4, errors4, four);
+  EXPECT_NE(one[0].cosinc.mean, four[0].cosinc.mean);
+}
+
+}  // namespace
+}  // namespace solpos
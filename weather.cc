@@ -0,0 +1,428 @@
+/*============================================================================
+ *    Contains:
+ *        S_weather_open, S_weather_attach, S_weather_close,
+ *        S_weather_rewind, S_weather_read, S_solpos_weather
+ *
+ *        EPW format:
+ *            U.S. Department of Energy.  EnergyPlus Auxiliary Programs,
+ *            Weather Converter Program, EnergyPlus Weather File (EPW)
+ *            Data Dictionary.
+ *        TMY3 format:
+ *            Wilcox, S. and Marion, W.  2008.  Users Manual for TMY3 Data
+ *            Sets.  NREL/TP-581-43156, National Renewable Energy
+ *            Laboratory, Golden, CO.
+ *----------------------------------------------------------------------------*/
+#include "weather.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#include "batch.h"
+
+namespace solpos {
+
+/*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Temporary global variables used only in this file:
+ *
+ *++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
+static const double kMissing = std::numeric_limits<double>::quiet_NaN();
+
+/* Rows S_solpos_weather reads and computes at a time, in stack columns */
+static const int kBlock = 512;
+
+/*============================================================================
+*    Local function prototypes
+============================================================================*/
+static const char *line_end(const char *p, const char *end);
+static const char *next_line(const char *p, const char *end);
+static const char *next_field(const char *p, const char *eol);
+static bool field_is(const char *p, const char *eol, const char *text);
+static double get_number(const char *p, const char *eol);
+static int get_int(const char **p, const char *eol);
+static int epw_header(weatherfile *wf);
+static int tmy3_header(weatherfile *wf);
+static double measured(const weatherfile *wf, double value, bool press);
+
+/*============================================================================
+ *    Int function S_weather_open
+ *----------------------------------------------------------------------------*/
+int S_weather_open(const char *path, weatherfile *wf) {
+  struct stat st;
+  void *map;
+  int fd;
+  int retval;
+
+  if ((fd = open(path, O_RDONLY)) < 0) return S_WEATHER_NOT_FOUND;
+  if ((fstat(fd, &st) != 0) || (st.st_size <= 0)) {
+    close(fd);
+    return S_WEATHER_NOT_FOUND;
+  }
+  map = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd); /* (the mapping keeps the file) */
+  if (map == MAP_FAILED) return S_WEATHER_NOT_FOUND;
+  madvise(map, st.st_size, MADV_SEQUENTIAL);
+
+  if ((retval = S_weather_attach(static_cast<const char *>(map), st.st_size,
+                                 wf)) != S_WEATHER_OK) {
+    munmap(map, st.st_size);
+    return retval;
+  }
+  wf->map = map;
+  wf->map_size = st.st_size;
+  return S_WEATHER_OK;
+}
+
+/*============================================================================
+ *    Int function S_weather_attach
+ *----------------------------------------------------------------------------*/
+int S_weather_attach(const char *data, std::size_t size, weatherfile *wf) {
+  memset(wf, 0, sizeof(*wf));
+  wf->data = data;
+  wf->end = data + size;
+
+  if ((size > 9) && (memcmp(data, "LOCATION,", 9) == 0))
+    return epw_header(wf);
+  return tmy3_header(wf);
+}
+
+/*============================================================================
+ *    Void function S_weather_close
+ *----------------------------------------------------------------------------*/
+void S_weather_close(weatherfile *wf) {
+  if (wf->map != nullptr) munmap(wf->map, wf->map_size);
+  wf->map = nullptr;
+  wf->data = wf->end = wf->rows = wf->next = nullptr;
+}
+
+/*============================================================================
+ *    Void function S_weather_rewind
+ *----------------------------------------------------------------------------*/
+void S_weather_rewind(weatherfile *wf) { wf->next = wf->rows; }
+
+/*============================================================================
+ *    Int function S_weather_read
+ *----------------------------------------------------------------------------*/
+int S_weather_read(weatherfile *wf, int columns, int max_rows,
+                   long long *epoch, double *press, double *temp) {
+  const bool want_press = (columns & S_WX_PRESS) != 0;
+  const bool want_temp = (columns & S_WX_TEMP) != 0;
+  int last_field = -1; /* the line is skipped after this field */
+  int rows = 0;
+
+  if (want_press && (wf->press_field > last_field))
+    last_field = wf->press_field;
+  if (want_temp && (wf->temp_field > last_field)) last_field = wf->temp_field;
+
+  while ((rows < max_rows) && (wf->next < wf->end)) {
+    const char *p = wf->next;
+    const char *eol = line_end(p, wf->end);
+
+    wf->next = next_line(eol, wf->end);
+    if ((eol == p) || (*p == '\r')) continue; /* (blank line) */
+
+    if (columns & S_WX_TIME) {
+      const char *q = p;
+      int year, month, day, hour, minute;
+
+      if (wf->format == S_WEATHER_EPW) {
+        /* year,month,day,hour,minute; hour 1 - 24 ends at hh:00, unless
+           the minute (sub-hourly files) is within the hour */
+        year = get_int(&q, eol);
+        month = get_int(&q, eol);
+        day = get_int(&q, eol);
+        hour = get_int(&q, eol);
+        minute = get_int(&q, eol);
+        if ((minute > 0) && (minute < 60))
+          --hour;
+        else
+          minute = 0;
+      } else {
+        /* MM/DD/YYYY,HH:MM */
+        month = get_int(&q, eol);
+        day = get_int(&q, eol);
+        year = get_int(&q, eol);
+        hour = get_int(&q, eol);
+        minute = get_int(&q, eol);
+      }
+      epoch[rows] = S_epoch(year, month, day, hour, minute, 0, wf->timezone);
+    }
+
+    if (last_field >= 0) {
+      const char *q = p;
+
+      /* (fields missing from a short line read as missing values) */
+      if (want_temp) temp[rows] = kMissing;
+      if (want_press) press[rows] = kMissing;
+      for (int field = 0; (field <= last_field) && (q != nullptr); ++field) {
+        if (want_temp && (field == wf->temp_field))
+          temp[rows] = measured(wf, get_number(q, eol), false);
+        if (want_press && (field == wf->press_field))
+          press[rows] = measured(wf, get_number(q, eol), true);
+        q = next_field(q, eol);
+      }
+    }
+    ++rows;
+  }
+  return rows;
+}
+
+/*============================================================================
+ *    Int function S_solpos_weather
+ *----------------------------------------------------------------------------*/
+int S_solpos_weather(weatherfile *wf, const posdata *base, int max_rows,
+                     int *errors, posdata *out) {
+  long long epoch[kBlock];
+  double press[kBlock], temp[kBlock];
+  posdata site = *base;
+  posbatch batch = {};
+  int rows = 0;
+
+  site.function |= S_EPOCH;
+  site.latitude = wf->latitude;
+  site.longitude = wf->longitude;
+  site.timezone = wf->timezone;
+  if (site.interval == 0) site.interval = wf->interval;
+
+  batch.base = &site;
+  batch.epoch = epoch;
+  batch.press = press;
+  batch.temp = temp;
+
+  while (rows < max_rows) {
+    int want = std::min(kBlock, max_rows - rows);
+    std::fill(press, press + want, kMissing);
+    std::fill(temp, temp + want, kMissing);
+    int n = S_weather_read(wf, S_WX_ALL, want, epoch, press, temp);
+    for (int i = 0; i < n; ++i) {
+      if (std::isnan(press[i])) press[i] = base->press;
+      if (std::isnan(temp[i])) temp[i] = base->temp;
+    }
+
+    batch.count = n;
+    S_solpos_batch(&batch, errors + rows, out + rows);
+
+    /* The hour-24 line of 31 DEC 2050 ends at 1 JAN 2051, past the
+       S_EPOCH range; its interval is inside it, so it is computed at
+       the interval midpoint with interval 0 instead */
+    for (int i = 0; (i < n) && (site.interval > 0); ++i) {
+      if (errors[rows + i] != (1L << S_YEAR_ERROR)) continue;
+      posdata *pd = &out[rows + i];
+      S_batch_row(&batch, i, pd);
+      double middle = pd->epochfrac - pd->interval / 2.0;
+      double whole = std::floor(middle);
+      pd->epoch += static_cast<long long>(whole);
+      pd->epochfrac = middle - whole;
+      pd->interval = 0;
+      errors[rows + i] = S_solpos(pd);
+    }
+    rows += n;
+    if (n < want) break; /* the end of the file */
+  }
+  return rows;
+}
+
+/*============================================================================
+ *    Local const char* functions line_end, next_line, next_field
+ *
+ *    The end of the line at p, the start of the line after eol, and the
+ *    start of the field after the one at p (nullptr if none)
+ *----------------------------------------------------------------------------*/
+static const char *line_end(const char *p, const char *end) {
+  const char *eol = static_cast<const char *>(memchr(p, '\n', end - p));
+  return (eol != nullptr) ? eol : end;
+}
+
+static const char *next_line(const char *eol, const char *end) {
+  return (eol < end) ? eol + 1 : end;
+}
+
+static const char *next_field(const char *p, const char *eol) {
+  const char *comma = static_cast<const char *>(memchr(p, ',', eol - p));
+  return (comma != nullptr) ? comma + 1 : nullptr;
+}
+
+/*============================================================================
+ *    Local bool function field_is
+ *
+ *    Whether the field at p begins with text
+ *----------------------------------------------------------------------------*/
+static bool field_is(const char *p, const char *eol, const char *text) {
+  std::size_t len = strlen(text);
+  return (static_cast<std::size_t>(eol - p) >= len) &&
+         (memcmp(p, text, len) == 0);
+}
+
+/*============================================================================
+ *    Local double function get_number
+ *
+ *    Decimal number at p ([-+]digits[.digits][e[-+]digits]), without
+ *    reading past eol; NaN if there is none
+ *----------------------------------------------------------------------------*/
+static double get_number(const char *p, const char *eol) {
+  double mantissa = 0.0; /* all digits, as an integer (exact to 2^53) */
+  int exponent = 0;      /* power of ten to apply to the mantissa */
+  bool digits = false;
+  bool negative = false;
+
+  while ((p < eol) && (*p == ' ')) ++p;
+  if ((p < eol) && ((*p == '-') || (*p == '+'))) negative = (*p++ == '-');
+  for (; (p < eol) && (*p >= '0') && (*p <= '9'); ++p, digits = true)
+    mantissa = mantissa * 10.0 + (*p - '0');
+  if ((p < eol) && (*p == '.')) {
+    for (++p; (p < eol) && (*p >= '0') && (*p <= '9'); ++p, digits = true) {
+      mantissa = mantissa * 10.0 + (*p - '0');
+      --exponent;
+    }
+  }
+  if (!digits) return kMissing;
+  if ((p < eol) && ((*p == 'e') || (*p == 'E'))) {
+    int value = 0;
+    bool down = false;
+
+    ++p;
+    if ((p < eol) && ((*p == '-') || (*p == '+'))) down = (*p++ == '-');
+    for (; (p < eol) && (*p >= '0') && (*p <= '9') && (value < 1000); ++p)
+      value = value * 10 + (*p - '0');
+    exponent += down ? -value : value;
+  }
+
+  /* (dividing by an exact power of ten rounds correctly, unlike
+     multiplying by an inexact 0.1 per digit) */
+  if (exponent < 0)
+    mantissa /= std::pow(10.0, -exponent);
+  else if (exponent > 0)
+    mantissa *= std::pow(10.0, exponent);
+  return negative ? -mantissa : mantissa;
+}
+
+/*============================================================================
+ *    Local int function get_int
+ *
+ *    Unsigned integer at *p; advances *p past it and one separator
+ *----------------------------------------------------------------------------*/
+static int get_int(const char **p, const char *eol) {
+  const char *q = *p;
+  int value = 0;
+
+  while ((q < eol) && (*q == ' ')) ++q;
+  for (; (q < eol) && (*q >= '0') && (*q <= '9'); ++q)
+    value = value * 10 + (*q - '0');
+  if (q < eol) ++q; /* ',', '/' or ':' */
+  *p = q;
+  return value;
+}
+
+/*============================================================================
+ *    Local int function epw_header
+ *
+ *    LOCATION,city,state,country,source,WMO,latitude,longitude,timezone,
+ *    elevation ... DATA PERIODS,periods,records per hour,...
+ *----------------------------------------------------------------------------*/
+static int epw_header(weatherfile *wf) {
+  const char *p = wf->data;
+  const char *eol = line_end(p, wf->end);
+  const char *q = p;
+
+  wf->format = S_WEATHER_EPW;
+  for (int field = 0; (field < 9) && (q != nullptr); ++field) {
+    if (field == 6) wf->latitude = get_number(q, eol);
+    if (field == 7) wf->longitude = get_number(q, eol);
+    if (field == 8) wf->timezone = get_number(q, eol);
+    q = next_field(q, eol);
+  }
+  if (q == nullptr) return S_WEATHER_BAD_DATA;
+  wf->elevation = get_number(q, eol);
+
+  /* The data follow the DATA PERIODS line */
+  wf->interval = 3600;
+  for (int line = 1; line < 8; ++line) {
+    p = next_line(eol, wf->end);
+    eol = line_end(p, wf->end);
+    if (field_is(p, eol, "DATA PERIODS,")) {
+      q = next_field(next_field(p, eol), eol);
+      if (q != nullptr) {
+        double per_hour = get_number(q, eol);
+        if ((per_hour >= 1.0) && (per_hour <= 60.0))
+          wf->interval = static_cast<int>(3600 / static_cast<int>(per_hour));
+      }
+      wf->rows = wf->next = next_line(eol, wf->end);
+      break;
+    }
+  }
+  if (wf->rows == nullptr) return S_WEATHER_BAD_DATA;
+
+  wf->temp_field = 6;
+  wf->press_field = 9;
+  wf->press_scale = 0.01; /* Pa */
+  return S_WEATHER_OK;
+}
+
+/*============================================================================
+ *    Local int function tmy3_header
+ *
+ *    USAF,"name",state,timezone,latitude,longitude,elevation
+ *    Date (MM/DD/YYYY),Time (HH:MM),... column names
+ *----------------------------------------------------------------------------*/
+static int tmy3_header(weatherfile *wf) {
+  const char *p = wf->data;
+  const char *eol = line_end(p, wf->end);
+  const char *q = p;
+  bool quoted = false;
+  int field = 0;
+
+  wf->format = S_WEATHER_TMY3;
+  wf->interval = 3600;
+
+  /* (the station name is quoted and may hold commas) */
+  for (; (q < eol) && (field < 7); ++q) {
+    if (*q == '"') quoted = !quoted;
+    if ((*q != ',') || quoted) continue;
+    ++field;
+    if (field == 3) wf->timezone = get_number(q + 1, eol);
+    if (field == 4) wf->latitude = get_number(q + 1, eol);
+    if (field == 5) wf->longitude = get_number(q + 1, eol);
+    if (field == 6) wf->elevation = get_number(q + 1, eol);
+  }
+  if (field < 6) return S_WEATHER_BAD_DATA;
+
+  p = next_line(eol, wf->end);
+  eol = line_end(p, wf->end);
+  if (!field_is(p, eol, "Date (MM/DD/YYYY)")) return S_WEATHER_BAD_DATA;
+
+  wf->temp_field = wf->press_field = -1;
+  q = p;
+  for (field = 0; q != nullptr; ++field, q = next_field(q, eol)) {
+    if (field_is(q, eol, "Dry-bulb (C)")) wf->temp_field = field;
+    if (field_is(q, eol, "Pressure (mbar)")) wf->press_field = field;
+  }
+  if ((wf->temp_field < 0) || (wf->press_field < 0)) return S_WEATHER_BAD_DATA;
+
+  wf->press_scale = 1.0; /* mbar */
+  wf->rows = wf->next = next_line(eol, wf->end);
+  return S_WEATHER_OK;
+}
+
+/*============================================================================
+ *    Local double function measured
+ *
+ *    Converts a file value to solpos units, or NaN for the missing value
+ *    codes (EPW 99.9 C and 999999 Pa; TMY3 -9900)
+ *----------------------------------------------------------------------------*/
+static double measured(const weatherfile *wf, double value, bool press) {
+  if (wf->format == S_WEATHER_EPW) {
+    if (press ? (value >= 999999.0) : (value >= 99.9)) return kMissing;
+  } else if (value <= -9900.0) {
+    return kMissing;
+  }
+  return press ? value * wf->press_scale : value;
+}
+
+}  // namespace solpos
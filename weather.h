@@ -0,0 +1,139 @@
+/*============================================================================
+ *
+ *    NAME:  weather.h
+ *
+ *    Contains:
+ *        S_weather_open    (memory-maps an EPW or TMY3 weather file)
+ *        S_weather_read    (decodes the next rows into time, pressure and
+ *                           temperature columns)
+ *        S_solpos_weather  (runs S_solpos over the next rows with the
+ *                           file's site and per-row press and temp)
+ *
+ *    refrac() and amass() use press and temp, which otherwise stay at
+ *    their S_init defaults.  The readers parse the mapped file in place
+ *    and in order: each call picks up where the last one stopped, and
+ *    only the fields of the requested columns are converted (the rest of
+ *    a line is skipped with a memchr).
+ *
+ *    Formats:
+ *        EPW   EnergyPlus weather, 8 header lines then one line per
+ *              interval: year, month, day, hour (1 - 24), minute, ...,
+ *              dry-bulb (C) in field 7, pressure (Pa) in field 10.
+ *        TMY3  NREL Typical Meteorological Year 3: a site line, a column
+ *              name line, then "MM/DD/YYYY,HH:MM,..." lines; the
+ *              "Dry-bulb (C)" and "Pressure (mbar)" columns are located
+ *              by name.
+ *
+ *    Both stamp each line with the END of its interval, in local standard
+ *    time; S_solpos_weather therefore uses the file's interval (so that
+ *    positions are for the interval midpoint) unless the base posdata
+ *    already sets one.  A line whose end is past the S_EPOCH range but
+ *    whose midpoint is not (hour 24 of 31 DEC 2050) is instead stamped
+ *    with its midpoint and interval 0, which is the same position.
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_WEATHER_H_
+#define SOLPOS_WEATHER_H_
+
+#include <cstddef>
+
+#include "solpos.h"
+
+namespace solpos {
+
+/*============================================================================
+ *
+ *     Formats, status codes and column switches
+ *
+ *----------------------------------------------------------------------------*/
+enum { S_WEATHER_EPW = 1, S_WEATHER_TMY3 };
+
+enum {
+  S_WEATHER_OK = 0,
+  S_WEATHER_NOT_FOUND, /* file cannot be opened or mapped */
+  S_WEATHER_BAD_DATA   /* neither an EPW nor a TMY3 file */
+};
+
+#define S_WX_TIME 0x01  /* epoch column */
+#define S_WX_PRESS 0x02 /* press column */
+#define S_WX_TEMP 0x04  /* temp column */
+#define S_WX_ALL (S_WX_TIME | S_WX_PRESS | S_WX_TEMP)
+
+struct weatherfile {
+  /* VARIABLE        I/O  Description */
+  /* -------------  ----  ---------------------------------------------------*/
+  int format;        /* O:  S_WEATHER_EPW or S_WEATHER_TMY3 */
+  double latitude;   /* O:  Site latitude, degrees north */
+  double longitude;  /* O:  Site longitude, degrees east */
+  double timezone;   /* O:  Site standard time zone, hours east */
+  double elevation;  /* O:  Site elevation, meters */
+  int interval;      /* O:  Seconds covered by each line */
+
+  /* Reader state; treat as private */
+  const char *data;  /* file contents */
+  const char *end;   /* one past the contents */
+  const char *rows;  /* first data line */
+  const char *next;  /* next line to read */
+  int temp_field;    /* zero-based field index of dry-bulb temperature */
+  int press_field;   /* zero-based field index of pressure */
+  double press_scale; /* file pressure units to millibars */
+  void *map;         /* mmap region, or nullptr if attached */
+  std::size_t map_size;
+};
+
+/*============================================================================
+ *    Int function S_weather_open
+ *
+ *    Maps the file read-only and parses its header.
+ *
+ *    RETURNS: S_WEATHER_OK, or an error code (nothing is left mapped)
+ *----------------------------------------------------------------------------*/
+int S_weather_open(const char *path, weatherfile *wf);
+
+/*============================================================================
+ *    Int function S_weather_attach
+ *
+ *    As S_weather_open, for file contents already in memory.  The data
+ *    must outlive the weatherfile; it is not copied.
+ *----------------------------------------------------------------------------*/
+int S_weather_attach(const char *data, std::size_t size, weatherfile *wf);
+
+/* Unmaps the file (if S_weather_open mapped it) */
+void S_weather_close(weatherfile *wf);
+
+/* Restarts reading at the first data line */
+void S_weather_rewind(weatherfile *wf);
+
+/*============================================================================
+ *    Int function S_weather_read
+ *
+ *    Decodes up to max_rows lines into the columns selected by the S_WX_*
+ *    switches in columns (the other column pointers may be nullptr):
+ *        epoch   Unix time of the end of the interval
+ *        press   Surface pressure, millibars (NaN where missing)
+ *        temp    Dry-bulb temperature, degrees C (NaN where missing)
+ *
+ *    RETURNS: Number of rows decoded; 0 at the end of the file
+ *----------------------------------------------------------------------------*/
+int S_weather_read(weatherfile *wf, int columns, int max_rows,
+                   long long *epoch, double *press, double *temp);
+
+/*============================================================================
+ *    Int function S_solpos_weather
+ *
+ *    Reads up to max_rows lines and computes them as a batch (see
+ *    batch.h) with the S_EPOCH switch: site and time zone from the file,
+ *    press and temp per row (base values where missing), every other
+ *    input from base.  Lines are decoded and computed a block at a time
+ *    through fixed stack columns, so nothing is allocated.
+ *
+ *    OUTPUTS: errors[i] (S_solpos return code) and out[i] per row read
+ *
+ *    RETURNS: Number of rows read; 0 at the end of the file
+ *----------------------------------------------------------------------------*/
+int S_solpos_weather(weatherfile *wf, const posdata *base, int max_rows,
+                     int *errors, posdata *out);
+
+}  // namespace solpos
+
+#endif  // SOLPOS_WEATHER_H_
@@ -0,0 +1,220 @@
+#include "weather.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace solpos {
+namespace {
+
+const char kEpw[] =
+    "LOCATION,Golden,CO,USA,TMY3,724666,39.74,-105.18,-7.0,1829.0\n"
+    "DESIGN CONDITIONS,0\n"
+    "TYPICAL/EXTREME PERIODS,0\n"
+    "GROUND TEMPERATURES,0\n"
+    "HOLIDAYS/DAYLIGHT SAVINGS,No,0,0,0\n"
+    "COMMENTS 1,synthetic\n"
+    "COMMENTS 2,\n"
+    "DATA PERIODS,1,1,Data,Sunday, 1/ 1,12/31\n"
+    "1999,7,22,10,60,A7A7,27.0,10.0,40,81000,0,0\n"
+    "1999,7,22,11,60,A7A7,28.5,10.0,40,999999,0,0\r\n"
+    "\n"
+    "1999,7,22,12,0,A7A7,99.9,10.0,40,80950,0,0\n";
+
+const char kTmy3[] =
+    "724666,\"DENVER/CENTENNIAL [GOLDEN, NREL]\",CO,-7.0,39.742,-105.179,1829\n"
+    "Date (MM/DD/YYYY),Time (HH:MM),ETR (W/m^2),Dry-bulb (C),"
+    "Dry-bulb source,Pressure (mbar),Pressure source\n"
+    "07/22/1999,10:00,1200,27.0,A,810,A\n"
+    "07/22/1999,11:00,1250,28.5,A,809.5,A\n";
+
+TEST(WeatherTest, ReadsEpwColumns) {
+  weatherfile wf;
+  ASSERT_EQ(S_weather_attach(kEpw, sizeof(kEpw) - 1, &wf), S_WEATHER_OK);
+  EXPECT_EQ(wf.format, S_WEATHER_EPW);
+  EXPECT_EQ(wf.latitude, 39.74);
+  EXPECT_EQ(wf.longitude, -105.18);
+  EXPECT_EQ(wf.timezone, -7.0);
+  EXPECT_EQ(wf.elevation, 1829.0);
+  EXPECT_EQ(wf.interval, 3600);
+
+  long long epoch[8];
+  double press[8], temp[8];
+  ASSERT_EQ(S_weather_read(&wf, S_WX_ALL, 8, epoch, press, temp), 3);
+  EXPECT_EQ(epoch[0], S_epoch(1999, 7, 22, 10, 0, 0, -7.0));
+  EXPECT_EQ(epoch[2], S_epoch(1999, 7, 22, 12, 0, 0, -7.0));
+  EXPECT_EQ(press[0], 810.0);
+  EXPECT_TRUE(std::isnan(press[1]));
+  EXPECT_EQ(temp[1], 28.5);
+  EXPECT_TRUE(std::isnan(temp[2]));
+  EXPECT_EQ(S_weather_read(&wf, S_WX_ALL, 8, epoch, press, temp), 0);
+
+  /* Only the requested columns are touched */
+  S_weather_rewind(&wf);
+  temp[0] = -1.0;
+  ASSERT_EQ(S_weather_read(&wf, S_WX_PRESS, 2, nullptr, press, nullptr), 2);
+  EXPECT_EQ(press[0], 810.0);
+  EXPECT_EQ(temp[0], -1.0);
+  ASSERT_EQ(S_weather_read(&wf, S_WX_TIME, 2, epoch, nullptr, nullptr), 1);
+  EXPECT_EQ(epoch[0], S_epoch(1999, 7, 22, 12, 0, 0, -7.0));
+  S_weather_close(&wf);
+}
+
+TEST(WeatherTest, ReadsTmy3Columns) {
+  weatherfile wf;
+  ASSERT_EQ(S_weather_attach(kTmy3, sizeof(kTmy3) - 1, &wf), S_WEATHER_OK);
+  EXPECT_EQ(wf.format, S_WEATHER_TMY3);
+  EXPECT_EQ(wf.latitude, 39.742);
+  EXPECT_EQ(wf.longitude, -105.179);
+  EXPECT_EQ(wf.timezone, -7.0);
+
+  long long epoch[4];
+  double press[4], temp[4];
+  ASSERT_EQ(S_weather_read(&wf, S_WX_ALL, 4, epoch, press, temp), 2);
+  EXPECT_EQ(epoch[1], S_epoch(1999, 7, 22, 11, 0, 0, -7.0));
+  EXPECT_EQ(press[1], 809.5);
+  EXPECT_EQ(temp[0], 27.0);
+  S_weather_close(&wf);
+}
+
+TEST(WeatherTest, DrivesSolposFromMappedFile) {
+  char path[] = "/tmp/weather_testXXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_GE(fd, 0);
+  FILE *file = fdopen(fd, "w");
+  fputs(kEpw, file);
+  fclose(file);
+
+  weatherfile wf;
+  ASSERT_EQ(S_weather_open(path, &wf), S_WEATHER_OK);
+  remove(path); /* (the mapping stays valid) */
+
+  posdata base;
+  S_init(&base);
+  int errors[3];
+  posdata out[3];
+  ASSERT_EQ(S_solpos_weather(&wf, &base, 3, errors, out), 3);
+
+  const double press[] = {810.0, base.press, 809.5};
+  const double temp[] = {27.0, 28.5, base.temp};
+  const int hour[] = {10, 11, 12};
+  for (int i = 0; i < 3; ++i) {
+    posdata pd;
+    S_init(&pd);
+    pd.latitude = 39.74;
+    pd.longitude = -105.18;
+    pd.timezone = -7.0;
+    pd.year = 1999;
+    pd.daynum = 203;
+    pd.hour = hour[i];
+    pd.minute = 0;
+    pd.second = 0;
+    pd.interval = 3600;
+    pd.press = press[i];
+    pd.temp = temp[i];
+    ASSERT_EQ(S_solpos(&pd), 0);
+
+    EXPECT_EQ(errors[i], 0);
+    EXPECT_EQ(out[i].press, press[i]);
+    EXPECT_EQ(out[i].temp, temp[i]);
+    EXPECT_NEAR(out[i].zenref, pd.zenref, 1e-6);
+    EXPECT_NEAR(out[i].ampress, pd.ampress, 1e-6);
+  }
+  EXPECT_EQ(S_solpos_weather(&wf, &base, 3, errors, out), 0);
+  S_weather_close(&wf);
+
+  EXPECT_EQ(S_weather_open("/nonexistent/file.epw", &wf),
+            S_WEATHER_NOT_FOUND);
+  EXPECT_EQ(S_weather_attach("garbage\n", 8, &wf), S_WEATHER_BAD_DATA);
+}
+
+TEST(WeatherTest, LastHourOf2050) {
+  std::string epw(kEpw, strstr(kEpw, "1999,7,22,10") - kEpw);
+  epw += "2050,12,31,23,60,A7A7,-5.0,-9.0,40,81000,0,0\n"
+         "2050,12,31,24,60,A7A7,-5.5,-9.0,40,81000,0,0\n";
+  weatherfile wf;
+  ASSERT_EQ(S_weather_attach(epw.data(), epw.size(), &wf), S_WEATHER_OK);
+
+  posdata base;
+  S_init(&base);
+  int errors[2];
+  posdata out[2];
+  ASSERT_EQ(S_solpos_weather(&wf, &base, 2, errors, out), 2);
+  EXPECT_EQ(errors[0], 0);
+  EXPECT_EQ(errors[1], 0);
+  EXPECT_EQ(out[0].interval, 3600);
+  EXPECT_EQ(out[1].interval, 0);
+
+  /* the same position as the interval ending at 24:00 would have */
+  posdata pd;
+  S_init(&pd);
+  pd.latitude = 39.74;
+  pd.longitude = -105.18;
+  pd.timezone = -7.0;
+  pd.year = 2050;
+  pd.daynum = 365;
+  pd.hour = 23;
+  pd.minute = 30;
+  pd.second = 0;
+  pd.press = 810.0;
+  pd.temp = -5.5;
+  ASSERT_EQ(S_solpos(&pd), 0);
+  EXPECT_NEAR(out[1].zenetr, pd.zenetr, 1e-9);
+  EXPECT_NEAR(out[1].azim, pd.azim, 1e-9);
+  S_weather_close(&wf);
+}
+
+TEST(WeatherTest, SolposAcrossBlocks) {
+  /* 55 days of hourly lines: more rows than S_solpos_weather takes at once */
+  std::string text(kEpw, std::strstr(kEpw, "1999,"));
+  char line[96];
+  for (int i = 0; i < 55 * 24; ++i) {
+    int temp = i % 40;
+    std::snprintf(line, sizeof(line),
+                  "1999,%d,%d,%d,60,A7A7,%d.5,10,40,%d,0,0\n",
+                  1 + i / 24 / 31, 1 + i / 24 % 31, 1 + i % 24, temp,
+                  i % 7 ? 81000 + i : 999999);
+    text += line;
+  }
+  weatherfile wf;
+  ASSERT_EQ(S_weather_attach(text.data(), text.size(), &wf), S_WEATHER_OK);
+
+  posdata base;
+  S_init(&base);
+  const int n = 55 * 24;
+  std::vector<int> errors(n + 10);
+  std::vector<posdata> out(n + 10);
+  ASSERT_EQ(S_solpos_weather(&wf, &base, n + 10, errors.data(), out.data()),
+            n);
+
+  S_weather_rewind(&wf);
+  std::vector<long long> epoch(n);
+  std::vector<double> press(n), temp(n);
+  ASSERT_EQ(S_weather_read(&wf, S_WX_ALL, n, epoch.data(), press.data(),
+                           temp.data()),
+            n);
+  for (int i = 0; i < n; ++i) {
+    posdata pd = base;
+    pd.function |= S_EPOCH;
+    pd.latitude = wf.latitude;
+    pd.longitude = wf.longitude;
+    pd.timezone = wf.timezone;
+    pd.interval = wf.interval;
+    pd.epoch = epoch[i];
+    pd.epochfrac = 0.0;
+    pd.press = std::isnan(press[i]) ? base.press : press[i];
+    pd.temp = temp[i];
+    ASSERT_EQ(S_solpos(&pd), 0);
+    EXPECT_EQ(errors[i], 0) << "row " << i;
+    EXPECT_EQ(out[i].press, pd.press) << "row " << i;
+    EXPECT_EQ(out[i].zenref, pd.zenref) << "row " << i;
+  }
+  S_weather_close(&wf);
+}
+
+}  // namespace
+}  // namespace solpos
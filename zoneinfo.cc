@@ -0,0 +1,512 @@
+/*============================================================================
+ *    Contains:
+ *        S_tz_cursor_init, S_tz_load, S_tz_parse, S_tz_utc2local,
+ *        S_tz_local2utc
+ *
+ *        TZif format:
+ *            Olson, A., Eggert, P., & Murchison, K.  2019.  The Time Zone
+ *            Information Format (TZif).  RFC 8536.
+ *        Footer TZ strings:
+ *            IEEE Std 1003.1-2017, 8.3 Other Environment Variables (TZ)
+ *----------------------------------------------------------------------------*/
+#include "zoneinfo.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+#include "solpos.h"
+
+namespace solpos {
+
+/*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Structures defined for this module
+ *
+ *++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
+struct tzheader /* counts from a TZif header */
+{
+  char version; /* 0 for version 1, else '2', '3', ... */
+  long long isutcnt;
+  long long isstdcnt;
+  long long leapcnt;
+  long long timecnt;
+  long long typecnt;
+  long long charcnt;
+};
+
+struct tzrule /* date and time of a footer transition */
+{
+  char kind; /* 'J' (Jn), 'N' (n) or 'M' (Mm.w.d) */
+  int month; /* Mm.w.d only */
+  int week;  /* Mm.w.d only, 1 - 5 (5 = last) */
+  int day;   /* n or Jn, or the weekday (Sunday = 0) of Mm.w.d */
+  int time;  /* seconds after local midnight, DEFAULT 02:00 */
+};
+
+struct tzfooter /* the parts of a POSIX TZ string we use */
+{
+  int stdoff;   /* standard time offset, seconds east */
+  int dstoff;   /* daylight saving time offset, seconds east */
+  bool has_dst; /* whether there are rules at all */
+  tzrule start; /* change to daylight saving time */
+  tzrule end;   /* change back to standard time */
+};
+
+/*++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++
+ *
+ * Temporary global variables used only in this file:
+ *
+ *++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++++*/
+static const int kLastYear = 2050; /* footer rules are expanded up to here */
+static const long long kMaxOffset = 26 * 3600; /* bounds any |utoff| */
+static const int kMaxZoneFile = 1 << 20;
+
+/*============================================================================
+*    Local function prototypes
+============================================================================*/
+static long long get_int(const unsigned char *p, int bytes);
+static bool read_header(const unsigned char *p, std::size_t size,
+                        tzheader *hdr);
+static long long body_size(const tzheader *hdr, int timesize);
+static bool parse_name(const char **s);
+static bool parse_time(const char **s, int *seconds);
+static bool parse_rule(const char **s, tzrule *rule);
+static bool parse_footer(const char *s, tzfooter *footer);
+static long long rule_epoch(const tzrule *rule, int year, int utoff);
+static int year_of(long long utc);
+static void expand_footer(const tzfooter *footer, tzinfo *tz,
+                          std::vector<int> *isdst);
+static void fill_stdoff(const std::vector<int> &isdst, tzinfo *tz);
+static int find_utc(const tzinfo *tz, int k, long long utc);
+static int find_local(const tzinfo *tz, int k, long long local);
+
+/*============================================================================
+ *    Void function S_tz_cursor_init
+ *----------------------------------------------------------------------------*/
+void S_tz_cursor_init(tzcursor *cursor) { cursor->interval = 0; }
+
+/*============================================================================
+ *    Int function S_tz_load
+ *----------------------------------------------------------------------------*/
+int S_tz_load(const char *name, tzinfo *tz) {
+  const char *dir = std::getenv("TZDIR");
+  std::string path;
+  std::vector<char> data(kMaxZoneFile);
+  std::size_t size;
+  FILE *file;
+
+  *tz = tzinfo();
+
+  /* (zone names are relative; keep them inside the zoneinfo directory) */
+  if ((name[0] == '/') || (std::strstr(name, "..") != nullptr))
+    return S_TZ_NOT_FOUND;
+
+  path = (dir != nullptr && dir[0] != '\0') ? dir : "/usr/share/zoneinfo";
+  path += '/';
+  path += name;
+  if ((file = std::fopen(path.c_str(), "rb")) == nullptr)
+    return S_TZ_NOT_FOUND;
+  size = std::fread(data.data(), 1, data.size(), file);
+  std::fclose(file);
+
+  return S_tz_parse(data.data(), size, tz);
+}
+
+/*============================================================================
+ *    Int function S_tz_parse
+ *----------------------------------------------------------------------------*/
+int S_tz_parse(const char *data, std::size_t size, tzinfo *tz) {
+  const unsigned char *p = reinterpret_cast<const unsigned char *>(data);
+  tzheader hdr;
+  tzfooter footer;
+  int timesize = 4;
+  long long type;
+  const unsigned char *types; /* transition type indices */
+  const unsigned char *ttinfo;
+  std::vector<int> isdst; /* per interval */
+
+  *tz = tzinfo();
+  if (!read_header(p, size, &hdr)) return S_TZ_BAD_DATA;
+
+  /* Version 2+ files repeat the data with 64-bit times; use that copy */
+  if (hdr.version != 0) {
+    long long skip = 44 + body_size(&hdr, 4);
+    if ((skip > static_cast<long long>(size)) ||
+        !read_header(p + skip, size - skip, &hdr))
+      return S_TZ_BAD_DATA;
+    p += skip;
+    size -= skip;
+    timesize = 8;
+  }
+  if ((hdr.typecnt < 1) || (44 + body_size(&hdr, timesize) >
+                            static_cast<long long>(size)))
+    return S_TZ_BAD_DATA;
+
+  types = p + 44 + hdr.timecnt * timesize;
+  ttinfo = types + hdr.timecnt;
+
+  /* Interval 0 uses local time type 0, interval k the type of transition
+     k - 1 */
+  tz->transitions.reserve(hdr.timecnt);
+  tz->utoff.push_back(static_cast<int>(get_int(ttinfo, 4)));
+  isdst.push_back(ttinfo[4] != 0);
+  for (long long i = 0; i < hdr.timecnt; ++i) {
+    long long t = get_int(p + 44 + i * timesize, timesize);
+
+    type = types[i];
+    if ((type >= hdr.typecnt) ||
+        (!tz->transitions.empty() && (t <= tz->transitions.back()))) {
+      *tz = tzinfo();
+      return S_TZ_BAD_DATA;
+    }
+    tz->transitions.push_back(t);
+    tz->utoff.push_back(static_cast<int>(get_int(ttinfo + type * 6, 4)));
+    isdst.push_back(ttinfo[type * 6 + 4] != 0);
+  }
+
+  /* The footer, "\nTZ string\n", follows the version 2+ data */
+  if (timesize == 8) {
+    const char *s = reinterpret_cast<const char *>(p) + 44 +
+                    body_size(&hdr, 8);
+    const char *end = reinterpret_cast<const char *>(p) + size;
+
+    if ((s < end) && (*s == '\n')) {
+      const char *nl =
+          static_cast<const char *>(std::memchr(s + 1, '\n', end - s - 1));
+      std::string tzstring(s + 1, (nl != nullptr) ? nl : end);
+
+      if (parse_footer(tzstring.c_str(), &footer) && footer.has_dst)
+        expand_footer(&footer, tz, &isdst);
+    }
+  }
+
+  fill_stdoff(isdst, tz);
+  return S_TZ_OK;
+}
+
+/*============================================================================
+ *    Void function S_tz_utc2local
+ *----------------------------------------------------------------------------*/
+void S_tz_utc2local(const tzinfo *tz, tzcursor *cursor, const long long *utc,
+                    int count, int *utoff, double *timezone) {
+  int k = cursor->interval;
+
+  for (int i = 0; i < count; ++i) {
+    k = find_utc(tz, k, utc[i]);
+    if (utoff) utoff[i] = tz->utoff[k];
+    if (timezone) timezone[i] = tz->stdoff[k] / 3600.0;
+  }
+  cursor->interval = k;
+}
+
+/*============================================================================
+ *    Void function S_tz_local2utc
+ *----------------------------------------------------------------------------*/
+void S_tz_local2utc(const tzinfo *tz, tzcursor *cursor, const long long *local,
+                    int count, long long *utc, double *timezone) {
+  int k = cursor->interval;
+
+  for (int i = 0; i < count; ++i) {
+    int used; /* interval whose offset applies */
+
+    k = find_local(tz, k, local[i]);
+    used = k;
+
+    /* (skipped wall clock time: keep the offset from before the change) */
+    if ((k > 0) && (local[i] - tz->utoff[k] < tz->transitions[k - 1]))
+      used = k - 1;
+
+    utc[i] = local[i] - tz->utoff[used];
+    if (timezone) timezone[i] = tz->stdoff[used] / 3600.0;
+  }
+  cursor->interval = k;
+}
+
+/*============================================================================
+ *    Local long long function get_int
+ *
+ *    Big-endian two's complement integer of 4 or 8 bytes
+ *----------------------------------------------------------------------------*/
+static long long get_int(const unsigned char *p, int bytes) {
+  unsigned long long value = 0;
+
+  for (int i = 0; i < bytes; ++i) value = (value << 8) | p[i];
+  if (bytes == 4) return static_cast<int>(static_cast<unsigned int>(value));
+  return static_cast<long long>(value);
+}
+
+/*============================================================================
+ *    Local bool function read_header
+ *----------------------------------------------------------------------------*/
+static bool read_header(const unsigned char *p, std::size_t size,
+                        tzheader *hdr) {
+  if ((size < 44) || (std::memcmp(p, "TZif", 4) != 0)) return false;
+
+  hdr->version = static_cast<char>(p[4]);
+  hdr->isutcnt = get_int(p + 20, 4);
+  hdr->isstdcnt = get_int(p + 24, 4);
+  hdr->leapcnt = get_int(p + 28, 4);
+  hdr->timecnt = get_int(p + 32, 4);
+  hdr->typecnt = get_int(p + 36, 4);
+  hdr->charcnt = get_int(p + 40, 4);
+
+  return (hdr->isutcnt >= 0) && (hdr->isstdcnt >= 0) && (hdr->leapcnt >= 0) &&
+         (hdr->timecnt >= 0) && (hdr->typecnt >= 0) && (hdr->charcnt >= 0);
+}
+
+/*============================================================================
+ *    Local long long function body_size
+ *
+ *    Bytes of data following a header
+ *----------------------------------------------------------------------------*/
+static long long body_size(const tzheader *hdr, int timesize) {
+  return hdr->timecnt * timesize + hdr->timecnt + hdr->typecnt * 6 +
+         hdr->charcnt + hdr->leapcnt * (timesize + 4) + hdr->isstdcnt +
+         hdr->isutcnt;
+}
+
+/*============================================================================
+ *    Local bool function parse_name
+ *
+ *    Skips a zone abbreviation, "EST" or "<-03>"
+ *----------------------------------------------------------------------------*/
+static bool parse_name(const char **s) {
+  const char *p = *s;
+
+  if (*p == '<') {
+    while ((*p != '\0') && (*p != '>')) ++p;
+    if (*p != '>') return false;
+    ++p;
+  } else {
+    while (((*p >= 'A') && (*p <= 'Z')) || ((*p >= 'a') && (*p <= 'z'))) ++p;
+    if (p - *s < 3) return false;
+  }
+  *s = p;
+  return true;
+}
+
+/*============================================================================
+ *    Local bool function parse_time
+ *
+ *    [+|-]hh[:mm[:ss]], in seconds
+ *----------------------------------------------------------------------------*/
+static bool parse_time(const char **s, int *seconds) {
+  const char *p = *s;
+  int sign = 1;
+  int part[3] = {0, 0, 0};
+
+  if ((*p == '+') || (*p == '-')) sign = (*p++ == '-') ? -1 : 1;
+  for (int i = 0; i < 3; ++i) {
+    if ((*p < '0') || (*p > '9')) return false;
+    while ((*p >= '0') && (*p <= '9')) part[i] = part[i] * 10 + (*p++ - '0');
+    if (*p != ':') break;
+    ++p;
+  }
+  *seconds = sign * (part[0] * 3600 + part[1] * 60 + part[2]);
+  *s = p;
+  return true;
+}
+
+/*============================================================================
+ *    Local bool function parse_rule
+ *
+ *    ,Jn[/time] or ,n[/time] or ,Mm.w.d[/time]
+ *----------------------------------------------------------------------------*/
+static bool parse_rule(const char **s, tzrule *rule) {
+  const char *p = *s;
+  char *end;
+
+  if (*p++ != ',') return false;
+  rule->time = 2 * 3600;
+  if (*p == 'M') {
+    rule->kind = 'M';
+    rule->month = static_cast<int>(std::strtol(p + 1, &end, 10));
+    if (*end != '.') return false;
+    rule->week = static_cast<int>(std::strtol(end + 1, &end, 10));
+    if (*end != '.') return false;
+    rule->day = static_cast<int>(std::strtol(end + 1, &end, 10));
+    if ((rule->month < 1) || (rule->month > 12) || (rule->week < 1) ||
+        (rule->week > 5) || (rule->day < 0) || (rule->day > 6))
+      return false;
+  } else {
+    rule->kind = (*p == 'J') ? 'J' : 'N';
+    if (*p == 'J') ++p;
+    if ((*p < '0') || (*p > '9')) return false;
+    rule->day = static_cast<int>(std::strtol(p, &end, 10));
+    if ((rule->day > 365) || ((rule->kind == 'J') && (rule->day < 1)))
+      return false;
+  }
+  p = end;
+  if (*p == '/') {
+    ++p;
+    if (!parse_time(&p, &rule->time)) return false;
+  }
+  *s = p;
+  return true;
+}
+
+/*============================================================================
+ *    Local bool function parse_footer
+ *
+ *    std offset [dst [offset] ,start[/time],end[/time]]
+ *----------------------------------------------------------------------------*/
+static bool parse_footer(const char *s, tzfooter *footer) {
+  int offset;
+
+  /* (POSIX offsets are hours WEST; utoff is seconds east) */
+  if (!parse_name(&s) || !parse_time(&s, &offset)) return false;
+  footer->stdoff = -offset;
+  footer->dstoff = footer->stdoff + 3600;
+  footer->has_dst = false;
+  if (*s == '\0') return true;
+
+  if (!parse_name(&s)) return false;
+  if ((*s != ',') && (*s != '\0')) {
+    if (!parse_time(&s, &offset)) return false;
+    footer->dstoff = -offset;
+  }
+  if (!parse_rule(&s, &footer->start) || !parse_rule(&s, &footer->end))
+    return false;
+  footer->has_dst = true;
+  return *s == '\0';
+}
+
+/*============================================================================
+ *    Local long long function rule_epoch
+ *
+ *    Unix time at which a footer rule fires in a year, the rule's time
+ *    being wall clock time at offset utoff
+ *----------------------------------------------------------------------------*/
+static long long rule_epoch(const tzrule *rule, int year, int utoff) {
+  static const int month_len[13] = {0,  31, 28, 31, 30, 31, 30,
+                                    31, 31, 30, 31, 30, 31};
+  int leap = ((year % 4) == 0) && (((year % 100) != 0) || ((year % 400) == 0));
+  long long day; /* local midnight of the rule's day, Unix time at UTC */
+
+  if (rule->kind == 'J') {
+    /* (Jn never counts 29 February) */
+    day = S_epoch(year, 1, rule->day + ((leap && rule->day >= 60) ? 1 : 0), 0,
+                  0, 0, 0.0);
+  } else if (rule->kind == 'N') {
+    day = S_epoch(year, 1, 1 + rule->day, 0, 0, 0, 0.0);
+  } else {
+    int length = month_len[rule->month] + ((rule->month == 2) ? leap : 0);
+    long long first = S_epoch(year, rule->month, 1, 0, 0, 0, 0.0);
+    /* (Sunday = 0; 1 JAN 1970 was a Thursday) */
+    int weekday = static_cast<int>(((first / 86400) % 7 + 11) % 7);
+    int mday = 1 + (rule->day - weekday + 7) % 7 + (rule->week - 1) * 7;
+
+    while (mday > length) mday -= 7;
+    day = first + (mday - 1) * 86400LL;
+  }
+  return day + rule->time - utoff;
+}
+
+/*============================================================================
+ *    Local int function year_of
+ *
+ *    UTC calendar year of a Unix time
+ *----------------------------------------------------------------------------*/
+static int year_of(long long utc) {
+  int year = 1970 + static_cast<int>(utc / 31556952); /* mean year */
+
+  while (S_epoch(year, 1, 1, 0, 0, 0, 0.0) > utc) --year;
+  while (S_epoch(year + 1, 1, 1, 0, 0, 0, 0.0) <= utc) ++year;
+  return year;
+}
+
+/*============================================================================
+ *    Local void function expand_footer
+ *
+ *    Appends the footer's transitions from the year of the last stored
+ *    transition through kLastYear
+ *----------------------------------------------------------------------------*/
+static void expand_footer(const tzfooter *footer, tzinfo *tz,
+                          std::vector<int> *isdst) {
+  int year = tz->transitions.empty() ? 1950 : year_of(tz->transitions.back());
+
+  for (; year <= kLastYear; ++year) {
+    /* The start is given in standard time, the end in daylight time */
+    long long start = rule_epoch(&footer->start, year, footer->stdoff);
+    long long end = rule_epoch(&footer->end, year, footer->dstoff);
+    long long when[2] = {std::min(start, end), std::max(start, end)};
+
+    for (int i = 0; i < 2; ++i) {
+      if (!tz->transitions.empty() && (when[i] <= tz->transitions.back()))
+        continue;
+      tz->transitions.push_back(when[i]);
+      tz->utoff.push_back((when[i] == start) ? footer->dstoff
+                                             : footer->stdoff);
+      isdst->push_back(when[i] == start);
+    }
+  }
+}
+
+/*============================================================================
+ *    Local void function fill_stdoff
+ *
+ *    Standard offset of each interval: its own offset when not daylight
+ *    saving time, else that of the closest preceding standard interval
+ *    (or the first standard interval, or an hour less, if there is none)
+ *----------------------------------------------------------------------------*/
+static void fill_stdoff(const std::vector<int> &isdst, tzinfo *tz) {
+  const std::size_t n = tz->utoff.size();
+  std::size_t first = 0; /* first standard time interval */
+
+  while ((first < n) && isdst[first]) ++first;
+
+  tz->stdoff.resize(n);
+  for (std::size_t k = 0; k < n; ++k) {
+    if (!isdst[k])
+      tz->stdoff[k] = tz->utoff[k];
+    else if (k > first)
+      tz->stdoff[k] = tz->stdoff[k - 1];
+    else
+      tz->stdoff[k] = (first < n) ? tz->utoff[first] : tz->utoff[k] - 3600;
+  }
+}
+
+/*============================================================================
+ *    Local int function find_utc
+ *
+ *    Interval containing Unix time utc, starting the search at k
+ *----------------------------------------------------------------------------*/
+static int find_utc(const tzinfo *tz, int k, long long utc) {
+  const std::vector<long long> &tr = tz->transitions;
+  const int n = static_cast<int>(tr.size());
+
+  /* Usually still in interval k, or just past its end */
+  if ((k > 0) && (utc < tr[k - 1]))
+    k = -1;
+  else if ((k < n) && (utc >= tr[k]) && ((++k < n) && (utc >= tr[k])))
+    k = -1;
+  if (k < 0)
+    k = static_cast<int>(std::upper_bound(tr.begin(), tr.end(), utc) -
+                         tr.begin());
+  return k;
+}
+
+/*============================================================================
+ *    Local int function find_local
+ *
+ *    First interval whose local wall clock end is after local, starting
+ *    the search at k
+ *----------------------------------------------------------------------------*/
+static int find_local(const tzinfo *tz, int k, long long local) {
+  const std::vector<long long> &tr = tz->transitions;
+  const int n = static_cast<int>(tr.size());
+
+  /* Going backward, or forward by more than an interval: restart from an
+     interval that cannot be past the answer */
+  if (((k > 0) && (local < tr[k - 1] + tz->utoff[k - 1])) ||
+      ((k + 1 < n) && (local >= tr[k + 1] + tz->utoff[k + 1])))
+    k = find_utc(tz, 0, local - kMaxOffset);
+
+  while ((k < n) && (local >= tr[k] + tz->utoff[k])) ++k;
+  return k;
+}
+
+}  // namespace solpos
@@ -0,0 +1,108 @@
+/*============================================================================
+ *
+ *    NAME:  zoneinfo.h
+ *
+ *    Contains:
+ *        S_tz_load      (reads an IANA time zone, e.g. "America/New_York",
+ *                        from the system zoneinfo database)
+ *        S_tz_parse     (the same, from TZif data already in memory)
+ *        S_tz_utc2local (UTC -> offsets, for a series of Unix times)
+ *        S_tz_local2utc (local wall clock -> UTC, for a series of times)
+ *
+ *    posdata::timezone is a fixed offset from UTC, in standard time.  A
+ *    tzinfo holds every offset change of a zone as one sorted transition
+ *    array, read once, so that local clock readings that follow daylight
+ *    saving time can be turned into Unix times (for S_EPOCH) and standard
+ *    time zones without a per-row localtime_r call.
+ *
+ *    The conversions take a tzcursor that remembers the last transition
+ *    interval used.  For time-ordered input it only ever moves forward a
+ *    step at a time; out-of-order input falls back to a binary search.
+ *
+ *    Transitions past the last one stored in the file are generated from
+ *    the file's POSIX TZ footer up to the end of 2050, the upper limit of
+ *    the solpos algorithm.
+ *
+ *----------------------------------------------------------------------------*/
+#ifndef SOLPOS_ZONEINFO_H_
+#define SOLPOS_ZONEINFO_H_
+
+#include <cstddef>
+#include <vector>
+
+namespace solpos {
+
+/*============================================================================
+ *
+ *     Status codes returned by S_tz_load and S_tz_parse
+ *
+ *----------------------------------------------------------------------------*/
+enum {
+  S_TZ_OK = 0,
+  S_TZ_NOT_FOUND, /* no such zone, or not readable */
+  S_TZ_BAD_DATA   /* not a valid TZif file */
+};
+
+struct tzinfo {
+  /* Interval k runs from transitions[k - 1] (or the beginning of time)
+     until transitions[k] (or the end of time), so there is always one
+     more interval than there are transitions. */
+  std::vector<long long> transitions; /* UTC Unix times, ascending */
+  std::vector<int> utoff;  /* Wall clock offset per interval, seconds east */
+  std::vector<int> stdoff; /* Standard time offset per interval, seconds
+                              east (utoff less any daylight saving) */
+};
+
+struct tzcursor {
+  int interval; /* Interval of the last conversion */
+};
+
+/* Starts a cursor at the first interval */
+void S_tz_cursor_init(tzcursor *cursor);
+
+/*============================================================================
+ *    Int function S_tz_load
+ *
+ *    Reads $TZDIR/name, or /usr/share/zoneinfo/name without TZDIR.
+ *
+ *    RETURNS: S_TZ_OK, or an error code with tz left empty
+ *----------------------------------------------------------------------------*/
+int S_tz_load(const char *name, tzinfo *tz);
+
+/*============================================================================
+ *    Int function S_tz_parse
+ *
+ *    Parses TZif data (RFC 8536, versions 1 to 4)
+ *
+ *    RETURNS: S_TZ_OK, or S_TZ_BAD_DATA with tz left empty
+ *----------------------------------------------------------------------------*/
+int S_tz_parse(const char *data, std::size_t size, tzinfo *tz);
+
+/*============================================================================
+ *    Void function S_tz_utc2local
+ *
+ *    For each Unix time utc[i], writes the wall clock offset utoff[i]
+ *    (seconds east) and the standard time zone timezone[i] (hours east,
+ *    as posdata::timezone expects).  Either output may be nullptr.
+ *----------------------------------------------------------------------------*/
+void S_tz_utc2local(const tzinfo *tz, tzcursor *cursor, const long long *utc,
+                    int count, int *utoff, double *timezone);
+
+/*============================================================================
+ *    Void function S_tz_local2utc
+ *
+ *    For each local wall clock time local[i], given as seconds since
+ *    1 JAN 1970 00:00 on that clock (S_epoch with timezone 0), writes the
+ *    Unix time utc[i] and, if not nullptr, the standard time zone
+ *    timezone[i] in effect.
+ *
+ *    A time repeated when the clocks go back is taken as its first
+ *    occurrence; a time skipped when they go forward is read with the
+ *    offset before the change (so 02:30 becomes 03:30 daylight time).
+ *----------------------------------------------------------------------------*/
+void S_tz_local2utc(const tzinfo *tz, tzcursor *cursor, const long long *local,
+                    int count, long long *utc, double *timezone);
+
+}  // namespace solpos
+
+#endif  // SOLPOS_ZONEINFO_H_
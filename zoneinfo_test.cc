@@ -0,0 +1,186 @@
+#include "zoneinfo.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "solpos.h"
+
+namespace solpos {
+namespace {
+
+struct TzType {
+  int utoff;
+  bool isdst;
+};
+
+void Put(std::string *out, long long value, int bytes) {
+  for (int i = bytes - 1; i >= 0; --i)
+    out->push_back(static_cast<char>((value >> (8 * i)) & 0xFF));
+}
+
+void PutHeader(std::string *out, char version, int timecnt, int typecnt) {
+  out->append("TZif");
+  out->push_back(version);
+  out->append(15, '\0');
+  Put(out, 0, 4);        /* isutcnt */
+  Put(out, 0, 4);        /* isstdcnt */
+  Put(out, 0, 4);        /* leapcnt */
+  Put(out, timecnt, 4);  /* timecnt */
+  Put(out, typecnt, 4);  /* typecnt */
+  Put(out, 4, 4);        /* charcnt */
+}
+
+/* A version 2 file: a minimal version 1 block, then the real data */
+std::string MakeTzif(const std::vector<long long> &times,
+                     const std::vector<int> &type_of,
+                     const std::vector<TzType> &types,
+                     const std::string &footer) {
+  std::string out;
+
+  PutHeader(&out, '2', 0, 1);
+  Put(&out, 0, 6); /* utoff 0, isdst 0, desigidx 0 */
+  out.append("UTC", 4);
+
+  PutHeader(&out, '2', static_cast<int>(times.size()),
+            static_cast<int>(types.size()));
+  for (long long t : times) Put(&out, t, 8);
+  for (int k : type_of) out.push_back(static_cast<char>(k));
+  for (const TzType &type : types) {
+    Put(&out, type.utoff, 4);
+    out.push_back(type.isdst ? 1 : 0);
+    out.push_back(0);
+  }
+  out.append("ABC", 4);
+  out += "\n" + footer + "\n";
+  return out;
+}
+
+long long Utc(int year, int month, int day, int hour, int minute) {
+  return S_epoch(year, month, day, hour, minute, 0, 0.0);
+}
+
+std::string NewYork2020() {
+  return MakeTzif({Utc(2020, 3, 8, 7, 0), Utc(2020, 11, 1, 6, 0)}, {1, 0},
+                  {{-18000, false}, {-14400, true}}, "EST5EDT,M3.2.0,M11.1.0");
+}
+
+TEST(ZoneinfoTest, ParsesAndExpandsFooter) {
+  std::string data = NewYork2020();
+  tzinfo tz;
+
+  ASSERT_EQ(S_tz_parse(data.data(), data.size(), &tz), S_TZ_OK);
+  ASSERT_EQ(tz.utoff.size(), tz.transitions.size() + 1);
+  EXPECT_EQ(tz.transitions.size(), 2u + 2u * 30u); /* 2021 - 2050 */
+  EXPECT_EQ(tz.transitions[2], Utc(2021, 3, 14, 7, 0));
+  EXPECT_EQ(tz.transitions[3], Utc(2021, 11, 7, 6, 0));
+  EXPECT_EQ(tz.transitions.back(), Utc(2050, 11, 6, 6, 0));
+  for (std::size_t k = 1; k < tz.transitions.size(); ++k)
+    EXPECT_LT(tz.transitions[k - 1], tz.transitions[k]);
+  for (int stdoff : tz.stdoff) EXPECT_EQ(stdoff, -18000);
+
+  std::vector<long long> utc = {Utc(2019, 6, 1, 0, 0), Utc(2020, 3, 8, 6, 59),
+                                Utc(2020, 3, 8, 7, 0), Utc(2045, 3, 12, 6, 59),
+                                Utc(2045, 3, 12, 7, 0), Utc(2020, 7, 1, 0, 0)};
+  std::vector<int> utoff(utc.size());
+  std::vector<double> timezone(utc.size());
+  tzcursor cursor;
+  S_tz_cursor_init(&cursor);
+  S_tz_utc2local(&tz, &cursor, utc.data(), static_cast<int>(utc.size()),
+                 utoff.data(), timezone.data());
+  EXPECT_EQ(utoff, std::vector<int>({-18000, -18000, -14400, -18000, -14400,
+                                     -14400}));
+  for (double zone : timezone) EXPECT_EQ(zone, -5.0);
+}
+
+TEST(ZoneinfoTest, LocalToUtc) {
+  std::string data = NewYork2020();
+  tzinfo tz;
+  ASSERT_EQ(S_tz_parse(data.data(), data.size(), &tz), S_TZ_OK);
+
+  /* A time series across both changes of 2021, then out of order */
+  std::vector<long long> local = {
+      Utc(2021, 3, 14, 1, 59),  /* EST */
+      Utc(2021, 3, 14, 2, 30),  /* skipped: read as EST, i.e. 3:30 EDT */
+      Utc(2021, 3, 14, 3, 0),   /* EDT */
+      Utc(2021, 11, 7, 1, 30),  /* repeated: first (EDT) occurrence */
+      Utc(2021, 11, 7, 2, 0),   /* EST */
+      Utc(2020, 1, 1, 12, 0),   /* EST, backward jump */
+      Utc(2049, 7, 4, 12, 0)};  /* EDT, forward jump */
+  std::vector<long long> expected = {
+      Utc(2021, 3, 14, 6, 59), Utc(2021, 3, 14, 7, 30),
+      Utc(2021, 3, 14, 7, 0),  Utc(2021, 11, 7, 5, 30),
+      Utc(2021, 11, 7, 7, 0),  Utc(2020, 1, 1, 17, 0),
+      Utc(2049, 7, 4, 16, 0)};
+  std::vector<long long> utc(local.size());
+  std::vector<double> timezone(local.size());
+
+  tzcursor cursor;
+  S_tz_cursor_init(&cursor);
+  S_tz_local2utc(&tz, &cursor, local.data(), static_cast<int>(local.size()),
+                 utc.data(), timezone.data());
+  EXPECT_EQ(utc, expected);
+  for (double zone : timezone) EXPECT_EQ(zone, -5.0);
+
+  /* The same times one at a time with a fresh cursor */
+  for (std::size_t i = 0; i < local.size(); ++i) {
+    long long one;
+    S_tz_cursor_init(&cursor);
+    S_tz_local2utc(&tz, &cursor, &local[i], 1, &one, nullptr);
+    EXPECT_EQ(one, expected[i]) << "row " << i;
+  }
+}
+
+TEST(ZoneinfoTest, SouthernHemisphereFooterOnly) {
+  std::string data = MakeTzif({}, {}, {{36000, false}},
+                              "AEST-10AEDT,M10.1.0,M4.1.0/3");
+  tzinfo tz;
+
+  ASSERT_EQ(S_tz_parse(data.data(), data.size(), &tz), S_TZ_OK);
+  EXPECT_EQ(tz.transitions.size(), 2u * 101u); /* 1950 - 2050 */
+
+  std::vector<long long> utc = {Utc(2024, 4, 6, 15, 59), Utc(2024, 4, 6, 16, 0),
+                                Utc(2024, 10, 5, 15, 59),
+                                Utc(2024, 10, 5, 16, 0)};
+  std::vector<int> utoff(utc.size());
+  std::vector<double> timezone(utc.size());
+  tzcursor cursor;
+  S_tz_cursor_init(&cursor);
+  S_tz_utc2local(&tz, &cursor, utc.data(), 4, utoff.data(), timezone.data());
+  EXPECT_EQ(utoff, std::vector<int>({39600, 36000, 36000, 39600}));
+  for (double zone : timezone) EXPECT_EQ(zone, 10.0);
+}
+
+TEST(ZoneinfoTest, RejectsBadInput) {
+  tzinfo tz;
+  std::string data = NewYork2020();
+
+  EXPECT_EQ(S_tz_parse("TZif", 4, &tz), S_TZ_BAD_DATA);
+  EXPECT_EQ(S_tz_parse(data.data(), data.size() - 40, &tz), S_TZ_BAD_DATA);
+  EXPECT_TRUE(tz.utoff.empty());
+  EXPECT_EQ(S_tz_load("../../etc/passwd", &tz), S_TZ_NOT_FOUND);
+  EXPECT_EQ(S_tz_load("No/Such_Zone", &tz), S_TZ_NOT_FOUND);
+}
+
+TEST(ZoneinfoTest, SystemZoneinfo) {
+  tzinfo tz;
+
+  /* (only where the system has a zoneinfo database) */
+  if (S_tz_load("America/New_York", &tz) != S_TZ_OK) return;
+
+  std::vector<long long> utc = {Utc(2024, 3, 10, 6, 59),
+                                Utc(2024, 3, 10, 7, 0),
+                                Utc(2024, 11, 3, 5, 59),
+                                Utc(2024, 11, 3, 6, 0),
+                                Utc(2045, 3, 12, 7, 0)};
+  std::vector<int> utoff(utc.size());
+  tzcursor cursor;
+  S_tz_cursor_init(&cursor);
+  S_tz_utc2local(&tz, &cursor, utc.data(), static_cast<int>(utc.size()),
+                 utoff.data(), nullptr);
+  EXPECT_EQ(utoff,
+            std::vector<int>({-18000, -14400, -14400, -18000, -14400}));
+}
+
+}  // namespace
+}  // namespace solpos